@@ -0,0 +1,338 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ARAStarEngine.h"
+#include "DistanceKernels.h"
+#include "OccupancyGrid.h"
+#include "PathGrid.h"
+#include "SearchHeatmap.h"
+#include "HAL/PlatformTime.h"
+
+// How many expansions to do between looking at the clock
+static const int32 DeadlineCheckInterval = 64;
+
+AnytimeSearch::AnytimeSearch()
+{
+	Expansions = 0;
+	Seconds = 0.0;
+	GoalCell = INDEX_NONE;
+	StartCell = INDEX_NONE;
+	Start = FIntPoint::ZeroValue;
+	NextStart = FIntPoint::ZeroValue;
+	OriginCell = INDEX_NONE;
+	SizeY = 0;
+	Epsilon = 1.f;
+	EpsilonStep = 1.f;
+	CompletedEpsilon = MAX_flt;
+	bActive = false;
+	bIterationRunning = false;
+	FirstPathSeconds = 0.0;
+	FirstCost = 0;
+	Heatmap = nullptr;
+}
+
+bool AnytimeSearch::Begin(const PathGrid& Grid, const OccupancyGrid& Occupancy, const FPathQuery& InQuery, float InitialEpsilon, float InEpsilonStep, FPathResult& OutResult)
+{
+	OutResult.Reset();
+	const double StartTime = FPlatformTime::Seconds();
+
+	Query = InQuery;
+	SizeY = Grid.SizeY;
+	GoalCell = Grid.GetIndex(Query.Goal.X, Query.Goal.Y);
+	StartCell = Grid.GetIndex(Query.Start.X, Query.Start.Y);
+	Start = Query.Start;
+	NextStart = Query.Start;
+	OriginCell = StartCell;
+
+	Epsilon = FMath::Max(1.f, InitialEpsilon);
+	EpsilonStep = FMath::Max(0.01f, InEpsilonStep);
+	CompletedEpsilon = MAX_flt;
+	Expansions = 0;
+	Seconds = 0.0;
+	FirstPathSeconds = 0.0;
+	FirstCost = 0;
+	bActive = false;
+	bIterationRunning = false;
+
+	Space.Prepare(Grid.GetNumCells());
+	OpenList.Reset();
+	Inconsistent.Reset();
+
+	if (StartCell == GoalCell)
+	{
+		OutResult.bFound = true;
+		OutResult.Seconds = FPlatformTime::Seconds() - StartTime;
+		return true;
+	}
+
+	// a blocked goal can never be entered
+	if (Occupancy.IsBlocked(Query.Goal.X, Query.Goal.Y, Query.BlockingLayers))
+	{
+		OutResult.Seconds = FPlatformTime::Seconds() - StartTime;
+		return false;
+	}
+
+	// the tree grows from the goal
+	Space.Visit(GoalCell, 0, INDEX_NONE);
+	OpenList.HeapPush(FOpenEntry(Key(0, GoalCell), 0, GoalCell), FOpenEntryPredicate());
+
+	// the first path is what the agent waits for, so it is never cut short
+	const bool bCompleted = ImprovePath(Grid, Occupancy, MAX_dbl);
+	Seconds = FPlatformTime::Seconds() - StartTime;
+
+	if (!bCompleted || !Space.IsSeen(StartCell))
+	{
+		OutResult.Expansions = Expansions;
+		OutResult.Seconds = Seconds;
+		return false;
+	}
+
+	bActive = true;
+	CompletedEpsilon = Epsilon;
+	BuildResult(Grid, OutResult);
+	FirstPathSeconds = Seconds;
+	FirstCost = OutResult.Cost;
+	return true;
+}
+
+void AnytimeSearch::SetStart(const FIntPoint& NewStart)
+{
+	// the open list is keyed on the start, mixing keys towards two starts would end the iteration too early
+	NextStart = NewStart;
+}
+
+bool AnytimeSearch::Improve(const PathGrid& Grid, const OccupancyGrid& Occupancy, double MaxSeconds, FPathResult& OutResult)
+{
+	if (!bActive || IsOptimal())
+	{
+		return false;
+	}
+
+	const double StartTime = FPlatformTime::Seconds();
+
+	if (!bIterationRunning)
+	{
+		Epsilon = FMath::Max(1.f, CompletedEpsilon - EpsilonStep);
+		Start = NextStart;
+		StartCell = Grid.GetIndex(Start.X, Start.Y);
+		StartIteration();
+		bIterationRunning = true;
+	}
+
+	const bool bCompleted = ImprovePath(Grid, Occupancy, StartTime + MaxSeconds);
+	Seconds += FPlatformTime::Seconds() - StartTime;
+
+	if (!bCompleted)
+	{
+		return false;
+	}
+
+	bIterationRunning = false;
+	CompletedEpsilon = Epsilon;
+
+	// the agent may have walked somewhere the tree cannot reach any more
+	if (!Space.IsSeen(StartCell))
+	{
+		bActive = false;
+		return false;
+	}
+
+	BuildResult(Grid, OutResult);
+	return true;
+}
+
+int32 AnytimeSearch::GetCurrentCostFromOrigin(const PathGrid& Grid) const
+{
+	if (!bActive || !Space.IsSeen(OriginCell))
+	{
+		return FirstCost;
+	}
+
+	int32 Cost = 0;
+	for (int Cell = Space.GetParent(OriginCell); Cell != INDEX_NONE; Cell = Space.GetParent(Cell))
+	{
+		const FIntPoint Position = Grid.GetPosition(Cell);
+		Cost += (int32)Grid.GetTravelCost(Position.X, Position.Y);
+	}
+	return Cost;
+}
+
+bool AnytimeSearch::ImprovePath(const PathGrid& Grid, const OccupancyGrid& Occupancy, double Deadline)
+{
+	int32 SinceCheck = 0;
+
+	while (OpenList.Num() > 0)
+	{
+		// skip entries that were superseded by a better G or expanded already
+		const FOpenEntry& Top = OpenList.HeapTop();
+		if (Space.IsClosed(Top.Cell) || Top.G != Space.GetG(Top.Cell))
+		{
+			FOpenEntry Stale;
+			OpenList.HeapPop(Stale, FOpenEntryPredicate(), false);
+			continue;
+		}
+
+		// nothing left in the open list can improve the start by more than Epsilon
+		if (Space.IsSeen(StartCell) && Key(Space.GetG(StartCell), StartCell) <= Top.F)
+		{
+			return true;
+		}
+
+		if (++SinceCheck >= DeadlineCheckInterval)
+		{
+			SinceCheck = 0;
+			if (FPlatformTime::Seconds() >= Deadline)
+			{
+				return false;
+			}
+		}
+
+		FOpenEntry Current;
+		OpenList.HeapPop(Current, FOpenEntryPredicate(), false);
+		Space.Close(Current.Cell);
+		Expansions++;
+		if (Heatmap)
+		{
+			Heatmap->AddExpansion(Current.Cell);
+		}
+
+		const FIntPoint Position = Grid.GetPosition(Current.Cell);
+		// going backwards, the step into a neighbour costs the cell being left
+		const int32 StepCost = (int32)Grid.GetTravelCost(Position.X, Position.Y);
+
+		uint8 Available = Occupancy.GetPassableNeighbours(Position.X, Position.Y, Query.BlockingLayers);
+		// the start holds the agent itself, but the search still has to be able to reach it
+		for (int Direction = 0; Direction < 4; Direction++)
+		{
+			if (Position + PathSearchEngine::NeighbourOffsets[Direction] == Start)
+			{
+				Available |= 1 << Direction;
+			}
+		}
+
+		for (int Direction = 0; Direction < 4; Direction++)
+		{
+			if (!(Available & (1 << Direction)))
+			{
+				continue;
+			}
+
+			const int NextX = Position.X + PathSearchEngine::NeighbourOffsets[Direction].X;
+			const int NextY = Position.Y + PathSearchEngine::NeighbourOffsets[Direction].Y;
+			const int Next = Grid.GetIndex(NextX, NextY);
+
+			const int32 PossibleG = Current.G + StepCost;
+			if (!Space.IsSeen(Next) || PossibleG < Space.GetG(Next))
+			{
+				Space.Visit(Next, PossibleG, Current.Cell);
+
+				// a cell expanded in this iteration waits for the next one instead of being expanded twice
+				if (Space.IsClosed(Next))
+				{
+					Inconsistent.Add(Next);
+				}
+				else
+				{
+					OpenList.HeapPush(FOpenEntry(Key(PossibleG, Next), PossibleG, Next), FOpenEntryPredicate());
+				}
+			}
+		}
+	}
+
+	// the open list ran dry, the start is either reached or unreachable
+	return true;
+}
+
+void AnytimeSearch::StartIteration()
+{
+	// keep the entries that are still current, the others were expanded or superseded
+	TArray<FOpenEntry> Previous = MoveTemp(OpenList);
+	OpenList.Reset(Previous.Num() + Inconsistent.Num());
+	for (const FOpenEntry& Entry : Previous)
+	{
+		if (!Space.IsClosed(Entry.Cell) && Entry.G == Space.GetG(Entry.Cell))
+		{
+			OpenList.Add(FOpenEntry(0.f, Entry.G, Entry.Cell));
+		}
+	}
+	for (int32 Cell : Inconsistent)
+	{
+		OpenList.Add(FOpenEntry(0.f, Space.GetG(Cell), Cell));
+	}
+	Inconsistent.Reset();
+
+	// every key changes with the new Epsilon and start, so the heuristics are computed together (same values as Key)
+	const int32 NumEntries = OpenList.Num();
+	RekeyXs.SetNumUninitialized(NumEntries, false);
+	RekeyYs.SetNumUninitialized(NumEntries, false);
+	RekeyDistances.SetNumUninitialized(NumEntries, false);
+	for (int32 Index = 0; Index < NumEntries; Index++)
+	{
+		RekeyXs[Index] = (float)(OpenList[Index].Cell / SizeY);
+		RekeyYs[Index] = (float)(OpenList[Index].Cell % SizeY);
+	}
+	DistanceKernels::Distances(RekeyXs.GetData(), RekeyYs.GetData(), NumEntries, (float)Start.X, (float)Start.Y, RekeyDistances.GetData());
+	for (int32 Index = 0; Index < NumEntries; Index++)
+	{
+		OpenList[Index].F = OpenList[Index].G + Epsilon * RekeyDistances[Index];
+	}
+
+	// every cell may be expanded again, with the new Epsilon and start
+	Space.ClearClosed();
+	OpenList.Heapify(FOpenEntryPredicate());
+}
+
+void AnytimeSearch::BuildResult(const PathGrid& Grid, FPathResult& OutResult) const
+{
+	OutResult.Reset();
+
+	// the parents lead to the goal, which is the only cell without one. Costs are summed again because a parent
+	// may have got cheaper since its child was reached
+	for (int Cell = Space.GetParent(StartCell); Cell != INDEX_NONE; Cell = Space.GetParent(Cell))
+	{
+		const FIntPoint Position = Grid.GetPosition(Cell);
+		OutResult.Path.Add(Position);
+		OutResult.Cost += (int32)Grid.GetTravelCost(Position.X, Position.Y);
+	}
+
+	OutResult.bFound = true;
+	OutResult.Expansions = Expansions;
+	OutResult.Seconds = Seconds;
+}
+
+float AnytimeSearch::Key(int32 G, int Cell) const
+{
+	return G + Epsilon * PathSearchEngine::Heuristic(Cell / SizeY, Cell % SizeY, Start);
+}
+
+ARAStarEngine::ARAStarEngine()
+{
+	InitialEpsilon = 2.5f;
+	EpsilonStep = 0.5f;
+	MaxImproveSeconds = 0.001;
+}
+
+bool ARAStarEngine::FindPath(const PathGrid& Grid, const OccupancyGrid& Occupancy, const FPathQuery& Query, FPathResult& OutResult)
+{
+	const double StartTime = FPlatformTime::Seconds();
+	if (!Search.Begin(Grid, Occupancy, Query, InitialEpsilon, EpsilonStep, OutResult))
+	{
+		return false;
+	}
+
+	// spend what is left of the budget on better paths, keeping the last complete one
+	const double Deadline = FPlatformTime::Seconds() + MaxImproveSeconds;
+	while (Search.IsActive() && !Search.IsOptimal())
+	{
+		const double Remaining = Deadline - FPlatformTime::Seconds();
+		if (Remaining <= 0.0 || !Search.Improve(Grid, Occupancy, Remaining, Improved))
+		{
+			break;
+		}
+		OutResult = Improved;
+	}
+
+	OutResult.Expansions = Search.Expansions;
+	OutResult.Seconds = FPlatformTime::Seconds() - StartTime;
+	return true;
+}
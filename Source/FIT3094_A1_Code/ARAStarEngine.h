@@ -0,0 +1,171 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "PathSearch.h"
+
+/**
+ * Anytime Repairing A* (ARA*) for one query, kept alive so it can be improved a bit every tick.
+ *
+ * The search runs backwards from the goal, so the tree stays rooted at the goal while the agent walks:
+ * the start can move between iterations and the path from wherever the agent is comes from the parents.
+ * Each iteration expands by G + Epsilon * H and stops once the start cannot be improved within the bound,
+ * giving a path at most Epsilon times the optimal. Later iterations lower Epsilon and only revisit the cells
+ * whose G went down (the inconsistent ones) instead of searching from scratch. Once an iteration at
+ * Epsilon 1 completes the path is optimal.
+ *
+ * As in the bidirectional engine, searching backwards charges the travel cost of the cell being left.
+ */
+class FIT3094_A1_CODE_API AnytimeSearch
+{
+
+public:
+
+	AnytimeSearch();
+
+	// Forget the previous query and run the first iteration at InitialEpsilon. Returns OutResult.bFound
+	bool Begin(const PathGrid& Grid, const OccupancyGrid& Occupancy, const FPathQuery& Query, float InitialEpsilon, float InEpsilonStep, FPathResult& OutResult);
+
+	// The agent moved, the next iteration aims at the new start (the one running keeps the old one)
+	void SetStart(const FIntPoint& NewStart);
+
+	// Keep improving for up to MaxSeconds. Returns true with the better path in OutResult when an iteration completed
+	bool Improve(const PathGrid& Grid, const OccupancyGrid& Occupancy, double MaxSeconds, FPathResult& OutResult);
+
+	// Is there a query with a path being improved
+	bool IsActive() const
+	{
+		return bActive;
+	}
+	// Has an iteration at Epsilon 1 completed, nothing left to improve
+	bool IsOptimal() const
+	{
+		return bActive && CompletedEpsilon <= 1.f;
+	}
+
+	// The cell the last completed iteration searched from, the start of its path
+	int GetStartCell() const
+	{
+		return StartCell;
+	}
+
+	// Has the search reached the cell, so its tree depends on the terrain there
+	bool HasReached(int Cell) const
+	{
+		return bActive && Space.IsSeen(Cell);
+	}
+
+	// The bound of the last completed iteration
+	float GetEpsilon() const
+	{
+		return CompletedEpsilon;
+	}
+
+	// Metrics of the current query: time and cost of the first path, and the cost from the original start now
+	double GetTimeToFirstPath() const
+	{
+		return FirstPathSeconds;
+	}
+	int32 GetFirstCost() const
+	{
+		return FirstCost;
+	}
+	int32 GetCurrentCostFromOrigin(const PathGrid& Grid) const;
+
+	// Total expansions and time spent on the current query
+	int32 Expansions;
+	double Seconds;
+
+	// Stop improving, the agent picked another goal
+	void End()
+	{
+		bActive = false;
+	}
+
+	// Count the expansions of this and later queries into the heatmap, nullptr to stop
+	void SetHeatmap(SearchHeatmap* NewHeatmap)
+	{
+		Heatmap = NewHeatmap;
+	}
+
+private:
+
+	// Expand until the start is within the bound or the time runs out, returns true when the iteration completed
+	bool ImprovePath(const PathGrid& Grid, const OccupancyGrid& Occupancy, double Deadline);
+
+	// Rebuild the open list with the current Epsilon and start, taking the inconsistent cells back in
+	void StartIteration();
+
+	// Walk the parents from the start to the goal
+	void BuildResult(const PathGrid& Grid, FPathResult& OutResult) const;
+
+	float Key(int32 G, int Cell) const;
+
+	SearchSpace Space;
+	TArray<FOpenEntry> OpenList;
+
+	// Cells whose G went down after they were expanded in the current iteration
+	TArray<int32> Inconsistent;
+
+	// Scratch for re-keying the open list, the positions of its cells and their distances to the start
+	TArray<float> RekeyXs;
+	TArray<float> RekeyYs;
+	TArray<float> RekeyDistances;
+
+	FPathQuery Query;
+	int GoalCell;
+	// The start of the current iteration, which every key in the open list aims at, and the one the next iteration takes
+	int StartCell;
+	FIntPoint Start;
+	FIntPoint NextStart;
+	int OriginCell;
+	int SizeY;
+
+	float Epsilon;
+	float EpsilonStep;
+	float CompletedEpsilon;
+	bool bActive;
+	bool bIterationRunning;
+
+	double FirstPathSeconds;
+	int32 FirstCost;
+
+	SearchHeatmap* Heatmap;
+
+};
+
+/**
+ * Bounded-suboptimal engine for one-off queries: a first path within InitialEpsilon of the optimal,
+ * then improved until the time budget runs out
+ */
+class FIT3094_A1_CODE_API ARAStarEngine : public PathSearchEngine
+{
+
+public:
+
+	ARAStarEngine();
+
+	virtual FName GetName() const override
+	{
+		return TEXT("ARAStar");
+	}
+
+	virtual bool FindPath(const PathGrid& Grid, const OccupancyGrid& Occupancy, const FPathQuery& Query, FPathResult& OutResult) override;
+
+	virtual void SetHeatmap(SearchHeatmap* Heatmap) override
+	{
+		Search.SetHeatmap(Heatmap);
+	}
+
+	float InitialEpsilon;
+	float EpsilonStep;
+	// Time allowed for improving after the first path
+	double MaxImproveSeconds;
+
+private:
+
+	AnytimeSearch Search;
+	FPathResult Improved;
+
+};
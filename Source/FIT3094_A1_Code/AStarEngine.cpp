@@ -0,0 +1,173 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "AStarEngine.h"
+#include "GoalBounds.h"
+#include "OccupancyGrid.h"
+#include "PathGrid.h"
+#include "SearchHeatmap.h"
+#include "HAL/PlatformTime.h"
+
+AStarEngine::AStarEngine()
+{
+	Bounds = nullptr;
+	PrunedSearches = 0;
+	Fallbacks = 0;
+	Unreachable = 0;
+	BlockedBound = MAX_flt;
+	Rooms = nullptr;
+	Heatmap = nullptr;
+}
+
+void AStarEngine::SetGoalBounds(const GoalBounds* NewBounds)
+{
+	LogPruning();
+	Bounds = NewBounds;
+}
+
+void AStarEngine::SetRooms(const RoomGraph* NewRooms)
+{
+	LogPruning();
+	Rooms = NewRooms;
+}
+
+void AStarEngine::LogPruning()
+{
+	if (PrunedSearches > 0)
+	{
+		UE_LOG(LogTemp, Log, TEXT("Pruning with %s: %d pruned searches, %d fell back to a full search (blocked or possibly not optimal), %d ruled out by the walls alone"),
+			Bounds && Rooms ? TEXT("goal bounds and rooms") : Bounds ? TEXT("goal bounds") : TEXT("rooms"), PrunedSearches, Fallbacks, Unreachable);
+	}
+
+	PrunedSearches = 0;
+	Fallbacks = 0;
+	Unreachable = 0;
+}
+
+bool AStarEngine::FindPath(const PathGrid& Grid, const OccupancyGrid& Occupancy, const FPathQuery& Query, FPathResult& OutResult)
+{
+	if (!Bounds && !Rooms)
+	{
+		return Search(Grid, Occupancy, Query, false, OutResult);
+	}
+
+	// only the rooms between the start and the goal can hold the path, and when walls part them there is nothing to search
+	PrunedSearches++;
+	if (Rooms && !Rooms->MarkUsefulRooms(Grid.GetIndex(Query.Start.X, Query.Start.Y), Grid.GetIndex(Query.Goal.X, Query.Goal.Y), UsefulRooms))
+	{
+		Unreachable++;
+		OutResult.Reset();
+		return false;
+	}
+
+	// the bounds and rooms only know the terrain, agents or food may have blocked every way they allow. When they
+	// blocked a move the pruning allowed, a path through there may have been cheaper than the detour taken: the
+	// pruned path is only the answer when no such move could have led to a cheaper one
+	if (Search(Grid, Occupancy, Query, true, OutResult) && BlockedBound >= OutResult.Cost)
+	{
+		return true;
+	}
+
+	Fallbacks++;
+	const int32 PrunedExpansions = OutResult.Expansions;
+	const double PrunedSeconds = OutResult.Seconds;
+	Search(Grid, Occupancy, Query, false, OutResult);
+	OutResult.Expansions += PrunedExpansions;
+	OutResult.Seconds += PrunedSeconds;
+	return OutResult.bFound;
+}
+
+bool AStarEngine::Search(const PathGrid& Grid, const OccupancyGrid& Occupancy, const FPathQuery& Query, bool bPrune, FPathResult& OutResult)
+{
+	OutResult.Reset();
+	const double StartTime = FPlatformTime::Seconds();
+
+	Space.Prepare(Grid.GetNumCells());
+	OpenList.Reset();
+	BlockedBound = MAX_flt;
+	const uint8 WallLayers = Query.BlockingLayers & OccupancyGrid::LayerMask(OccupancyGrid::Walls);
+
+	const int StartCell = Grid.GetIndex(Query.Start.X, Query.Start.Y);
+	const int GoalCell = Grid.GetIndex(Query.Goal.X, Query.Goal.Y);
+
+	// explore the start node, it has no parent and costs nothing
+	Space.Visit(StartCell, 0, INDEX_NONE);
+	OpenList.HeapPush(FOpenEntry(Heuristic(Query.Start.X, Query.Start.Y, Query.Goal), 0, StartCell), FOpenEntryPredicate());
+
+	while (OpenList.Num() > 0)
+	{
+		// take the cheapest node, skipping entries that were superseded by a better G
+		FOpenEntry Current;
+		OpenList.HeapPop(Current, FOpenEntryPredicate(), false);
+		if (Space.IsClosed(Current.Cell) || Current.G != Space.GetG(Current.Cell))
+		{
+			continue;
+		}
+
+		Space.Close(Current.Cell);
+		OutResult.Expansions++;
+		if (Heatmap)
+		{
+			Heatmap->AddExpansion(Current.Cell);
+		}
+
+		// if the node is the goal node, finish and generate the path
+		if (Current.Cell == GoalCell)
+		{
+			BuildPath(Grid, Space, GoalCell, OutResult);
+			break;
+		}
+
+		// Check the neighbours, walls, other agents and disliked food are filtered out by the occupancy
+		const FIntPoint Position = Grid.GetPosition(Current.Cell);
+		const uint8 Available = Occupancy.GetPassableNeighbours(Position.X, Position.Y, Query.BlockingLayers);
+		// the moves only agents or food block, which the pruning cannot know about
+		const uint8 Blocked = bPrune ? Occupancy.GetPassableNeighbours(Position.X, Position.Y, WallLayers) & ~Available : 0;
+
+		for (int Direction = 0; Direction < 4; Direction++)
+		{
+			if (!((Available | Blocked) & (1 << Direction)))
+			{
+				continue;
+			}
+
+			// no optimal path to the goal leaves this cell with this move
+			if (bPrune && Bounds && !Bounds->MayReach(Current.Cell, Direction, Query.Goal))
+			{
+				continue;
+			}
+
+			const int NextX = Position.X + NeighbourOffsets[Direction].X;
+			const int NextY = Position.Y + NeighbourOffsets[Direction].Y;
+			const int Next = Grid.GetIndex(NextX, NextY);
+			if (Space.IsClosed(Next))
+			{
+				continue;
+			}
+
+			// the cell is in a dead end for this query
+			if (bPrune && Rooms && !Rooms->IsUseful(Next, UsefulRooms))
+			{
+				continue;
+			}
+
+			// a move the pruning allows but something stands in the way of, remember the cheapest path it could start
+			if (Blocked & (1 << Direction))
+			{
+				BlockedBound = FMath::Min(BlockedBound, Current.G + Grid.GetTravelCost(NextX, NextY) + Heuristic(NextX, NextY, Query.Goal));
+				continue;
+			}
+
+			// possible G equals the current G adding the cost of entering the next node
+			const int32 PossibleG = Current.G + (int32)Grid.GetTravelCost(NextX, NextY);
+			if (!Space.IsSeen(Next) || PossibleG < Space.GetG(Next))
+			{
+				Space.Visit(Next, PossibleG, Current.Cell);
+				OpenList.HeapPush(FOpenEntry(PossibleG + Heuristic(NextX, NextY, Query.Goal), PossibleG, Next), FOpenEntryPredicate());
+			}
+		}
+	}
+
+	OutResult.Seconds = FPlatformTime::Seconds() - StartTime;
+	return OutResult.bFound;
+}
@@ -0,0 +1,71 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "PathSearch.h"
+#include "RoomGraph.h"
+
+/**
+ * Plain A* over the four-connected grid, with the travel cost of the cell being entered as the edge cost
+ */
+class FIT3094_A1_CODE_API AStarEngine : public PathSearchEngine
+{
+
+public:
+
+	virtual FName GetName() const override
+	{
+		return TEXT("AStar");
+	}
+
+	AStarEngine();
+
+	virtual bool FindPath(const PathGrid& Grid, const OccupancyGrid& Occupancy, const FPathQuery& Query, FPathResult& OutResult) override;
+
+	virtual void SetGoalBounds(const GoalBounds* Bounds) override;
+
+	virtual void SetRooms(const RoomGraph* Rooms) override;
+	virtual bool CanPruneRooms() const override
+	{
+		return true;
+	}
+
+	virtual void SetHeatmap(SearchHeatmap* NewHeatmap) override
+	{
+		Heatmap = NewHeatmap;
+	}
+
+private:
+
+	// One search, skipping the moves the goal bounds and the dead-end rooms rule out when bPrune is set
+	bool Search(const PathGrid& Grid, const OccupancyGrid& Occupancy, const FPathQuery& Query, bool bPrune, FPathResult& OutResult);
+
+	// Log how pruning did and start counting again, for a change of bounds or rooms
+	void LogPruning();
+
+	// Moves are pruned with these when set
+	const GoalBounds* Bounds;
+
+	// Dead-end rooms are skipped with these when set, the mask holding the rooms of the current query
+	const RoomGraph* Rooms;
+	RoomMask UsefulRooms;
+
+	// The lowest F of a move the last pruned search would have taken but agents or food blocked. A* expands every
+	// cell with an F below the cost it finds, so a found path costing no more than this is as cheap as a full search's
+	float BlockedBound;
+
+	// How often pruning was used on the current map, how often it failed or could not be trusted and the full search
+	// had to run, and how often the rooms showed there was no path before searching
+	int32 PrunedSearches;
+	int32 Fallbacks;
+	int32 Unreachable;
+
+	// Expansions are counted into it when set
+	SearchHeatmap* Heatmap;
+
+	// Reused between searches so a query does not allocate
+	SearchSpace Space;
+	TArray<FOpenEntry> OpenList;
+
+};
@@ -0,0 +1,157 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ActorPool.h"
+#include "Agent.h"
+#include "Food.h"
+#include "Engine/World.h"
+
+ActorPool::ActorPool()
+{
+	FoodRequests = 0;
+	FoodHits = 0;
+	AgentRequests = 0;
+	AgentHits = 0;
+	TileRequests = 0;
+	TileHits = 0;
+}
+
+AFood* ActorPool::AcquireFood(UWorld* World, TSubclassOf<AActor> FoodBlueprint, const FVector& Position)
+{
+	FoodRequests++;
+
+	// reuse the most recently released food that is still alive
+	while (FreeFood.Num() > 0)
+	{
+		AFood* Food = FreeFood.Pop(false);
+		if (IsValid(Food))
+		{
+			FoodHits++;
+			Activate(Food, Position);
+			// pick a new type and the matching material, like a freshly spawned food
+			Food->Reinitialise();
+			return Food;
+		}
+	}
+
+	// nothing to reuse, so spawn a new one
+	return World->SpawnActor<AFood>(FoodBlueprint, Position, FRotator::ZeroRotator);
+}
+
+void ActorPool::ReleaseFood(AFood* Food)
+{
+	if (!IsValid(Food))
+	{
+		return;
+	}
+
+	Deactivate(Food);
+	FreeFood.Add(Food);
+}
+
+AAgent* ActorPool::AcquireAgent(UWorld* World, TSubclassOf<AActor> AgentBlueprint, const FVector& Position)
+{
+	AgentRequests++;
+
+	while (FreeAgents.Num() > 0)
+	{
+		AAgent* Agent = FreeAgents.Pop(false);
+		if (IsValid(Agent))
+		{
+			AgentHits++;
+			Activate(Agent, Position);
+			// reset health, type, material and timer as BeginPlay would have done
+			Agent->Reinitialise();
+			return Agent;
+		}
+	}
+
+	return World->SpawnActor<AAgent>(AgentBlueprint, Position, FRotator::ZeroRotator);
+}
+
+void ActorPool::ReleaseAgent(AAgent* Agent)
+{
+	if (!IsValid(Agent) || FreeAgents.Contains(Agent))
+	{
+		return;
+	}
+
+	Deactivate(Agent);
+	FreeAgents.Add(Agent);
+}
+
+AActor* ActorPool::AcquireTile(UWorld* World, TSubclassOf<AActor> TileBlueprint, const FVector& Position)
+{
+	TileRequests++;
+
+	if (TArray<AActor*>* Free = FreeTiles.Find(TileBlueprint.Get()))
+	{
+		while (Free->Num() > 0)
+		{
+			AActor* Tile = Free->Pop(false);
+			if (IsValid(Tile))
+			{
+				TileHits++;
+				Activate(Tile, Position);
+				return Tile;
+			}
+		}
+	}
+
+	return World->SpawnActor(TileBlueprint, &Position, &FRotator::ZeroRotator);
+}
+
+void ActorPool::ReleaseTile(AActor* Tile)
+{
+	if (!IsValid(Tile))
+	{
+		return;
+	}
+
+	Deactivate(Tile);
+	FreeTiles.FindOrAdd(Tile->GetClass()).Add(Tile);
+}
+
+void ActorPool::Empty()
+{
+	FreeFood.Empty();
+	FreeAgents.Empty();
+	FreeTiles.Empty();
+}
+
+float ActorPool::GetFoodHitRate() const
+{
+	return FoodRequests > 0 ? (float)FoodHits / FoodRequests : 0.f;
+}
+
+float ActorPool::GetAgentHitRate() const
+{
+	return AgentRequests > 0 ? (float)AgentHits / AgentRequests : 0.f;
+}
+
+float ActorPool::GetTileHitRate() const
+{
+	return TileRequests > 0 ? (float)TileHits / TileRequests : 0.f;
+}
+
+void ActorPool::LogStats() const
+{
+	UE_LOG(LogTemp, Log, TEXT("Food Pool: %d/%d hits (%.1f%%), %d pooled"), FoodHits, FoodRequests, GetFoodHitRate() * 100.f, FreeFood.Num());
+	UE_LOG(LogTemp, Log, TEXT("Agent Pool: %d/%d hits (%.1f%%), %d pooled"), AgentHits, AgentRequests, GetAgentHitRate() * 100.f, FreeAgents.Num());
+	UE_LOG(LogTemp, Log, TEXT("Tile Pool: %d/%d hits (%.1f%%)"), TileHits, TileRequests, GetTileHitRate() * 100.f);
+}
+
+void ActorPool::Deactivate(AActor* Actor)
+{
+	Actor->SetActorHiddenInGame(true);
+	Actor->SetActorEnableCollision(false);
+	Actor->SetActorTickEnabled(false);
+}
+
+void ActorPool::Activate(AActor* Actor, const FVector& Position)
+{
+	Actor->SetActorLocation(Position);
+	Actor->SetActorHiddenInGame(false);
+	Actor->SetActorEnableCollision(true);
+	Actor->SetActorTickEnabled(Actor->PrimaryActorTick.bCanEverTick);
+}
@@ -0,0 +1,69 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+
+class AFood;
+class AAgent;
+
+/**
+ * Keeps eaten food and starved agents around so they can be recycled
+ * instead of destroying them and spawning new actors every time
+ */
+class FIT3094_A1_CODE_API ActorPool
+{
+
+public:
+
+	ActorPool();
+
+	// Get a food at the position, reusing a released one when there is any
+	AFood* AcquireFood(UWorld* World, TSubclassOf<AActor> FoodBlueprint, const FVector& Position);
+	// Hide the food and keep it for later instead of destroying it
+	void ReleaseFood(AFood* Food);
+
+	// Get an agent at the position, reusing a released one when there is any
+	AAgent* AcquireAgent(UWorld* World, TSubclassOf<AActor> AgentBlueprint, const FVector& Position);
+	// Hide the agent and keep it for later instead of destroying it, releasing an agent twice does nothing
+	void ReleaseAgent(AAgent* Agent);
+
+	// Get a map tile of the blueprint at the position, reusing a released one of the same class when there is any
+	AActor* AcquireTile(UWorld* World, TSubclassOf<AActor> TileBlueprint, const FVector& Position);
+	// Hide the tile and keep it for the next chunk that streams in
+	void ReleaseTile(AActor* Tile);
+
+	// Forget every pooled actor (the world owns them, so nothing is destroyed here)
+	void Empty();
+
+	// The fraction of acquire calls that were served from the pool
+	float GetFoodHitRate() const;
+	float GetAgentHitRate() const;
+	float GetTileHitRate() const;
+
+	// Write the pool statistics to the log
+	void LogStats() const;
+
+private:
+
+	// Disable an actor so it does not show, collide or tick while it is pooled
+	static void Deactivate(AActor* Actor);
+	// Move a pooled actor to its new position and enable it again
+	static void Activate(AActor* Actor, const FVector& Position);
+
+	// Released actors waiting to be reused
+	TArray<AFood*> FreeFood;
+	TArray<AAgent*> FreeAgents;
+	// Tiles are pooled per blueprint
+	TMap<UClass*, TArray<AActor*>> FreeTiles;
+
+	// Statistics for the hit rates
+	int FoodRequests;
+	int FoodHits;
+	int AgentRequests;
+	int AgentHits;
+	int TileRequests;
+	int TileHits;
+
+};
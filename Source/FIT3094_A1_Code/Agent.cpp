@@ -2,7 +2,7 @@
 
 
 #include "Agent.h"
-#include "EngineUtils.h"
+#include "FrameArena.h"
 
 // initialize the counter
 int AAgent::Counter = 0;
@@ -22,6 +22,21 @@ AAgent::AAgent()
 	MoveSpeed = 100;
 	Tolerance = 20;
 	HasStart = false;
+	WaitingForGoal = false;
+	WantsToMove = false;
+	HasMoved = false;
+	LowDetail = false;
+	StepTarget = nullptr;
+	StepDistance = 0.f;
+	Asleep = false;
+	StepsAsleep = false;
+	SleepTime = 0.0;
+	StartNode = nullptr;
+	GoalNode = nullptr;
+	LastNode = nullptr;
+	ClaimedNode = nullptr;
+	CurrentGoal = nullptr;
+	CurrentGoalGeneration = 0;
 	SetupPreferredFoodType();
 }
 
@@ -30,11 +45,12 @@ void AAgent::BeginPlay()
 {
 	Super::BeginPlay();
 
-	// Set a timer for every two seconds and call the decrease health function
-	GetWorldTimerManager().SetTimer(TimerHandle, this, &AAgent::DecreaseHealth, 2.0f, true, 2.0f);
-	
-	// Set up the level generator reference
-	SetUpLevelGeneratorRef();
+	// Set up the pathfinding subsystem reference
+	SetUpPathfindingRef();
+
+	// Schedule the health to drop in two seconds, and every two seconds from then on (see HandleEvent)
+	HealthEvent = Pathfinding->Events.Schedule(GetWorld()->GetTimeSeconds() + 2.0, EScheduledEvent::HealthDecay, this);
+
 	// Set up the material of the agent
 	SetupMaterial();
 }
@@ -46,15 +62,111 @@ void AAgent::DecreaseHealth()
 
 	if(Health <= 0)
 	{
-		GetWorldTimerManager().ClearTimer(TimerHandle);
-		Destroy();
+		Despawn();
 	}
 }
 
+void AAgent::Despawn()
+{
+	Pathfinding->Events.Cancel(HealthEvent);
+	Pathfinding->Events.Cancel(ArrivalEvent);
+	Asleep = false;
+	StepsAsleep = false;
+	EndAnytimeSearch();
+	// let the food it was going for be given to someone else
+	Pathfinding->Assignment.Cancel(this);
+	// the pooled agent stays alive, so the nodes it occupies have to be released by hand
+	ReleaseOccupiedNodes();
+	Path.Reset();
+	WantsToMove = false;
+	HasMoved = false;
+	// give the agent back to the pool instead of destroying it
+	Pathfinding->Pool.ReleaseAgent(this);
+}
+
+// Reset the agent to a freshly spawned state when the pool reuses it
+void AAgent::Reinitialise()
+{
+	// give it a new id for logging
+	Counter++;
+	ID = Counter;
+
+	Health = 50;
+	HasStart = false;
+	WaitingForGoal = false;
+	WantsToMove = false;
+	HasMoved = false;
+	// the pool placed the actor, the level generator picks the detail again next frame
+	LowDetail = false;
+	StepTarget = nullptr;
+	StepDistance = 0.f;
+	Asleep = false;
+	StepsAsleep = false;
+	StartNode = nullptr;
+	GoalNode = nullptr;
+	LastNode = nullptr;
+	ClaimedNode = nullptr;
+	CurrentGoal = nullptr;
+	Path.Reset();
+	Anytime.End();
+
+	// pick a new type and the matching material
+	SetupPreferredFoodType();
+	SetupMaterial();
+
+	// restart the health drops, as BeginPlay would have done
+	Pathfinding->Events.Cancel(HealthEvent);
+	HealthEvent = Pathfinding->Events.Schedule(GetWorld()->GetTimeSeconds() + 2.0, EScheduledEvent::HealthDecay, this);
+}
+
+void AAgent::HandleEvent(const FScheduledEvent& Event, double MovedUntil)
+{
+	switch (Event.Kind)
+	{
+	case EScheduledEvent::Arrival:
+		// the step ends in this tick's movement phase, an agent woken since has its own way there
+		WakeUp(MovedUntil);
+		break;
+	case EScheduledEvent::HealthDecay:
+		// two seconds from when it was due rather than when it fired, as a looping timer does
+		HealthEvent = Pathfinding->Events.Schedule(Event.Time + 2.0, EScheduledEvent::HealthDecay, this);
+		DecreaseHealth();
+		break;
+	default:
+		break;
+	}
+}
+
+void AAgent::FallAsleep()
+{
+	Asleep = true;
+	SetActorTickEnabled(false);
+}
+
+void AAgent::WakeUp(double MovedUntil)
+{
+	if (!Asleep)
+	{
+		return;
+	}
+
+	// the step went on while the agent slept, the movement phase carries on from MovedUntil
+	if (StepsAsleep)
+	{
+		StepDistance += MoveSpeed * (float)(MovedUntil - SleepTime);
+		WantsToMove = true;
+	}
+	Pathfinding->Events.Cancel(ArrivalEvent);
+	Asleep = false;
+	StepsAsleep = false;
+	SetActorTickEnabled(true);
+}
+
 // Called every frame
 void AAgent::Tick(float DeltaTime)
 {
 	Super::Tick(DeltaTime);
+	WantsToMove = false;
 
 	// if the agent is the first time starting their action
 	if (!HasStart) {
@@ -64,6 +176,12 @@ void AAgent::Tick(float DeltaTime)
 		CalculateAStar();
 	}
 
+	// stay put until the food assignment hands out a goal, ReceiveGoal wakes the agent and plans the path then
+	if (WaitingForGoal) {
+		FallAsleep();
+		return;
+	}
+
 	// A tricky way to check if the agent has overlayed with the goal food
 	// if the agent reaches the end of the path
 	if (Path.Num() == 0) {
@@ -74,7 +192,7 @@ void AAgent::Tick(float DeltaTime)
 	}
 
 	// If the current goal is not valid (be eaten by other agents, etc.) and the agent has not reached good 
-	if (!IsValid(CurrentGoal) && Path.Num() > 0) {
+	if (!IsGoalValid() && Path.Num() > 0) {
 		// search goal and calculate path
 		SearchGoal();
 		CalculateAStar();
@@ -95,83 +213,197 @@ void AAgent::Tick(float DeltaTime)
 
 		// A tricky way to deal with the food that generates on the current paths but not the current goal
 		// preventing the agent from going through the food
-		// If the next node contains a food
-		if (AFood* food = Cast<AFood>(Path[0]->ObjectAtLocation)) {
-			// If the food is not the current goal and the agent likes this food
-			if (food != CurrentGoal && food->Type == GetPreferredFoodType()) {
-				// search goal
-				SearchGoal();
-				// recalculate path
-				CalculateAStar();
-				// stop the current tick
-				return;
-			}
+		// If the next node contains a food the agent likes and it is not the current goal
+		if (Path[0] != GoalNode && Pathfinding->Occupancy.Test(Path[0]->X, Path[0]->Y, OccupancyGrid::GetFoodLayer(GetPreferredFoodType()))) {
+			// search goal
+			SearchGoal();
+			// recalculate path
+			CalculateAStar();
+			// stop the current tick
+			return;
 		}
 
-		// 'occupy' the next node, preventing agents from crashing
-		Path[0]->ObjectAtLocation = this;
+		// the path ahead may have got better since the last tick
+		ImproveAnytimePath();
 
-		// Move the agent
-		FVector CurrentPosition = GetActorLocation();
-		
-		float TargetXPos = Path[0]->X * ALevelGenerator::GRID_SIZE_WORLD;
-		float TargetYPos = Path[0]->Y * ALevelGenerator::GRID_SIZE_WORLD;
+		// the level generator moves every agent that gets here together, once they have all ticked
+		WantsToMove = true;
+	}
+}
 
-		FVector TargetPosition(TargetXPos, TargetYPos, CurrentPosition.Z);
+// the node to bid for in the movement phase
+GridNode* AAgent::GetNodeToClaim() const {
+	return WantsToMove && Path.Num() > 0 && ClaimedNode != Path[0] ? Path[0] : nullptr;
+}
 
-		FVector Direction = TargetPosition - CurrentPosition;
-		Direction.Normalize();
+// the bid for the next node was won
+void AAgent::ClaimNextNode() {
+	// 'occupy' the next node, preventing agents from crashing
+	if (Pathfinding->OccupyNode(Path[0], this)) {
+		ClaimedNode = Path[0];
+	}
+}
 
-		CurrentPosition += Direction * MoveSpeed * DeltaTime;
-		SetActorLocation(CurrentPosition);
+// walk towards the claimed node, may run on any thread
+void AAgent::StepMovement(float DeltaTime) {
+	// agents that lost the bid for their next node wait, their next tick plans around whoever won it
+	HasMoved = false;
+	if (!WantsToMove || Path.Num() == 0 || ClaimedNode != Path[0]) {
+		return;
+	}
 
-		UE_LOG(LogClass, Log, TEXT("Agent%d CurrentPosition X: %d Y: %d"), ID, (int)(CurrentPosition.X/ ALevelGenerator::GRID_SIZE_WORLD), (int)(CurrentPosition.Y / ALevelGenerator::GRID_SIZE_WORLD));
+	float TargetXPos = Path[0]->X * ALevelGenerator::GRID_SIZE_WORLD;
+	float TargetYPos = Path[0]->Y * ALevelGenerator::GRID_SIZE_WORLD;
 
-		//UE_LOG(LogClass, Log, TEXT("Agent%d CurrentTarget%d X: %d Y: %d"), ID, Path.Num(), Path[0]->X, Path[0]->Y);
+	// nobody is looking, so only count how far the agent walked and move the actor once it gets to the node
+	if (LowDetail) {
+		// a replan mid step turned the agent towards another node, it walks on from where it got to
+		if (StepTarget != Path[0]) {
+			StepOrigin = GetSimulatedLocation();
+			StepTarget = Path[0];
+			StepDistance = 0.f;
+		}
 
-		// if the distance between the current position and the target position less than the tolerance
-		if(FVector::Dist(CurrentPosition, TargetPosition) <= Tolerance)
-		{
-			// set the actor current position as the position of the next node
-			CurrentPosition = TargetPosition;
-			// 'release' the last node, so other agents now can go through that node
-			LastNode->ObjectAtLocation = nullptr;
-			// the last node now should be the current node which is Path[0]
-			LastNode = Path[0];
-			// has the agent has already been at Path[0], remove it from the path
-			Path.RemoveAt(0);
+		FVector TargetPosition(TargetXPos, TargetYPos, StepOrigin.Z);
+		StepDistance += MoveSpeed * DeltaTime;
+
+		// the smooth walk below comes within the tolerance on the same frame, and stops at the same place short of the node
+		if (FVector::Dist(StepOrigin, TargetPosition) - StepDistance <= Tolerance) {
+			StepOrigin = GetSimulatedLocation();
+			StepTarget = nullptr;
+			StepDistance = 0.f;
+			MoveLocation = StepOrigin;
+			HasMoved = true;
+			ArriveAtNode();
 		}
+		return;
 	}
-}
 
-// set up the level generator reference
-void AAgent::SetUpLevelGeneratorRef() {
-	// nullify the pointer
-	LevelGenerator = nullptr;
-	// loop through all the actors in the world
-	for (TActorIterator<AActor> ActorItr(GetWorld()); ActorItr; ++ActorItr)
+	// Move the agent
+	FVector CurrentPosition = GetActorLocation();
+
+	FVector TargetPosition(TargetXPos, TargetYPos, CurrentPosition.Z);
+
+	FVector Direction = TargetPosition - CurrentPosition;
+	Direction.Normalize();
+
+	CurrentPosition += Direction * MoveSpeed * DeltaTime;
+	// the actor is moved on the game thread, by ApplyMovement
+	MoveLocation = CurrentPosition;
+	HasMoved = true;
+
+	//UE_LOG(LogClass, Log, TEXT("Agent%d CurrentTarget%d X: %d Y: %d"), ID, Path.Num(), Path[0]->X, Path[0]->Y);
+
+	// if the distance between the current position and the target position less than the tolerance
+	if(FVector::Dist(CurrentPosition, TargetPosition) <= Tolerance)
 	{
-		// if a actor can successfully cast to level generator
-		if (ALevelGenerator* temp = Cast<ALevelGenerator>(*ActorItr)) {
-			// set up the reference
-			LevelGenerator = temp;
-		}
+		// set the actor current position as the position of the next node
+		CurrentPosition = TargetPosition;
+		ArriveAtNode();
+	}
+}
+
+// the agent got to Path[0]
+void AAgent::ArriveAtNode() {
+	// 'release' the last node, so other agents now can go through that node
+	Pathfinding->ReleaseNode(LastNode, this);
+	// the last node now should be the current node which is Path[0]
+	LastNode = Path[0];
+	ClaimedNode = nullptr;
+	// has the agent has already been at Path[0], remove it from the path, keeping the memory for the next path
+	Path.RemoveAt(0, 1, false);
+}
+
+// move the actor to where the movement phase took it
+void AAgent::ApplyMovement() {
+	if (HasMoved) {
+		SetActorLocation(MoveLocation);
+	}
+
+	// partway through a low detail step nothing the tick checks can change until the agent gets to the node: it holds
+	// the node, its goal is claimed for it and food is not put down on held nodes. So unless the path is still being
+	// improved, it sleeps until it would arrive
+	if (LowDetail && WantsToMove && !HasMoved && Path.Num() > 0 && StepTarget == Path[0] && ClaimedNode == Path[0]
+		&& (!Anytime.IsActive() || Anytime.IsOptimal() || Path.Num() < 2)) {
+		FVector TargetPosition(StepTarget->X * ALevelGenerator::GRID_SIZE_WORLD, StepTarget->Y * ALevelGenerator::GRID_SIZE_WORLD, StepOrigin.Z);
+		const float DistanceLeft = FVector::Dist(StepOrigin, TargetPosition) - Tolerance - StepDistance;
+		SleepTime = Pathfinding->Events.GetTime();
+		ArrivalEvent = Pathfinding->Events.Schedule(SleepTime + FMath::Max(DistanceLeft, 0.f) / MoveSpeed, EScheduledEvent::Arrival, this);
+		StepsAsleep = true;
+		FallAsleep();
+	}
+	WantsToMove = false;
+	HasMoved = false;
+}
+
+void AAgent::SetLowDetail(bool bLowDetail) {
+	if (bLowDetail == LowDetail) {
+		return;
+	}
+
+	if (bLowDetail) {
+		// the next step starts from wherever the smooth walk got to
+		StepOrigin = GetActorLocation();
+		StepTarget = nullptr;
+		StepDistance = 0.f;
+	}
+	else {
+		// put the actor where the cell steps got to, the smooth walk carries on from there
+		SetActorLocation(GetSimulatedLocation());
 	}
+	LowDetail = bLowDetail;
+}
+
+FVector AAgent::GetSimulatedLocation() const {
+	if (!LowDetail) {
+		return GetActorLocation();
+	}
+	// a sleeping agent walks on without counting
+	float Distance = StepDistance;
+	if (StepsAsleep) {
+		Distance += MoveSpeed * (float)(Pathfinding->Events.GetTime() - SleepTime);
+	}
+	if (!StepTarget || Distance <= 0.f) {
+		return StepOrigin;
+	}
+
+	FVector TargetPosition(StepTarget->X * ALevelGenerator::GRID_SIZE_WORLD, StepTarget->Y * ALevelGenerator::GRID_SIZE_WORLD, StepOrigin.Z);
+	return StepOrigin + (TargetPosition - StepOrigin).GetSafeNormal() * Distance;
+}
+
+// set up the pathfinding subsystem reference
+void AAgent::SetUpPathfindingRef() {
+	// the subsystem is owned by the world, so there is no need to search the actors for it
+	Pathfinding = GetWorld()->GetSubsystem<UPathfindingSubsystem>();
 }
 
 // Set up the start node
 void AAgent::SetupStartNode() {
-	// calculate the node information
-	int X = GetActorLocation().X / ALevelGenerator::GRID_SIZE_WORLD;
-	int Y = GetActorLocation().Y / ALevelGenerator::GRID_SIZE_WORLD;
-	StartNode = LevelGenerator->WorldArray[X][Y];
+	// calculate the node information, off screen the actor lags behind the agent
+	int X = GetSimulatedLocation().X / ALevelGenerator::GRID_SIZE_WORLD;
+	int Y = GetSimulatedLocation().Y / ALevelGenerator::GRID_SIZE_WORLD;
+	StartNode = Pathfinding->Grid.GetNode(X, Y);
+
+	// 'release' whatever the agent occupied before replanning, unless it is the start node itself
+	if (LastNode && LastNode != StartNode) {
+		Pathfinding->ReleaseNode(LastNode, this);
+	}
+	if (ClaimedNode && ClaimedNode != StartNode) {
+		Pathfinding->ReleaseNode(ClaimedNode, this);
+	}
+	ClaimedNode = nullptr;
 	
 	// 'occupy' the start node, preventing other agents from going through 
-	StartNode->ObjectAtLocation = this;
+	Pathfinding->OccupyNode(StartNode, this);
 	// set the start node as last node because the agent has already at the node
 	LastNode = StartNode;
 }
 
+FName AAgent::GetTypeName() const
+{
+	return Type == AAgent::Herbivore ? TEXT("Herbivore") : TEXT("Carnivore");
+}
+
 // set up the preferred food type of the agent
 void AAgent::SetupPreferredFoodType() {
 	int selector = FMath::RandRange(0, TYPE_COUNTER - 1);
@@ -189,13 +421,14 @@ void AAgent::SetupPreferredFoodType() {
 
 // set up the material of the agent
 void AAgent::SetupMaterial() {
-	TArray<UActorComponent*> children;
+	// the component list is only needed here, it comes from the frame arena
+	FrameArena::FMark Mark;
+	TArray<UActorComponent*, TFrameArenaAllocator<>> children;
 	this->GetComponents(children);
 
 	for (UActorComponent* child : children) {
-		FString name = child->GetName();
-		// set up the material for the child actor "cone"
-		if (child->GetName() == "Cone")
+		// set up the material for the child actor "cone", comparing names without building strings
+		if (child->GetFName() == TEXT("Cone"))
 		{
 			UStaticMeshComponent* mesh = Cast<UStaticMeshComponent>(child);
 			// if the agent is herbivore, set it to green, otherwise set it to red
@@ -214,250 +447,234 @@ void AAgent::SetupMaterial() {
 	}
 }
 
-// search the nearest goal 
+// give up the current goal and wait for the food assignment to hand out a new one
 void AAgent::SearchGoal() {
-	// nullify the current goal pointer
+	// nullify the current goal, the food it was going for can be given to another agent
 	CurrentGoal = nullptr;
-	// set up the min cost as a very large number, so it will be overwritten later
-	float minCost = 9999999999.f;
-
-	// loop through all the foods in the food actors array
-	for (AFood* food : LevelGenerator->FoodActors) {
-		// if the food has not been eaten and the food is valid and the agent likes the food
-		if (!food->IsEaten && IsValid(food) && food->Type == GetPreferredFoodType()) {
-			// get the node that the food is at
-			int X = food->GetActorLocation().X / ALevelGenerator::GRID_SIZE_WORLD;
-			int Y = food->GetActorLocation().Y / ALevelGenerator::GRID_SIZE_WORLD;
-			GridNode* tempNode = LevelGenerator->WorldArray[X][Y];
-			// if there is no other agents that 'occupies' the node
-			if (Cast<AAgent>(tempNode->ObjectAtLocation) == nullptr) {
-				// estimate the travel cost to the food
-				float cost = EstimateTravelCost(food);
-				// if the current cost less than the min cost
-				if (cost < minCost) {
-					// set the current goal as this food
-					minCost = cost;
-					CurrentGoal = food;
-				}
+	GoalNode = nullptr;
+	// agents needing a goal in the same tick are matched to the food together, so they do not all race for the nearest one
+	Pathfinding->Assignment.Request(this);
+	WaitingForGoal = true;
+}
+
+// take the food the assignment picked and plan the path to it
+void AAgent::ReceiveGoal(AFood* Food) {
+	WakeUp(Pathfinding->Events.GetTime());
+	WaitingForGoal = false;
+	CurrentGoal = Food;
+	CurrentGoalGeneration = Food->Generation;
+
+	// set up the goal node for further use
+	int X = CurrentGoal->GetActorLocation().X / ALevelGenerator::GRID_SIZE_WORLD;
+	int Y = CurrentGoal->GetActorLocation().Y / ALevelGenerator::GRID_SIZE_WORLD;
+	GoalNode = Pathfinding->Grid.GetNode(X, Y);
+	//UE_LOG(LogClass, Log, TEXT("Agent%d Goal X: %d, Y: %d"), ID, X, Y);
+
+	CalculateAStar();
+}
+
+// repair the path when the terrain under it changed
+void AAgent::HandleTerrainChanged(const FTerrainChange& Change) {
+	// a cell of the path may have become a wall or more expensive, so plan again from here
+	for (const GridNode* Node : Path) {
+		if (Change.Contains(Node->X, Node->Y)) {
+			WakeUp(Pathfinding->Events.GetTime());
+			CalculateAStar();
+			return;
+		}
+	}
+
+	// the path is still fine, but the tree the anytime search improves it with was grown over the old terrain
+	if (Anytime.IsActive()) {
+		for (const FIntPoint& Cell : Change.Cells) {
+			if (Anytime.HasReached(Pathfinding->Grid.GetIndex(Cell.X, Cell.Y))) {
+				EndAnytimeSearch();
+				return;
 			}
 		}
 	}
+}
+
+void AAgent::CaptureState(FSimAgent& OutState) {
+	OutState.Id = ID;
+	OutState.Type = Type;
+	OutState.FoodType = GetPreferredFoodType();
+	OutState.Health = Health;
+	OutState.HealthSeconds = Pathfinding->Events.IsScheduled(HealthEvent) ? (float)(Pathfinding->Events.GetDueTime(HealthEvent) - Pathfinding->Events.GetTime()) : 0.f;
+	OutState.MoveSpeed = MoveSpeed;
+	OutState.Tolerance = Tolerance;
+
+	// agents which never started stand where they were spawned
+	const FVector Location = GetSimulatedLocation();
+	const GridNode* Node = LastNode ? LastNode : Pathfinding->GetNodeAtLocation(Location);
+	OutState.Cell = Node ? FIntPoint(Node->X, Node->Y) : FIntPoint::ZeroValue;
+	OutState.StepDistance = 0.f;
+	if (Node && ClaimedNode && Path.Num() > 0 && ClaimedNode == Path[0]) {
+		OutState.StepDistance = FVector::Dist2D(Location, FVector(Node->X * ALevelGenerator::GRID_SIZE_WORLD, Node->Y * ALevelGenerator::GRID_SIZE_WORLD, 0.f));
+	}
+
+	// the snapshot keeps the next cell last
+	OutState.Path.Reset(Path.Num());
+	for (int Index = Path.Num() - 1; Index >= 0; Index--) {
+		OutState.Path.Add(FIntPoint(Path[Index]->X, Path[Index]->Y));
+	}
+
+	OutState.Goal = IsGoalValid() ? Pathfinding->FoodActors.IndexOfByKey(CurrentGoal) : INDEX_NONE;
+	OutState.GoalGeneration = 0;
+}
+
+void AAgent::RestoreState(const FSimAgent& State, AFood* Goal) {
+	ID = State.Id;
+	Type = (AGENT_TYPE)State.Type;
+	SetupMaterial();
+	Health = State.Health;
+	MoveSpeed = State.MoveSpeed;
+	Tolerance = State.Tolerance;
+
+	// the health drops when it would have, and every two seconds from there
+	Pathfinding->Events.Cancel(HealthEvent);
+	HealthEvent = Pathfinding->Events.Schedule(Pathfinding->Events.GetTime() + FMath::Max(State.HealthSeconds, KINDA_SMALL_NUMBER), EScheduledEvent::HealthDecay, this);
+
+	// the agent holds the cell it last reached, and the next one when it was partway into it
+	LastNode = Pathfinding->Grid.GetNode(State.Cell.X, State.Cell.Y);
+	Pathfinding->OccupyNode(LastNode, this);
+	Path.Reset(State.Path.Num());
+	for (int Index = State.Path.Num() - 1; Index >= 0; Index--) {
+		Path.Add(Pathfinding->Grid.GetNode(State.Path[Index].X, State.Path[Index].Y));
+	}
+	ClaimedNode = nullptr;
+	if (State.StepDistance > 0.f && Path.Num() > 0 && Pathfinding->OccupyNode(Path[0], this)) {
+		ClaimedNode = Path[0];
+	}
 
-	// if the current goal has found
-	if (CurrentGoal) {
-		// set up the goal node for further use
-		int X = CurrentGoal->GetActorLocation().X / ALevelGenerator::GRID_SIZE_WORLD;
-		int Y = CurrentGoal->GetActorLocation().Y / ALevelGenerator::GRID_SIZE_WORLD;
-		GoalNode = LevelGenerator->WorldArray[X][Y];
-		//UE_LOG(LogClass, Log, TEXT("Agent%d Goal X: %d, Y: %d"), ID, X, Y);
+	// without a goal the agent asks for one on its first tick, as a new agent does
+	HasStart = Goal != nullptr;
+	if (Goal) {
+		// no other agent may be given the food it is walking to
+		Pathfinding->Assignment.Claim(this, Goal);
+		CurrentGoal = Goal;
+		CurrentGoalGeneration = Goal->Generation;
+		GoalNode = Pathfinding->GetNodeAtLocation(Goal->GetActorLocation());
+	}
+	else {
+		Path.Reset();
 	}
 }
 
 // Astar calculation to find the minimum path to the target
 void AAgent::CalculateAStar() {
-    // set up the variables and arrays for the calculation
+	// set up the start node and forget the old path
 	SetupStartNode();
-	GridNode* currentNode = nullptr;
-	GridNode* tempNode = nullptr;
-	bool isPathCalculated = false;
-
-	TArray<GridNode*> OpenedPath;
-	TArray<GridNode*> ClosedPath;
-	Path.Empty();
-	OpenedPath.Empty();
-	ClosedPath.Empty();
-
-	// clear the start node's parent and explore the start node by calculating G, H, F
-	StartNode->Parent = nullptr;
-	StartNode->G = 0;
-	StartNode->H = LevelGenerator->CalculateDistanceBetween(StartNode, GoalNode);
-	StartNode->F = StartNode->G + StartNode->H;
+	Path.Reset();
+	EndAnytimeSearch();
+
+	// nothing to search for until a goal has been found
+	if (!GoalNode) {
+		return;
+	}
+
+	// where agents have to plan from, when the heatmap is recording
+	if (SearchHeatmap* Heatmap = Pathfinding->GetHeatmap()) {
+		Heatmap->Add(SearchHeatmap::Replans, Pathfinding->Grid.GetIndex(StartNode->X, StartNode->Y));
+	}
 
 	//UE_LOG(LogClass, Log, TEXT("Agent%d StartPosition X: %d Y: %d"), ID, StartNode->X, StartNode->Y);
 
-	// Add the start node to the openList
-	OpenedPath.Add(StartNode);
-	//if the openList contain nodes
-	while (OpenedPath.Num() > 0) {
-		// go through each node and find the one that cost least
-		float lowestF = 999999999;
-		for (int i = 0; i < OpenedPath.Num(); i++) {
-			if (OpenedPath[i]->F < lowestF) {
-				lowestF = OpenedPath[i]->F;
-				currentNode = OpenedPath[i];
-			}
+	// ask the subsystem's search engine, the start node is this agent's own so only the others block
+	FPathQuery Query;
+	Query.Start = FIntPoint(StartNode->X, StartNode->Y);
+	Query.Goal = FIntPoint(GoalNode->X, GoalNode->Y);
+	Query.BlockingLayers = GetBlockingLayers();
+
+	FPathResult& Result = SearchResult;
+	// agent types with an anytime setting take the first path within the bound and improve it while walking,
+	// unless an optimal path is cached already
+	if (const FAnytimeSearchSetting* Setting = Pathfinding->GetAnytimeSetting(GetTypeName())) {
+		if (Pathfinding->BeginAnytimePath(Anytime, *Setting, Query, Result)) {
+			GeneratePath(Result);
 		}
+		return;
+	}
 
-		// remove the node from the openList and add it to the closeList
-		OpenedPath.Remove(currentNode);
-		ClosedPath.Add(currentNode);
-		// if the node is the goal node
-		if (currentNode == GoalNode) {
-			// finish calculation and start generating the path
-			isPathCalculated = true;
-			break;
-		}
+	// if the path has been calculated, generate the path
+	if (Pathfinding->FindPath(Query, Result)) {
+		GeneratePath(Result);
+	}
+}
 
-		// Check the neighbours
-		// Check to ensure not out of range
-		if (currentNode->Y - 1 > 0)
-		{
-			// Get it from the worldArray
-			tempNode = LevelGenerator->WorldArray[currentNode->X][currentNode->Y - 1];
-			// Check to make sure the node hasnt been visited AND is valid (not wall, no other agent is 'occupying', ect.
-			if (CheckNodeAvailablity(tempNode) && !ClosedPath.Contains(tempNode)) {
-				// possible G equals curent Node's G adding the next node's G
-				int possibleG = currentNode->G + tempNode->GetTravelCost();
-				// set up the flag indicates if possible G is better
-				bool isPossibleGBetter = false;
-
-				// if the next node is not in the openList
-				if (!OpenedPath.Contains(tempNode)) {
-					// add it to the list
-					OpenedPath.Add(tempNode);
-					// set up the H value by calculating the distance between the next node and the goal node
-					tempNode->H = LevelGenerator->CalculateDistanceBetween(tempNode, GoalNode);
-					// possible G is better
-					isPossibleGBetter = true;
-				}
-				// if possible G less than the next node's G but the next node is in the openList
-				else if (possibleG < tempNode->G) {
-					// possible G is better
-					isPossibleGBetter = true;
-				}
-
-				// if possible G is better
-				if (isPossibleGBetter) {
-					// set up the next node's parent as the current node
-					tempNode->Parent = currentNode;
-					// next node's G = possible G
-					tempNode->G = possibleG;
-					// next node's F = G + H
-					tempNode->F = tempNode->G + tempNode->H;
-				}
-			}
-		}
+void AAgent::ImproveAnytimePath()
+{
+	// the last step has nothing to improve
+	if (!Anytime.IsActive() || Anytime.IsOptimal() || Path.Num() < 2) {
+		return;
+	}
 
-		if (currentNode->X + 1 < LevelGenerator->MapSizeX)
-		{
-			tempNode = LevelGenerator->WorldArray[currentNode->X + 1][currentNode->Y];
-			if (CheckNodeAvailablity(tempNode) && !ClosedPath.Contains(tempNode))
-			{
-				int possibleG = currentNode->G + tempNode->GetTravelCost();
-				bool isPossibleGBetter = false;
-
-				if (!OpenedPath.Contains(tempNode)) {
-					OpenedPath.Add(tempNode);
-					tempNode->H = LevelGenerator->CalculateDistanceBetween(tempNode, GoalNode);
-					isPossibleGBetter = true;
-				}
-				else if (possibleG < tempNode->G) {
-					isPossibleGBetter = true;
-				}
-
-				if (isPossibleGBetter) {
-					tempNode->Parent = currentNode;
-					tempNode->G = possibleG;
-					tempNode->F = tempNode->G + tempNode->H;
-				}
-			}
-		}
+	const FAnytimeSearchSetting* Setting = Pathfinding->GetAnytimeSetting(GetTypeName());
+	if (!Setting) {
+		return;
+	}
 
-		if (currentNode->Y + 1 < LevelGenerator->MapSizeY)
-		{
-			tempNode = LevelGenerator->WorldArray[currentNode->X][currentNode->Y + 1];
-			if (CheckNodeAvailablity(tempNode) && !ClosedPath.Contains(tempNode))
-			{
-				int possibleG = currentNode->G + tempNode->GetTravelCost();
-				bool isPossibleGBetter = false;
-
-				if (!OpenedPath.Contains(tempNode)) {
-					OpenedPath.Add(tempNode);
-					tempNode->H = LevelGenerator->CalculateDistanceBetween(tempNode, GoalNode);
-					isPossibleGBetter = true;
-				}
-				else if (possibleG < tempNode->G) {
-					isPossibleGBetter = true;
-				}
-
-				if (isPossibleGBetter) {
-					tempNode->Parent = currentNode;
-					tempNode->G = possibleG;
-					tempNode->F = tempNode->G + tempNode->H;
-				}
-			}
-		}
+	// aim at the node the agent is walking into, everything after it can be replaced
+	Anytime.SetStart(FIntPoint(Path[0]->X, Path[0]->Y));
 
-		if (currentNode->X - 1 > 0)
-		{
-			tempNode = LevelGenerator->WorldArray[currentNode->X - 1][currentNode->Y];
-			if (CheckNodeAvailablity(tempNode) && !ClosedPath.Contains(tempNode))
-			{
-				int possibleG = currentNode->G + tempNode->GetTravelCost();
-				bool isPossibleGBetter = false;
-
-				if (!OpenedPath.Contains(tempNode)) {
-					OpenedPath.Add(tempNode);
-					tempNode->H = LevelGenerator->CalculateDistanceBetween(tempNode, GoalNode);
-					isPossibleGBetter = true;
-				}
-				else if (possibleG < tempNode->G) {
-					isPossibleGBetter = true;
-				}
-
-				if (isPossibleGBetter) {
-					tempNode->Parent = currentNode;
-					tempNode->G = possibleG;
-					tempNode->F = tempNode->G + tempNode->H;
-				}
-			}
-		}
+	FPathResult& Result = SearchResult;
+	if (!Pathfinding->ImproveAnytimePath(Anytime, *Setting, Result)) {
+		return;
+	}
 
+	// the improved path starts where the iteration started, which the agent may have walked past by now
+	const int From = Path.IndexOfByPredicate([this](const GridNode* Node) {
+		return Pathfinding->Grid.GetIndex(Node->X, Node->Y) == Anytime.GetStartCell();
+	});
+	if (From == INDEX_NONE) {
+		return;
 	}
 
-	// if the path has been calculated, generate the path
-	if (isPathCalculated) {
-		GeneratePath();
+	Path.SetNum(From + 1, false);
+	GeneratePath(Result);
+
+	// only optimal paths are shared with other agents
+	if (Anytime.IsOptimal() && GoalNode) {
+		FPathQuery Query;
+		Query.Start = FIntPoint(Path[From]->X, Path[From]->Y);
+		Query.Goal = FIntPoint(GoalNode->X, GoalNode->Y);
+		Query.BlockingLayers = GetBlockingLayers();
+		Pathfinding->CachePath(Query, Result);
 	}
 }
 
-void AAgent::GeneratePath()
+void AAgent::EndAnytimeSearch()
 {
-	// set the current node as the goal node
-	GridNode* CurrentNode = GoalNode;
-	
-	// count the nodes for debugging
-	int pathcount = 0;
-
-	// loop through all the nodes which the parent is not null
-	while (CurrentNode->Parent != nullptr)
-	{	
-		//UE_LOG(LogClass, Log, TEXT("Agent%d Path%d X: %d Y: %d"), ID, pathcount, CurrentNode->X, CurrentNode->Y);
-		
-		// insert it to the start of the path array
-		Path.Insert(CurrentNode, 0);
-
-		// counter +1
-		pathcount++;
+	if (Anytime.IsActive()) {
+		Pathfinding->RecordAnytimeSearch(GetTypeName(), Anytime);
+		Anytime.End();
+	}
+}
 
-		// the current node now should be the parent of the current node
-		CurrentNode = CurrentNode->Parent;
+void AAgent::GeneratePath(const FPathResult& Result)
+{
+	// the engine gives the cells from the first step to the goal, turn them into nodes
+	Path.Reserve(Result.Path.Num());
+	for (const FIntPoint& Cell : Result.Path)
+	{
+		//UE_LOG(LogClass, Log, TEXT("Agent%d Path%d X: %d Y: %d"), ID, Path.Num(), Cell.X, Cell.Y);
+		Path.Add(Pathfinding->Grid.GetNode(Cell.X, Cell.Y));
 	}
 }
 
 // eat the food
 void AAgent::Eat() {
-	// guard code preventing the program crashing
-	if (CurrentGoal != nullptr) {
+	// guard code preventing the program crashing, and preventing eating a food that has been recycled elsewhere
+	if (IsGoalValid()) {
 		// restore health
 		Health = 50;
-		// remove the food from the food array
-		LevelGenerator->FoodActors.Remove(CurrentGoal);
+		// remove the food from the food array and its node
+		Pathfinding->UnregisterFood(CurrentGoal);
 		// set it as being eaten
 		CurrentGoal->IsEaten = true;
 		UE_LOG(LogClass, Log, TEXT("Agent%d Reached, Food: %s Consumed"), ID, *(CurrentGoal->GetName()));
-		// destroy it
-		CurrentGoal->Destroy();
+		// give it back to the pool so the level generator can reuse it
+		Pathfinding->Pool.ReleaseFood(CurrentGoal);
 	}
 }
 
@@ -476,39 +693,63 @@ int AAgent::GetPreferredFoodType()
 
 // check if the node is avaliable
 bool AAgent::CheckNodeAvailablity(GridNode* Node) {
-	// the node cant be a wall
-	if (Node->GridType == GridNode::Wall) {
-		return false;
+	// the nodes this agent 'occupies' itself are always fine
+	if (Node == LastNode || Node == ClaimedNode) {
+		return true;
 	}
-	
-	// if the node contains a object
-	if (IsValid(Node->ObjectAtLocation)) {
-		// if it is an agent
-		if (AAgent* temp = Cast<AAgent>(Node->ObjectAtLocation)) {
-			// if the agent is not 'this agent'
-			if (temp != this) {
-				// then it means the node has been 'occupied' and this agent cannot go through it
-				return false;
-			}
-		}
-		// if the object is a food
-		if (AFood* temp = Cast<AFood>(Node->ObjectAtLocation)) {
-			// if it is a food type that the agent do not like
-			if (temp->Type != GetPreferredFoodType()) {
-				// the agent should avoid it
-				return false;
-			}
-		}
+
+	// the node cant be a wall, 'occupied' by another agent or hold a food type that the agent do not like
+	if (!Pathfinding->Occupancy.IsBlocked(Node->X, Node->Y, GetBlockingLayers())) {
+		return true;
 	}
 
-	// otherwise it is ok to go 
-	return true;
+	if (SearchHeatmap* Heatmap = Pathfinding->GetHeatmap()) {
+		Heatmap->Add(SearchHeatmap::Blocks, Pathfinding->Grid.GetIndex(Node->X, Node->Y));
+	}
+	return false;
+}
+
+// the layers the agent cannot go through: walls, other agents and the food it does not like
+uint8 AAgent::GetBlockingLayers() {
+	uint8 Layers = OccupancyGrid::LayerMask(OccupancyGrid::Walls) | OccupancyGrid::LayerMask(OccupancyGrid::Agents);
+	if (GetPreferredFoodType() == AFood::Meat) {
+		Layers |= OccupancyGrid::LayerMask(OccupancyGrid::Vegetation);
+	}
+	else {
+		Layers |= OccupancyGrid::LayerMask(OccupancyGrid::Meat);
+	}
+	return Layers;
+}
+
+// check if the current goal is still the food the agent chose
+bool AAgent::IsGoalValid() {
+	// pooled food stays valid after being eaten, so the eaten flag and generation have to match as well
+	return IsValid(CurrentGoal) && !CurrentGoal->IsEaten && CurrentGoal->Generation == CurrentGoalGeneration;
+}
+
+// release the node the agent stands on and the one it is moving into
+void AAgent::ReleaseOccupiedNodes() {
+	if (LastNode) {
+		Pathfinding->ReleaseNode(LastNode, this);
+	}
+	if (ClaimedNode) {
+		Pathfinding->ReleaseNode(ClaimedNode, this);
+	}
+	// agents which never started still occupy the node they were spawned at
+	if (!LastNode) {
+		GridNode* SpawnNode = Pathfinding->GetNodeAtLocation(GetActorLocation());
+		if (SpawnNode) {
+			Pathfinding->ReleaseNode(SpawnNode, this);
+		}
+	}
+	LastNode = nullptr;
+	ClaimedNode = nullptr;
 }
 
 // estimate the travel cost by food reference
 float AAgent::EstimateTravelCost(AFood* food) {
 	FVector foodLocation = food->GetActorLocation();
-	FVector agentLocation = GetActorLocation();
+	FVector agentLocation = GetSimulatedLocation();
 	FVector distance = FVector(foodLocation.X / ALevelGenerator::GRID_SIZE_WORLD - agentLocation.X / ALevelGenerator::GRID_SIZE_WORLD,
 		foodLocation.Y / ALevelGenerator::GRID_SIZE_WORLD - agentLocation.Y / ALevelGenerator::GRID_SIZE_WORLD, 0);
 	return distance.Size();
@@ -6,6 +6,8 @@
 #include "GridNode.h"
 #include "Food.h"
 #include "LevelGenerator.h"
+#include "PathfindingSubsystem.h"
+#include "SimSnapshot.h"
 #include "GameFramework/Actor.h"
 #include "Agent.generated.h"
 
@@ -34,45 +36,111 @@ public:
 	GridNode* StartNode; // The starting node in the current path
 	GridNode* GoalNode; // The goal node in the current path
 	GridNode* LastNode; // The previous node that the agent used to be in 
-	ALevelGenerator* LevelGenerator; // The level generator reference for accesssing some members
+	GridNode* ClaimedNode; // The next node that the agent has 'occupied' while moving into it
+	UPathfindingSubsystem* Pathfinding; // The subsystem that owns the grid, the food and the path services
 	bool HasStart; // The flag to indicate if the agent has started their action
+	bool WaitingForGoal; // The agent asked the food assignment for a goal and has not been given one yet
+	bool WantsToMove; // The agent ticked up to moving this frame, the movement phase moves it
+	bool HasMoved; // The movement phase moved the agent to MoveLocation, the actor is moved there on the game thread
+	FVector MoveLocation; // Where the movement phase took the agent
+	bool LowDetail; // Nobody is looking, the agent walks in whole cell steps and the actor only moves on reaching a cell
+	FVector StepOrigin; // Where the current step started while in low detail, the actor stays there until the step ends
+	GridNode* StepTarget; // The node the current low detail step goes to
+	float StepDistance; // How far the agent has walked from StepOrigin towards StepTarget
+	bool Asleep; // The agent does not tick until one of its events fires or something it depends on changes
+	bool StepsAsleep; // The agent fell asleep partway through a low detail step, which goes on while it sleeps
+	double SleepTime; // When the agent fell asleep, StepDistance is how far it had walked then
 	AFood* CurrentGoal; // The food the agent is going for
+	int CurrentGoalGeneration; // The pool generation of the food when it was chosen, so a recycled food is not mistaken for the goal
 	AGENT_TYPE Type; // The type of the agent
-	TArray<GridNode*> Path; // The path the agent is following
+	TArray<GridNode*> Path; // The path the agent is following, keeps its memory across replans
+	FPathResult SearchResult; // The answer of the last search, reused so replanning does not allocate
+	AnytimeSearch Anytime; // The search behind the path when the agent type uses anytime search, improved while walking
 
 	// The materials for different types of agent
 	UPROPERTY(EditAnywhere, Category = "Mat")
 		UMaterial* HerbivoreMat;
 	UPROPERTY(EditAnywhere, Category = "Mat")
 		UMaterial* CarnivoreMat;
+
+	// Called by the actor pool when a released agent is reused
+	void Reinitialise();
+
+	// Stop the agent, free the nodes it holds and give it back to the pool
+	void Despawn();
+
+	// Called by the food assignment with the food this agent has been given, plans the path to it
+	void ReceiveGoal(AFood* Food);
+
+	// Plan again if the rest of the path goes through changed terrain, other paths are kept
+	void HandleTerrainChanged(const FTerrainChange& Change);
+
+	// Called by the level generator with the events of this agent as they come due (see EventScheduler).
+	// MovedUntil is the time the movement phases have moved the awake agents up to
+	void HandleEvent(const FScheduledEvent& Event, double MovedUntil);
+	// Start ticking again, catching up on the walking done while asleep. An agent woken partway through a step moves
+	// in the next movement phase, as it would have after ticking
+	void WakeUp(double MovedUntil);
+	bool IsAsleep() const { return Asleep; }
+	// Is the agent part of the simulation, asleep or not, rather than back in the pool
+	bool IsActive() const { return Asleep || IsActorTickEnabled(); }
+
+	// Write what the agent is doing into a snapshot, and take it back from one (see ALevelGenerator::CaptureSnapshot).
+	// Restoring is for an agent fresh out of the pool, Goal is the food its goal was put back as (nullptr for none)
+	void CaptureState(FSimAgent& OutState);
+	void RestoreState(const FSimAgent& State, AFood* Goal);
+
+	// The movement phase, run by the level generator for all agents together after they ticked (see CellClaims).
+	// The first three are safe to call for different agents on different threads at once
+	GridNode* GetNodeToClaim() const; // the node to bid for, nullptr when the agent holds its next node already or stays put
+	void ClaimNextNode(); // occupy the next node after winning the bid for it
+	void StepMovement(float DeltaTime); // walk towards the claimed node, releasing the last node on arrival
+	void ApplyMovement(); // move the actor to where StepMovement took it and fall asleep if nothing is due, on the game thread
+
+	// Switch between walking smoothly and in cell steps, on the game thread. Both take the agent to the same cell on the same
+	// frame, so what it eats and when it starves do not depend on being seen
+	void SetLowDetail(bool bLowDetail);
+	// Where the agent is, which in low detail is ahead of the actor during a step
+	FVector GetSimulatedLocation() const;
+
+	int GetPreferredFoodType(); // based on the agent type, get their preferred food type
+	float EstimateTravelCost(AFood* food); // allows to use AFood pointer as parameter to calculate distance
 	
 
 protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
 
-	// Timed function that decreases health every 2 seconds;
+	// Scheduled event that decreases health every 2 seconds
 	void DecreaseHealth();
+	// Stop ticking until the event scheduled (if any) fires or WakeUp is called
+	void FallAsleep();
 	
 	// Some initialization function
-	void SetUpLevelGeneratorRef(); // set up the level generator reference for further calling
+	void SetUpPathfindingRef(); // set up the pathfinding subsystem reference for further calling
 	void SetupPreferredFoodType(); // set up the food type that the agent likes
 	void SetupMaterial(); // set up the material based on the agent type
 	void SetupStartNode(); // set up the start node in the current path
 
 	// Agent Behaviours
-	void SearchGoal(); // search the nearest food as the goal 
+	void SearchGoal(); // give up the current goal and ask the food assignment for a new one
 	void CalculateAStar(); // calculate the path by Astar
-	void GeneratePath(); // generate the path based on the calculation
+	void GeneratePath(const FPathResult& Result); // generate the path based on the calculation
+	void ImproveAnytimePath(); // spend this tick's budget on a better path, replacing the rest of the path when one is found
+	void EndAnytimeSearch(); // stop improving the current path and record how it went
 	void Eat(); // Eat the food at the current node
 	
 	// Some helper functions
-	int GetPreferredFoodType(); // based on the agent type, get their preferred food type
+	FName GetTypeName() const; // the name of the agent type, as used by the per-type settings
 	bool CheckNodeAvailablity(GridNode * Node); // check the availability of the node, preventing the game from crashing 
-	float EstimateTravelCost(AFood* food); // allows to use AFood pointer as parameter to calculate distance
+	void ArriveAtNode(); // the agent got to the next node of the path
+	uint8 GetBlockingLayers(); // the occupancy layers this agent cannot go through
+	bool IsGoalValid(); // check the current goal still exists and has not been eaten or recycled
+	void ReleaseOccupiedNodes(); // 'release' every node this agent occupies, so other agents can go through
 	
-	// Handle for Timer
-	FTimerHandle TimerHandle;
+	// The next health drop, and the end of the step the agent sleeps through
+	FEventHandle HealthEvent;
+	FEventHandle ArrivalEvent;
 	
 public:	
 	// Called every frame
@@ -0,0 +1,182 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "BidirectionalAStarEngine.h"
+#include "OccupancyGrid.h"
+#include "PathGrid.h"
+#include "SearchHeatmap.h"
+#include "HAL/PlatformTime.h"
+
+bool BidirectionalAStarEngine::FindPath(const PathGrid& Grid, const OccupancyGrid& Occupancy, const FPathQuery& Query, FPathResult& OutResult)
+{
+	if (!Rooms)
+	{
+		return Search(Grid, Occupancy, Query, false, OutResult);
+	}
+
+	// when walls part the two ends there is nothing to search
+	if (!Rooms->MarkUsefulRooms(Grid.GetIndex(Query.Start.X, Query.Start.Y), Grid.GetIndex(Query.Goal.X, Query.Goal.Y), UsefulRooms))
+	{
+		OutResult.Reset();
+		return false;
+	}
+	if (Search(Grid, Occupancy, Query, true, OutResult))
+	{
+		return true;
+	}
+
+	// the rooms only know the terrain, agents or food may have blocked every way they leave
+	const int32 PrunedExpansions = OutResult.Expansions;
+	const double PrunedSeconds = OutResult.Seconds;
+	Search(Grid, Occupancy, Query, false, OutResult);
+	OutResult.Expansions += PrunedExpansions;
+	OutResult.Seconds += PrunedSeconds;
+	return OutResult.bFound;
+}
+
+bool BidirectionalAStarEngine::Search(const PathGrid& Grid, const OccupancyGrid& Occupancy, const FPathQuery& Query, bool bPrune, FPathResult& OutResult)
+{
+	OutResult.Reset();
+	const double StartTime = FPlatformTime::Seconds();
+
+	Forward.Prepare(Grid.GetNumCells());
+	Backward.Prepare(Grid.GetNumCells());
+	ForwardOpen.Reset();
+	BackwardOpen.Reset();
+
+	StartCell = Grid.GetIndex(Query.Start.X, Query.Start.Y);
+	const int GoalCell = Grid.GetIndex(Query.Goal.X, Query.Goal.Y);
+	BestCost = MAX_int32;
+	BestMeeting = INDEX_NONE;
+
+	if (StartCell == GoalCell)
+	{
+		OutResult.bFound = true;
+		OutResult.Seconds = FPlatformTime::Seconds() - StartTime;
+		return true;
+	}
+
+	// a blocked goal can never be entered, so there is nothing to meet
+	if (Occupancy.IsBlocked(Query.Goal.X, Query.Goal.Y, Query.BlockingLayers))
+	{
+		OutResult.Seconds = FPlatformTime::Seconds() - StartTime;
+		return false;
+	}
+
+	Forward.Visit(StartCell, 0, INDEX_NONE);
+	ForwardOpen.HeapPush(FOpenEntry(Heuristic(Query.Start.X, Query.Start.Y, Query.Goal), 0, StartCell), FOpenEntryPredicate());
+	Backward.Visit(GoalCell, 0, INDEX_NONE);
+	BackwardOpen.HeapPush(FOpenEntry(Heuristic(Query.Goal.X, Query.Goal.Y, Query.Start), 0, GoalCell), FOpenEntryPredicate());
+
+	while (true)
+	{
+		const float ForwardTop = GetTopF(ForwardOpen, Forward);
+		const float BackwardTop = GetTopF(BackwardOpen, Backward);
+
+		// either frontier being empty or unable to beat the best meeting proves it optimal
+		if (ForwardTop == MAX_flt || BackwardTop == MAX_flt || FMath::Max(ForwardTop, BackwardTop) >= BestCost)
+		{
+			break;
+		}
+
+		// grow the smaller frontier, which keeps the two searches balanced in cost
+		ExpandNext(Grid, Occupancy, Query, ForwardOpen.Num() <= BackwardOpen.Num(), bPrune, OutResult);
+	}
+
+	if (BestMeeting != INDEX_NONE)
+	{
+		// start (excluded) to the meeting cell from the forward parents
+		BuildPath(Grid, Forward, BestMeeting, OutResult);
+
+		// then the meeting cell to the goal from the backward parents, which point towards the goal
+		for (int Cell = Backward.GetParent(BestMeeting); Cell != INDEX_NONE; Cell = Backward.GetParent(Cell))
+		{
+			OutResult.Path.Add(Grid.GetPosition(Cell));
+		}
+		OutResult.Cost = BestCost;
+	}
+
+	OutResult.Seconds = FPlatformTime::Seconds() - StartTime;
+	return OutResult.bFound;
+}
+
+void BidirectionalAStarEngine::ExpandNext(const PathGrid& Grid, const OccupancyGrid& Occupancy, const FPathQuery& Query, bool bForward, bool bPrune, FPathResult& OutResult)
+{
+	SearchSpace& Space = bForward ? Forward : Backward;
+	SearchSpace& Other = bForward ? Backward : Forward;
+	TArray<FOpenEntry>& OpenList = bForward ? ForwardOpen : BackwardOpen;
+	const FIntPoint& Target = bForward ? Query.Goal : Query.Start;
+
+	FOpenEntry Current;
+	OpenList.HeapPop(Current, FOpenEntryPredicate(), false);
+	Space.Close(Current.Cell);
+	OutResult.Expansions++;
+	if (Heatmap)
+	{
+		Heatmap->AddExpansion(Current.Cell);
+	}
+
+	const FIntPoint Position = Grid.GetPosition(Current.Cell);
+	// the backward search pays for the cell it leaves, the forward search for the cell it enters
+	const int32 CurrentCost = (int32)Grid.GetTravelCost(Position.X, Position.Y);
+
+	uint8 Available = Occupancy.GetPassableNeighbours(Position.X, Position.Y, Query.BlockingLayers);
+	if (!bForward)
+	{
+		// the start holds the agent itself, but the backward search still has to be able to reach it
+		for (int Direction = 0; Direction < 4; Direction++)
+		{
+			if (Position + NeighbourOffsets[Direction] == Query.Start)
+			{
+				Available |= 1 << Direction;
+			}
+		}
+	}
+
+	for (int Direction = 0; Direction < 4; Direction++)
+	{
+		if (!(Available & (1 << Direction)))
+		{
+			continue;
+		}
+
+		const int NextX = Position.X + NeighbourOffsets[Direction].X;
+		const int NextY = Position.Y + NeighbourOffsets[Direction].Y;
+		const int Next = Grid.GetIndex(NextX, NextY);
+		if (Space.IsClosed(Next) || (bPrune && !Rooms->IsUseful(Next, UsefulRooms)))
+		{
+			continue;
+		}
+
+		const int32 StepCost = bForward ? (int32)Grid.GetTravelCost(NextX, NextY) : CurrentCost;
+		const int32 PossibleG = Current.G + StepCost;
+		if (!Space.IsSeen(Next) || PossibleG < Space.GetG(Next))
+		{
+			Space.Visit(Next, PossibleG, Current.Cell);
+			OpenList.HeapPush(FOpenEntry(PossibleG + Heuristic(NextX, NextY, Target), PossibleG, Next), FOpenEntryPredicate());
+
+			// reached by the other direction too, so this is a complete path
+			if (Other.IsSeen(Next) && PossibleG + Other.GetG(Next) < BestCost)
+			{
+				BestCost = PossibleG + Other.GetG(Next);
+				BestMeeting = Next;
+			}
+		}
+	}
+}
+
+float BidirectionalAStarEngine::GetTopF(TArray<FOpenEntry>& OpenList, const SearchSpace& Space)
+{
+	while (OpenList.Num() > 0)
+	{
+		const FOpenEntry& Top = OpenList.HeapTop();
+		if (!Space.IsClosed(Top.Cell) && Top.G == Space.GetG(Top.Cell))
+		{
+			return Top.F;
+		}
+
+		FOpenEntry Stale;
+		OpenList.HeapPop(Stale, FOpenEntryPredicate(), false);
+	}
+	return MAX_flt;
+}
@@ -0,0 +1,74 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "PathSearch.h"
+#include "RoomGraph.h"
+
+/**
+ * Front-to-end bidirectional A*: one search from the start, one backwards from the goal, each aimed at the other end.
+ *
+ * Entering a cell costs that cell's travel cost, so the backward search charges the cost of the cell it
+ * comes from: G backward of a cell is the cost of the rest of the path after it. A path through a cell
+ * met by both searches costs G forward + G backward. The search stops once either open list cannot hold
+ * anything cheaper than the best meeting, which is exact for the consistent straight line heuristic
+ * (every step costs at least 1 and moves 1).
+ */
+class FIT3094_A1_CODE_API BidirectionalAStarEngine : public PathSearchEngine
+{
+
+public:
+
+	virtual FName GetName() const override
+	{
+		return TEXT("BidirectionalAStar");
+	}
+
+	virtual bool FindPath(const PathGrid& Grid, const OccupancyGrid& Occupancy, const FPathQuery& Query, FPathResult& OutResult) override;
+
+	virtual void SetRooms(const RoomGraph* NewRooms) override
+	{
+		Rooms = NewRooms;
+	}
+	virtual bool CanPruneRooms() const override
+	{
+		return true;
+	}
+
+	virtual void SetHeatmap(SearchHeatmap* NewHeatmap) override
+	{
+		Heatmap = NewHeatmap;
+	}
+
+private:
+
+	// One search, keeping both directions out of the dead-end rooms when bPrune is set
+	bool Search(const PathGrid& Grid, const OccupancyGrid& Occupancy, const FPathQuery& Query, bool bPrune, FPathResult& OutResult);
+
+	// Expand the cheapest node of one direction, updating the best meeting cost and cell
+	void ExpandNext(const PathGrid& Grid, const OccupancyGrid& Occupancy, const FPathQuery& Query, bool bForward, bool bPrune, FPathResult& OutResult);
+
+	// Drop stale entries off the top of an open list, returns the F of the top or MAX_flt when empty
+	float GetTopF(TArray<FOpenEntry>& OpenList, const SearchSpace& Space);
+
+	SearchSpace Forward;
+	SearchSpace Backward;
+	TArray<FOpenEntry> ForwardOpen;
+	TArray<FOpenEntry> BackwardOpen;
+
+	// The start cell is the searching agent's own, so it never blocks the backward search
+	int StartCell;
+
+	// The cheapest path found so far and the cell where the two searches met on it
+	int32 BestCost;
+	int BestMeeting;
+
+	// Both directions skip the dead-end rooms of the query when set
+	const RoomGraph* Rooms = nullptr;
+	RoomMask UsefulRooms;
+
+	// Expansions of both directions are counted into it when set
+	SearchHeatmap* Heatmap = nullptr;
+
+};
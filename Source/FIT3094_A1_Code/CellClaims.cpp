@@ -0,0 +1,255 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CellClaims.h"
+#include "OccupancyGrid.h"
+#include "PathGrid.h"
+#include "PathSearch.h"
+#include "Async/ParallelFor.h"
+#include "Async/TaskGraphInterfaces.h"
+#include "HAL/PlatformAtomics.h"
+#include "HAL/PlatformTime.h"
+#include "Misc/Crc.h"
+
+// A bijection of 32 bit values (the finaliser of MurmurHash3), so different owners never get the same priority
+static uint32 MixPriority(uint32 Value)
+{
+	Value ^= Value >> 16;
+	Value *= 0x85ebca6bu;
+	Value ^= Value >> 13;
+	Value *= 0xc2b2ae35u;
+	Value ^= Value >> 16;
+	return Value;
+}
+
+CellClaims::CellClaims()
+{
+	Round = 0;
+}
+
+void CellClaims::Init(int32 NumCells)
+{
+	Owners.Init(0, NumCells);
+	Bids.Init(0, NumCells);
+	Round = 0;
+}
+
+void CellClaims::Reset()
+{
+	Owners.Empty();
+	Bids.Empty();
+	Round = 0;
+}
+
+int64 CellClaims::GetBid(uint32 Owner) const
+{
+	// the round in the high half makes every older bid lower, so bids never have to be cleared
+	return ((int64)Round << 32) | MixPriority(Owner ^ (Round * 0x9e3779b9u));
+}
+
+void CellClaims::Bid(int32 Cell, uint32 Owner)
+{
+	checkSlow(Owner != 0);
+	volatile int64* Slot = &Bids[Cell];
+	const int64 Value = GetBid(Owner);
+
+	// raise the bid to ours unless a higher one got there first
+	int64 Current = FPlatformAtomics::AtomicRead(Slot);
+	while (Current < Value)
+	{
+		const int64 Previous = FPlatformAtomics::InterlockedCompareExchange(Slot, Value, Current);
+		if (Previous == Current)
+		{
+			break;
+		}
+		Current = Previous;
+	}
+}
+
+bool CellClaims::HasWon(int32 Cell, uint32 Owner) const
+{
+	return FPlatformAtomics::AtomicRead(&Bids[Cell]) == GetBid(Owner);
+}
+
+bool CellClaims::TryClaim(int32 Cell, uint32 Owner)
+{
+	checkSlow(Owner != 0);
+	const int32 Previous = FPlatformAtomics::InterlockedCompareExchange(&Owners[Cell], (int32)Owner, 0);
+	return Previous == 0 || (uint32)Previous == Owner;
+}
+
+bool CellClaims::Release(int32 Cell, uint32 Owner)
+{
+	return FPlatformAtomics::InterlockedCompareExchange(&Owners[Cell], 0, (int32)Owner) == (int32)Owner;
+}
+
+uint32 CellClaims::GetOwner(int32 Cell) const
+{
+	return (uint32)FPlatformAtomics::AtomicRead(&Owners[Cell]);
+}
+
+void CellClaims::Benchmark(const PathGrid& Grid, const OccupancyGrid& Occupancy, int32 NumAgents, int32 Steps)
+{
+	const uint8 WallLayers = OccupancyGrid::LayerMask(OccupancyGrid::Walls);
+	TArray<int32> OpenCells;
+	for (int32 Cell = 0; Cell < Grid.GetNumCells(); Cell++)
+	{
+		const FIntPoint Position = Grid.GetPosition(Cell);
+		if (!Occupancy.IsBlocked(Position.X, Position.Y, WallLayers))
+		{
+			OpenCells.Add(Cell);
+		}
+	}
+
+	NumAgents = FMath::Clamp(NumAgents, 1, OpenCells.Num() / 2);
+	Steps = FMath::Max(1, Steps);
+	if (OpenCells.Num() < 2)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Claims benchmark: the map has no room for agents"));
+		return;
+	}
+
+	struct FBenchAgent
+	{
+		int32 Cell;
+		int32 Goal;
+		// The cell the agent wants this step, INDEX_NONE when it stays
+		int32 Next;
+	};
+
+	TArray<FBenchAgent> Agents;
+	CellClaims Claims;
+	OccupancyGrid Layers;
+
+	// one step of every agent, the agents of a batch handled by one thread
+	auto RunPhase = [&Agents](int32 NumThreads, TFunctionRef<void(int32, FBenchAgent&)> Body)
+	{
+		const int32 BatchSize = FMath::DivideAndRoundUp(Agents.Num(), NumThreads);
+		ParallelFor(NumThreads, [&Agents, &Body, BatchSize](int32 Batch)
+		{
+			const int32 End = FMath::Min(Agents.Num(), (Batch + 1) * BatchSize);
+			for (int32 Index = Batch * BatchSize; Index < End; Index++)
+			{
+				Body(Index, Agents[Index]);
+			}
+		});
+	};
+
+	const int32 MaxThreads = FTaskGraphInterface::Get().GetNumWorkerThreads() + 1;
+	double SingleThreadSeconds = 0.0;
+	uint32 SingleThreadOutcome = 0;
+	for (int32 NumThreads = 1; ; NumThreads = FMath::Min(NumThreads * 2, MaxThreads))
+	{
+		// the same crowd every run
+		FRandomStream Random(NumAgents);
+		Claims.Init(Grid.GetNumCells());
+		Layers = Occupancy;
+		Agents.Reset();
+		while (Agents.Num() < NumAgents)
+		{
+			const int32 Cell = OpenCells[Random.RandRange(0, OpenCells.Num() - 1)];
+			if (Claims.TryClaim(Cell, Agents.Num() + 1))
+			{
+				Agents.Add({ Cell, OpenCells[Random.RandRange(0, OpenCells.Num() - 1)], INDEX_NONE });
+			}
+		}
+
+		int64 Moves = 0;
+		const double StartTime = FPlatformTime::Seconds();
+		for (int32 Step = 0; Step < Steps; Step++)
+		{
+			Claims.BeginRound();
+
+			// bid for the free neighbour closest to the goal. Nothing is claimed or released in this phase, so what is free is the same for everyone
+			RunPhase(NumThreads, [&](int32 Index, FBenchAgent& Agent)
+			{
+				if (Agent.Cell == Agent.Goal)
+				{
+					Agent.Goal = OpenCells[MixPriority(Index ^ (Step * 0x9e3779b9u)) % OpenCells.Num()];
+				}
+
+				const FIntPoint Position = Grid.GetPosition(Agent.Cell);
+				const FIntPoint Goal = Grid.GetPosition(Agent.Goal);
+				int32 BestDistance = FMath::Abs(Goal.X - Position.X) + FMath::Abs(Goal.Y - Position.Y);
+				Agent.Next = INDEX_NONE;
+				for (const FIntPoint& Offset : PathSearchEngine::NeighbourOffsets)
+				{
+					const FIntPoint Neighbour = Position + Offset;
+					const int32 Distance = FMath::Abs(Goal.X - Neighbour.X) + FMath::Abs(Goal.Y - Neighbour.Y);
+					if (Distance < BestDistance && !Layers.IsBlocked(Neighbour.X, Neighbour.Y, WallLayers))
+					{
+						BestDistance = Distance;
+						Agent.Next = Grid.GetIndex(Neighbour.X, Neighbour.Y);
+					}
+				}
+
+				// stuck behind a wall, give up on the goal. Behind another agent, wait for it to move on
+				if (Agent.Next == INDEX_NONE)
+				{
+					Agent.Goal = Agent.Cell;
+				}
+				else if (Claims.GetOwner(Agent.Next) != 0)
+				{
+					Agent.Next = INDEX_NONE;
+				}
+				else
+				{
+					Claims.Bid(Agent.Next, Index + 1);
+				}
+			});
+
+			// the winners take their cells
+			RunPhase(NumThreads, [&](int32 Index, FBenchAgent& Agent)
+			{
+				if (Agent.Next != INDEX_NONE && Claims.HasWon(Agent.Next, Index + 1) && Claims.TryClaim(Agent.Next, Index + 1))
+				{
+					const FIntPoint Next = Grid.GetPosition(Agent.Next);
+					Layers.SetAtomic(Next.X, Next.Y, OccupancyGrid::Agents);
+				}
+				else
+				{
+					Agent.Next = INDEX_NONE;
+				}
+			});
+
+			// and leave the cells they stood on
+			RunPhase(NumThreads, [&](int32 Index, FBenchAgent& Agent)
+			{
+				if (Agent.Next != INDEX_NONE)
+				{
+					const FIntPoint Position = Grid.GetPosition(Agent.Cell);
+					Claims.Release(Agent.Cell, Index + 1);
+					Layers.ClearAtomic(Position.X, Position.Y, OccupancyGrid::Agents);
+					Agent.Cell = Agent.Next;
+				}
+			});
+
+			for (const FBenchAgent& Agent : Agents)
+			{
+				Moves += Agent.Next != INDEX_NONE ? 1 : 0;
+			}
+		}
+		const double Seconds = (FPlatformTime::Seconds() - StartTime) / Steps;
+
+		// where every agent ended up
+		uint32 Outcome = 0;
+		for (const FBenchAgent& Agent : Agents)
+		{
+			Outcome = FCrc::MemCrc32(&Agent.Cell, sizeof(Agent.Cell), Outcome);
+		}
+
+		if (NumThreads == 1)
+		{
+			SingleThreadSeconds = Seconds;
+			SingleThreadOutcome = Outcome;
+		}
+		UE_LOG(LogTemp, Log, TEXT("Claims benchmark: %d agents, %d threads: %.3f ms per step, speedup %.2fx, %lld moves, outcome %08x%s"),
+			NumAgents, NumThreads, Seconds * 1000.0, Seconds > 0.0 ? SingleThreadSeconds / Seconds : 0.0, Moves, Outcome,
+			Outcome == SingleThreadOutcome ? TEXT("") : TEXT(" DIFFERS FROM ONE THREAD"));
+
+		if (NumThreads >= MaxThreads)
+		{
+			break;
+		}
+	}
+}
@@ -0,0 +1,66 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class PathGrid;
+class OccupancyGrid;
+
+/**
+ * Which agent holds every cell, changed with atomic compare-and-swap so agents on different threads can claim and
+ * release cells at the same time without locks.
+ *
+ * When several agents want the same cell in one step, claiming first would let thread timing pick the winner.
+ * Instead every agent bids in a round, and the highest bid of the round takes the cell whatever order the bids came in.
+ * Bids are a bijective mix of the owner and the round, so no two owners tie and no owner always wins.
+ * A step is three phases, each safe to run in parallel: bid, claim the cells won, release the cells left.
+ * Cells released in a step can be claimed from the next step on, so no claim depends on a release racing it
+ */
+class FIT3094_A1_CODE_API CellClaims
+{
+
+public:
+
+	CellClaims();
+
+	// Make every cell of a map free
+	void Init(int32 NumCells);
+
+	// Forget the cells
+	void Reset();
+
+	// Start the next round of bids, the bids of earlier rounds lose to every bid of this one
+	void BeginRound()
+	{
+		Round++;
+	}
+
+	// Bid for the cell in the current round. Owners are never 0
+	void Bid(int32 Cell, uint32 Owner);
+	// Is the owner's bid the highest for the cell in the current round
+	bool HasWon(int32 Cell, uint32 Owner) const;
+
+	// Take a free cell, true when the owner holds it now (also when it held it already)
+	bool TryClaim(int32 Cell, uint32 Owner);
+	// Give a cell back, false (and nothing changes) when the owner does not hold it
+	bool Release(int32 Cell, uint32 Owner);
+
+	// The owner holding the cell, 0 when it is free
+	uint32 GetOwner(int32 Cell) const;
+
+	// Run a headless crowd of agents walking to random goals over the map, splitting the movement phases over 1, 2, 4...
+	// threads up to one per worker, and log the time per step and the speedup. Every run must end the same,
+	// the outcome of each is checked against the single thread one
+	static void Benchmark(const PathGrid& Grid, const OccupancyGrid& Occupancy, int32 NumAgents, int32 Steps);
+
+private:
+
+	// The bid of an owner in the current round, higher wins
+	int64 GetBid(uint32 Owner) const;
+
+	TArray<int32> Owners;
+	TArray<int64> Bids;
+	uint32 Round;
+
+};
@@ -0,0 +1,150 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CountingMalloc.h"
+#include "HAL/PlatformAtomics.h"
+
+CountingMalloc::CountingMalloc()
+	: Inner(nullptr)
+	, NumAllocs(0)
+	, NumBytes(0)
+{
+}
+
+void CountingMalloc::Install()
+{
+	check(!IsInstalled());
+	Inner = GMalloc;
+	ResetCounts();
+	GMalloc = this;
+}
+
+void CountingMalloc::Uninstall()
+{
+	// Inner stays set for the calls that read GMalloc before it changed back
+	check(IsInstalled());
+	GMalloc = Inner;
+}
+
+int64 CountingMalloc::GetNumAllocs() const
+{
+	return FPlatformAtomics::AtomicRead(&NumAllocs);
+}
+
+int64 CountingMalloc::GetNumBytes() const
+{
+	return FPlatformAtomics::AtomicRead(&NumBytes);
+}
+
+void CountingMalloc::ResetCounts()
+{
+	FPlatformAtomics::InterlockedExchange(&NumAllocs, 0);
+	FPlatformAtomics::InterlockedExchange(&NumBytes, 0);
+}
+
+void* CountingMalloc::Malloc(SIZE_T Count, uint32 Alignment)
+{
+	Record(Count);
+	return Inner->Malloc(Count, Alignment);
+}
+
+void* CountingMalloc::TryMalloc(SIZE_T Count, uint32 Alignment)
+{
+	Record(Count);
+	return Inner->TryMalloc(Count, Alignment);
+}
+
+void* CountingMalloc::Realloc(void* Original, SIZE_T Count, uint32 Alignment)
+{
+	// a realloc to 0 only frees
+	if (Count > 0)
+	{
+		Record(Count);
+	}
+	return Inner->Realloc(Original, Count, Alignment);
+}
+
+void* CountingMalloc::TryRealloc(void* Original, SIZE_T Count, uint32 Alignment)
+{
+	if (Count > 0)
+	{
+		Record(Count);
+	}
+	return Inner->TryRealloc(Original, Count, Alignment);
+}
+
+void CountingMalloc::Free(void* Original)
+{
+	Inner->Free(Original);
+}
+
+SIZE_T CountingMalloc::QuantizeSize(SIZE_T Count, uint32 Alignment)
+{
+	return Inner->QuantizeSize(Count, Alignment);
+}
+
+bool CountingMalloc::GetAllocationSize(void* Original, SIZE_T& SizeOut)
+{
+	return Inner->GetAllocationSize(Original, SizeOut);
+}
+
+void CountingMalloc::Trim(bool bTrimThreadCaches)
+{
+	Inner->Trim(bTrimThreadCaches);
+}
+
+void CountingMalloc::SetupTLSCachesOnCurrentThread()
+{
+	Inner->SetupTLSCachesOnCurrentThread();
+}
+
+void CountingMalloc::ClearAndDisableTLSCachesOnCurrentThread()
+{
+	Inner->ClearAndDisableTLSCachesOnCurrentThread();
+}
+
+void CountingMalloc::InitializeStatsMetadata()
+{
+	Inner->InitializeStatsMetadata();
+}
+
+void CountingMalloc::UpdateStats()
+{
+	Inner->UpdateStats();
+}
+
+void CountingMalloc::GetAllocatorStats(FGenericMemoryStats& OutStats)
+{
+	Inner->GetAllocatorStats(OutStats);
+}
+
+void CountingMalloc::DumpAllocatorStats(FOutputDevice& Ar)
+{
+	Inner->DumpAllocatorStats(Ar);
+}
+
+bool CountingMalloc::ValidateHeap()
+{
+	return Inner->ValidateHeap();
+}
+
+bool CountingMalloc::Exec(UWorld* InWorld, const TCHAR* Cmd, FOutputDevice& Ar)
+{
+	return Inner->Exec(InWorld, Cmd, Ar);
+}
+
+bool CountingMalloc::IsInternallyThreadSafe() const
+{
+	return Inner->IsInternallyThreadSafe();
+}
+
+const TCHAR* CountingMalloc::GetDescriptiveName()
+{
+	return Inner->GetDescriptiveName();
+}
+
+void CountingMalloc::Record(SIZE_T Bytes)
+{
+	FPlatformAtomics::InterlockedIncrement(&NumAllocs);
+	FPlatformAtomics::InterlockedAdd(&NumBytes, (int64)Bytes);
+}
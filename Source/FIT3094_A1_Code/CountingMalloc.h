@@ -0,0 +1,61 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/MemoryBase.h"
+
+/**
+ * Counts the heap allocations made while it is installed as GMalloc, handing every call on to the allocator it replaced,
+ * the thread caches, trimming and statistics included.
+ * Allocations from every thread are counted. Calls already on their way keep reaching it after it is uninstalled,
+ * so an installed counter must outlive anything that could still call it
+ */
+class FIT3094_A1_CODE_API CountingMalloc final : public FMalloc
+{
+
+public:
+
+	CountingMalloc();
+
+	// Put the counter in front of GMalloc, and take it out again
+	void Install();
+	void Uninstall();
+	bool IsInstalled() const
+	{
+		return GMalloc == this;
+	}
+
+	// Allocations and bytes asked for since the last ResetCounts. A realloc that can move the block counts as one
+	int64 GetNumAllocs() const;
+	int64 GetNumBytes() const;
+	void ResetCounts();
+
+	virtual void* Malloc(SIZE_T Count, uint32 Alignment) override;
+	virtual void* TryMalloc(SIZE_T Count, uint32 Alignment) override;
+	virtual void* Realloc(void* Original, SIZE_T Count, uint32 Alignment) override;
+	virtual void* TryRealloc(void* Original, SIZE_T Count, uint32 Alignment) override;
+	virtual void Free(void* Original) override;
+	virtual SIZE_T QuantizeSize(SIZE_T Count, uint32 Alignment) override;
+	virtual bool GetAllocationSize(void* Original, SIZE_T& SizeOut) override;
+	virtual void Trim(bool bTrimThreadCaches) override;
+	virtual void SetupTLSCachesOnCurrentThread() override;
+	virtual void ClearAndDisableTLSCachesOnCurrentThread() override;
+	virtual void InitializeStatsMetadata() override;
+	virtual void UpdateStats() override;
+	virtual void GetAllocatorStats(FGenericMemoryStats& OutStats) override;
+	virtual void DumpAllocatorStats(FOutputDevice& Ar) override;
+	virtual bool ValidateHeap() override;
+	virtual bool Exec(UWorld* InWorld, const TCHAR* Cmd, FOutputDevice& Ar) override;
+	virtual bool IsInternallyThreadSafe() const override;
+	virtual const TCHAR* GetDescriptiveName() override;
+
+private:
+
+	void Record(SIZE_T Bytes);
+
+	FMalloc* Inner;
+	volatile int64 NumAllocs;
+	volatile int64 NumBytes;
+
+};
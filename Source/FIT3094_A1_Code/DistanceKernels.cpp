@@ -0,0 +1,256 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "DistanceKernels.h"
+
+#if PLATFORM_CPU_X86_FAMILY && PLATFORM_ENABLE_VECTORINTRINSICS
+#define DISTANCE_KERNELS_X86 1
+#include <immintrin.h>
+#if PLATFORM_WINDOWS
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#else
+#define DISTANCE_KERNELS_X86 0
+#endif
+
+// MSVC emits AVX instructions anywhere, clang and gcc only in functions marked for them
+#if DISTANCE_KERNELS_X86 && (defined(__clang__) || defined(__GNUC__))
+#define DISTANCE_KERNELS_AVX2_TARGET __attribute__((target("avx2")))
+#else
+#define DISTANCE_KERNELS_AVX2_TARGET
+#endif
+
+typedef void (*FDistanceKernel)(const float* Xs, const float* Ys, int32 Count, float FromX, float FromY, float* OutDistances);
+
+static void DistancesScalar(const float* Xs, const float* Ys, int32 Count, float FromX, float FromY, float* OutDistances)
+{
+	for (int32 Index = 0; Index < Count; Index++)
+	{
+		const float DX = Xs[Index] - FromX;
+		const float DY = Ys[Index] - FromY;
+		OutDistances[Index] = FMath::Sqrt(DX * DX + DY * DY);
+	}
+}
+
+#if DISTANCE_KERNELS_X86
+
+static void DistancesSSE(const float* Xs, const float* Ys, int32 Count, float FromX, float FromY, float* OutDistances)
+{
+	const __m128 FromX4 = _mm_set1_ps(FromX);
+	const __m128 FromY4 = _mm_set1_ps(FromY);
+
+	int32 Index = 0;
+	for (; Index + 4 <= Count; Index += 4)
+	{
+		const __m128 DX = _mm_sub_ps(_mm_loadu_ps(Xs + Index), FromX4);
+		const __m128 DY = _mm_sub_ps(_mm_loadu_ps(Ys + Index), FromY4);
+		_mm_storeu_ps(OutDistances + Index, _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(DX, DX), _mm_mul_ps(DY, DY))));
+	}
+
+	// the last few points that do not fill a register
+	DistancesScalar(Xs + Index, Ys + Index, Count - Index, FromX, FromY, OutDistances + Index);
+}
+
+DISTANCE_KERNELS_AVX2_TARGET static void DistancesAVX2(const float* Xs, const float* Ys, int32 Count, float FromX, float FromY, float* OutDistances)
+{
+	const __m256 FromX8 = _mm256_set1_ps(FromX);
+	const __m256 FromY8 = _mm256_set1_ps(FromY);
+
+	int32 Index = 0;
+	for (; Index + 8 <= Count; Index += 8)
+	{
+		const __m256 DX = _mm256_sub_ps(_mm256_loadu_ps(Xs + Index), FromX8);
+		const __m256 DY = _mm256_sub_ps(_mm256_loadu_ps(Ys + Index), FromY8);
+		// no fused multiply-add, so the results stay the same as the other kernels
+		_mm256_storeu_ps(OutDistances + Index, _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(DX, DX), _mm256_mul_ps(DY, DY))));
+	}
+
+	DistancesSSE(Xs + Index, Ys + Index, Count - Index, FromX, FromY, OutDistances + Index);
+}
+
+// AVX2 needs the CPU to have it and the OS to save the 256 bit registers on a context switch
+static bool HasAVX2()
+{
+#if PLATFORM_WINDOWS
+	int Info[4];
+	__cpuid(Info, 0);
+	if (Info[0] < 7)
+	{
+		return false;
+	}
+	__cpuid(Info, 1);
+	const bool bOSSavesYMM = (Info[2] & (1 << 27)) && (Info[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6;
+	__cpuidex(Info, 7, 0);
+	return bOSSavesYMM && (Info[1] & (1 << 5)) != 0;
+#else
+	unsigned int EAX, EBX, ECX, EDX;
+	if (__get_cpuid_max(0, nullptr) < 7)
+	{
+		return false;
+	}
+	__cpuid(1, EAX, EBX, ECX, EDX);
+	if (!(ECX & (1 << 27)) || !(ECX & (1 << 28)))
+	{
+		return false;
+	}
+	unsigned int XCR0Low, XCR0High;
+	__asm__ volatile("xgetbv" : "=a"(XCR0Low), "=d"(XCR0High) : "c"(0));
+	if ((XCR0Low & 6) != 6)
+	{
+		return false;
+	}
+	__cpuid_count(7, 0, EAX, EBX, ECX, EDX);
+	return (EBX & (1 << 5)) != 0;
+#endif
+}
+
+#endif
+
+static FDistanceKernel GetKernelFunction(DistanceKernels::KERNEL Kernel)
+{
+	switch (Kernel)
+	{
+#if DISTANCE_KERNELS_X86
+	case DistanceKernels::SSE:
+		return &DistancesSSE;
+	case DistanceKernels::AVX2:
+		return &DistancesAVX2;
+#endif
+	default:
+		return &DistancesScalar;
+	}
+}
+
+static DistanceKernels::KERNEL GetBestKernel()
+{
+	for (int Kernel = DistanceKernels::KERNEL_COUNT - 1; Kernel > DistanceKernels::Scalar; Kernel--)
+	{
+		if (DistanceKernels::IsSupported((DistanceKernels::KERNEL)Kernel))
+		{
+			return (DistanceKernels::KERNEL)Kernel;
+		}
+	}
+	return DistanceKernels::Scalar;
+}
+
+// Picked on first use, so the CPU is only asked once
+static DistanceKernels::KERNEL& GetActiveKernel()
+{
+	static DistanceKernels::KERNEL ActiveKernel = GetBestKernel();
+	return ActiveKernel;
+}
+
+static FDistanceKernel& GetActiveKernelFunction()
+{
+	static FDistanceKernel ActiveKernelFunction = GetKernelFunction(GetActiveKernel());
+	return ActiveKernelFunction;
+}
+
+void DistanceKernels::Distances(const float* Xs, const float* Ys, int32 Count, float FromX, float FromY, float* OutDistances)
+{
+	GetActiveKernelFunction()(Xs, Ys, Count, FromX, FromY, OutDistances);
+}
+
+DistanceKernels::KERNEL DistanceKernels::GetKernel()
+{
+	return GetActiveKernel();
+}
+
+bool DistanceKernels::IsSupported(KERNEL Kernel)
+{
+	switch (Kernel)
+	{
+	case Scalar:
+		return true;
+#if DISTANCE_KERNELS_X86
+	case SSE:
+		// every 64 bit x86 CPU has it
+		return true;
+	case AVX2:
+	{
+		static const bool bHasAVX2 = HasAVX2();
+		return bHasAVX2;
+	}
+#endif
+	default:
+		return false;
+	}
+}
+
+bool DistanceKernels::SetKernel(KERNEL Kernel)
+{
+	if (!IsSupported(Kernel))
+	{
+		return false;
+	}
+	GetActiveKernel() = Kernel;
+	GetActiveKernelFunction() = GetKernelFunction(Kernel);
+	return true;
+}
+
+const TCHAR* DistanceKernels::GetKernelName(KERNEL Kernel)
+{
+	switch (Kernel)
+	{
+	case Scalar:
+		return TEXT("Scalar");
+	case SSE:
+		return TEXT("SSE");
+	case AVX2:
+		return TEXT("AVX2");
+	default:
+		return TEXT("Unknown");
+	}
+}
+
+void DistanceKernels::Benchmark(int32 NumCandidates, int32 Repeats)
+{
+	NumCandidates = FMath::Max(1, NumCandidates);
+	Repeats = FMath::Max(1, Repeats);
+
+	// candidates spread over a large map, as food would be
+	FRandomStream Random(NumCandidates);
+	TArray<float> Xs, Ys, Distances, ScalarDistances;
+	Xs.SetNumUninitialized(NumCandidates);
+	Ys.SetNumUninitialized(NumCandidates);
+	Distances.SetNumUninitialized(NumCandidates);
+	for (int32 Index = 0; Index < NumCandidates; Index++)
+	{
+		Xs[Index] = (float)Random.RandRange(0, 1023);
+		Ys[Index] = (float)Random.RandRange(0, 1023);
+	}
+
+	double ScalarSeconds = 0.0;
+	for (int Kernel = Scalar; Kernel < KERNEL_COUNT; Kernel++)
+	{
+		if (!IsSupported((KERNEL)Kernel))
+		{
+			UE_LOG(LogTemp, Log, TEXT("Distance kernel %s: not supported"), GetKernelName((KERNEL)Kernel));
+			continue;
+		}
+
+		const FDistanceKernel Function = GetKernelFunction((KERNEL)Kernel);
+		double Checksum = 0.0;
+		const double StartTime = FPlatformTime::Seconds();
+		for (int32 Repeat = 0; Repeat < Repeats; Repeat++)
+		{
+			// a different origin every time, so nothing can be hoisted out of the loop
+			Function(Xs.GetData(), Ys.GetData(), NumCandidates, (float)(Repeat & 1023), (float)((Repeat * 7) & 1023), Distances.GetData());
+			Checksum += Distances[Repeat % NumCandidates];
+		}
+		const double Seconds = (FPlatformTime::Seconds() - StartTime) / Repeats;
+
+		if (Kernel == Scalar)
+		{
+			ScalarSeconds = Seconds;
+			ScalarDistances = Distances;
+		}
+		const bool bMatches = Distances == ScalarDistances;
+
+		UE_LOG(LogTemp, Log, TEXT("Distance kernel %s: %d candidates in %.2f us (%.2f ns each), %.2fx scalar%s (checksum %.0f)"),
+			GetKernelName((KERNEL)Kernel), NumCandidates, Seconds * 1000000.0, Seconds * 1000000000.0 / NumCandidates,
+			Seconds > 0.0 ? ScalarSeconds / Seconds : 0.0, bMatches ? TEXT("") : TEXT(", RESULTS DIFFER"), Checksum);
+	}
+}
@@ -0,0 +1,41 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Straight line distances from one point to many, for scoring food candidates and re-keying open lists in bulk.
+ *
+ * The points are passed as separate X and Y arrays so a vector register holds 4 (SSE) or 8 (AVX2) of them.
+ * The widest kernel the CPU supports is picked the first time one is needed. Every kernel gives the same results
+ * for grid coordinates, as their squared distances are exact in float
+ */
+class FIT3094_A1_CODE_API DistanceKernels
+{
+
+public:
+
+	enum KERNEL
+	{
+		Scalar,
+		SSE,
+		AVX2,
+		KERNEL_COUNT
+	};
+
+	// OutDistances[i] is the distance from (FromX, FromY) to (Xs[i], Ys[i]). The arrays need no particular alignment
+	static void Distances(const float* Xs, const float* Ys, int32 Count, float FromX, float FromY, float* OutDistances);
+
+	// The kernel Distances uses, and whether a kernel can run on this CPU
+	static KERNEL GetKernel();
+	static bool IsSupported(KERNEL Kernel);
+	// Force a kernel, returns false (and keeps the current one) when the CPU cannot run it
+	static bool SetKernel(KERNEL Kernel);
+
+	static const TCHAR* GetKernelName(KERNEL Kernel);
+
+	// Time every supported kernel scoring NumCandidates random points and log the speedup over the scalar one
+	static void Benchmark(int32 NumCandidates, int32 Repeats);
+
+};
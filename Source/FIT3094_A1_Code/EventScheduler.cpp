@@ -0,0 +1,214 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "EventScheduler.h"
+
+EventScheduler::EventScheduler()
+{
+	NextSequence = 0;
+	NextSerial = 1;
+	Fired = 0;
+	Cancelled = 0;
+	Cascaded = 0;
+	Reset(0.0);
+}
+
+void EventScheduler::Reset(double StartTime)
+{
+	// handles of the forgotten events have serials no event will get again, so they stay unscheduled
+	Events.Reset();
+	FirstFree = INDEX_NONE;
+	for (int32 Wheel = 0; Wheel < NUM_WHEELS; Wheel++)
+	{
+		for (int32 Slot = 0; Slot < WHEEL_SIZE; Slot++)
+		{
+			Slots[Wheel][Slot] = INDEX_NONE;
+		}
+	}
+	FarEvents = INDEX_NONE;
+	NumScheduled = 0;
+
+	Time = StartTime;
+	CurrentTick = GetTick(StartTime);
+}
+
+FEventHandle EventScheduler::Schedule(double DueTime, EScheduledEvent Kind, AActor* Target)
+{
+	int32 Event = FirstFree;
+	if (Event != INDEX_NONE)
+	{
+		FirstFree = Events[Event].Next;
+	}
+	else
+	{
+		Event = Events.AddUninitialized();
+	}
+
+	FEvent& NewEvent = Events[Event];
+	NewEvent.Time = DueTime;
+	NewEvent.Sequence = NextSequence++;
+	NewEvent.Target = Target;
+	NewEvent.Serial = NextSerial++;
+	NewEvent.Kind = Kind;
+	NewEvent.bCancelled = false;
+	Insert(Event);
+	NumScheduled++;
+
+	FEventHandle Handle;
+	Handle.Index = Event;
+	Handle.Serial = NewEvent.Serial;
+	return Handle;
+}
+
+void EventScheduler::Cancel(FEventHandle& Handle)
+{
+	// the event stays in its slot and is freed when the time gets there, which saves keeping the slots doubly linked
+	if (IsScheduled(Handle))
+	{
+		Events[Handle.Index].bCancelled = true;
+		NumScheduled--;
+		Cancelled++;
+	}
+	Handle = FEventHandle();
+}
+
+void EventScheduler::Insert(int32 Event)
+{
+	// late events go in the current tick and fire at the next Advance
+	const int64 Tick = FMath::Max(GetTick(Events[Event].Time), CurrentTick);
+
+	// the innermost wheel whose turn the event falls in
+	for (int32 Wheel = 0; Wheel < NUM_WHEELS; Wheel++)
+	{
+		const int32 Shift = WHEEL_BITS * (Wheel + 1);
+		if ((Tick >> Shift) == (CurrentTick >> Shift))
+		{
+			int32& Slot = Slots[Wheel][(Tick >> (WHEEL_BITS * Wheel)) & (WHEEL_SIZE - 1)];
+			Events[Event].Next = Slot;
+			Slot = Event;
+			return;
+		}
+	}
+
+	Events[Event].Next = FarEvents;
+	FarEvents = Event;
+}
+
+void EventScheduler::Cascade(int32& Slot)
+{
+	int32 Event = Slot;
+	Slot = INDEX_NONE;
+	while (Event != INDEX_NONE)
+	{
+		const int32 Next = Events[Event].Next;
+		if (Events[Event].bCancelled)
+		{
+			Free(Event);
+		}
+		else
+		{
+			Insert(Event);
+			Cascaded++;
+		}
+		Event = Next;
+	}
+}
+
+void EventScheduler::EnterNextTick()
+{
+	CurrentTick++;
+
+	// the outer wheels first, their events may land in the slot of an inner wheel turning at the same tick
+	if ((CurrentTick & ((1LL << (WHEEL_BITS * NUM_WHEELS)) - 1)) == 0)
+	{
+		Cascade(FarEvents);
+	}
+	for (int32 Wheel = NUM_WHEELS - 1; Wheel > 0; Wheel--)
+	{
+		const int32 Shift = WHEEL_BITS * Wheel;
+		if ((CurrentTick & ((1LL << Shift) - 1)) == 0)
+		{
+			Cascade(Slots[Wheel][(CurrentTick >> Shift) & (WHEEL_SIZE - 1)]);
+		}
+	}
+}
+
+void EventScheduler::CollectDue(int32& Slot, double DueBy)
+{
+	int32* Link = &Slot;
+	while (*Link != INDEX_NONE)
+	{
+		const int32 Event = *Link;
+		if (Events[Event].bCancelled || Events[Event].Time <= DueBy)
+		{
+			// unlink it, the cancelled ones are done with and the due ones are freed once they are handed out
+			*Link = Events[Event].Next;
+			if (Events[Event].bCancelled)
+			{
+				Free(Event);
+			}
+			else
+			{
+				DueScratch.Add(Event);
+			}
+			continue;
+		}
+		Link = &Events[Event].Next;
+	}
+}
+
+void EventScheduler::Advance(double NewTime, TArray<FScheduledEvent>& OutDue)
+{
+	OutDue.Reset();
+	const int64 NewTick = GetTick(NewTime);
+
+	// an empty scheduler jumps straight there, only cancelled events can be left in the slots
+	if (NumScheduled == 0)
+	{
+		if (NewTick != CurrentTick || Events.Num() > 0)
+		{
+			Reset(NewTime);
+		}
+		Time = NewTime;
+		return;
+	}
+
+	// every tick passed is due as a whole, the one the time is in only up to the time
+	DueScratch.Reset();
+	while (CurrentTick < NewTick)
+	{
+		CollectDue(Slots[0][CurrentTick & (WHEEL_SIZE - 1)], NewTime);
+		EnterNextTick();
+	}
+	CollectDue(Slots[0][CurrentTick & (WHEEL_SIZE - 1)], NewTime);
+	Time = FMath::Max(Time, NewTime);
+
+	// the slots hold their events in no order, hand them out as they were due
+	DueScratch.Sort([this](int32 A, int32 B)
+	{
+		return Events[A].Time < Events[B].Time || (Events[A].Time == Events[B].Time && Events[A].Sequence < Events[B].Sequence);
+	});
+	OutDue.Reserve(DueScratch.Num());
+	for (int32 Event : DueScratch)
+	{
+		FScheduledEvent& Due = OutDue.AddDefaulted_GetRef();
+		Due.Kind = Events[Event].Kind;
+		Due.Target = Events[Event].Target;
+		Due.Time = Events[Event].Time;
+		Free(Event);
+	}
+	NumScheduled -= DueScratch.Num();
+	Fired += DueScratch.Num();
+}
+
+void EventScheduler::Free(int32 Event)
+{
+	Events[Event].Serial = 0;
+	Events[Event].Next = FirstFree;
+	FirstFree = Event;
+}
+
+void EventScheduler::LogStats() const
+{
+	UE_LOG(LogTemp, Log, TEXT("Events: %lld fired, %lld cancelled, %lld moved down a wheel, %d waiting"), Fired, Cancelled, Cascaded, NumScheduled);
+}
@@ -0,0 +1,157 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class AActor;
+
+// What happens when a scheduled event is due
+enum class EScheduledEvent : uint8
+{
+	// A sleeping agent gets to the node it is walking into
+	Arrival,
+	// An agent loses a point of health, and starves at 0
+	HealthDecay,
+	// Eaten food is put down again somewhere else
+	FoodRespawn
+};
+
+// An event that came due, in the order they were due
+struct FScheduledEvent
+{
+	EScheduledEvent Kind;
+	// The actor the event is for
+	AActor* Target;
+	// When it was due, which may be a little before the time it fired at
+	double Time;
+};
+
+// Refers to a scheduled event, to cancel it or ask when it is due. Stays safe to use after the event fired
+struct FEventHandle
+{
+	int32 Index = INDEX_NONE;
+	uint32 Serial = 0;
+};
+
+/**
+ * Events of the simulation due at known times, so nothing has to check every frame whether they are due yet.
+ *
+ * A hierarchical timing wheel: time is cut into ticks of TICK_SECONDS, the first wheel has a slot for every tick of the
+ * next WHEEL_SIZE, the second a slot for every WHEEL_SIZE ticks and so on. Scheduling and cancelling are constant time,
+ * and an event is only moved down a wheel when the time gets to its slot, at most once per wheel. Events in the slot of
+ * the current tick still fire at their exact time, so an agent woken by its arrival arrives on the frame it would have
+ * walked there on
+ */
+class FIT3094_A1_CODE_API EventScheduler
+{
+
+public:
+
+	// Resolution of the wheels
+	static constexpr double TICK_SECONDS = 1.0 / 64.0;
+	// Slots per wheel (a power of two) and number of wheels. Four wheels of 64 cover three days, later events wait
+	// in a list looked at when the last wheel turns
+	static const int32 WHEEL_BITS = 6;
+	static const int32 WHEEL_SIZE = 1 << WHEEL_BITS;
+	static const int32 NUM_WHEELS = 4;
+
+	EventScheduler();
+
+	// Forget every event and start the clock at the time
+	void Reset(double StartTime);
+
+	// Schedule an event, times before the current one fire at the next Advance
+	FEventHandle Schedule(double DueTime, EScheduledEvent Kind, AActor* Target);
+	// Take an event off the wheels before it fires, does nothing when it fired or was cancelled already
+	void Cancel(FEventHandle& Handle);
+
+	// Is the event still waiting to fire
+	bool IsScheduled(const FEventHandle& Handle) const
+	{
+		return Handle.Index >= 0 && Handle.Index < Events.Num() && Events[Handle.Index].Serial == Handle.Serial && !Events[Handle.Index].bCancelled;
+	}
+	// When a scheduled event is due
+	double GetDueTime(const FEventHandle& Handle) const
+	{
+		return Events[Handle.Index].Time;
+	}
+
+	// Move the clock on and take out every event due by then, in the order they were due (and scheduled, for ties)
+	void Advance(double NewTime, TArray<FScheduledEvent>& OutDue);
+
+	// The time of the last Advance
+	double GetTime() const
+	{
+		return Time;
+	}
+
+	// How many events are waiting
+	int32 GetNumScheduled() const
+	{
+		return NumScheduled;
+	}
+
+	// Write the event counts to the log
+	void LogStats() const;
+
+private:
+
+	struct FEvent
+	{
+		double Time;
+		// Breaks ties between events due at the same time
+		uint64 Sequence;
+		AActor* Target;
+		// The next event in the same slot, or the next free event
+		int32 Next;
+		// Changes every time the event is freed, so old handles do not match the next event put there
+		uint32 Serial;
+		EScheduledEvent Kind;
+		bool bCancelled;
+	};
+
+	// The tick a time falls in
+	static int64 GetTick(double InTime)
+	{
+		return (int64)FMath::FloorToDouble(InTime / TICK_SECONDS);
+	}
+
+	// Put an event in the slot for its tick, seen from the current one
+	void Insert(int32 Event);
+	// Move the events of a slot of an outer wheel down, as the current tick got to it
+	void Cascade(int32& Slot);
+	// Start the next tick, cascading the wheels that turned
+	void EnterNextTick();
+
+	// Take the events of a slot due by the time into DueScratch, the others (due later in the tick) stay
+	void CollectDue(int32& Slot, double DueBy);
+
+	// Give an event back to the free list
+	void Free(int32 Event);
+
+	TArray<FEvent> Events;
+	int32 FirstFree;
+
+	// The first event of every slot of every wheel, INDEX_NONE when empty
+	int32 Slots[NUM_WHEELS][WHEEL_SIZE];
+	// Events beyond the last wheel
+	int32 FarEvents;
+
+	// The current tick, whose events fire as soon as they are due
+	int64 CurrentTick;
+	double Time;
+
+	uint64 NextSequence;
+	uint32 NextSerial;
+	int32 NumScheduled;
+
+	// The events that came due in an Advance, to be sorted
+	TArray<int32> DueScratch;
+
+	// Statistics
+	int64 Fired;
+	int64 Cancelled;
+	int64 Cascaded;
+
+};
@@ -4,6 +4,8 @@
 #include "FIT3094_A1_CodeGameModeBase.h"
 
 #include "Misc/FileHelper.h"
+#include "PathfindingSubsystem.h"
+#include "Engine/World.h"
 
 TArray<FString> AFIT3094_A1_CodeGameModeBase::GetMapFileList()
 {
@@ -15,16 +17,27 @@ TArray<FString> AFIT3094_A1_CodeGameModeBase::GetMapFileList()
 		return MapFiles;
 }
 
-FString AFIT3094_A1_CodeGameModeBase::GetRandomMapText()
+FString AFIT3094_A1_CodeGameModeBase::GetRandomMapPath()
 {
 	TArray<FString> MapFiles = GetMapFileList();
 
 	int32 MapPosition = FMath::RandRange(0, MapFiles.Num() - 1);
-	FString MapPath = MapFiles[MapPosition];
+	return MapFiles[MapPosition];
+}
+
+FString AFIT3094_A1_CodeGameModeBase::GetRandomMapText()
+{
+	FString MapPath = GetRandomMapPath();
 
 	FString MapText;
 	FFileHelper::LoadFileToString(MapText, *MapPath);
 
+	// let the subsystem know which map is coming, for its per-map settings
+	if (UPathfindingSubsystem* Pathfinding = GetWorld()->GetSubsystem<UPathfindingSubsystem>())
+	{
+		Pathfinding->SetNextMapName(FPaths::GetBaseFilename(MapPath));
+	}
+
 	return MapText;
 }
 
@@ -21,6 +21,10 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "Utility Functions")
 		TArray<FString> GetMapFileList();
 
+	// Pick one of the map files, for loading it in the background with ALevelGenerator::GenerateWorldFromMapFile
+	UFUNCTION(BlueprintCallable, Category = "Utility Functions")
+		FString GetRandomMapPath();
+
 	UFUNCTION(BlueprintCallable, Category = "Utility Functions")
 		FString GetRandomMapText();
 
@@ -2,12 +2,15 @@
 
 
 #include "Food.h"
+#include "FrameArena.h"
 
 // Sets default values
 AFood::AFood()
 {
  	// Set this actor to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
 	PrimaryActorTick.bCanEverTick = false;
+	IsEaten = false;
+	Generation = 0;
 	SetupFoodType();
 }
 
@@ -20,6 +23,19 @@ void AFood::BeginPlay()
 
 }
 
+// Give a recycled food a new type and material, as if it had just been spawned
+void AFood::Reinitialise() {
+	IsEaten = false;
+	Generation++;
+	SetupFoodType();
+	SetupMaterial();
+}
+
+void AFood::SetType(FOOD_TYPE NewType) {
+	Type = NewType;
+	SetupMaterial();
+}
+
 // Called in the contructor to set up the food type
 void AFood::SetupFoodType() {
 	int selector = FMath::RandRange(0, TYPE_COUNTER-1);
@@ -37,12 +53,13 @@ void AFood::SetupFoodType() {
 
 // Set up the Material for the Cylinder child actor, based on the food type
 void AFood::SetupMaterial() {
-	TArray<UActorComponent*> children;
+	// the component list is only needed here, it comes from the frame arena
+	FrameArena::FMark Mark;
+	TArray<UActorComponent*, TFrameArenaAllocator<>> children;
 	this->GetComponents(children);
 
 	for (UActorComponent* child : children) {
-		FString name = child->GetName();
-		if (child->GetName() == "Cylinder")
+		if (child->GetFName() == TEXT("Cylinder"))
 		{
 			UStaticMeshComponent* mesh = Cast<UStaticMeshComponent>(child);
 			// If its a vegetable, set it to green, otherwise set it to green
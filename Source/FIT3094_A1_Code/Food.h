@@ -29,11 +29,20 @@ public:
 	// If the food has been eaten
 	bool IsEaten;
 
+	// Bumped every time the food is recycled by the pool, so agents can tell a reused food from the one they chose
+	int Generation;
+
 	// Two materials for different type of food 
 	UPROPERTY(EditAnywhere, Category = "Mat")
 		UMaterial* HerbivoreMat;
 	UPROPERTY(EditAnywhere, Category = "Mat")
 		UMaterial* CarnivoreMat;
+
+	// Called by the actor pool when a released food is reused
+	void Reinitialise();
+
+	// Make the food another type, for putting back a snapshot
+	void SetType(FOOD_TYPE NewType);
 	
 protected:
 	// Called when the game starts or when spawned
@@ -0,0 +1,273 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "FoodAssignment.h"
+#include "Agent.h"
+#include "DistanceKernels.h"
+#include "Food.h"
+#include "FrameArena.h"
+#include "LevelGenerator.h"
+#include "OccupancyGrid.h"
+
+FoodAssignment::FoodAssignment()
+{
+	Requests = 0;
+	Batches = 0;
+	Assigned = 0;
+	LargestBatch = 0;
+	TotalCost = 0.0;
+	Seconds = 0.0;
+}
+
+void FoodAssignment::Request(AAgent* Agent)
+{
+	ReleaseClaim(Agent);
+	if (!Waiting.Contains(Agent))
+	{
+		Waiting.Add(Agent);
+		Requests++;
+	}
+}
+
+void FoodAssignment::Cancel(AAgent* Agent)
+{
+	ReleaseClaim(Agent);
+	Waiting.Remove(Agent);
+}
+
+void FoodAssignment::Claim(AAgent* Agent, AFood* Food)
+{
+	ReleaseClaim(Agent);
+	ReleaseFood(Food);
+	Waiting.Remove(Agent);
+	Claims.Add(Agent, Food);
+	Claimants.Add(Food, Agent);
+}
+
+void FoodAssignment::ReleaseClaim(AAgent* Agent)
+{
+	AFood* Food = nullptr;
+	if (Claims.RemoveAndCopyValue(Agent, Food))
+	{
+		Claimants.Remove(Food);
+	}
+}
+
+void FoodAssignment::ReleaseFood(AFood* Food)
+{
+	AAgent* Agent = nullptr;
+	if (Claimants.RemoveAndCopyValue(Food, Agent))
+	{
+		Claims.Remove(Agent);
+	}
+}
+
+void FoodAssignment::Solve(const TArray<AFood*>& Foods, const OccupancyGrid& Occupancy)
+{
+	// agents can be destroyed with the world while waiting
+	Waiting.RemoveAll([](AAgent* Agent)
+	{
+		return !IsValid(Agent);
+	});
+	if (Waiting.Num() == 0)
+	{
+		return;
+	}
+
+	double StartTime = FPlatformTime::Seconds();
+	Batches++;
+	LargestBatch = FMath::Max(LargestBatch, Waiting.Num());
+
+	// agents only compete with agents of the same type, so every food type is a separate matching
+	for (int FoodType = 0; FoodType < AFood::TYPE_COUNTER; FoodType++)
+	{
+		BatchAgents.Reset();
+		for (AAgent* Agent : Waiting)
+		{
+			if (Agent->GetPreferredFoodType() == FoodType)
+			{
+				BatchAgents.Add(Agent);
+			}
+		}
+
+		// the food nobody holds and no agent stands on
+		BatchFoods.Reset();
+		for (AFood* Food : Foods)
+		{
+			if (!IsValid(Food) || Food->IsEaten || Food->Type != FoodType || IsClaimed(Food))
+			{
+				continue;
+			}
+			int X = Food->GetActorLocation().X / ALevelGenerator::GRID_SIZE_WORLD;
+			int Y = Food->GetActorLocation().Y / ALevelGenerator::GRID_SIZE_WORLD;
+			if (!Occupancy.Test(X, Y, OccupancyGrid::Agents))
+			{
+				BatchFoods.Add(Food);
+			}
+		}
+
+		if (BatchAgents.Num() == 0 || BatchFoods.Num() == 0)
+		{
+			continue;
+		}
+
+		// the estimate every agent used to pick its nearest food with (see AAgent::EstimateTravelCost),
+		// a whole row of food at a time
+		const int NumFoods = BatchFoods.Num();
+		BatchFoodXs.SetNumUninitialized(NumFoods, false);
+		BatchFoodYs.SetNumUninitialized(NumFoods, false);
+		BatchRow.SetNumUninitialized(NumFoods, false);
+		for (int Column = 0; Column < NumFoods; Column++)
+		{
+			BatchFoodXs[Column] = BatchFoods[Column]->GetActorLocation().X / ALevelGenerator::GRID_SIZE_WORLD;
+			BatchFoodYs[Column] = BatchFoods[Column]->GetActorLocation().Y / ALevelGenerator::GRID_SIZE_WORLD;
+		}
+		BatchCosts.SetNumUninitialized(BatchAgents.Num() * NumFoods, false);
+		for (int Row = 0; Row < BatchAgents.Num(); Row++)
+		{
+			const FVector AgentLocation = BatchAgents[Row]->GetSimulatedLocation();
+			DistanceKernels::Distances(BatchFoodXs.GetData(), BatchFoodYs.GetData(), NumFoods,
+				AgentLocation.X / ALevelGenerator::GRID_SIZE_WORLD, AgentLocation.Y / ALevelGenerator::GRID_SIZE_WORLD, BatchRow.GetData());
+			for (int Column = 0; Column < NumFoods; Column++)
+			{
+				BatchCosts[Row * NumFoods + Column] = BatchRow[Column];
+			}
+		}
+
+		SolveMinCost(BatchCosts, BatchAgents.Num(), BatchFoods.Num(), BatchColumns);
+
+		// publish every claim of the batch before any agent plans, so the paths see the final claims
+		for (int Row = 0; Row < BatchAgents.Num(); Row++)
+		{
+			const int32 Column = BatchColumns[Row];
+			if (Column == INDEX_NONE)
+			{
+				continue;
+			}
+			Claims.Add(BatchAgents[Row], BatchFoods[Column]);
+			Claimants.Add(BatchFoods[Column], BatchAgents[Row]);
+			Waiting.Remove(BatchAgents[Row]);
+			TotalCost += BatchCosts[Row * BatchFoods.Num() + Column];
+			Assigned++;
+		}
+		for (int Row = 0; Row < BatchAgents.Num(); Row++)
+		{
+			if (BatchColumns[Row] != INDEX_NONE)
+			{
+				BatchAgents[Row]->ReceiveGoal(BatchFoods[BatchColumns[Row]]);
+			}
+		}
+	}
+
+	Seconds += FPlatformTime::Seconds() - StartTime;
+}
+
+void FoodAssignment::Reset()
+{
+	Waiting.Empty();
+	Claims.Empty();
+	Claimants.Empty();
+}
+
+void FoodAssignment::LogStats() const
+{
+	UE_LOG(LogTemp, Log, TEXT("Food Assignment: %d requests, %d assigned in %d batches (largest %d), average cost %.1f, %.3f ms per batch"),
+		Requests, Assigned, Batches, LargestBatch, Assigned > 0 ? TotalCost / Assigned : 0.0, Batches > 0 ? Seconds * 1000.0 / Batches : 0.0);
+}
+
+void FoodAssignment::SolveMinCost(const TArray<double>& Costs, int NumRows, int NumColumns, TArray<int32>& OutColumns)
+{
+	OutColumns.Init(INDEX_NONE, NumRows);
+
+	// the method below needs at least as many columns as rows, so more agents than food is solved the other way round
+	const bool bTransposed = NumRows > NumColumns;
+	const int N = bTransposed ? NumColumns : NumRows;
+	const int M = bTransposed ? NumRows : NumColumns;
+	auto Cost = [&Costs, bTransposed, NumColumns](int Row, int Column)
+	{
+		return bTransposed ? Costs[Column * NumColumns + Row] : Costs[Row * NumColumns + Column];
+	};
+
+	// Hungarian method with potentials, O(N^2 M). Rows and columns are counted from 1, column 0 is a dummy
+	// that holds the row being added. Match[Column] is the row of a column, 0 when the column is free.
+	// All of it is scratch for this solve, from the frame arena
+	FrameArena::FMark Mark;
+	TArray<double, TFrameArenaAllocator<>> RowPotential, ColumnPotential, MinSlack;
+	TArray<int32, TFrameArenaAllocator<>> Match, Way;
+	TArray<bool, TFrameArenaAllocator<>> Used;
+	RowPotential.Init(0.0, N + 1);
+	ColumnPotential.Init(0.0, M + 1);
+	Match.Init(0, M + 1);
+	Way.Init(0, M + 1);
+
+	for (int Row = 1; Row <= N; Row++)
+	{
+		// grow a tree of tight edges from the new row until it reaches a free column
+		Match[0] = Row;
+		int32 Column0 = 0;
+		MinSlack.Init(MAX_dbl, M + 1);
+		Used.Init(false, M + 1);
+		do
+		{
+			Used[Column0] = true;
+			const int32 Row0 = Match[Column0];
+			double Delta = MAX_dbl;
+			int32 Column1 = 0;
+			for (int Column = 1; Column <= M; Column++)
+			{
+				if (Used[Column])
+				{
+					continue;
+				}
+				const double Slack = Cost(Row0 - 1, Column - 1) - RowPotential[Row0] - ColumnPotential[Column];
+				if (Slack < MinSlack[Column])
+				{
+					MinSlack[Column] = Slack;
+					Way[Column] = Column0;
+				}
+				if (MinSlack[Column] < Delta)
+				{
+					Delta = MinSlack[Column];
+					Column1 = Column;
+				}
+			}
+			for (int Column = 0; Column <= M; Column++)
+			{
+				if (Used[Column])
+				{
+					RowPotential[Match[Column]] += Delta;
+					ColumnPotential[Column] -= Delta;
+				}
+				else
+				{
+					MinSlack[Column] -= Delta;
+				}
+			}
+			Column0 = Column1;
+		} while (Match[Column0] != 0);
+
+		// flip the augmenting path back to the root
+		do
+		{
+			const int32 Column1 = Way[Column0];
+			Match[Column0] = Match[Column1];
+			Column0 = Column1;
+		} while (Column0 != 0);
+	}
+
+	for (int Column = 1; Column <= M; Column++)
+	{
+		if (Match[Column] == 0)
+		{
+			continue;
+		}
+		if (bTransposed)
+		{
+			OutColumns[Column - 1] = Match[Column] - 1;
+		}
+		else
+		{
+			OutColumns[Match[Column] - 1] = Column - 1;
+		}
+	}
+}
@@ -0,0 +1,89 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class AAgent;
+class AFood;
+class OccupancyGrid;
+
+/**
+ * Hands out food to the agents that need a goal, all at once every tick instead of each agent taking the nearest food.
+ *
+ * Agents asking for a goal during a tick wait for Solve, which matches them to the unclaimed food of their type
+ * with the smallest total estimated travel cost (Hungarian method). The matched food is claimed by its agent
+ * until the agent eats it, asks for a new goal or goes back to the pool, and no other agent is given a claimed food
+ */
+class FIT3094_A1_CODE_API FoodAssignment
+{
+
+public:
+
+	FoodAssignment();
+
+	// Ask for a goal in the next batch, giving up the food the agent holds
+	void Request(AAgent* Agent);
+	// Forget the agent, it is not waiting for a goal nor holding any food any more
+	void Cancel(AAgent* Agent);
+
+	// Give the food to the agent straight away, as a batch would have. Both give up what they held
+	void Claim(AAgent* Agent, AFood* Food);
+	// Give up the food held by the agent
+	void ReleaseClaim(AAgent* Agent);
+	// The food is gone, whoever held it loses the claim
+	void ReleaseFood(AFood* Food);
+
+	// Is the food held by an agent
+	bool IsClaimed(const AFood* Food) const
+	{
+		return Claimants.Contains(Food);
+	}
+
+	// Is the agent waiting for the next batch
+	bool IsWaiting(const AAgent* Agent) const
+	{
+		return Waiting.Contains(Agent);
+	}
+
+	// Match the waiting agents to the food and give every matched agent its goal.
+	// Agents left without food (there is less food than agents of their type) keep waiting for the next batch
+	void Solve(const TArray<AFood*>& Foods, const OccupancyGrid& Occupancy);
+
+	// Forget every request and claim, used when the map changes
+	void Reset();
+
+	// Write the batch statistics to the log
+	void LogStats() const;
+
+	// Find the assignment of rows to columns with the smallest total cost. Costs holds NumRows x NumColumns values, row major.
+	// OutColumns gets the column of every row, INDEX_NONE for the rows left out when there are more rows than columns
+	static void SolveMinCost(const TArray<double>& Costs, int NumRows, int NumColumns, TArray<int32>& OutColumns);
+
+private:
+
+	// The agents waiting for a goal, in the order they asked
+	TArray<AAgent*> Waiting;
+
+	// Who holds which food, both ways
+	TMap<AAgent*, AFood*> Claims;
+	TMap<const AFood*, AAgent*> Claimants;
+
+	// Scratch for one batch, kept to avoid allocating every tick
+	TArray<AAgent*> BatchAgents;
+	TArray<AFood*> BatchFoods;
+	TArray<float> BatchFoodXs;
+	TArray<float> BatchFoodYs;
+	TArray<float> BatchRow;
+	TArray<double> BatchCosts;
+	TArray<int32> BatchColumns;
+
+	// Statistics
+	int32 Requests;
+	int32 Batches;
+	int32 Assigned;
+	int32 LargestBatch;
+	double TotalCost;
+	double Seconds;
+
+};
@@ -0,0 +1,324 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ForkSimulation.h"
+#include "LevelGenerator.h"
+#include "Async/ParallelFor.h"
+#include "HAL/PlatformTime.h"
+
+// Health is lost every two seconds and eating fills it up again, as for the actors
+static const float HealthSeconds = 2.f;
+static const int32 FullHealth = 50;
+
+// Tries at finding a random free cell for food before leaving it where it was
+static const int32 MaxRandomTries = 100;
+
+namespace
+{
+	int32 PickNearestFood(ForkSimulation& Fork, const FSimAgent& Agent)
+	{
+		const TArray<FSimFood>& Food = Fork.GetState().Food;
+		int32 Best = INDEX_NONE;
+		float BestDistance = MAX_flt;
+		for (int32 Index = 0; Index < Food.Num(); Index++)
+		{
+			if (Food[Index].Type != Agent.FoodType || Fork.IsFoodTaken(Index, Agent))
+			{
+				continue;
+			}
+			const float Distance = FVector2D::Distance(FVector2D(Food[Index].Cell), FVector2D(Agent.Cell));
+			if (Distance < BestDistance)
+			{
+				BestDistance = Distance;
+				Best = Index;
+			}
+		}
+		return Best;
+	}
+
+	int32 PickRandomFood(ForkSimulation& Fork, const FSimAgent& Agent)
+	{
+		const TArray<FSimFood>& Food = Fork.GetState().Food;
+		int32 Picked = INDEX_NONE;
+		int32 Seen = 0;
+		for (int32 Index = 0; Index < Food.Num(); Index++)
+		{
+			// every candidate is kept with an equal chance, in one pass
+			if (Food[Index].Type == Agent.FoodType && !Fork.IsFoodTaken(Index, Agent) && Fork.GetRandom().RandRange(0, Seen++) == 0)
+			{
+				Picked = Index;
+			}
+		}
+		return Picked;
+	}
+}
+
+ForkSimulation::FPolicy ForkSimulation::GetPolicy(FName Name)
+{
+	if (Name == TEXT("Nearest"))
+	{
+		return &PickNearestFood;
+	}
+	if (Name == TEXT("Random"))
+	{
+		return &PickRandomFood;
+	}
+	return FPolicy();
+}
+
+void ForkSimulation::GetPolicyNames(TArray<FName>& OutNames)
+{
+	OutNames.Add(TEXT("Nearest"));
+	OutNames.Add(TEXT("Random"));
+}
+
+void ForkSimulation::RunAll(const TArray<TUniquePtr<ForkSimulation>>& Forks, double Seconds, float StepSeconds)
+{
+	// the forks only share the terrain, which none of them changes in place while another uses it
+	ParallelFor(Forks.Num(), [&Forks, Seconds, StepSeconds](int32 Index)
+	{
+		Forks[Index]->Run(Seconds, StepSeconds);
+	});
+}
+
+ForkSimulation::ForkSimulation(const SimSnapshot& From, FPolicy InPolicy)
+	: State(From)
+	, Policy(MoveTemp(InPolicy))
+	, Random(From.Seed)
+{
+	// the occupancy follows from the terrain, the food and where the agents stand or are stepping into
+	Occupancy.Init(State.GetTerrain());
+	for (const FSimFood& Food : State.Food)
+	{
+		Occupancy.Set(Food.Cell.X, Food.Cell.Y, OccupancyGrid::GetFoodLayer(Food.Type));
+	}
+	for (const FSimAgent& Agent : State.Agents)
+	{
+		Occupancy.Set(Agent.Cell.X, Agent.Cell.Y, OccupancyGrid::Agents);
+		if (Agent.StepDistance > 0.f && Agent.Path.Num() > 0)
+		{
+			Occupancy.Set(Agent.Path.Last().X, Agent.Path.Last().Y, OccupancyGrid::Agents);
+		}
+	}
+}
+
+void ForkSimulation::Reseed(int32 Seed)
+{
+	Random.Initialize(Seed);
+}
+
+void ForkSimulation::Run(double Seconds, float StepSeconds)
+{
+	const double StartTime = FPlatformTime::Seconds();
+	const double EndTime = State.Time + Seconds;
+	while (State.Time < EndTime && State.Agents.Num() > 0)
+	{
+		Step(StepSeconds);
+	}
+	Stats.Seconds += FPlatformTime::Seconds() - StartTime;
+}
+
+void ForkSimulation::Step(float DeltaSeconds)
+{
+	State.Time += DeltaSeconds;
+
+	for (int32 Index = 0; Index < State.Agents.Num();)
+	{
+		FSimAgent& Agent = State.Agents[Index];
+
+		// health goes on the timer, whatever the agent is doing
+		Agent.HealthSeconds -= DeltaSeconds;
+		while (Agent.HealthSeconds <= 0.f && Agent.Health > 0)
+		{
+			Agent.Health--;
+			Agent.HealthSeconds += HealthSeconds;
+		}
+		if (Agent.Health <= 0)
+		{
+			CancelStep(Agent);
+			Occupancy.Clear(Agent.Cell.X, Agent.Cell.Y, OccupancyGrid::Agents);
+			State.Agents.RemoveAt(Index, 1, false);
+			Stats.Starved++;
+			continue;
+		}
+		Index++;
+
+		// the goal was eaten by someone else, or there was none yet
+		const bool bGoalValid = Agent.Goal != INDEX_NONE && State.Food[Agent.Goal].Generation == Agent.GoalGeneration;
+		if (!bGoalValid)
+		{
+			CancelStep(Agent);
+			Agent.Path.Reset();
+			Agent.Goal = Policy(*this, Agent);
+			if (Agent.Goal == INDEX_NONE)
+			{
+				continue;
+			}
+			Agent.GoalGeneration = State.Food[Agent.Goal].Generation;
+			if (!PlanPath(Agent))
+			{
+				Agent.Goal = INDEX_NONE;
+				continue;
+			}
+		}
+
+		// at the end of the path, eat
+		if (Agent.Path.Num() == 0)
+		{
+			const int32 Eaten = Agent.Goal;
+			Agent.Health = FullHealth;
+			Agent.Goal = INDEX_NONE;
+			Stats.FoodEaten++;
+			RespawnFood(Eaten);
+			continue;
+		}
+
+		// starting a step, the next cell has to be free and is held until the agent is in it
+		const FIntPoint Next = Agent.Path.Last();
+		if (Agent.StepDistance <= 0.f)
+		{
+			if (Occupancy.IsBlocked(Next.X, Next.Y, GetBlockingLayers(Agent)))
+			{
+				if (!PlanPath(Agent))
+				{
+					Agent.Goal = INDEX_NONE;
+				}
+				continue;
+			}
+			Occupancy.Set(Next.X, Next.Y, OccupancyGrid::Agents);
+		}
+
+		// the actors arrive once they are within the tolerance of the next cell
+		Agent.StepDistance += Agent.MoveSpeed * DeltaSeconds;
+		if (Agent.StepDistance >= ALevelGenerator::GRID_SIZE_WORLD - Agent.Tolerance)
+		{
+			Occupancy.Clear(Agent.Cell.X, Agent.Cell.Y, OccupancyGrid::Agents);
+			Agent.Cell = Next;
+			Agent.Path.Pop(false);
+			Agent.StepDistance = 0.f;
+			Stats.Moves++;
+		}
+	}
+}
+
+bool ForkSimulation::PlanPath(FSimAgent& Agent)
+{
+	CancelStep(Agent);
+	Agent.Path.Reset();
+
+	// the agent's own cell does not block it, only the others do
+	FPathQuery Query;
+	Query.Start = Agent.Cell;
+	Query.Goal = State.Food[Agent.Goal].Cell;
+	Query.BlockingLayers = GetBlockingLayers(Agent);
+
+	Stats.Plans++;
+	if (!Engine.FindPath(State.GetTerrain(), Occupancy, Query, Result))
+	{
+		Stats.PlanFailures++;
+		return false;
+	}
+
+	// the engine gives the first step first, the agent pops steps off the end
+	Agent.Path.Reserve(Result.Path.Num());
+	for (int32 Index = Result.Path.Num() - 1; Index >= 0; Index--)
+	{
+		Agent.Path.Add(Result.Path[Index]);
+	}
+	return true;
+}
+
+void ForkSimulation::CancelStep(FSimAgent& Agent)
+{
+	if (Agent.StepDistance > 0.f && Agent.Path.Num() > 0)
+	{
+		Occupancy.Clear(Agent.Path.Last().X, Agent.Path.Last().Y, OccupancyGrid::Agents);
+	}
+	Agent.StepDistance = 0.f;
+}
+
+void ForkSimulation::RespawnFood(int32 FoodIndex)
+{
+	FSimFood& Food = State.Food[FoodIndex];
+	Occupancy.Clear(Food.Cell.X, Food.Cell.Y, OccupancyGrid::GetFoodLayer(Food.Type));
+
+	const PathGrid& Terrain = State.GetTerrain();
+	const uint8 Taken = OccupancyGrid::LayerMask(OccupancyGrid::Walls) | OccupancyGrid::LayerMask(OccupancyGrid::Agents)
+		| OccupancyGrid::LayerMask(OccupancyGrid::Meat) | OccupancyGrid::LayerMask(OccupancyGrid::Vegetation);
+	for (int32 Tries = 0; Tries < MaxRandomTries; Tries++)
+	{
+		const FIntPoint Cell(Random.RandRange(0, Terrain.SizeX - 1), Random.RandRange(0, Terrain.SizeY - 1));
+		if (!Occupancy.IsBlocked(Cell.X, Cell.Y, Taken))
+		{
+			Food.Cell = Cell;
+			break;
+		}
+	}
+
+	// a recycled food, agents going for the old one choose again
+	Food.Type = Random.RandRange(0, 1);
+	Food.Generation++;
+	Occupancy.Set(Food.Cell.X, Food.Cell.Y, OccupancyGrid::GetFoodLayer(Food.Type));
+}
+
+uint8 ForkSimulation::GetBlockingLayers(const FSimAgent& Agent)
+{
+	// the food of the other type is in the way
+	return OccupancyGrid::LayerMask(OccupancyGrid::Walls) | OccupancyGrid::LayerMask(OccupancyGrid::Agents)
+		| OccupancyGrid::LayerMask(OccupancyGrid::GetFoodLayer(1 - Agent.FoodType));
+}
+
+bool ForkSimulation::IsFoodTaken(int32 FoodIndex, const FSimAgent& Agent) const
+{
+	const int32 Generation = State.Food[FoodIndex].Generation;
+	return State.Agents.ContainsByPredicate([FoodIndex, Generation, &Agent](const FSimAgent& Other)
+	{
+		return &Other != &Agent && Other.Goal == FoodIndex && Other.GoalGeneration == Generation;
+	});
+}
+
+int32 ForkSimulation::EditTerrain(const TArray<FIntPoint>& Cells, GridNode::GRID_TYPE NewType)
+{
+	const uint8 ObjectLayers = OccupancyGrid::LayerMask(OccupancyGrid::Agents) | OccupancyGrid::LayerMask(OccupancyGrid::Meat) | OccupancyGrid::LayerMask(OccupancyGrid::Vegetation);
+
+	TSet<FIntPoint> Changed;
+	for (const FIntPoint& Cell : Cells)
+	{
+		const PathGrid& Terrain = State.GetTerrain();
+		if (!Terrain.IsInside(Cell.X, Cell.Y) || Terrain.GetType(Cell.X, Cell.Y) == NewType)
+		{
+			continue;
+		}
+		// nothing may stand in a wall
+		if (NewType == GridNode::Wall && Occupancy.IsBlocked(Cell.X, Cell.Y, ObjectLayers))
+		{
+			continue;
+		}
+
+		// the first change copies the shared terrain
+		State.EditTerrain().SetType(Cell.X, Cell.Y, NewType);
+		if (NewType == GridNode::Wall)
+		{
+			Occupancy.Set(Cell.X, Cell.Y, OccupancyGrid::Walls);
+		}
+		else
+		{
+			Occupancy.Clear(Cell.X, Cell.Y, OccupancyGrid::Walls);
+		}
+		Changed.Add(Cell);
+	}
+
+	// plan again where the path crosses a changed cell
+	for (FSimAgent& Agent : State.Agents)
+	{
+		const bool bCrosses = Agent.Path.ContainsByPredicate([&Changed](const FIntPoint& Cell)
+		{
+			return Changed.Contains(Cell);
+		});
+		if (bCrosses && Agent.Goal != INDEX_NONE && !PlanPath(Agent))
+		{
+			Agent.Goal = INDEX_NONE;
+		}
+	}
+	return Changed.Num();
+}
@@ -0,0 +1,106 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AStarEngine.h"
+#include "GridNode.h"
+#include "OccupancyGrid.h"
+#include "PathSearch.h"
+#include "SimSnapshot.h"
+
+class ForkSimulation;
+
+// What a fork did since it started
+struct FForkStats
+{
+	int32 FoodEaten = 0;
+	int32 Starved = 0;
+	int32 Plans = 0;
+	int32 PlanFailures = 0;
+	int64 Moves = 0;
+	// Time the fork took to run
+	double Seconds = 0.0;
+};
+
+/**
+ * Runs a snapshot on headless, for what-if experiments from one mid-game state: fork a snapshot a few times,
+ * give every fork its own policy (or terrain edit, or seed) and run them all at once on worker threads.
+ *
+ * The rules are the ones the actors follow, in whole cell steps (as agents out of sight walk, see AAgent::SetLowDetail):
+ * health drops every two seconds and an agent starves at zero, eating the goal food restores it, and eaten food comes
+ * back on a random free cell. Agents pick their goal with the policy and plan again when something stands in their way.
+ * Every fork has its own occupancy, search engine and random stream, the terrain is shared until a fork edits it
+ */
+class FIT3094_A1_CODE_API ForkSimulation
+{
+
+public:
+
+	// Which food (an index into the food of the state) an agent goes for, INDEX_NONE to wait for now
+	typedef TFunction<int32(ForkSimulation& Fork, const FSimAgent& Agent)> FPolicy;
+
+	// The policy with that name, an empty one when there is none. "Nearest" picks the closest food the agent eats in a
+	// straight line (as the food assignment estimates it), "Random" any food the agent eats. Neither picks a food
+	// another agent goes for
+	static FPolicy GetPolicy(FName Name);
+	static void GetPolicyNames(TArray<FName>& OutNames);
+
+	// Run every fork for the same simulated time, each on its own worker
+	static void RunAll(const TArray<TUniquePtr<ForkSimulation>>& Forks, double Seconds, float StepSeconds);
+
+	// Start from a copy of the snapshot, sharing its terrain
+	ForkSimulation(const SimSnapshot& From, FPolicy InPolicy);
+
+	// Draw other random numbers than the snapshot would
+	void Reseed(int32 Seed);
+
+	// Run on in fixed steps for this much simulated time
+	void Run(double Seconds, float StepSeconds);
+
+	// Change the terrain of cells of this fork only, it stops sharing the terrain. Walls are not raised under agents
+	// or food, and agents whose paths cross a changed cell plan again. Returns how many cells changed
+	int32 EditTerrain(const TArray<FIntPoint>& Cells, GridNode::GRID_TYPE NewType);
+
+	// The state the fork got to, copy it to fork again from here
+	const SimSnapshot& GetState() const
+	{
+		return State;
+	}
+
+	FRandomStream& GetRandom()
+	{
+		return Random;
+	}
+
+	// Does another agent than this one go for the food
+	bool IsFoodTaken(int32 FoodIndex, const FSimAgent& Agent) const;
+
+	FForkStats Stats;
+
+private:
+
+	// Move the simulation on by one step
+	void Step(float DeltaSeconds);
+
+	// Plan from the agent's cell to its goal food, false when there is no way there
+	bool PlanPath(FSimAgent& Agent);
+
+	// Give up the cell the agent is stepping into, it stays on the cell it last reached
+	void CancelStep(FSimAgent& Agent);
+
+	// Put a food slot on a random free cell with a random type, as the level generator and the food do
+	void RespawnFood(int32 FoodIndex);
+
+	// The occupancy layers an agent cannot go through
+	static uint8 GetBlockingLayers(const FSimAgent& Agent);
+
+	SimSnapshot State;
+	FPolicy Policy;
+
+	OccupancyGrid Occupancy;
+	AStarEngine Engine;
+	FPathResult Result;
+	FRandomStream Random;
+
+};
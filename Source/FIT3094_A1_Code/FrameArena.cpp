@@ -0,0 +1,183 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "FrameArena.h"
+#include "HAL/PlatformAtomics.h"
+#include "Templates/AlignmentTemplates.h"
+
+// Blocks the arenas of every thread took from the heap
+static volatile int64 TotalHeapAllocations = 0;
+
+// Allocations are at least this aligned, as FMemory::Malloc's are
+static const uint32 MinAlignment = 16;
+
+FrameArena::FrameArena()
+	: Current(0)
+	, Offset(0)
+	, NumMarks(0)
+	, bTrimOnReset(false)
+	, LastResetFrame(MAX_uint64)
+{
+}
+
+FrameArena::~FrameArena()
+{
+	for (const FBlock& Block : Blocks)
+	{
+		FMemory::Free(Block.Data);
+	}
+}
+
+void* FrameArena::Allocate(SIZE_T Size, uint32 Alignment)
+{
+	Alignment = FMath::Max(Alignment, MinAlignment);
+	SIZE_T Start = Blocks.Num() > 0 ? Align(Blocks[Current].Data + Offset, Alignment) - Blocks[Current].Data : 0;
+	if (Blocks.Num() == 0 || Start + Size > Blocks[Current].Size)
+	{
+		NextBlock(Size, Alignment);
+		Start = Align(Blocks[Current].Data, Alignment) - Blocks[Current].Data;
+	}
+
+	Offset = Start + Size;
+	Frame.Allocations++;
+	Frame.Bytes += Size;
+	return Blocks[Current].Data + Start;
+}
+
+void* FrameArena::Reallocate(void* Original, SIZE_T OldSize, SIZE_T NewSize, uint32 Alignment)
+{
+	// the last allocation can grow or shrink where it is
+	uint8* Data = (uint8*)Original;
+	if (Data && Blocks.Num() > 0 && Data >= Blocks[Current].Data && Data + OldSize == Blocks[Current].Data + Offset
+		&& (SIZE_T)(Data - Blocks[Current].Data) + NewSize <= Blocks[Current].Size)
+	{
+		Offset = (Data - Blocks[Current].Data) + NewSize;
+		Frame.Bytes += (int64)NewSize - (int64)OldSize;
+		return Original;
+	}
+
+	void* NewData = Allocate(NewSize, Alignment);
+	if (Data && OldSize > 0)
+	{
+		FMemory::Memcpy(NewData, Data, FMath::Min(OldSize, NewSize));
+	}
+	return NewData;
+}
+
+void FrameArena::NextBlock(SIZE_T Size, uint32 Alignment)
+{
+	// the blocks after the current one are free, they were only used by allocations given back by a mark
+	for (int32 Index = Blocks.Num() > 0 ? Current + 1 : 0; Index < Blocks.Num(); Index++)
+	{
+		const FBlock& Block = Blocks[Index];
+		if ((SIZE_T)(Align(Block.Data, Alignment) - Block.Data) + Size <= Block.Size)
+		{
+			Current = Index;
+			Offset = 0;
+			return;
+		}
+	}
+
+	// as large as everything held so far, so a frame needs few blocks however large it gets
+	const SIZE_T BlockSize = FMath::Max<SIZE_T>(FMath::Max<SIZE_T>(MIN_BLOCK_SIZE, GetReservedBytes()), Size + Alignment);
+	Blocks.Add({ (uint8*)FMemory::Malloc(BlockSize, MinAlignment), BlockSize });
+	Current = Blocks.Num() - 1;
+	Offset = 0;
+	Frame.HeapAllocations++;
+	FPlatformAtomics::InterlockedIncrement(&TotalHeapAllocations);
+}
+
+void FrameArena::Reset()
+{
+	if (LastResetFrame == GFrameCounter)
+	{
+		return;
+	}
+	LastResetFrame = GFrameCounter;
+	checkf(NumMarks == 0, TEXT("The frame arena is reset inside a mark"));
+
+	// one block as large as all of them, so the next frame of this size fits without another
+	if (bTrimOnReset)
+	{
+		ReleaseBlocks();
+		bTrimOnReset = false;
+	}
+	else if (Blocks.Num() > 1)
+	{
+		const SIZE_T Size = GetReservedBytes();
+		for (const FBlock& Block : Blocks)
+		{
+			FMemory::Free(Block.Data);
+		}
+		Blocks.Reset();
+		Blocks.Add({ (uint8*)FMemory::Malloc(Size, MinAlignment), Size });
+		Frame.HeapAllocations++;
+		FPlatformAtomics::InterlockedIncrement(&TotalHeapAllocations);
+	}
+
+	Current = 0;
+	Offset = 0;
+	LastFrame = Frame;
+	Frame = FStats();
+}
+
+void FrameArena::Trim()
+{
+	bTrimOnReset = true;
+}
+
+void FrameArena::ReleaseBlocks()
+{
+	// a small block stays, so light use of the arena does not go to the heap every time
+	TArray<FBlock> Kept;
+	for (const FBlock& Block : Blocks)
+	{
+		if (Kept.Num() == 0 && Block.Size <= MIN_BLOCK_SIZE)
+		{
+			Kept.Add(Block);
+		}
+		else
+		{
+			FMemory::Free(Block.Data);
+		}
+	}
+	Blocks = MoveTemp(Kept);
+	Current = 0;
+	Offset = 0;
+}
+
+SIZE_T FrameArena::GetReservedBytes() const
+{
+	SIZE_T Size = 0;
+	for (const FBlock& Block : Blocks)
+	{
+		Size += Block.Size;
+	}
+	return Size;
+}
+
+int64 FrameArena::GetTotalHeapAllocations()
+{
+	return FPlatformAtomics::AtomicRead(&TotalHeapAllocations);
+}
+
+FrameArena::FMark::FMark()
+	: Arena(FrameArena::Get())
+	, Block(Arena.Current)
+	, Offset(Arena.Offset)
+{
+	Arena.NumMarks++;
+}
+
+FrameArena::FMark::~FMark()
+{
+	Arena.Current = Block;
+	Arena.Offset = Offset;
+	Arena.NumMarks--;
+
+	// a worker's arena is never reset, the end of its outermost mark is the only time it holds nothing
+	if (Arena.NumMarks == 0 && Block == 0 && Offset == 0 && !IsInGameThread())
+	{
+		Arena.ReleaseBlocks();
+	}
+}
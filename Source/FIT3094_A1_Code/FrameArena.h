@@ -0,0 +1,207 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/ThreadSingleton.h"
+
+/**
+ * A linear allocator for memory that does not outlive the frame, one per thread.
+ *
+ * Allocating moves a pointer along a block and freeing does nothing, the game thread's arena is reset in bulk at the
+ * end of every frame (see UPathfindingSubsystem). Blocks are kept across resets and the blocks a frame needed are
+ * merged into one, so once the frames reach their usual size the arena does not touch the heap at all.
+ * Worker threads have no frame: they use their arena between an FMark and its end of scope, which gives the memory back.
+ * The end of a worker's outermost mark also gives the heap every block but a small one, as nothing resets that arena.
+ *
+ * Containers use it through TFrameArenaAllocator, e.g. TArray<int32, TFrameArenaAllocator<>>. Such a container must not be
+ * kept past the end of the frame (or its mark), and must only grow on the thread that made it
+ */
+class FIT3094_A1_CODE_API FrameArena : public TThreadSingleton<FrameArena>
+{
+	friend class TThreadSingleton<FrameArena>;
+
+public:
+
+	// Smallest block taken from the heap
+	static const int32 MIN_BLOCK_SIZE = 64 * 1024;
+
+	virtual ~FrameArena();
+
+	// Memory for Size bytes, valid until the arena is reset or a mark taken before it ends
+	void* Allocate(SIZE_T Size, uint32 Alignment);
+
+	// Grow or shrink an allocation, in place when it is the last one made. The first OldSize bytes are kept
+	void* Reallocate(void* Original, SIZE_T OldSize, SIZE_T NewSize, uint32 Alignment);
+
+	// Give back everything allocated since the last reset, once per frame however often it is called
+	void Reset();
+
+	// Let the next reset give the heap every block but a small one, for when the frames will not be as large again
+	// (e.g. after the map changed)
+	void Trim();
+
+	// Takes the position of the arena of this thread and goes back to it at the end of the scope
+	class FIT3094_A1_CODE_API FMark
+	{
+	public:
+
+		FMark();
+		~FMark();
+
+	private:
+
+		FrameArena& Arena;
+		int32 Block;
+		SIZE_T Offset;
+	};
+
+	// What the arena did in a frame
+	struct FStats
+	{
+		int32 Allocations = 0;
+		int64 Bytes = 0;
+		// Blocks taken from the heap, 0 in a steady state
+		int32 HeapAllocations = 0;
+	};
+
+	// The last frame reset, and the memory held
+	const FStats& GetLastFrameStats() const
+	{
+		return LastFrame;
+	}
+	SIZE_T GetReservedBytes() const;
+
+	// Blocks taken from the heap by the arenas of every thread since the start
+	static int64 GetTotalHeapAllocations();
+
+private:
+
+	FrameArena();
+
+	// Move to the next block that fits the allocation, taking a new one from the heap when none does
+	void NextBlock(SIZE_T Size, uint32 Alignment);
+
+	// Free the blocks larger than MIN_BLOCK_SIZE and all but one of the others. Nothing may be allocated
+	void ReleaseBlocks();
+
+	struct FBlock
+	{
+		uint8* Data;
+		SIZE_T Size;
+	};
+
+	TArray<FBlock> Blocks;
+	// The block being allocated from and where in it the free memory starts
+	int32 Current;
+	SIZE_T Offset;
+	int32 NumMarks;
+	bool bTrimOnReset;
+
+	FStats Frame;
+	FStats LastFrame;
+	uint64 LastResetFrame;
+};
+
+/**
+ * Allocation policy for containers with memory from the frame arena of the thread making them (see FrameArena),
+ * following TMemStackAllocator
+ */
+template<uint32 Alignment = DEFAULT_ALIGNMENT>
+class TFrameArenaAllocator
+{
+public:
+
+	typedef int32 SizeType;
+
+	enum { NeedsElementType = true };
+	enum { RequireRangeCheck = true };
+
+	class ForAnyElementType
+	{
+	public:
+
+		ForAnyElementType()
+			: Data(nullptr)
+		{
+		}
+
+		FORCEINLINE void MoveToEmpty(ForAnyElementType& Other)
+		{
+			checkSlow(this != &Other);
+			Data = Other.Data;
+			Other.Data = nullptr;
+		}
+
+		FORCEINLINE FScriptContainerElement* GetAllocation() const
+		{
+			return Data;
+		}
+
+		void ResizeAllocation(SizeType PreviousNumElements, SizeType NumElements, SIZE_T NumBytesPerElement)
+		{
+			// the old memory goes back with the arena, only the elements in use are copied
+			if (NumElements)
+			{
+				Data = (FScriptContainerElement*)FrameArena::Get().Reallocate(Data, Data ? PreviousNumElements * NumBytesPerElement : 0,
+					NumElements * NumBytesPerElement, Alignment);
+			}
+			else
+			{
+				Data = nullptr;
+			}
+		}
+
+		FORCEINLINE SizeType CalculateSlackReserve(SizeType NumElements, SIZE_T NumBytesPerElement) const
+		{
+			return DefaultCalculateSlackReserve(NumElements, NumBytesPerElement, false, Alignment);
+		}
+		FORCEINLINE SizeType CalculateSlackShrink(SizeType NumElements, SizeType NumAllocatedElements, SIZE_T NumBytesPerElement) const
+		{
+			return DefaultCalculateSlackShrink(NumElements, NumAllocatedElements, NumBytesPerElement, false, Alignment);
+		}
+		FORCEINLINE SizeType CalculateSlackGrow(SizeType NumElements, SizeType NumAllocatedElements, SIZE_T NumBytesPerElement) const
+		{
+			return DefaultCalculateSlackGrow(NumElements, NumAllocatedElements, NumBytesPerElement, false, Alignment);
+		}
+
+		SIZE_T GetAllocatedSize(SizeType NumAllocatedElements, SIZE_T NumBytesPerElement) const
+		{
+			return NumAllocatedElements * NumBytesPerElement;
+		}
+
+		bool HasAllocation() const
+		{
+			return !!Data;
+		}
+
+		SizeType GetInitialCapacity() const
+		{
+			return 0;
+		}
+
+	private:
+
+		ForAnyElementType(const ForAnyElementType&);
+		ForAnyElementType& operator=(const ForAnyElementType&);
+
+		FScriptContainerElement* Data;
+	};
+
+	template<typename ElementType>
+	class ForElementType : public ForAnyElementType
+	{
+	public:
+
+		FORCEINLINE ElementType* GetAllocation() const
+		{
+			return (ElementType*)ForAnyElementType::GetAllocation();
+		}
+	};
+};
+
+template<uint32 Alignment>
+struct TAllocatorTraits<TFrameArenaAllocator<Alignment>> : TAllocatorTraitsBase<TFrameArenaAllocator<Alignment>>
+{
+	enum { SupportsMove = true };
+};
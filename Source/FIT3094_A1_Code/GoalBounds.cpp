@@ -0,0 +1,148 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "GoalBounds.h"
+#include "FrameArena.h"
+#include "PathGrid.h"
+#include "PathSearch.h"
+#include "Async/ParallelFor.h"
+#include "HAL/PlatformTime.h"
+
+// The most expensive step is Water (15), so distances waiting to be settled all fit in 16 buckets
+static const int32 NumBuckets = 16;
+
+// Sources are handed to the workers in this many batches, the scratch arrays of a batch come from the frame arena of its worker
+static const int32 NumBatches = 64;
+
+GoalBounds::GoalBounds()
+{
+	NumSources = 0;
+	BuildSeconds = 0.0;
+}
+
+void GoalBounds::Build(const PathGrid& Grid)
+{
+	const double StartTime = FPlatformTime::Seconds();
+
+	// every box starts empty
+	FBounds Empty;
+	Empty.MinX = MAX_uint16;
+	Empty.MinY = MAX_uint16;
+	Empty.MaxX = 0;
+	Empty.MaxY = 0;
+	Boxes.Init(Empty, Grid.GetNumCells() * 4);
+
+	TArray<int32> Sources;
+	for (int X = 0; X < Grid.SizeX; X++)
+	{
+		for (int Y = 0; Y < Grid.SizeY; Y++)
+		{
+			if (Grid.GetType(X, Y) != GridNode::Wall)
+			{
+				Sources.Add(Grid.GetIndex(X, Y));
+			}
+		}
+	}
+	NumSources = Sources.Num();
+
+	// each source only writes its own boxes, so the batches never touch the same memory
+	const int32 BatchSize = FMath::DivideAndRoundUp(FMath::Max(NumSources, 1), NumBatches);
+	ParallelFor(NumBatches, [this, &Grid, &Sources, BatchSize](int32 Batch)
+	{
+		const int32 First = Batch * BatchSize;
+		BuildRange(Grid, Sources, First, FMath::Min(First + BatchSize, Sources.Num()));
+	});
+
+	BuildSeconds = FPlatformTime::Seconds() - StartTime;
+}
+
+void GoalBounds::BuildRange(const PathGrid& Grid, const TArray<int32>& Sources, int32 First, int32 Last)
+{
+	if (First >= Last)
+	{
+		return;
+	}
+
+	// Dist and Moves are only valid where Stamp holds the current source's generation.
+	// A worker runs several batches, they all reuse the memory of the first
+	FrameArena::FMark Mark;
+	TArray<int32, TFrameArenaAllocator<>> Dist;
+	TArray<uint32, TFrameArenaAllocator<>> Stamp;
+	TArray<uint8, TFrameArenaAllocator<>> Moves;
+	Dist.SetNumUninitialized(Grid.GetNumCells());
+	Stamp.SetNumZeroed(Grid.GetNumCells());
+	Moves.SetNumUninitialized(Grid.GetNumCells());
+	TArray<int32, TFrameArenaAllocator<>> Buckets[NumBuckets];
+	uint32 Generation = 0;
+
+	for (int32 SourceIndex = First; SourceIndex < Last; SourceIndex++)
+	{
+		const int32 Source = Sources[SourceIndex];
+		FBounds* SourceBoxes = &Boxes[Source << 2];
+		Generation++;
+
+		Dist[Source] = 0;
+		Stamp[Source] = Generation;
+		Moves[Source] = 0;
+		Buckets[0].Add(Source);
+		int32 Pending = 1;
+
+		// Dijkstra with a bucket queue (Dial's algorithm), the step costs are small integers
+		for (int32 Current = 0; Pending > 0; Current++)
+		{
+			TArray<int32, TFrameArenaAllocator<>>& Bucket = Buckets[Current % NumBuckets];
+			while (Bucket.Num() > 0)
+			{
+				const int32 Cell = Bucket.Pop(false);
+				Pending--;
+
+				// lowered after it was queued, it was settled from another bucket
+				if (Dist[Cell] != Current)
+				{
+					continue;
+				}
+
+				const FIntPoint Position = Grid.GetPosition(Cell);
+
+				// the cell is settled, so it is a goal of every first move that reaches it optimally
+				for (uint8 Remaining = Moves[Cell]; Remaining; Remaining &= Remaining - 1)
+				{
+					FBounds& Box = SourceBoxes[FMath::CountTrailingZeros(Remaining)];
+					Box.MinX = FMath::Min<uint16>(Box.MinX, Position.X);
+					Box.MinY = FMath::Min<uint16>(Box.MinY, Position.Y);
+					Box.MaxX = FMath::Max<uint16>(Box.MaxX, Position.X);
+					Box.MaxY = FMath::Max<uint16>(Box.MaxY, Position.Y);
+				}
+
+				for (int Direction = 0; Direction < 4; Direction++)
+				{
+					const int NextX = Position.X + PathSearchEngine::NeighbourOffsets[Direction].X;
+					const int NextY = Position.Y + PathSearchEngine::NeighbourOffsets[Direction].Y;
+					if (!Grid.IsInside(NextX, NextY) || Grid.GetType(NextX, NextY) == GridNode::Wall)
+					{
+						continue;
+					}
+
+					const int32 Next = Grid.GetIndex(NextX, NextY);
+					const int32 NextDist = Current + (int32)Grid.GetTravelCost(NextX, NextY);
+					// leaving the source, the move is the first move itself, after that it is inherited
+					const uint8 NextMoves = Cell == Source ? (uint8)(1 << Direction) : Moves[Cell];
+
+					if (Stamp[Next] != Generation || NextDist < Dist[Next])
+					{
+						Stamp[Next] = Generation;
+						Dist[Next] = NextDist;
+						Moves[Next] = NextMoves;
+						Buckets[NextDist % NumBuckets].Add(Next);
+						Pending++;
+					}
+					else if (NextDist == Dist[Next])
+					{
+						// another optimal way in, its first moves are just as good
+						Moves[Next] |= NextMoves;
+					}
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,64 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class PathGrid;
+
+/**
+ * Geometric goal bounding over the static map (walls only).
+ *
+ * For every cell and each of its four moves this keeps the bounding box of the goals that have an optimal
+ * path (under the travel costs) starting with that move. A search expanding a cell can skip a move whose box
+ * does not hold its goal, because the rest of an optimal path from the cell starts with one of the other moves.
+ *
+ * Building runs a Dijkstra from every open cell, so it is quadratic in the size of the map and only worth it
+ * on maps that get many queries. Agents and food are not known here: with them in the way the pruned search
+ * can fail or take a detour, callers fall back to a full search when it fails
+ */
+class FIT3094_A1_CODE_API GoalBounds
+{
+
+public:
+
+	GoalBounds();
+
+	// Build the boxes of every open cell of the grid, spreading the sources over worker threads
+	void Build(const PathGrid& Grid);
+
+	// Can the goal be on an optimal path leaving the cell with the move (a bit position of OccupancyGrid::NEIGHBOUR)
+	bool MayReach(int Cell, int Direction, const FIntPoint& Goal) const
+	{
+		const FBounds& Box = Boxes[(Cell << 2) | Direction];
+		return Goal.X >= Box.MinX && Goal.X <= Box.MaxX && Goal.Y >= Box.MinY && Goal.Y <= Box.MaxY;
+	}
+
+	// Memory used by the boxes
+	int64 GetAllocatedSize() const
+	{
+		return Boxes.GetAllocatedSize();
+	}
+
+	// Number of cells searched from, and how long building took
+	int32 NumSources;
+	double BuildSeconds;
+
+private:
+
+	// A box in cell coordinates, empty while Min is above Max
+	struct FBounds
+	{
+		uint16 MinX;
+		uint16 MinY;
+		uint16 MaxX;
+		uint16 MaxY;
+	};
+
+	// Run the searches from the sources First to Last - 1 with one set of scratch arrays
+	void BuildRange(const PathGrid& Grid, const TArray<int32>& Sources, int32 First, int32 Last);
+
+	// Four boxes per cell, in NEIGHBOUR order
+	TArray<FBounds> Boxes;
+
+};
@@ -20,7 +20,12 @@ GridNode::GridNode()
 
 float GridNode::GetTravelCost() const
 {
-	switch(GridType)
+	return GetTravelCost(GridType);
+}
+
+float GridNode::GetTravelCost(GRID_TYPE Type)
+{
+	switch(Type)
 	{
 		case Open:
 			return 1;
@@ -26,6 +26,8 @@ public:
 	GridNode();
 
 	float GetTravelCost() const;
+	// The cost of entering a node of the given type
+	static float GetTravelCost(GRID_TYPE Type);
 
 	// Position in Grid
 	int X;
@@ -3,152 +3,493 @@
 
 #include "LevelGenerator.h"
 #include "Agent.h"
+#include "PathfindingSubsystem.h"
 #include "Engine/World.h"
+#include "EngineUtils.h"
+#include "ForkSimulation.h"
+#include "Async/ParallelFor.h"
+#include "Camera/PlayerCameraManager.h"
+#include "GameFramework/PlayerController.h"
+
+static ALevelGenerator* FindLevelGenerator(UWorld* World)
+{
+	if (!World)
+	{
+		return nullptr;
+	}
+	TActorIterator<ALevelGenerator> It(World);
+	return It ? *It : nullptr;
+}
+
+static FAutoConsoleCommandWithWorldAndArgs SnapshotCommand(
+	TEXT("Sim.Snapshot"),
+	TEXT("Keep the state of the simulation under a name. Usage: Sim.Snapshot [Name]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		ALevelGenerator* Generator = FindLevelGenerator(World);
+		if (Generator && Generator->Pathfinding && Generator->Pathfinding->HasMap())
+		{
+			const FName Name = Args.Num() > 0 ? FName(*Args[0]) : FName(TEXT("Default"));
+			const SimSnapshot& Snapshot = Generator->Snapshots.Add(Name, Generator->CaptureSnapshot());
+			UE_LOG(LogTemp, Log, TEXT("Snapshot %s: %d agents, %d food, %.1f KB (terrain %.1f KB, shared)"), *Name.ToString(),
+				Snapshot.Agents.Num(), Snapshot.Food.Num(), Snapshot.GetAllocatedSize() / 1024.0, Snapshot.GetTerrainSize() / 1024.0);
+		}
+	}));
+
+static FAutoConsoleCommandWithWorldAndArgs RestoreCommand(
+	TEXT("Sim.Restore"),
+	TEXT("Put the simulation back the way a snapshot left it. Usage: Sim.Restore [Name]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		ALevelGenerator* Generator = FindLevelGenerator(World);
+		const FName Name = Args.Num() > 0 ? FName(*Args[0]) : FName(TEXT("Default"));
+		const SimSnapshot* Snapshot = Generator ? Generator->Snapshots.Find(Name) : nullptr;
+		if (!Snapshot)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("No snapshot %s"), *Name.ToString());
+		}
+		else if (!Generator->RestoreSnapshot(*Snapshot))
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Snapshot %s is of another map"), *Name.ToString());
+		}
+	}));
+
+static FAutoConsoleCommandWithWorldAndArgs ForkCommand(
+	TEXT("Sim.Fork"),
+	TEXT("Run forks of a snapshot headless with each policy at once and compare them, keeping where every fork got to as <Name>.<Policy>.<Fork>. ")
+	TEXT("Usage: Sim.Fork <Seconds> [Policy,Policy...] [ForksPerPolicy] [Name]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		ALevelGenerator* Generator = FindLevelGenerator(World);
+		const FName Name = Args.Num() > 3 ? FName(*Args[3]) : FName(TEXT("Default"));
+		const SimSnapshot* Snapshot = Generator ? Generator->Snapshots.Find(Name) : nullptr;
+		if (!Snapshot || Args.Num() < 1)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Usage: Sim.Fork <Seconds> [Policy,Policy...] [ForksPerPolicy] [Name], after Sim.Snapshot [Name]"));
+			return;
+		}
+
+		const double Seconds = FCString::Atod(*Args[0]);
+		TArray<FName> Policies;
+		if (Args.Num() > 1)
+		{
+			TArray<FString> PolicyNames;
+			Args[1].ParseIntoArray(PolicyNames, TEXT(","));
+			for (const FString& Policy : PolicyNames)
+			{
+				Policies.Add(FName(*Policy));
+			}
+		}
+		else
+		{
+			ForkSimulation::GetPolicyNames(Policies);
+		}
+		const int32 ForksPerPolicy = Args.Num() > 2 ? FMath::Max(1, FCString::Atoi(*Args[2])) : 1;
+
+		// every policy sees the same seeds, so the forks of one policy differ from the others' by the policy only
+		TArray<TUniquePtr<ForkSimulation>> Forks;
+		for (const FName& Policy : Policies)
+		{
+			ForkSimulation::FPolicy Pick = ForkSimulation::GetPolicy(Policy);
+			if (!Pick)
+			{
+				UE_LOG(LogTemp, Warning, TEXT("No policy %s"), *Policy.ToString());
+				return;
+			}
+			for (int32 Fork = 0; Fork < ForksPerPolicy; Fork++)
+			{
+				Forks.Add(MakeUnique<ForkSimulation>(*Snapshot, Pick));
+				Forks.Last()->Reseed(Snapshot->Seed + Fork);
+			}
+		}
+
+		const double StartTime = FPlatformTime::Seconds();
+		ForkSimulation::RunAll(Forks, Seconds, 1.f / 30.f);
+		UE_LOG(LogTemp, Log, TEXT("%d forks of %s ran %.0f seconds each in %.2f s, sharing %.1f KB of terrain"),
+			Forks.Num(), *Name.ToString(), Seconds, FPlatformTime::Seconds() - StartTime, Snapshot->GetTerrainSize() / 1024.0);
+
+		for (int32 Index = 0; Index < Forks.Num(); Index++)
+		{
+			const FName& Policy = Policies[Index / ForksPerPolicy];
+			const ForkSimulation& Fork = *Forks[Index];
+			UE_LOG(LogTemp, Log, TEXT("  %s %d: %d food eaten, %d starved, %d agents left, %d plans (%d failed), %.1f KB"),
+				*Policy.ToString(), Index % ForksPerPolicy, Fork.Stats.FoodEaten, Fork.Stats.Starved, Fork.GetState().Agents.Num(),
+				Fork.Stats.Plans, Fork.Stats.PlanFailures, Fork.GetState().GetAllocatedSize() / 1024.0);
+			Generator->Snapshots.Add(*FString::Printf(TEXT("%s.%s.%d"), *Name.ToString(), *Policy.ToString(), Index % ForksPerPolicy), Fork.GetState());
+		}
+	}));
 
 // Sets default values
 ALevelGenerator::ALevelGenerator()
 {
  	// Set this actor to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
 	PrimaryActorTick.bCanEverTick = true;
+	// the agents tick first, so their movement phase below sees every agent that wants to move this frame
+	PrimaryActorTick.TickGroup = TG_PostPhysics;
+
+	MapSizeX = 0;
+	MapSizeY = 0;
+	Pathfinding = nullptr;
+
+	StreamingRadius = 4;
+	MaxChunksStreamedPerTick = 4;
+	bParallelMovement = true;
+	bLowDetailAgents = true;
+	LowDetailDistance = 4000.f;
+	NumLowDetailAgents = 0;
+	NumSleepingAgents = 0;
 }
 
 // Called when the game starts or when spawned
 void ALevelGenerator::BeginPlay()
 {
+	// Hook up to the subsystem first, the blueprint BeginPlay may start loading a map straight away
+	Pathfinding = GetWorld()->GetSubsystem<UPathfindingSubsystem>();
+	Pathfinding->OnMapUnloading.AddUObject(this, &ALevelGenerator::HandleMapUnloading);
+	Pathfinding->OnMapLoaded.AddUObject(this, &ALevelGenerator::HandleMapLoaded);
+	Pathfinding->OnTerrainChanged.AddUObject(this, &ALevelGenerator::HandleTerrainChanged);
+
 	Super::BeginPlay();
 }
 
+void ALevelGenerator::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (Pathfinding)
+	{
+		Pathfinding->OnMapUnloading.RemoveAll(this);
+		Pathfinding->OnMapLoaded.RemoveAll(this);
+		Pathfinding->OnTerrainChanged.RemoveAll(this);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
 // Called every frame
 void ALevelGenerator::Tick(float DeltaTime)
 {
 	Super::Tick(DeltaTime);
 
-	// Should spawn more food if there are not the right number
+	// Nothing to spawn food on until a map is loaded
+	if (!Pathfinding || !Pathfinding->HasMap())
+	{
+		return;
+	}
+
+	StreamTiles();
+
+	// Only what is due happens: agents wake up at the end of the step they slept through, lose health and starve,
+	// and eaten food is put down again. Agents moved up to the start of this tick in the last movement phase
+	const double Now = GetWorld()->GetTimeSeconds();
+	const double MovedUntil = Now - DeltaTime;
+	Pathfinding->Events.Advance(Now, DueEvents);
+	for (const FScheduledEvent& Event : DueEvents)
+	{
+		if (Event.Kind == EScheduledEvent::FoodRespawn)
+		{
+			RespawnFood();
+		}
+		else if (AAgent* Agent = Cast<AAgent>(Event.Target))
+		{
+			Agent->HandleEvent(Event, MovedUntil);
+		}
+	}
+
+	// hand the food out to every agent that asked for a goal since the last tick, the new food included
+	Pathfinding->Assignment.Solve(Pathfinding->FoodActors, Pathfinding->Occupancy);
+
+	UpdateAgentDetail(MovedUntil);
+	MoveAgents(DeltaTime);
+}
 
+void ALevelGenerator::RespawnFood()
+{
 	// When one food is consumed, immediately generate another one
-	while (FoodActors.Num() < NUM_FOOD) {
-		int RandXPos = 0;
-		int RandYPos = 0;
-		bool isFree = false;
+	while (Pathfinding->FoodActors.Num() < NUM_FOOD) {
+		GridNode* Node = FindRandomNode([](const GridNode* Candidate)
+		{
+			return Candidate->GridType != GridNode::Wall && Candidate->ObjectAtLocation == nullptr;
+		});
 
-		while (!isFree) {
-			RandXPos = FMath::RandRange(0, MapSizeX - 1);
-			RandYPos = FMath::RandRange(0, MapSizeY - 1);
+		FVector Position(Node->X * GRID_SIZE_WORLD, Node->Y * GRID_SIZE_WORLD, 20);
+		// reuse an eaten food where possible instead of spawning a new actor
+		AFood* NewFood = Pathfinding->Pool.AcquireFood(GetWorld(), FoodBlueprint, Position);
 
-			if (WorldArray[RandXPos][RandYPos]->GridType != GridNode::Wall && WorldArray[RandXPos][RandYPos]->ObjectAtLocation == nullptr)
-			{
-				isFree = true;
-			}
-		}
+		Pathfinding->RegisterFood(NewFood, Node);
+	}
+}
 
-		FVector Position(RandXPos * GRID_SIZE_WORLD, RandYPos * GRID_SIZE_WORLD, 20);
-		AFood* NewFood = GetWorld()->SpawnActor<AFood>(FoodBlueprint, Position, FRotator::ZeroRotator);
+void ALevelGenerator::UpdateAgentDetail(double MovedUntil)
+{
+	FVector Focus;
+	const bool bHasCamera = GetStreamingFocus(Focus);
+	const float MaxDistanceSquared = FMath::Square(LowDetailDistance);
 
-		WorldArray[RandXPos][RandYPos]->ObjectAtLocation = NewFood;
-		FoodActors.Add(NewFood);
+	NumLowDetailAgents = 0;
+	NumSleepingAgents = 0;
+	for (AAgent* Agent : SpawnedAgents)
+	{
+		// agents back in the pool are not simulated at all
+		if (!IsValid(Agent) || !Agent->IsActive())
+		{
+			continue;
+		}
+
+		// the actor is at most a cell behind the agent, close enough to tell whether it can be seen
+		const bool bLowDetail = bLowDetailAgents && (!bHasCamera || !Agent->WasRecentlyRendered() || FVector::DistSquared(Focus, Agent->GetActorLocation()) > MaxDistanceSquared);
+		// only the cell steps can be slept through, an agent seen again walks smoothly from this tick on
+		if (!bLowDetail)
+		{
+			Agent->WakeUp(MovedUntil);
+		}
+		Agent->SetLowDetail(bLowDetail);
+		NumLowDetailAgents += bLowDetail ? 1 : 0;
+		NumSleepingAgents += Agent->IsAsleep() ? 1 : 0;
 	}
 }
 
-void ALevelGenerator::GenerateWorldFromFile(TArray<FString> WorldArrayStrings)
+void ALevelGenerator::MoveAgents(float DeltaTime)
 {
-	// If empty array exit immediately something is horribly wrong
-	if(WorldArrayStrings.Num() == 0)
+	MovingAgents.Reset();
+	for (AAgent* Agent : SpawnedAgents)
+	{
+		if (IsValid(Agent) && Agent->WantsToMove)
+		{
+			MovingAgents.Add(Agent);
+		}
+	}
+	if (MovingAgents.Num() == 0)
 	{
-		UE_LOG(LogTemp, Warning, TEXT("World Array is empty!"));
 		return;
 	}
 
-	// Second line is Height (aka X value)
-	FString Height = WorldArrayStrings[1];
-	Height.RemoveFromStart("height ");
-	MapSizeX = FCString::Atoi(*Height);
-	UE_LOG(LogTemp, Warning, TEXT("Height: %d"), MapSizeX);
+	// nothing is claimed or released while bidding, and nodes left are only released after every claim,
+	// so which agent gets a contested node never depends on the order the threads ran in
+	CellClaims& Claims = Pathfinding->Claims;
+	const bool bSingleThread = !bParallelMovement;
+	Claims.BeginRound();
+	ParallelFor(MovingAgents.Num(), [this, &Claims](int32 Index)
+	{
+		AAgent* Agent = MovingAgents[Index];
+		if (GridNode* Node = Agent->GetNodeToClaim())
+		{
+			Claims.Bid(Pathfinding->Grid.GetIndex(Node->X, Node->Y), Agent->GetUniqueID());
+		}
+	}, bSingleThread);
+
+	ParallelFor(MovingAgents.Num(), [this, &Claims](int32 Index)
+	{
+		AAgent* Agent = MovingAgents[Index];
+		GridNode* Node = Agent->GetNodeToClaim();
+		if (Node && Claims.HasWon(Pathfinding->Grid.GetIndex(Node->X, Node->Y), Agent->GetUniqueID()))
+		{
+			Agent->ClaimNextNode();
+		}
+	}, bSingleThread);
+
+	ParallelFor(MovingAgents.Num(), [this, DeltaTime](int32 Index)
+	{
+		MovingAgents[Index]->StepMovement(DeltaTime);
+	}, bSingleThread);
+
+	// the scene may only be changed on the game thread
+	for (AAgent* Agent : MovingAgents)
+	{
+		Agent->ApplyMovement();
+	}
+}
+
+void ALevelGenerator::GenerateWorldFromFile(TArray<FString> WorldArrayStrings)
+{
+	// Parsing, building the grid and preprocessing all belong to the subsystem, HandleMapLoaded picks up from there
+	Pathfinding->LoadMapAsync(WorldArrayStrings);
+}
+
+void ALevelGenerator::GenerateWorldFromMapFile(const FString& MapPath)
+{
+	Pathfinding->LoadMapFileAsync(MapPath);
+}
+
+bool ALevelGenerator::IsLoadingMap() const
+{
+	return Pathfinding && Pathfinding->IsLoadingMap();
+}
 
-	// Third line is Width (aka Y value)
-	FString Width = WorldArrayStrings[2];
-	Width.RemoveFromStart("width ");
-	MapSizeY = FCString::Atoi(*Width);
-	UE_LOG(LogTemp, Warning, TEXT("Width: %d"), MapSizeY);
-	
-	// After removing top 4 lines this is the map itself so iterate each line
-	for (int LineNum = 4; LineNum < WorldArrayStrings.Num(); LineNum++)
+float ALevelGenerator::GetLoadProgress() const
+{
+	return Pathfinding ? Pathfinding->GetLoadProgress() : 0.f;
+}
+
+void ALevelGenerator::HandleMapUnloading()
+{
+	// The tiles of the previous map are no use any more
+	ReleaseAllTiles();
+
+	for (AFood* Food : Pathfinding->FoodActors)
 	{
-		for (int CharNum = 0; CharNum < WorldArrayStrings[LineNum].Len(); CharNum++)
+		Pathfinding->Pool.ReleaseFood(Food);
+	}
+
+	// Dead agents are in the pool already, the pool ignores them
+	for (AAgent* Agent : SpawnedAgents)
+	{
+		if (IsValid(Agent))
 		{
-			CharMapArray[LineNum-4][CharNum] = WorldArrayStrings[LineNum][CharNum];
+			Agent->Despawn();
 		}
 	}
+	SpawnedAgents.Empty();
+}
+
+void ALevelGenerator::HandleMapLoaded()
+{
+	MapSizeX = Pathfinding->Grid.SizeX;
+	MapSizeY = Pathfinding->Grid.SizeY;
 
-	GenerateNodeGrid();
 	SpawnWorldActors();
 }
 
-void ALevelGenerator::SpawnWorldActors()
+void ALevelGenerator::HandleTerrainChanged(const FTerrainChange& Change)
 {
-	UWorld* World = GetWorld();
+	// Pooled agents have no path, so only the agents walking through the change do anything
+	for (AAgent* Agent : SpawnedAgents)
+	{
+		if (IsValid(Agent))
+		{
+			Agent->HandleTerrainChanged(Change);
+		}
+	}
 
-	// Make sure that all blueprints are connected. If not then fail
-	if(WallBlueprint && OpenBlueprint && WaterBlueprint && SwampBlueprint && TreeBlueprint)
+	// Chunks that are not streamed in pick the new terrain up when they are
+	for (int ChunkX = Change.Min.X >> PathGrid::CHUNK_SHIFT; ChunkX <= Change.Max.X >> PathGrid::CHUNK_SHIFT; ChunkX++)
+	{
+		for (int ChunkY = Change.Min.Y >> PathGrid::CHUNK_SHIFT; ChunkY <= Change.Max.Y >> PathGrid::CHUNK_SHIFT; ChunkY++)
+		{
+			RefreshChunkTiles(ChunkX, ChunkY, Change);
+		}
+	}
+}
+
+void ALevelGenerator::RefreshChunkTiles(int ChunkX, int ChunkY, const FTerrainChange& Change)
+{
+	PathGrid& Grid = Pathfinding->Grid;
+	const int32 ChunkIndex = ChunkX * Grid.GetNumChunksY() + ChunkY;
+	TArray<AActor*>* Tiles = StreamedChunks.Find(ChunkIndex);
+	if (!Tiles)
+	{
+		return;
+	}
+
+	const int FirstX = ChunkX << PathGrid::CHUNK_SHIFT;
+	const int FirstY = ChunkY << PathGrid::CHUNK_SHIFT;
+	const int NumX = FMath::Min(PathGrid::CHUNK_SIZE, MapSizeX - FirstX);
+	const int NumY = FMath::Min(PathGrid::CHUNK_SIZE, MapSizeY - FirstY);
+
+	// A chunk shown as one stretched tile, or one that is a single type now, is streamed again as a whole
+	GridNode::GRID_TYPE UniformType;
+	if (Grid.IsChunkUniform(ChunkX, ChunkY, UniformType) || Tiles->Num() != NumX * NumY || NumX * NumY == 1)
+	{
+		for (AActor* Tile : *Tiles)
+		{
+			Pathfinding->Pool.ReleaseTile(Tile);
+		}
+		StreamedChunks.Remove(ChunkIndex);
+		StreamInChunk(ChunkX, ChunkY);
+		return;
+	}
+
+	// Otherwise the tiles are one per cell, in the order StreamInChunk spawned them
+	for (int x = FirstX; x < FirstX + NumX; x++)
 	{
-		// For each grid space spawn an actor of the correct type in the game world
-		for(int x = 0; x < MapSizeX; x++)
+		for (int y = FirstY; y < FirstY + NumY; y++)
 		{
-			for (int y = 0; y < MapSizeY; y++)
+			if (!Change.Contains(x, y))
 			{
-				float XPos = x * GRID_SIZE_WORLD;
-				float YPos = y * GRID_SIZE_WORLD;
+				continue;
+			}
 
-				FVector Position(XPos, YPos, 0);
+			AActor*& Tile = (*Tiles)[(x - FirstX) * NumY + (y - FirstY)];
+			Pathfinding->Pool.ReleaseTile(Tile);
+			Tile = Pathfinding->Pool.AcquireTile(GetWorld(), GetTileBlueprint(Grid.GetType(x, y)), FVector(x * GRID_SIZE_WORLD, y * GRID_SIZE_WORLD, 0));
+			if (Tile)
+			{
+				Tile->SetActorScale3D(FVector::OneVector);
+			}
+		}
+	}
+}
 
-				switch (CharMapArray[x][y])
-				{
-					case '.':
-					case 'G':
-						World->SpawnActor(OpenBlueprint, &Position, &FRotator::ZeroRotator);
-						break;
-					case '@':
-					case 'O':
-						World->SpawnActor(WallBlueprint, &Position, &FRotator::ZeroRotator);
-						break;
-					case 'T':
-						World->SpawnActor(TreeBlueprint, &Position, &FRotator::ZeroRotator);
-						break;
-					case 'S':
-						World->SpawnActor(SwampBlueprint, &Position, &FRotator::ZeroRotator);
-						break;
-					case 'W':
-						World->SpawnActor(WaterBlueprint, &Position, &FRotator::ZeroRotator);
-						break;
-					default:
-						break;
-				}
+int32 ALevelGenerator::EditTerrain(const TArray<FIntPoint>& Cells, GridNode::GRID_TYPE NewType)
+{
+	// The subsystem broadcasts the change, HandleTerrainChanged does the rest
+	return Pathfinding ? Pathfinding->EditTerrain(Cells, NewType) : 0;
+}
+
+int32 ALevelGenerator::EditTerrainArea(int32 MinX, int32 MinY, int32 MaxX, int32 MaxY, GridNode::GRID_TYPE NewType, TFunctionRef<bool(GridNode::GRID_TYPE)> Condition)
+{
+	if (!Pathfinding || !Pathfinding->HasMap())
+	{
+		return 0;
+	}
+
+	TArray<FIntPoint> Cells;
+	for (int x = FMath::Max(MinX, 0); x <= FMath::Min(MaxX, MapSizeX - 1); x++)
+	{
+		for (int y = FMath::Max(MinY, 0); y <= FMath::Min(MaxY, MapSizeY - 1); y++)
+		{
+			if (Condition(Pathfinding->Grid.GetType(x, y)))
+			{
+				Cells.Add(FIntPoint(x, y));
 			}
 		}
 	}
+	return EditTerrain(Cells, NewType);
+}
+
+int32 ALevelGenerator::FloodArea(int32 MinX, int32 MinY, int32 MaxX, int32 MaxY)
+{
+	return EditTerrainArea(MinX, MinY, MaxX, MaxY, GridNode::Water, [](GridNode::GRID_TYPE Type)
+	{
+		return Type != GridNode::Wall;
+	});
+}
+
+int32 ALevelGenerator::ClearForest(int32 MinX, int32 MinY, int32 MaxX, int32 MaxY)
+{
+	return EditTerrainArea(MinX, MinY, MaxX, MaxY, GridNode::Open, [](GridNode::GRID_TYPE Type)
+	{
+		return Type == GridNode::Forest;
+	});
+}
+
+int32 ALevelGenerator::RaiseWalls(int32 MinX, int32 MinY, int32 MaxX, int32 MaxY)
+{
+	return EditTerrainArea(MinX, MinY, MaxX, MaxY, GridNode::Wall, [](GridNode::GRID_TYPE Type)
+	{
+		return true;
+	});
+}
+
+void ALevelGenerator::SpawnWorldActors()
+{
+	UWorld* World = GetWorld();
+
+	// Tiles are not spawned here, they stream in around the camera from Tick
 
 	// Generate Initial Agent Positions
 	if(AgentBlueprint)
 	{
 		for (int i = 0; i < NUM_AGENTS; i++)
 		{
-			int RandXPos = 0;
-			int RandYPos = 0;
-			bool isFree = false;
-
-			while (!isFree) {
-				RandXPos = FMath::RandRange(0, MapSizeX - 1);
-				RandYPos = FMath::RandRange(0, MapSizeY - 1);
-
-				if (WorldArray[RandXPos][RandYPos]->GridType == GridNode::Open && WorldArray[RandXPos][RandYPos]->ObjectAtLocation == nullptr)
-				{
-					isFree = true;
-				}
-			}
+			GridNode* Node = FindRandomNode([](const GridNode* Candidate)
+			{
+				return Candidate->GridType == GridNode::Open && Candidate->ObjectAtLocation == nullptr;
+			});
 
-			FVector Position(RandXPos * GRID_SIZE_WORLD, RandYPos * GRID_SIZE_WORLD, 20);
-			AAgent* Agent = World->SpawnActor<AAgent>(AgentBlueprint, Position, FRotator::ZeroRotator);
+			FVector Position(Node->X * GRID_SIZE_WORLD, Node->Y * GRID_SIZE_WORLD, 20);
+			AAgent* Agent = Pathfinding->Pool.AcquireAgent(World, AgentBlueprint, Position);
 
-			WorldArray[RandXPos][RandYPos]->ObjectAtLocation = Agent;
+			Pathfinding->OccupyNode(Node, Agent);
+			SpawnedAgents.Add(Agent);
 		}
 	}
 
@@ -157,83 +498,302 @@ void ALevelGenerator::SpawnWorldActors()
 	{
 		for(int i = 0; i < NUM_FOOD; i++)
 		{
-			int RandXPos = 0;
-			int RandYPos = 0;
-			bool isFree = false;
+			GridNode* Node = FindRandomNode([](const GridNode* Candidate)
+			{
+				return Candidate->GridType != GridNode::Wall && Candidate->ObjectAtLocation == nullptr;
+			});
 
-			while (!isFree) {
-				RandXPos = FMath::RandRange(0, MapSizeX - 1);
-				RandYPos = FMath::RandRange(0, MapSizeY - 1);
+			FVector Position(Node->X * GRID_SIZE_WORLD, Node->Y * GRID_SIZE_WORLD, 20);
+			AFood* NewFood = Pathfinding->Pool.AcquireFood(World, FoodBlueprint, Position);
 
-				if (WorldArray[RandXPos][RandYPos]->GridType != GridNode::Wall && WorldArray[RandXPos][RandYPos]->ObjectAtLocation == nullptr)
+			Pathfinding->RegisterFood(NewFood, Node);
+		}
+	}
+}
+
+void ALevelGenerator::StreamTiles()
+{
+	// Make sure that all blueprints are connected. If not then fail
+	if (!WallBlueprint || !OpenBlueprint || !WaterBlueprint || !SwampBlueprint || !TreeBlueprint)
+	{
+		return;
+	}
+
+	FVector Focus;
+	if (!GetStreamingFocus(Focus))
+	{
+		return;
+	}
+
+	const PathGrid& Grid = Pathfinding->Grid;
+	const int CenterX = FMath::Clamp(FMath::RoundToInt(Focus.X / GRID_SIZE_WORLD), 0, MapSizeX - 1) >> PathGrid::CHUNK_SHIFT;
+	const int CenterY = FMath::Clamp(FMath::RoundToInt(Focus.Y / GRID_SIZE_WORLD), 0, MapSizeY - 1) >> PathGrid::CHUNK_SHIFT;
+
+	// Drop chunks one past the radius, so moving back and forth over a chunk border does not stream the same chunks every frame
+	for (auto It = StreamedChunks.CreateIterator(); It; ++It)
+	{
+		const int ChunkX = It.Key() / Grid.GetNumChunksY();
+		const int ChunkY = It.Key() % Grid.GetNumChunksY();
+		if (FMath::Abs(ChunkX - CenterX) > StreamingRadius + 1 || FMath::Abs(ChunkY - CenterY) > StreamingRadius + 1)
+		{
+			for (AActor* Tile : It.Value())
+			{
+				Pathfinding->Pool.ReleaseTile(Tile);
+			}
+			It.RemoveCurrent();
+		}
+	}
+
+	// Stream in ring by ring so the chunks under the camera come first
+	int Budget = MaxChunksStreamedPerTick;
+	for (int Ring = 0; Ring <= StreamingRadius && Budget > 0; Ring++)
+	{
+		for (int ChunkX = CenterX - Ring; ChunkX <= CenterX + Ring && Budget > 0; ChunkX++)
+		{
+			for (int ChunkY = CenterY - Ring; ChunkY <= CenterY + Ring && Budget > 0; ChunkY++)
+			{
+				// only the border of the ring, the inside was done by the smaller rings
+				const bool bOnRing = FMath::Abs(ChunkX - CenterX) == Ring || FMath::Abs(ChunkY - CenterY) == Ring;
+				if (!bOnRing || ChunkX < 0 || ChunkY < 0 || ChunkX >= Grid.GetNumChunksX() || ChunkY >= Grid.GetNumChunksY())
 				{
-					isFree = true;
+					continue;
+				}
+				if (!StreamedChunks.Contains(ChunkX * Grid.GetNumChunksY() + ChunkY))
+				{
+					StreamInChunk(ChunkX, ChunkY);
+					Budget--;
 				}
 			}
+		}
+	}
+}
 
-			FVector Position(RandXPos * GRID_SIZE_WORLD, RandYPos * GRID_SIZE_WORLD, 20);
-			AFood* NewFood = World->SpawnActor<AFood>(FoodBlueprint, Position, FRotator::ZeroRotator);
+void ALevelGenerator::StreamInChunk(int ChunkX, int ChunkY)
+{
+	UWorld* World = GetWorld();
+	PathGrid& Grid = Pathfinding->Grid;
+	TArray<AActor*>& Tiles = StreamedChunks.Add(ChunkX * Grid.GetNumChunksY() + ChunkY);
+
+	// The cells of the chunk that are inside the map
+	const int FirstX = ChunkX << PathGrid::CHUNK_SHIFT;
+	const int FirstY = ChunkY << PathGrid::CHUNK_SHIFT;
+	const int NumX = FMath::Min(PathGrid::CHUNK_SIZE, MapSizeX - FirstX);
+	const int NumY = FMath::Min(PathGrid::CHUNK_SIZE, MapSizeY - FirstY);
 
-			WorldArray[RandXPos][RandYPos]->ObjectAtLocation = NewFood;
-			FoodActors.Add(NewFood);
+	GridNode::GRID_TYPE UniformType;
+	if (Grid.IsChunkUniform(ChunkX, ChunkY, UniformType))
+	{
+		// One tile scaled to cover the whole chunk, tiles are one grid space centred on their position
+		FVector Position((FirstX + (NumX - 1) * 0.5f) * GRID_SIZE_WORLD, (FirstY + (NumY - 1) * 0.5f) * GRID_SIZE_WORLD, 0);
+		if (AActor* Tile = Pathfinding->Pool.AcquireTile(World, GetTileBlueprint(UniformType), Position))
+		{
+			Tile->SetActorScale3D(FVector(NumX, NumY, 1));
+			Tiles.Add(Tile);
+		}
+		return;
+	}
+
+	// For each grid space spawn an actor of the correct type in the game world
+	Tiles.Reserve(NumX * NumY);
+	for (int x = FirstX; x < FirstX + NumX; x++)
+	{
+		for (int y = FirstY; y < FirstY + NumY; y++)
+		{
+			FVector Position(x * GRID_SIZE_WORLD, y * GRID_SIZE_WORLD, 0);
+			if (AActor* Tile = Pathfinding->Pool.AcquireTile(World, GetTileBlueprint(Grid.GetType(x, y)), Position))
+			{
+				Tile->SetActorScale3D(FVector::OneVector);
+				Tiles.Add(Tile);
+			}
 		}
 	}
 }
 
-// Generates the grid of nodes used for pathfinding and also for placement of objects in the game world
-void ALevelGenerator::GenerateNodeGrid()
+void ALevelGenerator::ReleaseAllTiles()
 {
-	for(int X = 0; X < MapSizeX; X++)
+	if (Pathfinding)
 	{
-		for(int Y = 0; Y < MapSizeY; Y++)
+		for (TPair<int32, TArray<AActor*>>& Chunk : StreamedChunks)
 		{
-			WorldArray[X][Y] = new GridNode();
-			WorldArray[X][Y]->X = X;
-			WorldArray[X][Y]->Y = Y;
-
-			// Characters as defined from the map file
-			switch(CharMapArray[X][Y])
+			for (AActor* Tile : Chunk.Value)
 			{
-				case '.':
-				case 'G':
-					WorldArray[X][Y]->GridType = GridNode::Open;
-					break;
-				case '@':
-				case 'O':
-					WorldArray[X][Y]->GridType = GridNode::Wall;
-					break;
-				case 'T':
-					WorldArray[X][Y]->GridType = GridNode::Forest;
-					break;
-				case 'S':
-					WorldArray[X][Y]->GridType = GridNode::Swamp;
-					break;
-				case 'W':
-					WorldArray[X][Y]->GridType = GridNode::Water;
-					break;
+				Pathfinding->Pool.ReleaseTile(Tile);
 			}
 		}
 	}
+	StreamedChunks.Empty();
+}
+
+TSubclassOf<AActor> ALevelGenerator::GetTileBlueprint(GridNode::GRID_TYPE Type) const
+{
+	switch (Type)
+	{
+		case GridNode::Wall:
+			return WallBlueprint;
+		case GridNode::Forest:
+			return TreeBlueprint;
+		case GridNode::Swamp:
+			return SwampBlueprint;
+		case GridNode::Water:
+			return WaterBlueprint;
+		case GridNode::Open:
+		default:
+			return OpenBlueprint;
+	}
+}
+
+bool ALevelGenerator::GetStreamingFocus(FVector& OutFocus) const
+{
+	APlayerController* Controller = GetWorld()->GetFirstPlayerController();
+	if (!Controller || !Controller->PlayerCameraManager)
+	{
+		return false;
+	}
+
+	OutFocus = Controller->PlayerCameraManager->GetCameraLocation();
+	return true;
+}
+
+// Keep picking random nodes until one satisfies the condition
+GridNode* ALevelGenerator::FindRandomNode(TFunctionRef<bool(const GridNode*)> Condition)
+{
+	while (true) {
+		int RandXPos = FMath::RandRange(0, MapSizeX - 1);
+		int RandYPos = FMath::RandRange(0, MapSizeY - 1);
+
+		// Nothing is ever placed on a wall, and skipping them here avoids creating the nodes of all-wall chunks
+		if (Pathfinding->Grid.GetType(RandXPos, RandYPos) == GridNode::Wall)
+		{
+			continue;
+		}
+
+		GridNode* Node = Pathfinding->Grid.GetNode(RandXPos, RandYPos);
+		if (Condition(Node))
+		{
+			return Node;
+		}
+	}
+}
+
+SimSnapshot ALevelGenerator::CaptureSnapshot()
+{
+	SimSnapshot Snapshot;
+	Snapshot.SetTerrain(Pathfinding->GetSharedTerrain());
+
+	for (AFood* Food : Pathfinding->FoodActors)
+	{
+		const GridNode* Node = Pathfinding->GetNodeAtLocation(Food->GetActorLocation());
+		FSimFood& State = Snapshot.Food.AddDefaulted_GetRef();
+		State.Cell = Node ? FIntPoint(Node->X, Node->Y) : FIntPoint::ZeroValue;
+		State.Type = Food->Type;
+	}
+
+	// agents back in the pool are not part of the simulation
+	for (AAgent* Agent : SpawnedAgents)
+	{
+		if (IsValid(Agent) && Agent->IsActive())
+		{
+			Agent->CaptureState(Snapshot.Agents.AddDefaulted_GetRef());
+		}
+	}
+
+	// the global random numbers cannot be read back, so they start over from a seed both the snapshot and the world know
+	Snapshot.Seed = FMath::Rand();
+	FMath::RandInit(Snapshot.Seed);
+	return Snapshot;
 }
 
-// Reset all node values (F, G, H & Parent)
-void ALevelGenerator::ResetAllNodes()
+bool ALevelGenerator::RestoreSnapshot(const SimSnapshot& Snapshot)
 {
+	if (!Snapshot.HasTerrain() || Snapshot.GetTerrain().SizeX != MapSizeX || Snapshot.GetTerrain().SizeY != MapSizeY)
+	{
+		return false;
+	}
+
+	// everything on the grid goes, the tiles stay
+	TArray<AFood*> OldFood = Pathfinding->FoodActors;
+	for (AFood* Food : OldFood)
+	{
+		Pathfinding->UnregisterFood(Food);
+		Pathfinding->Pool.ReleaseFood(Food);
+	}
+	for (AAgent* Agent : SpawnedAgents)
+	{
+		if (IsValid(Agent))
+		{
+			Agent->Despawn();
+		}
+	}
+	SpawnedAgents.Reset();
+
+	// only the cells a fork changed differ, one edit puts them all back and swaps their tiles, so the paths and the
+	// preprocessing of the map are repaired once
+	const PathGrid& Terrain = Snapshot.GetTerrain();
+	TArray<FTerrainEdit> Edits;
 	for (int X = 0; X < MapSizeX; X++)
 	{
 		for (int Y = 0; Y < MapSizeY; Y++)
 		{
-			WorldArray[X][Y]->F = 0;
-			WorldArray[X][Y]->G = 0;
-			WorldArray[X][Y]->H = 0;
-			WorldArray[X][Y]->Parent = nullptr;
+			const GridNode::GRID_TYPE Type = Terrain.GetType(X, Y);
+			if (Pathfinding->Grid.GetType(X, Y) != Type)
+			{
+				Edits.Add(FTerrainEdit(FIntPoint(X, Y), Type));
+			}
+		}
+	}
+	if (Edits.Num() > 0)
+	{
+		Pathfinding->EditTerrain(Edits);
+	}
+
+	UWorld* World = GetWorld();
+	TArray<AFood*> RestoredFood;
+	for (const FSimFood& State : Snapshot.Food)
+	{
+		FVector Position(State.Cell.X * GRID_SIZE_WORLD, State.Cell.Y * GRID_SIZE_WORLD, 20);
+		AFood* Food = Pathfinding->Pool.AcquireFood(World, FoodBlueprint, Position);
+		Food->SetType((AFood::FOOD_TYPE)State.Type);
+		Pathfinding->RegisterFood(Food, Pathfinding->Grid.GetNode(State.Cell.X, State.Cell.Y));
+		RestoredFood.Add(Food);
+	}
+
+	for (const FSimAgent& State : Snapshot.Agents)
+	{
+		// partway into its next cell, as far as it had walked
+		FVector Position(State.Cell.X * GRID_SIZE_WORLD, State.Cell.Y * GRID_SIZE_WORLD, 20);
+		if (State.StepDistance > 0.f && State.Path.Num() > 0)
+		{
+			const FVector Next(State.Path.Last().X * GRID_SIZE_WORLD, State.Path.Last().Y * GRID_SIZE_WORLD, 20);
+			Position += (Next - Position).GetSafeNormal() * State.StepDistance;
 		}
+
+		// a goal eaten since the snapshot was taken is no goal
+		const bool bGoalValid = State.Goal != INDEX_NONE && Snapshot.Food[State.Goal].Generation == State.GoalGeneration;
+		AAgent* Agent = Pathfinding->Pool.AcquireAgent(World, AgentBlueprint, Position);
+		Agent->RestoreState(State, bGoalValid ? RestoredFood[State.Goal] : nullptr);
+		SpawnedAgents.Add(Agent);
 	}
+
+	FMath::RandInit(Snapshot.Seed);
+	return true;
+}
+
+float ALevelGenerator::GetFoodPoolHitRate() const
+{
+	return Pathfinding ? Pathfinding->Pool.GetFoodHitRate() : 0.f;
+}
+
+float ALevelGenerator::GetAgentPoolHitRate() const
+{
+	return Pathfinding ? Pathfinding->Pool.GetAgentHitRate() : 0.f;
+}
+
+int32 ALevelGenerator::GetLowDetailAgentCount() const
+{
+	return NumLowDetailAgents;
 }
 
-float ALevelGenerator::CalculateDistanceBetween(GridNode* first, GridNode* second)
+int32 ALevelGenerator::GetSleepingAgentCount() const
 {
-	FVector distToTarget = FVector(second->X - first->X,
-		second->Y - first->Y, 0);
-	return distToTarget.Size();
+	return NumSleepingAgents;
 }
\ No newline at end of file
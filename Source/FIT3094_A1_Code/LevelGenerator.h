@@ -6,17 +6,20 @@
 #include "CoreMinimal.h"
 #include "Food.h"
 #include "GameFramework/Actor.h"
+#include "EventScheduler.h"
 #include "GridNode.h"
+#include "SimSnapshot.h"
 #include "LevelGenerator.generated.h"
 
+class AAgent;
+class UPathfindingSubsystem;
+struct FTerrainChange;
+
 UCLASS()
 class FIT3094_A1_CODE_API ALevelGenerator : public AActor
 {
 	GENERATED_BODY()
 
-	// Maximum Size for World Map
-	static const int MAX_MAP_SIZE = 256;
-
 public:
 
 	// Grid Size in World Units
@@ -31,15 +34,10 @@ public:
 		int MapSizeX;
 	UPROPERTY(BlueprintReadOnly)
 		int MapSizeY;
-	
-	// This is a 2D Array for holding all the elements of the world loaded from file
-	char CharMapArray[MAX_MAP_SIZE][MAX_MAP_SIZE];
-
-	// This is a 2D Array for holding nodes for each part of the world
-	GridNode* WorldArray[MAX_MAP_SIZE][MAX_MAP_SIZE];
 
+	// The subsystem that owns the grid, the food and the actor pool
 	UPROPERTY()
-		TArray<AFood*> FoodActors;
+		UPathfindingSubsystem* Pathfinding;
 
 	// Actors for spawning into the world
 	UPROPERTY(EditAnywhere, Category = "Entities")
@@ -57,25 +55,136 @@ public:
 	UPROPERTY(EditAnywhere, Category = "Entities")
 		TSubclassOf<AActor> AgentBlueprint;
 
+	// The agents spawned on the current map, handed back to the pool when the map changes
+	UPROPERTY()
+		TArray<AAgent*> SpawnedAgents;
+
+	// Run the movement phases of the agents on worker threads, off to debug on the game thread only
+	UPROPERTY(EditAnywhere, Category = "Agents")
+		bool bParallelMovement;
+
+	// Agents out of sight of the camera or further from it than LowDetailDistance walk in whole cell steps,
+	// moving their actors once per cell instead of every frame. Off to see every agent walk smoothly
+	UPROPERTY(EditAnywhere, Category = "Agents")
+		bool bLowDetailAgents;
+	UPROPERTY(EditAnywhere, Category = "Agents")
+		float LowDetailDistance;
+
+	// Tiles are only shown for the chunks (PathGrid::CHUNK_SIZE cells square) this many chunks around the camera
+	UPROPERTY(EditAnywhere, Category = "Streaming")
+		int StreamingRadius;
+	// Spread streaming in over several frames instead of hitching when the camera moves fast
+	UPROPERTY(EditAnywhere, Category = "Streaming")
+		int MaxChunksStreamedPerTick;
+
 protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
-
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 	void SpawnWorldActors();
 
-	void GenerateNodeGrid();
-	void ResetAllNodes();
+	// The subsystem is about to replace the map, so everything on the old grid goes back to the pool
+	void HandleMapUnloading();
+	// The new map is in place, populate it
+	void HandleMapLoaded();
+	// Some terrain changed, swap the tiles showing it and let the agents whose paths cross it plan again
+	void HandleTerrainChanged(const FTerrainChange& Change);
+
+	// Move every agent that ticked up to moving: bid for the next nodes, claim the nodes won, walk, then move the actors
+	void MoveAgents(float DeltaTime);
+
+	// The agents moving this tick, scratch kept between ticks
+	TArray<AAgent*> MovingAgents;
+
+	// Pick the detail every agent is simulated in this tick from where the camera is and what it saw. Sleeping agents
+	// coming into view are woken, MovedUntil is the time the last movement phase moved the agents up to
+	void UpdateAgentDetail(double MovedUntil);
+	int32 NumLowDetailAgents;
+	int32 NumSleepingAgents;
+
+	// Put food down until there is NUM_FOOD again, when a food respawn event fires
+	void RespawnFood();
+
+	// The events that came due this tick, scratch kept between ticks
+	TArray<FScheduledEvent> DueEvents;
+	// Replace the tiles of the changed cells of a streamed in chunk, or stream the whole chunk again when its layout changed
+	void RefreshChunkTiles(int ChunkX, int ChunkY, const FTerrainChange& Change);
+
+	// Change the cells of an area (clamped to the map) that meet the condition
+	int32 EditTerrainArea(int32 MinX, int32 MinY, int32 MaxX, int32 MaxY, GridNode::GRID_TYPE NewType, TFunctionRef<bool(GridNode::GRID_TYPE)> Condition);
+
+	// Show the tiles of the chunks near the camera and hide the ones that went out of range
+	void StreamTiles();
+	// Spawn (or take from the pool) the tiles of one chunk, a uniform chunk is one tile stretched over the chunk
+	void StreamInChunk(int ChunkX, int ChunkY);
+	// Give every streamed tile back to the pool
+	void ReleaseAllTiles();
+	// The blueprint that shows a terrain type
+	TSubclassOf<AActor> GetTileBlueprint(GridNode::GRID_TYPE Type) const;
+	// Where to stream around, false when there is no camera to follow
+	bool GetStreamingFocus(FVector& OutFocus) const;
+
+	// Find a random node that satisfies the condition, used to place agents and food
+	GridNode* FindRandomNode(TFunctionRef<bool(const GridNode*)> Condition);
 
-	
 
 public:	
 	// Called every frame
 	virtual void Tick(float DeltaTime) override;
 
+	// Start building the world from the lines of a map file, the map loads in the background and agents spawn once it is ready
 	UFUNCTION(BlueprintCallable)
 		void GenerateWorldFromFile(TArray<FString> WorldArray);
+	// The same, reading the file in the background as well
+	UFUNCTION(BlueprintCallable)
+		void GenerateWorldFromMapFile(const FString& MapPath);
+
+	// For a loading screen
+	UFUNCTION(BlueprintCallable)
+		bool IsLoadingMap() const;
+	UFUNCTION(BlueprintCallable)
+		float GetLoadProgress() const;
+
+	// Change the terrain of cells at runtime without reloading the map, returns how many cells changed.
+	// Walls are not raised under agents or food. Only the tiles and paths of the changed cells are updated
+	int32 EditTerrain(const TArray<FIntPoint>& Cells, GridNode::GRID_TYPE NewType);
+
+	// Area edits, both corners inclusive
+	// Turn everything but walls into water
+	UFUNCTION(BlueprintCallable, Category = "Terrain")
+		int32 FloodArea(int32 MinX, int32 MinY, int32 MaxX, int32 MaxY);
+	// Turn the forest into open ground
+	UFUNCTION(BlueprintCallable, Category = "Terrain")
+		int32 ClearForest(int32 MinX, int32 MinY, int32 MaxX, int32 MaxY);
+	// Turn everything into walls
+	UFUNCTION(BlueprintCallable, Category = "Terrain")
+		int32 RaiseWalls(int32 MinX, int32 MinY, int32 MaxX, int32 MaxY);
+
+	// Take the state of the whole simulation: terrain, food, agents and the random seed. The terrain is shared with the
+	// other snapshots of the map, so a snapshot costs little more than its agents
+	SimSnapshot CaptureSnapshot();
+	// Put the simulation back the way a snapshot of the current map (or a fork of one) left it, false for another map
+	bool RestoreSnapshot(const SimSnapshot& Snapshot);
+
+	// Snapshots by name, taken and restored with the Sim console commands
+	TMap<FName, SimSnapshot> Snapshots;
+
+	// The pool hit rates, for checking how much spawning the pool saves
+	UFUNCTION(BlueprintCallable)
+		float GetFoodPoolHitRate() const;
+	UFUNCTION(BlueprintCallable)
+		float GetAgentPoolHitRate() const;
+
+	// How many agents walk in cell steps, for checking what low detail saves
+	UFUNCTION(BlueprintCallable)
+		int32 GetLowDetailAgentCount() const;
+	// How many agents sleep until an event of theirs fires, for checking what the scheduler saves
+	UFUNCTION(BlueprintCallable)
+		int32 GetSleepingAgentCount() const;
+
+private:
 
-	// I make CalculateDistanceBetween as a public function, so I can call it in agent
-	float CalculateDistanceBetween(GridNode* first, GridNode* second);
+	// The tiles shown for each streamed in chunk, keyed by chunk index (ChunkX * NumChunksY + ChunkY)
+	TMap<int32, TArray<AActor*>> StreamedChunks;
 
 };
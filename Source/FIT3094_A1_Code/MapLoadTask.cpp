@@ -0,0 +1,124 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "MapLoadTask.h"
+#include "Async/ParallelFor.h"
+#include "HAL/PlatformTime.h"
+#include "Misc/FileHelper.h"
+
+MapLoadTask::MapLoadTask(const FString& InMapPath, const TArray<FString>& InMapLines, const FString& InMapName, const TArray<TPair<FName, FPreprocessPass>>& InPasses)
+	: MapLines(InMapLines)
+	, MapId(0)
+	, MapName(InMapName)
+	, MapPath(InMapPath)
+	, Passes(InPasses)
+	, Stage(Queued)
+	, ExpectedBands(1)
+{
+}
+
+void MapLoadTask::Run()
+{
+	if (!EnterStage(Reading))
+	{
+		return;
+	}
+
+	if (!MapPath.IsEmpty())
+	{
+		FString MapText;
+		if (!FFileHelper::LoadFileToString(MapText, *MapPath))
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Could not read map file %s"), *MapPath);
+			Stage = Failed;
+			return;
+		}
+		MapText.ParseIntoArrayLines(MapLines);
+	}
+	MapId = FCrc::StrCrc32(*FString::Join(MapLines, TEXT("\n")));
+
+	ExpectedBands = FMath::Max(1, FMath::DivideAndRoundUp(MapLines.Num() - 4, PathGrid::CHUNK_SIZE));
+	if (!EnterStage(Parsing))
+	{
+		return;
+	}
+
+	if (!Grid.Load(MapLines, &BandsDone))
+	{
+		Stage = Failed;
+		return;
+	}
+
+	// described here rather than in Load, which the kernel bench times
+	int32 NumUniform = 0;
+	for (int32 ChunkX = 0; ChunkX < Grid.GetNumChunksX(); ChunkX++)
+	{
+		for (int32 ChunkY = 0; ChunkY < Grid.GetNumChunksY(); ChunkY++)
+		{
+			GridNode::GRID_TYPE UniformType;
+			NumUniform += Grid.IsChunkUniform(ChunkX, ChunkY, UniformType) ? 1 : 0;
+		}
+	}
+	UE_LOG(LogTemp, Log, TEXT("Map %d x %d: %d of %d chunks are uniform"), Grid.SizeX, Grid.SizeY, NumUniform, Grid.GetNumChunksX() * Grid.GetNumChunksY());
+
+	// start with only the walls blocking, agents and food are added as they spawn
+	if (!EnterStage(BuildingOccupancy))
+	{
+		return;
+	}
+	Occupancy.Init(Grid);
+
+	// the map is static from now on, so derived data can be built once. The passes do not depend on each other
+	if (!EnterStage(Preprocessing))
+	{
+		return;
+	}
+
+	Commits.SetNum(Passes.Num());
+	ParallelFor(Passes.Num(), [this](int32 Index)
+	{
+		if (bCancelled)
+		{
+			return;
+		}
+
+		double StartTime = FPlatformTime::Seconds();
+		Commits[Index].Key = Passes[Index].Key;
+		Commits[Index].Value = Passes[Index].Value(Grid);
+		UE_LOG(LogTemp, Log, TEXT("Preprocess %s: %.2f ms"), *Passes[Index].Key.ToString(), (FPlatformTime::Seconds() - StartTime) * 1000.0);
+		PassesDone.Increment();
+	});
+
+	EnterStage(Done);
+}
+
+float MapLoadTask::GetProgress() const
+{
+	switch (GetStage())
+	{
+		case Queued:
+			return 0.f;
+		case Reading:
+			return 0.05f;
+		case Parsing:
+			return 0.1f + 0.6f * FMath::Min(1.f, (float)BandsDone.GetValue() / ExpectedBands.Load());
+		case BuildingOccupancy:
+			return 0.7f;
+		case Preprocessing:
+			return 0.75f + 0.25f * (Passes.Num() > 0 ? (float)PassesDone.GetValue() / Passes.Num() : 1.f);
+		default:
+			return 1.f;
+	}
+}
+
+bool MapLoadTask::EnterStage(STAGE NewStage)
+{
+	if (bCancelled)
+	{
+		Stage = Failed;
+		return false;
+	}
+
+	Stage = NewStage;
+	return true;
+}
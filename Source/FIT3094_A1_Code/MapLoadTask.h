@@ -0,0 +1,95 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/ThreadSafeBool.h"
+#include "HAL/ThreadSafeCounter.h"
+#include "Templates/Atomic.h"
+#include "OccupancyGrid.h"
+#include "PathGrid.h"
+
+// Installs the data a preprocessing pass derived from a grid, always run on the game thread
+typedef TFunction<void()> FPreprocessCommit;
+
+// A preprocessing pass run over the grid every time a map is loaded. It may run on a worker thread,
+// so it must only read the grid it is given and hand back the step that installs what it built
+typedef TFunction<FPreprocessCommit(const PathGrid&)> FPreprocessPass;
+
+/**
+ * Builds a map away from the game thread: reads the file, parses it into a grid, fills the occupancy
+ * and runs the preprocessing passes. Nothing the game uses is touched, the subsystem takes the results
+ * over in one go on the game thread once Run has finished
+ */
+class FIT3094_A1_CODE_API MapLoadTask
+{
+
+public:
+
+	// The stages of a load, in order
+	enum STAGE
+	{
+		Queued,
+		Reading,
+		Parsing,
+		BuildingOccupancy,
+		Preprocessing,
+		Done,
+		Failed
+	};
+
+	// Load from a file when MapPath is set, otherwise from the lines given
+	MapLoadTask(const FString& InMapPath, const TArray<FString>& InMapLines, const FString& InMapName, const TArray<TPair<FName, FPreprocessPass>>& InPasses);
+
+	// Run every stage on the calling thread
+	void Run();
+
+	// Ask the task to stop at the next stage, its results are thrown away
+	void Cancel()
+	{
+		bCancelled = true;
+	}
+	bool IsCancelled() const
+	{
+		return bCancelled;
+	}
+
+	STAGE GetStage() const
+	{
+		return (STAGE)Stage.Load();
+	}
+	bool IsFinished() const
+	{
+		return GetStage() == Done || GetStage() == Failed;
+	}
+
+	// Rough fraction of the work done, from 0 to 1
+	float GetProgress() const;
+
+	// The results, only to be used once the task is finished
+	TArray<FString> MapLines;
+	uint32 MapId;
+	FString MapName;
+	PathGrid Grid;
+	OccupancyGrid Occupancy;
+
+	// What each pass built, to be committed when the map is published
+	TArray<TPair<FName, FPreprocessCommit>> Commits;
+
+private:
+
+	// Move to the next stage, returns false when the task has been cancelled
+	bool EnterStage(STAGE NewStage);
+
+	FString MapPath;
+	TArray<TPair<FName, FPreprocessPass>> Passes;
+
+	TAtomic<int32> Stage;
+	FThreadSafeBool bCancelled;
+
+	// Progress inside the parsing and preprocessing stages
+	TAtomic<int32> ExpectedBands;
+	FThreadSafeCounter BandsDone;
+	FThreadSafeCounter PassesDone;
+
+};
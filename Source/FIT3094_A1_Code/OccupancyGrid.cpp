@@ -0,0 +1,181 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "OccupancyGrid.h"
+#include "Food.h"
+#include "PathGrid.h"
+#include "Async/ParallelFor.h"
+#include "HAL/PlatformAtomics.h"
+
+OccupancyGrid::OccupancyGrid()
+{
+	SizeX = 0;
+	SizeY = 0;
+	WordsPerRow = 0;
+}
+
+void OccupancyGrid::Init(const PathGrid& Grid)
+{
+	SizeX = Grid.SizeX;
+	SizeY = Grid.SizeY;
+	WordsPerRow = (SizeY + 63) / 64;
+	Bits.Init(0, SizeX * WordsPerRow * LAYER_COUNT);
+
+	// walls never change once the grid is built. Every row has its own words, so rows can be filled at the same time
+	ParallelFor(SizeX, [this, &Grid](int32 X)
+	{
+		for (int Y = 0; Y < SizeY; Y++)
+		{
+			if (Grid.GetType(X, Y) == GridNode::Wall)
+			{
+				Set(X, Y, Walls);
+			}
+		}
+	});
+}
+
+void OccupancyGrid::Reset()
+{
+	SizeX = 0;
+	SizeY = 0;
+	WordsPerRow = 0;
+	Bits.Empty();
+}
+
+OccupancyGrid::LAYER OccupancyGrid::GetFoodLayer(int FoodType)
+{
+	switch (FoodType) {
+	case AFood::Meat:
+		return Meat;
+	case AFood::Vegetation:
+		return Vegetation;
+	default:
+		return Meat;
+	}
+}
+
+uint64 OccupancyGrid::GetBlockedWord(int X, int WordIndex, uint8 BlockingLayers) const
+{
+	const uint64* Word = &Bits[(X * WordsPerRow + WordIndex) * LAYER_COUNT];
+
+	// turn each layer bit of the mask into an all-ones or all-zeros word, so there is no branch per layer
+	const uint64 WallsMask = 0ull - ((BlockingLayers >> Walls) & 1);
+	const uint64 AgentsMask = 0ull - ((BlockingLayers >> Agents) & 1);
+	const uint64 MeatMask = 0ull - ((BlockingLayers >> Meat) & 1);
+	const uint64 VegetationMask = 0ull - ((BlockingLayers >> Vegetation) & 1);
+
+	return (Word[Walls] & WallsMask) | (Word[Agents] & AgentsMask) | (Word[Meat] & MeatMask) | (Word[Vegetation] & VegetationMask);
+}
+
+void OccupancyGrid::SetAtomic(int X, int Y, LAYER Layer)
+{
+	volatile int64* Word = (volatile int64*)&GetWord(X, Y, Layer);
+	int64 Current = FPlatformAtomics::AtomicRead(Word);
+	while (true)
+	{
+		const int64 Previous = FPlatformAtomics::InterlockedCompareExchange(Word, Current | (int64)GetBit(Y), Current);
+		if (Previous == Current)
+		{
+			return;
+		}
+		Current = Previous;
+	}
+}
+
+void OccupancyGrid::ClearAtomic(int X, int Y, LAYER Layer)
+{
+	volatile int64* Word = (volatile int64*)&GetWord(X, Y, Layer);
+	int64 Current = FPlatformAtomics::AtomicRead(Word);
+	while (true)
+	{
+		const int64 Previous = FPlatformAtomics::InterlockedCompareExchange(Word, Current & ~(int64)GetBit(Y), Current);
+		if (Previous == Current)
+		{
+			return;
+		}
+		Current = Previous;
+	}
+}
+
+void OccupancyGrid::GetRow(int X, LAYER Layer, TArray<uint64>& OutWords) const
+{
+	OutWords.SetNumUninitialized(WordsPerRow);
+	for (int WordIndex = 0; WordIndex < WordsPerRow; WordIndex++)
+	{
+		OutWords[WordIndex] = Bits[(X * WordsPerRow + WordIndex) * LAYER_COUNT + Layer];
+	}
+}
+
+void OccupancyGrid::SetRow(int X, LAYER Layer, const TArray<uint64>& Words)
+{
+	check(Words.Num() == WordsPerRow);
+	for (int WordIndex = 0; WordIndex < WordsPerRow; WordIndex++)
+	{
+		Bits[(X * WordsPerRow + WordIndex) * LAYER_COUNT + Layer] = Words[WordIndex];
+	}
+}
+
+void OccupancyGrid::Diff(const OccupancyGrid& Other, TArray<uint32>& OutBitIndices) const
+{
+	OutBitIndices.Reset();
+	check(Bits.Num() == Other.Bits.Num());
+
+	for (int WordIndex = 0; WordIndex < Bits.Num(); WordIndex++)
+	{
+		uint64 Changed = Bits[WordIndex] ^ Other.Bits[WordIndex];
+		// pull out the set bits one at a time, lowest first
+		while (Changed)
+		{
+			const uint32 Bit = (uint32)FMath::CountTrailingZeros64(Changed);
+			OutBitIndices.Add((uint32)WordIndex * 64 + Bit);
+			Changed &= Changed - 1;
+		}
+	}
+}
+
+void OccupancyGrid::ToggleBits(const TArray<uint32>& BitIndices)
+{
+	for (uint32 BitIndex : BitIndices)
+	{
+		Bits[BitIndex >> 6] ^= 1ull << (BitIndex & 63);
+	}
+}
+
+uint8 OccupancyGrid::GetPassableNeighbours(int X, int Y, uint8 BlockingLayers) const
+{
+	// the layer masks once for the five words below, as in GetBlockedWord
+	const uint64 LayerMasks[LAYER_COUNT] = {
+		0ull - ((BlockingLayers >> Walls) & 1),
+		0ull - ((BlockingLayers >> Agents) & 1),
+		0ull - ((BlockingLayers >> Meat) & 1),
+		0ull - ((BlockingLayers >> Vegetation) & 1)
+	};
+	auto GetBlocked = [this, &LayerMasks](int RowX, int WordIndex)
+	{
+		const uint64* Word = &Bits[(RowX * WordsPerRow + WordIndex) * LAYER_COUNT];
+		return (Word[Walls] & LayerMasks[Walls]) | (Word[Agents] & LayerMasks[Agents]) | (Word[Meat] & LayerMasks[Meat]) | (Word[Vegetation] & LayerMasks[Vegetation]);
+	};
+
+	// rows and words off the map are read clamped, the edge mask drops them later, so every load is valid without a branch
+	const int WordIndex = Y >> 6;
+	const int Bit = Y & 63;
+	const uint64 Row = GetBlocked(X, WordIndex);
+	const uint64 RowBefore = GetBlocked(X, FMath::Max(WordIndex - 1, 0));
+	const uint64 RowAfter = GetBlocked(X, FMath::Min(WordIndex + 1, WordsPerRow - 1));
+	const uint64 LeftRow = GetBlocked(FMath::Max(X - 1, 0), WordIndex);
+	const uint64 RightRow = GetBlocked(FMath::Min(X + 1, SizeX - 1), WordIndex);
+
+	// the row shifted a cell each way, carrying in the end bit of the word next to it, puts Y - 1 and Y + 1 at the bit of Y
+	const uint64 UpRow = (Row << 1) | (RowBefore >> 63);
+	const uint64 DownRow = (Row >> 1) | (RowAfter << 63);
+
+	const uint32 Blocked = (uint32)((UpRow >> Bit) & 1)
+		| (uint32)((RightRow >> Bit) & 1) << 1
+		| (uint32)((DownRow >> Bit) & 1) << 2
+		| (uint32)((LeftRow >> Bit) & 1) << 3;
+	const uint32 Inside = (uint32)(Y > 0)
+		| (uint32)(X + 1 < SizeX) << 1
+		| (uint32)(Y + 1 < SizeY) << 2
+		| (uint32)(X > 0) << 3;
+	return (uint8)(~Blocked & Inside);
+}
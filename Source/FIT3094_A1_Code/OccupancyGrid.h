@@ -0,0 +1,125 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class PathGrid;
+
+/**
+ * Bit-packed occupancy of the grid, one bitmap per layer (walls, agents, meat, vegetation).
+ * Lets the search test passability with a few word operations instead of touching actors
+ */
+class FIT3094_A1_CODE_API OccupancyGrid
+{
+
+public:
+
+	// The layers that can block a cell
+	enum LAYER
+	{
+		Walls,
+		Agents,
+		Meat,
+		Vegetation,
+		LAYER_COUNT
+	};
+
+	// Bits returned by GetPassableNeighbours, in the order the search visits the neighbours
+	enum NEIGHBOUR
+	{
+		Up = 1 << 0,	// Y - 1
+		Right = 1 << 1,	// X + 1
+		Down = 1 << 2,	// Y + 1
+		Left = 1 << 3	// X - 1
+	};
+
+	OccupancyGrid();
+
+	// Size the layers to the grid, clear them and fill the wall layer from the static map
+	void Init(const PathGrid& Grid);
+
+	// Throw everything away
+	void Reset();
+
+	// A mask with the bit of the layer set, used to build the blocking mask of an agent type
+	static uint8 LayerMask(LAYER Layer)
+	{
+		return (uint8)(1 << Layer);
+	}
+
+	// The layer a food of the given type lives in
+	static LAYER GetFoodLayer(int FoodType);
+
+	// Update a single cell of a layer
+	void Set(int X, int Y, LAYER Layer)
+	{
+		GetWord(X, Y, Layer) |= GetBit(Y);
+	}
+	void Clear(int X, int Y, LAYER Layer)
+	{
+		GetWord(X, Y, Layer) &= ~GetBit(Y);
+	}
+	bool Test(int X, int Y, LAYER Layer) const
+	{
+		return (GetWord(X, Y, Layer) & GetBit(Y)) != 0;
+	}
+
+	// Set and Clear for threads updating cells at the same time, a word holds 64 cells so plain updates would lose bits
+	void SetAtomic(int X, int Y, LAYER Layer);
+	void ClearAtomic(int X, int Y, LAYER Layer);
+
+	// Is the cell blocked by any of the layers in the mask (cells outside the map are blocked)
+	bool IsBlocked(int X, int Y, uint8 BlockingLayers) const
+	{
+		if (X < 0 || Y < 0 || X >= SizeX || Y >= SizeY)
+		{
+			return true;
+		}
+		return (GetBlockedWord(X, Y >> 6, BlockingLayers) & GetBit(Y)) != 0;
+	}
+
+	// The 64 cells of a row starting at Y = WordIndex * 64, a set bit means blocked by one of the layers in the mask
+	uint64 GetBlockedWord(int X, int WordIndex, uint8 BlockingLayers) const;
+
+	// The four neighbours of a cell that are inside the map and not blocked, as NEIGHBOUR bits
+	uint8 GetPassableNeighbours(int X, int Y, uint8 BlockingLayers) const;
+
+	// Copy one row of a layer out or in, as WordsPerRow words. Used to send border rows to other processes
+	void GetRow(int X, LAYER Layer, TArray<uint64>& OutWords) const;
+	void SetRow(int X, LAYER Layer, const TArray<uint64>& Words);
+
+	// List the raw bits (across all layers) that differ from another grid of the same size, in increasing order
+	void Diff(const OccupancyGrid& Other, TArray<uint32>& OutBitIndices) const;
+	// Flip raw bits listed by Diff, turning the other grid into this one
+	void ToggleBits(const TArray<uint32>& BitIndices);
+
+	// Size of the map
+	int SizeX;
+	int SizeY;
+
+private:
+
+	// Get the bit of Y inside its word
+	static uint64 GetBit(int Y)
+	{
+		return 1ull << (Y & 63);
+	}
+
+	// The layers of a word are stored next to each other so a blocked word is one cache line
+	uint64& GetWord(int X, int Y, LAYER Layer)
+	{
+		return Bits[(X * WordsPerRow + (Y >> 6)) * LAYER_COUNT + Layer];
+	}
+	const uint64& GetWord(int X, int Y, LAYER Layer) const
+	{
+		return Bits[(X * WordsPerRow + (Y >> 6)) * LAYER_COUNT + Layer];
+	}
+
+	// Number of 64 bit words needed for one row
+	int WordsPerRow;
+
+	// All layers, interleaved per word
+	TArray<uint64> Bits;
+
+};
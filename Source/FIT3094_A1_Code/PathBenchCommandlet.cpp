@@ -0,0 +1,105 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "PathBenchCommandlet.h"
+#include "PathKernelBench.h"
+#include "HAL/PlatformFilemanager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+UPathBenchCommandlet::UPathBenchCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = false;
+	LogToConsole = true;
+}
+
+int32 UPathBenchCommandlet::Main(const FString& Params)
+{
+	TArray<FString> KernelNames;
+	PathKernelBench::GetKernelNames(KernelNames);
+	if (FParse::Param(*Params, TEXT("List")))
+	{
+		for (const FString& Name : KernelNames)
+		{
+			UE_LOG(LogTemp, Display, TEXT("%s"), *Name);
+		}
+		return 0;
+	}
+
+	PathKernelBench::FSettings Settings;
+	FParse::Value(*Params, TEXT("Samples="), Settings.Samples);
+	FParse::Value(*Params, TEXT("Queries="), Settings.NumQueries);
+	FParse::Value(*Params, TEXT("Seed="), Settings.Seed);
+	FParse::Value(*Params, TEXT("DoorwayWidth="), Settings.MaxDoorwayWidth);
+	float MinSampleMs = Settings.MinSampleSeconds * 1000.0;
+	if (FParse::Value(*Params, TEXT("MinSampleMs="), MinSampleMs))
+	{
+		Settings.MinSampleSeconds = FMath::Max(MinSampleMs, 0.01f) / 1000.0;
+	}
+	Settings.Samples = FMath::Max(1, Settings.Samples);
+
+	FString KernelList;
+	if (FParse::Value(*Params, TEXT("Kernels="), KernelList))
+	{
+		KernelList.ParseIntoArray(Settings.Kernels, TEXT(","));
+		for (const FString& Name : Settings.Kernels)
+		{
+			if (!KernelNames.Contains(Name))
+			{
+				UE_LOG(LogTemp, Error, TEXT("No kernel is called %s, -List prints their names"), *Name);
+				return 1;
+			}
+		}
+	}
+
+	// every map unless some were asked for by name
+	const FString MapsDir = FPaths::ProjectContentDir() + TEXT("MapFiles/");
+	TArray<FString> MapFiles;
+	FString MapList;
+	if (FParse::Value(*Params, TEXT("Maps="), MapList))
+	{
+		TArray<FString> MapNames;
+		MapList.ParseIntoArray(MapNames, TEXT(","));
+		for (const FString& Name : MapNames)
+		{
+			MapFiles.Add(MapsDir + (Name.EndsWith(TEXT(".map")) ? Name : Name + TEXT(".map")));
+		}
+	}
+	else
+	{
+		FPlatformFileManager::Get().GetPlatformFile().FindFiles(MapFiles, *MapsDir, TEXT("map"));
+		MapFiles.Sort();
+	}
+
+	if (MapFiles.Num() == 0)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Usage: -run=PathBench [-Maps=den001d,arena] [-Kernels=TravelCost,...] [-Samples=25] [-MinSampleMs=2] [-Queries=64] [-Seed=1] [-DoorwayWidth=4] [-Json=<file>] [-List]"));
+		return 1;
+	}
+
+	TArray<PathKernelBench::FResult> Results;
+	for (const FString& MapFile : MapFiles)
+	{
+		UE_LOG(LogTemp, Display, TEXT("Benchmarking %s"), *FPaths::GetCleanFilename(MapFile));
+		if (!PathKernelBench::RunMap(MapFile, Settings, Results))
+		{
+			return 1;
+		}
+	}
+
+	PathKernelBench::LogResults(Results);
+
+	FString JsonFile;
+	if (FParse::Value(*Params, TEXT("Json="), JsonFile))
+	{
+		if (!FFileHelper::SaveStringToFile(PathKernelBench::ToJson(Settings, Results), *JsonFile))
+		{
+			UE_LOG(LogTemp, Error, TEXT("Cannot write %s"), *JsonFile);
+			return 1;
+		}
+		UE_LOG(LogTemp, Display, TEXT("Wrote %d results to %s"), Results.Num(), *JsonFile);
+	}
+	return 0;
+}
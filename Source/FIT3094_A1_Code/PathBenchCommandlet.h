@@ -0,0 +1,25 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "PathBenchCommandlet.generated.h"
+
+/**
+ * Runs the pathfinding microbenchmarks (see PathKernelBench) on maps from Content/MapFiles and writes the timings as JSON.
+ * Usage: UE4Editor-Cmd FIT3094_A1_Code.uproject -run=PathBench [-Maps=den001d,arena] [-Kernels=TravelCost,...]
+ *        [-Samples=25] [-MinSampleMs=2] [-Queries=64] [-Seed=1] [-DoorwayWidth=4] [-Json=<file>] [-List]
+ * Every map is benchmarked unless some are named, -List prints the kernel names
+ */
+UCLASS()
+class FIT3094_A1_CODE_API UPathBenchCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+
+	UPathBenchCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
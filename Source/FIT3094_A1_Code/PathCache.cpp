@@ -0,0 +1,407 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "PathCache.h"
+#include "OccupancyGrid.h"
+#include "PathGrid.h"
+#include "HAL/PlatformTime.h"
+
+// Moves packed in a word of FEntry::Moves
+static const int32 MovesPerWord = 32;
+
+PathCache::FStepIterator::FStepIterator(const PathGrid& Grid, const FEntry& InEntry)
+	: Entry(InEntry)
+	, Step(-1)
+	, Cell(Grid.GetPosition(InEntry.StartCell))
+{
+	Next();
+}
+
+void PathCache::FStepIterator::Next()
+{
+	Step++;
+	if (Step < Entry.NumSteps)
+	{
+		const int Direction = (int)(Entry.Moves[Step / MovesPerWord] >> ((Step % MovesPerWord) * 2)) & 3;
+		Cell += PathSearchEngine::NeighbourOffsets[Direction];
+	}
+}
+
+PathCache::PathCache()
+{
+	Budget = 0;
+	NumBucketsY = 0;
+	Reset();
+}
+
+void PathCache::Init(const PathGrid& Grid)
+{
+	Reset();
+	const int NumBucketsX = (Grid.SizeX + (1 << BUCKET_SHIFT) - 1) >> BUCKET_SHIFT;
+	NumBucketsY = (Grid.SizeY + (1 << BUCKET_SHIFT) - 1) >> BUCKET_SHIFT;
+	Buckets.SetNum(NumBucketsX * NumBucketsY);
+}
+
+void PathCache::Clear()
+{
+	Entries.Reset();
+	FreeEntries.Reset();
+	for (TArray<int32>& Bucket : Buckets)
+	{
+		Bucket.Reset();
+	}
+	NumPaths = 0;
+	Newest = INDEX_NONE;
+	Oldest = INDEX_NONE;
+	PathBytes = 0;
+	Clears++;
+}
+
+void PathCache::Reset()
+{
+	Entries.Empty();
+	FreeEntries.Empty();
+	Buckets.Empty();
+	Doomed.Empty();
+	NumPaths = 0;
+	Newest = INDEX_NONE;
+	Oldest = INDEX_NONE;
+	PathBytes = 0;
+
+	Lookups = 0;
+	Hits = 0;
+	SuffixHits = 0;
+	BlockedMisses = 0;
+	Adds = 0;
+	Evictions = 0;
+	Invalidations = 0;
+	Clears = 0;
+	Seconds = 0.0;
+}
+
+void PathCache::SetBudget(int64 Bytes)
+{
+	// a smaller budget is made room for by the next Add
+	Budget = FMath::Max<int64>(Bytes, 0);
+	if (Budget == 0)
+	{
+		Clear();
+	}
+}
+
+bool PathCache::Find(const PathGrid& Grid, const OccupancyGrid& Occupancy, const FPathQuery& Query, FPathResult& OutResult)
+{
+	OutResult.Reset();
+	if (!IsEnabled())
+	{
+		return false;
+	}
+
+	const double StartTime = FPlatformTime::Seconds();
+	Lookups++;
+
+	const int32 StartCell = Grid.GetIndex(Query.Start.X, Query.Start.Y);
+	const int32 GoalCell = Grid.GetIndex(Query.Goal.X, Query.Goal.Y);
+	bool bBlocked = false;
+	for (const int32 EntryIndex : Buckets[GetBucket(Query.Start.X, Query.Start.Y)])
+	{
+		const FEntry& Entry = Entries[EntryIndex];
+		if (Entry.GoalCell != GoalCell || Entry.BlockingLayers != Query.BlockingLayers)
+		{
+			continue;
+		}
+
+		// a path from somewhere before the start is answered from the step after it
+		FStepIterator It(Grid, Entry);
+		const bool bSuffix = Entry.StartCell != StartCell;
+		if (bSuffix)
+		{
+			while (!It.IsDone() && It.Cell != Query.Start)
+			{
+				It.Next();
+			}
+			if (It.IsDone())
+			{
+				continue;
+			}
+			It.Next();
+		}
+
+		// other agents may have stepped onto the path since it was found
+		OutResult.Reset();
+		for (; !It.IsDone(); It.Next())
+		{
+			if (Occupancy.IsBlocked(It.Cell.X, It.Cell.Y, Query.BlockingLayers))
+			{
+				break;
+			}
+			OutResult.Path.Add(It.Cell);
+			OutResult.Cost += (int32)Grid.GetTravelCost(It.Cell.X, It.Cell.Y);
+		}
+		if (!It.IsDone() || OutResult.Path.Num() == 0)
+		{
+			bBlocked = bBlocked || !It.IsDone();
+			continue;
+		}
+
+		OutResult.bFound = true;
+		(bSuffix ? SuffixHits : Hits)++;
+		Touch(EntryIndex);
+		OutResult.Seconds = FPlatformTime::Seconds() - StartTime;
+		Seconds += OutResult.Seconds;
+		return true;
+	}
+
+	BlockedMisses += bBlocked ? 1 : 0;
+	OutResult.Reset();
+	Seconds += FPlatformTime::Seconds() - StartTime;
+	return false;
+}
+
+void PathCache::Add(const PathGrid& Grid, const FPathQuery& Query, const FPathResult& Result)
+{
+	if (!IsEnabled() || !Result.bFound || Result.Path.Num() == 0)
+	{
+		return;
+	}
+
+	const int32 StartCell = Grid.GetIndex(Query.Start.X, Query.Start.Y);
+	const int32 GoalCell = Grid.GetIndex(Query.Goal.X, Query.Goal.Y);
+
+	// the newer answer to the same question replaces the old one
+	Doomed.Reset();
+	for (const int32 EntryIndex : Buckets[GetBucket(Query.Start.X, Query.Start.Y)])
+	{
+		const FEntry& Entry = Entries[EntryIndex];
+		if (Entry.StartCell == StartCell && Entry.GoalCell == GoalCell && Entry.BlockingLayers == Query.BlockingLayers)
+		{
+			Doomed.Add(EntryIndex);
+		}
+	}
+	for (const int32 EntryIndex : Doomed)
+	{
+		Remove(Grid, EntryIndex);
+	}
+
+	// every step is to one of the four neighbours, anything else cannot be packed
+	TArray<uint64> Moves;
+	Moves.SetNumZeroed((Result.Path.Num() + MovesPerWord - 1) / MovesPerWord);
+	FIntPoint Previous = Query.Start;
+	for (int32 Step = 0; Step < Result.Path.Num(); Step++)
+	{
+		const FIntPoint Offset = Result.Path[Step] - Previous;
+		int Direction = 0;
+		while (Direction < 4 && PathSearchEngine::NeighbourOffsets[Direction] != Offset)
+		{
+			Direction++;
+		}
+		if (Direction == 4)
+		{
+			return;
+		}
+		Moves[Step / MovesPerWord] |= (uint64)Direction << ((Step % MovesPerWord) * 2);
+		Previous = Result.Path[Step];
+	}
+
+	const int32 EntryIndex = FreeEntries.Num() > 0 ? FreeEntries.Pop(false) : Entries.AddDefaulted();
+	FEntry& Entry = Entries[EntryIndex];
+	Entry.StartCell = StartCell;
+	Entry.GoalCell = GoalCell;
+	Entry.BlockingLayers = Query.BlockingLayers;
+	Entry.NumSteps = Result.Path.Num();
+	Entry.Cost = Result.Cost;
+	Entry.Moves = MoveTemp(Moves);
+	PathBytes += Entry.Moves.GetAllocatedSize();
+	NumPaths++;
+	Adds++;
+	Register(Grid, EntryIndex);
+	Touch(EntryIndex);
+
+	// make room by dropping the paths used longest ago, the new one stays even if it alone is over the budget
+	while (Oldest != Newest && GetAllocatedSize() > Budget)
+	{
+		Remove(Grid, Oldest);
+		Evictions++;
+	}
+}
+
+void PathCache::InvalidateCell(const PathGrid& Grid, int X, int Y, uint8 Layers)
+{
+	if (NumPaths == 0 || !Grid.IsInside(X, Y))
+	{
+		return;
+	}
+
+	const FIntPoint Cell(X, Y);
+	Doomed.Reset();
+	for (const int32 EntryIndex : Buckets[GetBucket(X, Y)])
+	{
+		const FEntry& Entry = Entries[EntryIndex];
+		if ((Entry.BlockingLayers & Layers) == 0)
+		{
+			continue;
+		}
+		for (FStepIterator It(Grid, Entry); !It.IsDone(); It.Next())
+		{
+			if (It.Cell == Cell)
+			{
+				Doomed.Add(EntryIndex);
+				break;
+			}
+		}
+	}
+
+	for (const int32 EntryIndex : Doomed)
+	{
+		Remove(Grid, EntryIndex);
+		Invalidations++;
+	}
+}
+
+void PathCache::InvalidateCheaper(const PathGrid& Grid, const FIntPoint& Min, const FIntPoint& Max)
+{
+	if (NumPaths == 0)
+	{
+		return;
+	}
+
+	// every step costs at least as much as open ground, so a way through the rectangle costs at least the steps
+	// from the start to its nearest cell and on to the goal. Suffixes of a path are covered by the whole path
+	const int32 MinStepCost = (int32)GridNode::GetTravelCost(GridNode::Open);
+	auto GetStepsTo = [&Min, &Max](const FIntPoint& Cell)
+	{
+		return FMath::Max3(Min.X - Cell.X, 0, Cell.X - Max.X) + FMath::Max3(Min.Y - Cell.Y, 0, Cell.Y - Max.Y);
+	};
+
+	Doomed.Reset();
+	for (int32 EntryIndex = 0; EntryIndex < Entries.Num(); EntryIndex++)
+	{
+		const FEntry& Entry = Entries[EntryIndex];
+		if (Entry.NumSteps == 0)
+		{
+			continue;
+		}
+		const int32 Steps = GetStepsTo(Grid.GetPosition(Entry.StartCell)) + GetStepsTo(Grid.GetPosition(Entry.GoalCell));
+		if (Steps * MinStepCost < Entry.Cost)
+		{
+			Doomed.Add(EntryIndex);
+		}
+	}
+
+	for (const int32 EntryIndex : Doomed)
+	{
+		Remove(Grid, EntryIndex);
+		Invalidations++;
+	}
+}
+
+int64 PathCache::GetAllocatedSize() const
+{
+	return PathBytes + Entries.GetAllocatedSize() + FreeEntries.GetAllocatedSize() + Buckets.GetAllocatedSize() + Doomed.GetAllocatedSize();
+}
+
+void PathCache::LogStats() const
+{
+	if (Lookups == 0 && Adds == 0)
+	{
+		return;
+	}
+
+	UE_LOG(LogTemp, Display, TEXT("Path cache: %d lookups, hit rate %.1f%% (%d whole paths, %d suffixes), %d blocked by agents, %d added, %d evicted, %d invalidated, %d clears, %d paths in %.1f KB, mean lookup %.1f us"),
+		Lookups, GetHitRate() * 100.0, Hits, SuffixHits, BlockedMisses, Adds, Evictions, Invalidations, Clears, NumPaths,
+		GetAllocatedSize() / 1024.0, Lookups > 0 ? Seconds * 1000000.0 / Lookups : 0.0);
+}
+
+void PathCache::Register(const PathGrid& Grid, int32 EntryIndex)
+{
+	const FEntry& Entry = Entries[EntryIndex];
+	const FIntPoint Start = Grid.GetPosition(Entry.StartCell);
+	int LastBucket = GetBucket(Start.X, Start.Y);
+	Buckets[LastBucket].Add(EntryIndex);
+	PathBytes += sizeof(int32);
+
+	// a path can leave a bucket and come back, it is listed once
+	for (FStepIterator It(Grid, Entry); !It.IsDone(); It.Next())
+	{
+		const int Bucket = GetBucket(It.Cell.X, It.Cell.Y);
+		if (Bucket != LastBucket && !Buckets[Bucket].Contains(EntryIndex))
+		{
+			Buckets[Bucket].Add(EntryIndex);
+			PathBytes += sizeof(int32);
+		}
+		LastBucket = Bucket;
+	}
+}
+
+void PathCache::Unregister(const PathGrid& Grid, int32 EntryIndex)
+{
+	const FEntry& Entry = Entries[EntryIndex];
+	const FIntPoint Start = Grid.GetPosition(Entry.StartCell);
+	int LastBucket = GetBucket(Start.X, Start.Y);
+	PathBytes -= Buckets[LastBucket].RemoveSingleSwap(EntryIndex, false) * sizeof(int32);
+
+	for (FStepIterator It(Grid, Entry); !It.IsDone(); It.Next())
+	{
+		const int Bucket = GetBucket(It.Cell.X, It.Cell.Y);
+		if (Bucket != LastBucket)
+		{
+			PathBytes -= Buckets[Bucket].RemoveSingleSwap(EntryIndex, false) * sizeof(int32);
+		}
+		LastBucket = Bucket;
+	}
+}
+
+void PathCache::Remove(const PathGrid& Grid, int32 EntryIndex)
+{
+	Unregister(Grid, EntryIndex);
+	Unlink(EntryIndex);
+
+	FEntry& Entry = Entries[EntryIndex];
+	PathBytes -= Entry.Moves.GetAllocatedSize();
+	Entry.Moves.Empty();
+	Entry.NumSteps = 0;
+	Entry.StartCell = INDEX_NONE;
+	Entry.GoalCell = INDEX_NONE;
+	FreeEntries.Add(EntryIndex);
+	NumPaths--;
+}
+
+void PathCache::Touch(int32 EntryIndex)
+{
+	Unlink(EntryIndex);
+
+	FEntry& Entry = Entries[EntryIndex];
+	Entry.Older = Newest;
+	if (Newest != INDEX_NONE)
+	{
+		Entries[Newest].Newer = EntryIndex;
+	}
+	Newest = EntryIndex;
+	if (Oldest == INDEX_NONE)
+	{
+		Oldest = EntryIndex;
+	}
+}
+
+void PathCache::Unlink(int32 EntryIndex)
+{
+	FEntry& Entry = Entries[EntryIndex];
+	if (Entry.Newer != INDEX_NONE)
+	{
+		Entries[Entry.Newer].Older = Entry.Older;
+	}
+	else if (Newest == EntryIndex)
+	{
+		Newest = Entry.Older;
+	}
+	if (Entry.Older != INDEX_NONE)
+	{
+		Entries[Entry.Older].Newer = Entry.Newer;
+	}
+	else if (Oldest == EntryIndex)
+	{
+		Oldest = Entry.Newer;
+	}
+	Entry.Newer = INDEX_NONE;
+	Entry.Older = INDEX_NONE;
+}
@@ -0,0 +1,164 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "PathSearch.h"
+
+class PathGrid;
+class OccupancyGrid;
+
+/**
+ * Remembers the paths found for earlier queries, so agents asking the same question again (the replans while another
+ * agent is in the way, agents spawned together heading for the same food) are answered without a search.
+ *
+ * A path is keyed by its start, goal and blocking layers (the layers are what tells agent types apart) and stored
+ * as its start and one 2-bit move per step. A query starting anywhere on a cached path with the same goal and layers
+ * is answered with the rest of that path.
+ *
+ * Cells are grouped in buckets that list the paths going through them, so the paths over a cell are found without
+ * a search of the whole cache. A path is dropped as soon as one of its cells becomes blocked for its layers by
+ * terrain or food. Agents move every step, so they do not drop paths: the cells handed out are checked against the
+ * agent layer instead and the query misses when one is taken. A cell becoming cheaper can shorten paths that never
+ * went near it, but only those costing more than the shortest way from their start to the cell and on to their goal.
+ *
+ * The cache keeps under a memory budget by dropping the least recently used paths
+ */
+class FIT3094_A1_CODE_API PathCache
+{
+
+public:
+
+	// Buckets are BUCKET_SIZE x BUCKET_SIZE cells
+	static const int BUCKET_SHIFT = 3;
+
+	PathCache();
+
+	// Size the buckets for the grid and forget every path
+	void Init(const PathGrid& Grid);
+
+	// Forget every path but keep the buckets
+	void Clear();
+
+	// Forget everything, statistics included
+	void Reset();
+
+	// Most memory the cache may use, 0 turns it off
+	void SetBudget(int64 Bytes);
+	bool IsEnabled() const
+	{
+		return Budget > 0 && Buckets.Num() > 0;
+	}
+
+	// Answer from a cached path going through the start with the query's goal and layers, returns false on a miss
+	bool Find(const PathGrid& Grid, const OccupancyGrid& Occupancy, const FPathQuery& Query, FPathResult& OutResult);
+
+	// Remember the path an engine found, replacing the one cached for the same start, goal and layers
+	void Add(const PathGrid& Grid, const FPathQuery& Query, const FPathResult& Result);
+
+	// The cell became blocked by the layers, drop the paths through it that any of them block
+	void InvalidateCell(const PathGrid& Grid, int X, int Y, uint8 Layers);
+
+	// Cells in the rectangle (corners inclusive) became cheaper, drop the paths a way through one of them could beat
+	void InvalidateCheaper(const PathGrid& Grid, const FIntPoint& Min, const FIntPoint& Max);
+
+	// Memory used, paths and buckets
+	int64 GetAllocatedSize() const;
+
+	int32 GetNumPaths() const
+	{
+		return NumPaths;
+	}
+
+	// Share of the lookups answered from the cache
+	double GetHitRate() const
+	{
+		return Lookups > 0 ? (double)(Hits + SuffixHits) / Lookups : 0.0;
+	}
+
+	// Write the statistics to the log
+	void LogStats() const;
+
+private:
+
+	// One cached path. Free slots have no steps
+	struct FEntry
+	{
+		int32 StartCell = INDEX_NONE;
+		int32 GoalCell = INDEX_NONE;
+		uint8 BlockingLayers = 0;
+		int32 NumSteps = 0;
+		// The cost when found, cells on the path getting cheaper since only lower it
+		int32 Cost = 0;
+		// The moves as bit positions of OccupancyGrid::NEIGHBOUR, 32 to a word
+		TArray<uint64> Moves;
+		// The next more and less recently used paths
+		int32 Newer = INDEX_NONE;
+		int32 Older = INDEX_NONE;
+	};
+
+	// Walks the cells of a path from its start, the start itself is not visited
+	struct FStepIterator
+	{
+		FStepIterator(const PathGrid& Grid, const FEntry& InEntry);
+
+		bool IsDone() const
+		{
+			return Step >= Entry.NumSteps;
+		}
+		void Next();
+
+		const FEntry& Entry;
+		int32 Step;
+		FIntPoint Cell;
+	};
+
+	int GetBucket(int X, int Y) const
+	{
+		return (X >> BUCKET_SHIFT) * NumBucketsY + (Y >> BUCKET_SHIFT);
+	}
+
+	// List the path in (or take it out of) every bucket it goes through
+	void Register(const PathGrid& Grid, int32 EntryIndex);
+	void Unregister(const PathGrid& Grid, int32 EntryIndex);
+
+	// Drop a path and give its slot back
+	void Remove(const PathGrid& Grid, int32 EntryIndex);
+
+	// Move a path to the front of the recently used list, or take it out of the list
+	void Touch(int32 EntryIndex);
+	void Unlink(int32 EntryIndex);
+
+	// Budget in bytes, 0 when the cache is off
+	int64 Budget;
+
+	TArray<FEntry> Entries;
+	TArray<int32> FreeEntries;
+	int32 NumPaths;
+
+	// The ends of the recently used list
+	int32 Newest;
+	int32 Oldest;
+
+	// The paths through the cells of every bucket
+	TArray<TArray<int32>> Buckets;
+	int NumBucketsY;
+
+	// Memory of the moves and bucket lists, kept up to date instead of summing the buckets
+	int64 PathBytes;
+
+	// Scratch for the paths to drop, they cannot be removed while their bucket is being read
+	TArray<int32> Doomed;
+
+	// Statistics
+	int32 Lookups;
+	int32 Hits;
+	int32 SuffixHits;
+	int32 BlockedMisses;
+	int32 Adds;
+	int32 Evictions;
+	int32 Invalidations;
+	int32 Clears;
+	double Seconds;
+
+};
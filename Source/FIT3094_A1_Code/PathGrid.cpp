@@ -0,0 +1,289 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "PathGrid.h"
+#include "FrameArena.h"
+#include "Async/ParallelFor.h"
+#include "HAL/ThreadSafeCounter.h"
+
+PathGrid::PathGrid()
+{
+	SizeX = 0;
+	SizeY = 0;
+	NumChunksX = 0;
+	NumChunksY = 0;
+}
+
+bool PathGrid::Load(const TArray<FString>& MapLines, FThreadSafeCounter* BandsDone)
+{
+	Reset();
+
+	// The header is four lines (type, height, width, map), if it is missing something is horribly wrong
+	if (MapLines.Num() < 4)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("World Array is empty!"));
+		return false;
+	}
+
+	// Second line is Height (aka X value)
+	FString Height = MapLines[1];
+	Height.RemoveFromStart("height ");
+	int NewSizeX = FCString::Atoi(*Height);
+
+	// Third line is Width (aka Y value)
+	FString Width = MapLines[2];
+	Width.RemoveFromStart("width ");
+	int NewSizeY = FCString::Atoi(*Width);
+
+	// the flat cell index has to fit in an int
+	if (NewSizeX <= 0 || NewSizeY <= 0 || (int64)NewSizeX * NewSizeY > MAX_int32)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Invalid map size %d x %d"), NewSizeX, NewSizeY);
+		return false;
+	}
+
+	SizeX = NewSizeX;
+	SizeY = NewSizeY;
+	NumChunksX = (SizeX + CHUNK_MASK) >> CHUNK_SHIFT;
+	NumChunksY = (SizeY + CHUNK_MASK) >> CHUNK_SHIFT;
+	Chunks.SetNum(NumChunksX * NumChunksY);
+
+	// Bands only write their own chunks, so they can be parsed at the same time
+	ParallelFor(NumChunksX, [this, &MapLines, BandsDone](int32 ChunkX)
+	{
+		LoadBand(MapLines, ChunkX);
+		if (BandsDone)
+		{
+			BandsDone->Increment();
+		}
+	});
+	return true;
+}
+
+void PathGrid::LoadBand(const TArray<FString>& MapLines, int ChunkX)
+{
+	// Only a band is ever held at full size, in the frame arena of the worker parsing it.
+	// Cells the file does not cover (and the padding of the last chunks) are walls
+	FrameArena::FMark Mark;
+	TArray<uint8, TFrameArenaAllocator<>> BandTypes;
+	BandTypes.Init((uint8)GridNode::Wall, CHUNK_SIZE * NumChunksY * CHUNK_SIZE);
+
+	// After removing top 4 lines this is the map itself, ignoring anything outside the declared size
+	for (int LocalX = 0; LocalX < CHUNK_SIZE; LocalX++)
+	{
+		const int LineNum = (ChunkX << CHUNK_SHIFT) + LocalX + 4;
+		if (LineNum - 4 >= SizeX || LineNum >= MapLines.Num())
+		{
+			break;
+		}
+
+		const FString& Line = MapLines[LineNum];
+		const int Columns = FMath::Min(Line.Len(), SizeY);
+		uint8* Row = &BandTypes[LocalX * NumChunksY * CHUNK_SIZE];
+		for (int CharNum = 0; CharNum < Columns; CharNum++)
+		{
+			Row[CharNum] = (uint8)GetTypeFromChar(Line[CharNum]);
+		}
+	}
+
+	for (int ChunkY = 0; ChunkY < NumChunksY; ChunkY++)
+	{
+		BuildChunk(ChunkX, ChunkY, BandTypes.GetData());
+	}
+}
+
+void PathGrid::Reset()
+{
+	SizeX = 0;
+	SizeY = 0;
+	NumChunksX = 0;
+	NumChunksY = 0;
+	Chunks.Empty();
+}
+
+void PathGrid::CopyTerrain(const PathGrid& Other)
+{
+	SizeX = Other.SizeX;
+	SizeY = Other.SizeY;
+	NumChunksX = Other.NumChunksX;
+	NumChunksY = Other.NumChunksY;
+
+	Chunks.Reset();
+	Chunks.SetNum(Other.Chunks.Num());
+	for (int Index = 0; Index < Chunks.Num(); Index++)
+	{
+		Chunks[Index].UniformType = Other.Chunks[Index].UniformType;
+		Chunks[Index].Types = Other.Chunks[Index].Types;
+	}
+}
+
+int64 PathGrid::GetTerrainSize() const
+{
+	int64 Size = Chunks.GetAllocatedSize();
+	for (const FChunk& Chunk : Chunks)
+	{
+		Size += Chunk.Types.GetAllocatedSize();
+	}
+	return Size;
+}
+
+// Characters as defined from the map file
+GridNode::GRID_TYPE PathGrid::GetTypeFromChar(TCHAR Char)
+{
+	switch (Char)
+	{
+		case '.':
+		case 'G':
+			return GridNode::Open;
+		case '@':
+		case 'O':
+			return GridNode::Wall;
+		case 'T':
+			return GridNode::Forest;
+		case 'S':
+			return GridNode::Swamp;
+		case 'W':
+			return GridNode::Water;
+		default:
+			return GridNode::Open;
+	}
+}
+
+void PathGrid::BuildChunk(int ChunkX, int ChunkY, const uint8* BandTypes)
+{
+	FChunk& Chunk = Chunks[GetChunkIndex(ChunkX, ChunkY)];
+	const int BandWidth = NumChunksY * CHUNK_SIZE;
+	const uint8* First = &BandTypes[ChunkY << CHUNK_SHIFT];
+
+	bool bUniform = true;
+	for (int LocalX = 0; LocalX < CHUNK_SIZE && bUniform; LocalX++)
+	{
+		const uint8* Row = First + LocalX * BandWidth;
+		for (int LocalY = 0; LocalY < CHUNK_SIZE; LocalY++)
+		{
+			if (Row[LocalY] != First[0])
+			{
+				bUniform = false;
+				break;
+			}
+		}
+	}
+
+	Chunk.UniformType = (GridNode::GRID_TYPE)First[0];
+	if (bUniform)
+	{
+		return;
+	}
+
+	Chunk.Types.SetNumUninitialized(CHUNK_SIZE * CHUNK_SIZE);
+	for (int LocalX = 0; LocalX < CHUNK_SIZE; LocalX++)
+	{
+		FMemory::Memcpy(&Chunk.Types[LocalX << CHUNK_SHIFT], First + LocalX * BandWidth, CHUNK_SIZE);
+	}
+}
+
+// Generates the nodes used for pathfinding and also for placement of objects in the game world
+void PathGrid::CreateChunkNodes(int ChunkX, int ChunkY)
+{
+	FChunk& Chunk = Chunks[GetChunkIndex(ChunkX, ChunkY)];
+	Chunk.Nodes.SetNum(CHUNK_SIZE * CHUNK_SIZE);
+
+	for (int LocalX = 0; LocalX < CHUNK_SIZE; LocalX++)
+	{
+		for (int LocalY = 0; LocalY < CHUNK_SIZE; LocalY++)
+		{
+			const int Cell = (LocalX << CHUNK_SHIFT) | LocalY;
+			GridNode& Node = Chunk.Nodes[Cell];
+			Node.X = (ChunkX << CHUNK_SHIFT) + LocalX;
+			Node.Y = (ChunkY << CHUNK_SHIFT) + LocalY;
+			Node.GridType = Chunk.Types.Num() == 0 ? Chunk.UniformType : (GridNode::GRID_TYPE)Chunk.Types[Cell];
+		}
+	}
+}
+
+bool PathGrid::IsChunkUniform(int ChunkX, int ChunkY, GridNode::GRID_TYPE& OutType) const
+{
+	const FChunk& Chunk = Chunks[GetChunkIndex(ChunkX, ChunkY)];
+	OutType = Chunk.UniformType;
+	return Chunk.Types.Num() == 0;
+}
+
+bool PathGrid::SetType(int X, int Y, GridNode::GRID_TYPE Type)
+{
+	FChunk& Chunk = Chunks[GetChunkIndex(X >> CHUNK_SHIFT, Y >> CHUNK_SHIFT)];
+	if (Chunk.Types.Num() == 0)
+	{
+		if (Chunk.UniformType == Type)
+		{
+			return false;
+		}
+		Chunk.Types.Init((uint8)Chunk.UniformType, CHUNK_SIZE * CHUNK_SIZE);
+	}
+
+	const int Cell = GetCellInChunk(X, Y);
+	if (Chunk.Types[Cell] == (uint8)Type)
+	{
+		return false;
+	}
+	Chunk.Types[Cell] = (uint8)Type;
+
+	// pointers to the node stay valid, only its type changes
+	if (Chunk.Nodes.Num() > 0)
+	{
+		Chunk.Nodes[Cell].GridType = Type;
+	}
+	return true;
+}
+
+void PathGrid::CompactChunk(int ChunkX, int ChunkY)
+{
+	FChunk& Chunk = Chunks[GetChunkIndex(ChunkX, ChunkY)];
+	if (Chunk.Types.Num() == 0)
+	{
+		return;
+	}
+
+	for (uint8 Type : Chunk.Types)
+	{
+		if (Type != Chunk.Types[0])
+		{
+			return;
+		}
+	}
+
+	Chunk.UniformType = (GridNode::GRID_TYPE)Chunk.Types[0];
+	Chunk.Types.Empty();
+}
+
+TCHAR PathGrid::GetCharFromType(GridNode::GRID_TYPE Type)
+{
+	switch (Type)
+	{
+		case GridNode::Wall:
+			return '@';
+		case GridNode::Forest:
+			return 'T';
+		case GridNode::Swamp:
+			return 'S';
+		case GridNode::Water:
+			return 'W';
+		case GridNode::Open:
+		default:
+			return '.';
+	}
+}
+
+// Reset all node values (F, G, H & Parent)
+void PathGrid::ResetAllNodes()
+{
+	for (FChunk& Chunk : Chunks)
+	{
+		for (GridNode& Node : Chunk.Nodes)
+		{
+			Node.F = 0;
+			Node.G = 0;
+			Node.H = 0;
+			Node.Parent = nullptr;
+		}
+	}
+}
@@ -0,0 +1,172 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GridNode.h"
+
+class FThreadSafeCounter;
+
+// A cell and the terrain it is changed to
+typedef TPair<FIntPoint, GridNode::GRID_TYPE> FTerrainEdit;
+
+/**
+ * The grid of nodes built from a map file, sized to the map instead of a fixed maximum.
+ *
+ * The map is split into square chunks. A chunk where every cell has the same type (all wall, all open...)
+ * only stores that type, the others store one byte per cell. Nodes are only created for a chunk
+ * the first time one of its nodes is asked for, so large maps only pay for the cells that are used
+ */
+class FIT3094_A1_CODE_API PathGrid
+{
+
+public:
+
+	// Chunks are CHUNK_SIZE x CHUNK_SIZE cells
+	static const int CHUNK_SHIFT = 5;
+	static const int CHUNK_SIZE = 1 << CHUNK_SHIFT;
+	static const int CHUNK_MASK = CHUNK_SIZE - 1;
+
+	PathGrid();
+
+	// Parse the lines of a map file and build the chunks, returns false if the file is malformed.
+	// Bands of chunks are parsed in parallel, BandsDone (when given) counts the finished ones for progress reports
+	bool Load(const TArray<FString>& MapLines, FThreadSafeCounter* BandsDone = nullptr);
+
+	// Throw away the current map
+	void Reset();
+
+	// Take the terrain of another grid, without any of its nodes
+	void CopyTerrain(const PathGrid& Other);
+	// Memory used by the terrain, the nodes not counted
+	int64 GetTerrainSize() const;
+
+	// Reset all node values (F, G, H & Parent)
+	void ResetAllNodes();
+
+	// Is the position inside the map
+	bool IsInside(int X, int Y) const
+	{
+		return X >= 0 && Y >= 0 && X < SizeX && Y < SizeY;
+	}
+
+	// The flat index of a position, used to key per-cell data
+	int GetIndex(int X, int Y) const
+	{
+		return X * SizeY + Y;
+	}
+
+	// The position of a flat index
+	FIntPoint GetPosition(int Index) const
+	{
+		return FIntPoint(Index / SizeY, Index % SizeY);
+	}
+
+	// Number of cells in the map
+	int GetNumCells() const
+	{
+		return SizeX * SizeY;
+	}
+
+	// The terrain at a position, the position must be inside the map. Does not create any node
+	GridNode::GRID_TYPE GetType(int X, int Y) const
+	{
+		const FChunk& Chunk = Chunks[GetChunkIndex(X >> CHUNK_SHIFT, Y >> CHUNK_SHIFT)];
+		if (Chunk.Types.Num() == 0)
+		{
+			return Chunk.UniformType;
+		}
+		return (GridNode::GRID_TYPE)Chunk.Types[GetCellInChunk(X, Y)];
+	}
+
+	// The cost of entering a position
+	float GetTravelCost(int X, int Y) const
+	{
+		return GridNode::GetTravelCost(GetType(X, Y));
+	}
+
+	// Get the node at a position, the position must be inside the map. Creates the nodes of its chunk if needed
+	GridNode* GetNode(int X, int Y)
+	{
+		FChunk& Chunk = Chunks[GetChunkIndex(X >> CHUNK_SHIFT, Y >> CHUNK_SHIFT)];
+		if (Chunk.Nodes.Num() == 0)
+		{
+			CreateChunkNodes(X >> CHUNK_SHIFT, Y >> CHUNK_SHIFT);
+		}
+		return &Chunk.Nodes[GetCellInChunk(X, Y)];
+	}
+
+	// Number of chunks along each axis
+	int GetNumChunksX() const
+	{
+		return NumChunksX;
+	}
+	int GetNumChunksY() const
+	{
+		return NumChunksY;
+	}
+
+	// Does every cell of the chunk have the same type, and which one
+	bool IsChunkUniform(int ChunkX, int ChunkY, GridNode::GRID_TYPE& OutType) const;
+
+	// Change the terrain at a position inside the map, returns false when it already was of that type.
+	// A uniform chunk gets per-cell types first, nodes that exist are updated in place
+	bool SetType(int X, int Y, GridNode::GRID_TYPE Type);
+	// Drop the per-cell types of a chunk whose cells all have the same type (again), after edits
+	void CompactChunk(int ChunkX, int ChunkY);
+
+	// The character standing for a terrain type in a map file
+	static TCHAR GetCharFromType(GridNode::GRID_TYPE Type);
+
+	// Size of the map (X is the height, Y is the width, as in the map file)
+	int SizeX;
+	int SizeY;
+
+private:
+
+	struct FChunk
+	{
+		// The type of every cell when Types is empty
+		GridNode::GRID_TYPE UniformType;
+
+		// One GRID_TYPE per cell, only for chunks with mixed terrain
+		TArray<uint8> Types;
+
+		// The nodes of the chunk, created on first use and never resized after so node pointers stay valid
+		TArray<GridNode> Nodes;
+
+		FChunk()
+			: UniformType(GridNode::Wall)
+		{
+		}
+	};
+
+	int GetChunkIndex(int ChunkX, int ChunkY) const
+	{
+		return ChunkX * NumChunksY + ChunkY;
+	}
+
+	static int GetCellInChunk(int X, int Y)
+	{
+		return ((X & CHUNK_MASK) << CHUNK_SHIFT) | (Y & CHUNK_MASK);
+	}
+
+	// The terrain a character of the map file stands for
+	static GridNode::GRID_TYPE GetTypeFromChar(TCHAR Char);
+
+	// Parse the CHUNK_SIZE rows of one band of chunks and build its chunks
+	void LoadBand(const TArray<FString>& MapLines, int ChunkX);
+
+	// Store one chunk from a band of CHUNK_SIZE parsed rows, dropping the per-cell types if they are all the same
+	void BuildChunk(int ChunkX, int ChunkY, const uint8* BandTypes);
+
+	// Generates the nodes of a chunk from its terrain
+	void CreateChunkNodes(int ChunkX, int ChunkY);
+
+	int NumChunksX;
+	int NumChunksY;
+
+	// All chunks, never resized after loading
+	TArray<FChunk> Chunks;
+
+};
@@ -0,0 +1,587 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "PathKernelBench.h"
+#include "AStarEngine.h"
+#include "CountingMalloc.h"
+#include "OccupancyGrid.h"
+#include "PathGrid.h"
+#include "PathSearch.h"
+#include "RoomGraph.h"
+#include "SubgoalGraph.h"
+#include "HAL/PlatformTime.h"
+#include "Math/RandomStream.h"
+#include "Misc/App.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+#if PLATFORM_LINUX
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	// The last level cache misses of this thread, from the hardware counters when the kernel lets us open them
+	class FCacheMissCounter
+	{
+	public:
+
+		FCacheMissCounter()
+			: Descriptor(-1)
+		{
+#if PLATFORM_LINUX
+			perf_event_attr Attributes;
+			FMemory::Memzero(Attributes);
+			Attributes.type = PERF_TYPE_HARDWARE;
+			Attributes.size = sizeof(Attributes);
+			Attributes.config = PERF_COUNT_HW_CACHE_MISSES;
+			Attributes.disabled = 1;
+			Attributes.exclude_kernel = 1;
+			Attributes.exclude_hv = 1;
+			Descriptor = (int32)syscall(__NR_perf_event_open, &Attributes, 0, -1, -1, 0);
+#endif
+		}
+
+		~FCacheMissCounter()
+		{
+#if PLATFORM_LINUX
+			if (Descriptor >= 0)
+			{
+				close(Descriptor);
+			}
+#endif
+		}
+
+		void Start()
+		{
+#if PLATFORM_LINUX
+			if (Descriptor >= 0)
+			{
+				ioctl(Descriptor, PERF_EVENT_IOC_RESET, 0);
+				ioctl(Descriptor, PERF_EVENT_IOC_ENABLE, 0);
+			}
+#endif
+		}
+
+		// The misses since Start, -1 when there is no counter
+		int64 Stop()
+		{
+#if PLATFORM_LINUX
+			uint64 Misses = 0;
+			if (Descriptor >= 0 && ioctl(Descriptor, PERF_EVENT_IOC_DISABLE, 0) == 0 && read(Descriptor, &Misses, sizeof(Misses)) == sizeof(Misses))
+			{
+				return (int64)Misses;
+			}
+#endif
+			return -1;
+		}
+
+	private:
+
+		int32 Descriptor;
+	};
+
+	// One pass of a kernel over its working set, returning the operations done
+	struct FKernel
+	{
+		FString Name;
+		TFunction<int64()> Pass;
+		// Nodes a search kernel expands per query, negative for the other kernels
+		double ExpansionsPerOp = -1.0;
+	};
+
+	// Results are written here so the compiler cannot drop the work of a pass
+	volatile uint64 Sink = 0;
+
+	double Median(TArray<double>& Values)
+	{
+		Values.Sort();
+		const int32 Middle = Values.Num() / 2;
+		return Values.Num() % 2 ? Values[Middle] : (Values[Middle - 1] + Values[Middle]) * 0.5;
+	}
+
+	// Time the kernel over the samples, the batch of passes in a sample growing until it is long enough for the clock
+	void TimeKernel(const FKernel& Kernel, const PathKernelBench::FSettings& Settings, PathKernelBench::FResult& OutResult)
+	{
+		OutResult.Kernel = Kernel.Name;
+		OutResult.ExpansionsPerOp = Kernel.ExpansionsPerOp;
+		OutResult.OpsPerPass = FMath::Max<int64>(1, Kernel.Pass());
+
+		int64 Passes = 1;
+		auto RunBatch = [&Kernel, &Passes]()
+		{
+			const double StartTime = FPlatformTime::Seconds();
+			for (int64 Pass = 0; Pass < Passes; Pass++)
+			{
+				Kernel.Pass();
+			}
+			return FPlatformTime::Seconds() - StartTime;
+		};
+		while (RunBatch() < Settings.MinSampleSeconds && Passes < (1 << 24))
+		{
+			Passes *= 2;
+		}
+		for (int32 Sample = 0; Sample < Settings.WarmupSamples; Sample++)
+		{
+			RunBatch();
+		}
+
+		// the counters cover the timed samples only. The allocation counter outlives the run, as CountingMalloc needs
+		static CountingMalloc Allocations;
+		FCacheMissCounter CacheMisses;
+		TArray<double> NsPerOp;
+		NsPerOp.Reserve(Settings.Samples);
+
+		Allocations.Install();
+		CacheMisses.Start();
+		const int32 NumSamples = FMath::Max(1, Settings.Samples);
+		for (int32 Sample = 0; Sample < NumSamples; Sample++)
+		{
+			NsPerOp.Add(RunBatch() * 1e9 / (Passes * OutResult.OpsPerPass));
+		}
+		const int64 Misses = CacheMisses.Stop();
+		Allocations.Uninstall();
+
+		// the samples array was reserved before counting, it does not allocate in between
+		OutResult.Samples = NumSamples;
+		OutResult.TotalOps = NumSamples * Passes * OutResult.OpsPerPass;
+		OutResult.CacheMissesPerOp = Misses >= 0 ? (double)Misses / OutResult.TotalOps : -1.0;
+		OutResult.AllocsPerOp = (double)Allocations.GetNumAllocs() / OutResult.TotalOps;
+		OutResult.AllocBytesPerOp = (double)Allocations.GetNumBytes() / OutResult.TotalOps;
+
+		double Sum = 0.0;
+		for (const double Value : NsPerOp)
+		{
+			Sum += Value;
+		}
+		OutResult.MeanNs = Sum / NsPerOp.Num();
+		OutResult.MedianNs = Median(NsPerOp);
+		OutResult.MinNs = NsPerOp[0];
+		OutResult.MaxNs = NsPerOp.Last();
+
+		TArray<double> Deviations;
+		for (const double Value : NsPerOp)
+		{
+			Deviations.Add(FMath::Abs(Value - OutResult.MedianNs));
+		}
+		OutResult.MadNs = Median(Deviations);
+	}
+
+	// A number for the JSON, null when the counter was not available
+	FString JsonNumber(double Value)
+	{
+		return Value < 0.0 ? FString(TEXT("null")) : FString::Printf(TEXT("%.4f"), Value);
+	}
+}
+
+void PathKernelBench::GetKernelNames(TArray<FString>& OutNames)
+{
+	OutNames = { TEXT("MapParse"), TEXT("RoomBuild"), TEXT("SubgoalBuild"), TEXT("TravelCost"), TEXT("NodeAvailability"), TEXT("Distance"), TEXT("NeighbourExpansion"), TEXT("OpenListPushPop"), TEXT("PathReconstruction") };
+
+	TArray<TUniquePtr<PathSearchEngine>> Engines;
+	PathSearchEngine::CreateEngines(Engines);
+	for (const TUniquePtr<PathSearchEngine>& Engine : Engines)
+	{
+		OutNames.Add(TEXT("FindPath.") + Engine->GetName().ToString());
+	}
+	for (const TUniquePtr<PathSearchEngine>& Engine : Engines)
+	{
+		if (Engine->CanPruneRooms())
+		{
+			OutNames.Add(TEXT("FindPath.") + Engine->GetName().ToString() + TEXT(".Rooms"));
+		}
+	}
+}
+
+bool PathKernelBench::RunMap(const FString& MapFile, const FSettings& Settings, TArray<FResult>& OutResults)
+{
+	FString MapText;
+	if (!FFileHelper::LoadFileToString(MapText, *MapFile))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Cannot read map %s"), *MapFile);
+		return false;
+	}
+	TArray<FString> MapLines;
+	MapText.ParseIntoArrayLines(MapLines);
+
+	PathGrid Grid;
+	if (!Grid.Load(MapLines))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Map %s is malformed"), *MapFile);
+		return false;
+	}
+
+	// a crowd like the level generator spawns, agents on a few cells and food of both kinds on fewer
+	FRandomStream Random(Settings.Seed);
+	OccupancyGrid Occupancy;
+	Occupancy.Init(Grid);
+	const uint8 WallLayers = OccupancyGrid::LayerMask(OccupancyGrid::Walls);
+	TArray<int32> OpenCells;
+	for (int32 Cell = 0; Cell < Grid.GetNumCells(); Cell++)
+	{
+		const FIntPoint Position = Grid.GetPosition(Cell);
+		if (!Occupancy.IsBlocked(Position.X, Position.Y, WallLayers))
+		{
+			OpenCells.Add(Cell);
+		}
+	}
+	if (OpenCells.Num() < 2)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Map %s has no open cells to benchmark on"), *MapFile);
+		return false;
+	}
+	for (const int32 Cell : OpenCells)
+	{
+		const FIntPoint Position = Grid.GetPosition(Cell);
+		const float Roll = Random.GetFraction();
+		if (Roll < 0.05f)
+		{
+			Occupancy.Set(Position.X, Position.Y, OccupancyGrid::Agents);
+		}
+		else if (Roll < 0.06f)
+		{
+			Occupancy.Set(Position.X, Position.Y, OccupancyGrid::Meat);
+		}
+		else if (Roll < 0.07f)
+		{
+			Occupancy.Set(Position.X, Position.Y, OccupancyGrid::Vegetation);
+		}
+	}
+
+	// searched for by a herbivore, which meat blocks
+	const uint8 BlockingLayers = WallLayers | OccupancyGrid::LayerMask(OccupancyGrid::Agents) | OccupancyGrid::LayerMask(OccupancyGrid::Meat);
+
+	// the working sets, cells anywhere on the map for the lookups and open cells for the searches
+	TArray<FIntPoint> Cells;
+	for (int32 Index = 0; Index < Settings.NumCells; Index++)
+	{
+		Cells.Add(FIntPoint(Random.RandRange(0, Grid.SizeX - 1), Random.RandRange(0, Grid.SizeY - 1)));
+	}
+	TArray<FIntPoint> OpenPositions;
+	for (int32 Index = 0; Index < Settings.NumCells; Index++)
+	{
+		OpenPositions.Add(Grid.GetPosition(OpenCells[Random.RandRange(0, OpenCells.Num() - 1)]));
+	}
+
+	// queries that have a path, the longest one is rebuilt by the reconstruction kernel
+	AStarEngine Reference;
+	TArray<FPathQuery> Queries;
+	FPathResult Longest;
+	FPathQuery LongestQuery;
+	for (int32 Attempt = 0; Attempt < Settings.NumQueries * 4 && Queries.Num() < Settings.NumQueries; Attempt++)
+	{
+		FPathQuery Query;
+		Query.Start = Grid.GetPosition(OpenCells[Random.RandRange(0, OpenCells.Num() - 1)]);
+		Query.Goal = Grid.GetPosition(OpenCells[Random.RandRange(0, OpenCells.Num() - 1)]);
+		Query.BlockingLayers = BlockingLayers;
+		if (Query.Start == Query.Goal || Occupancy.IsBlocked(Query.Start.X, Query.Start.Y, BlockingLayers) || Occupancy.IsBlocked(Query.Goal.X, Query.Goal.Y, BlockingLayers))
+		{
+			continue;
+		}
+
+		FPathResult Result;
+		if (Reference.FindPath(Grid, Occupancy, Query, Result))
+		{
+			Queries.Add(Query);
+			if (Result.Path.Num() > Longest.Path.Num())
+			{
+				Longest = Result;
+				LongestQuery = Query;
+			}
+		}
+	}
+
+	// the parents of the longest path, as a search leaves them
+	SearchSpace PathSpace;
+	PathSpace.Prepare(Grid.GetNumCells());
+	int32 Previous = Grid.GetIndex(LongestQuery.Start.X, LongestQuery.Start.Y);
+	PathSpace.Visit(Previous, 0, INDEX_NONE);
+	for (const FIntPoint& Cell : Longest.Path)
+	{
+		const int32 Next = Grid.GetIndex(Cell.X, Cell.Y);
+		PathSpace.Visit(Next, PathSpace.GetG(Previous) + (int32)Grid.GetTravelCost(Cell.X, Cell.Y), Previous);
+		Previous = Next;
+	}
+	const int32 LongestGoal = Previous;
+
+	// open list entries keyed as a search towards one goal would key them
+	TArray<FOpenEntry> Entries;
+	for (const FIntPoint& Position : OpenPositions)
+	{
+		const int32 G = Random.RandRange(0, Grid.SizeX + Grid.SizeY);
+		Entries.Add(FOpenEntry(G + PathSearchEngine::Heuristic(Position.X, Position.Y, OpenPositions[0]), G, Grid.GetIndex(Position.X, Position.Y)));
+	}
+
+	TArray<FKernel> Kernels;
+
+	// what loading a map file costs before any agent spawns, parsing the lines and filling the grid and its walls
+	Kernels.Add({ TEXT("MapParse"), [&MapText]()
+	{
+		TArray<FString> Lines;
+		MapText.ParseIntoArrayLines(Lines);
+		PathGrid ParsedGrid;
+		ParsedGrid.Load(Lines);
+		OccupancyGrid ParsedOccupancy;
+		ParsedOccupancy.Init(ParsedGrid);
+		Sink = Sink + ParsedGrid.GetNumCells();
+		return (int64)1;
+	} });
+
+	// decomposing the map into rooms, once per load on the maps pruning dead ends
+	RoomGraph Rooms;
+	const int32 MaxDoorwayWidth = Settings.MaxDoorwayWidth;
+	Kernels.Add({ TEXT("RoomBuild"), [&Grid, &Rooms, MaxDoorwayWidth]()
+	{
+		Rooms.Build(Grid, MaxDoorwayWidth);
+		Sink = Sink + Rooms.GetNumRooms();
+		return (int64)1;
+	} });
+
+	// finding the subgoals and linking them, once per load on the maps searched over the graph
+	SubgoalGraph Subgoals;
+	Kernels.Add({ TEXT("SubgoalBuild"), [&Grid, &Subgoals]()
+	{
+		Subgoals.Build(Grid);
+		Sink = Sink + Subgoals.GetNumLinks();
+		return (int64)1;
+	} });
+
+	Kernels.Add({ TEXT("TravelCost"), [&Grid, &Cells]()
+	{
+		float Sum = 0.f;
+		for (const FIntPoint& Cell : Cells)
+		{
+			Sum += Grid.GetTravelCost(Cell.X, Cell.Y);
+		}
+		Sink = Sink + (uint64)Sum;
+		return (int64)Cells.Num();
+	} });
+
+	// what AAgent::CheckNodeAvailablity comes down to
+	Kernels.Add({ TEXT("NodeAvailability"), [&Occupancy, &Cells, BlockingLayers]()
+	{
+		uint64 Available = 0;
+		for (const FIntPoint& Cell : Cells)
+		{
+			Available += Occupancy.IsBlocked(Cell.X, Cell.Y, BlockingLayers) ? 0 : 1;
+		}
+		Sink = Sink + Available;
+		return (int64)Cells.Num();
+	} });
+
+	// the heuristic, the same distance as UPathfindingSubsystem::CalculateDistanceBetween
+	Kernels.Add({ TEXT("Distance"), [&Cells]()
+	{
+		float Sum = 0.f;
+		for (int32 Index = 1; Index < Cells.Num(); Index++)
+		{
+			Sum += PathSearchEngine::Heuristic(Cells[Index].X, Cells[Index].Y, Cells[Index - 1]);
+		}
+		Sink = Sink + (uint64)Sum;
+		return (int64)Cells.Num() - 1;
+	} });
+
+	// the inner loop of A*, the moves out of a cell to the neighbours not yet closed, without the open list
+	SearchSpace ExpansionSpace;
+	Kernels.Add({ TEXT("NeighbourExpansion"), [&Grid, &Occupancy, &OpenPositions, &ExpansionSpace, BlockingLayers]()
+	{
+		ExpansionSpace.Prepare(Grid.GetNumCells());
+		uint64 Visits = 0;
+		for (const FIntPoint& Position : OpenPositions)
+		{
+			const int32 Cell = Grid.GetIndex(Position.X, Position.Y);
+			ExpansionSpace.Close(Cell);
+			const uint8 Available = Occupancy.GetPassableNeighbours(Position.X, Position.Y, BlockingLayers);
+			for (int Direction = 0; Direction < 4; Direction++)
+			{
+				if (!(Available & (1 << Direction)))
+				{
+					continue;
+				}
+				const int NextX = Position.X + PathSearchEngine::NeighbourOffsets[Direction].X;
+				const int NextY = Position.Y + PathSearchEngine::NeighbourOffsets[Direction].Y;
+				const int Next = Grid.GetIndex(NextX, NextY);
+				if (ExpansionSpace.IsClosed(Next))
+				{
+					continue;
+				}
+				const int32 PossibleG = (int32)Grid.GetTravelCost(NextX, NextY);
+				if (!ExpansionSpace.IsSeen(Next) || PossibleG < ExpansionSpace.GetG(Next))
+				{
+					ExpansionSpace.Visit(Next, PossibleG, Cell);
+					Visits++;
+				}
+			}
+		}
+		Sink = Sink + Visits;
+		return (int64)OpenPositions.Num();
+	} });
+
+	// a push and a pop of every entry, the list kept between passes so its memory is reused as in the engines
+	TArray<FOpenEntry> OpenList;
+	Kernels.Add({ TEXT("OpenListPushPop"), [&Entries, &OpenList]()
+	{
+		OpenList.Reset();
+		for (const FOpenEntry& Entry : Entries)
+		{
+			OpenList.HeapPush(Entry, FOpenEntryPredicate());
+		}
+		uint64 Sum = 0;
+		FOpenEntry Popped;
+		while (OpenList.Num() > 0)
+		{
+			OpenList.HeapPop(Popped, FOpenEntryPredicate(), false);
+			Sum += Popped.Cell;
+		}
+		Sink = Sink + Sum;
+		return (int64)Entries.Num();
+	} });
+
+	// walking the parents back from the goal and turning the cells into nodes, as AAgent::GeneratePath does
+	FPathResult Rebuilt;
+	TArray<GridNode*> Nodes;
+	Kernels.Add({ TEXT("PathReconstruction"), [&Grid, &PathSpace, &Rebuilt, &Nodes, LongestGoal]()
+	{
+		Rebuilt.Reset();
+		PathSearchEngine::BuildPath(Grid, PathSpace, LongestGoal, Rebuilt);
+		Nodes.Reset();
+		Nodes.Reserve(Rebuilt.Path.Num());
+		for (const FIntPoint& Cell : Rebuilt.Path)
+		{
+			Nodes.Add(Grid.GetNode(Cell.X, Cell.Y));
+		}
+		Sink = Sink + Nodes.Num();
+		return (int64)FMath::Max(1, Rebuilt.Path.Num());
+	} });
+
+	// whole searches, for the share of each operation in them, and then again skipping the dead-end rooms
+	Rooms.Build(Grid, MaxDoorwayWidth);
+	TArray<TUniquePtr<PathSearchEngine>> Engines;
+	TArray<TUniquePtr<PathSearchEngine>> RoomEngines;
+	PathSearchEngine::CreateEngines(Engines);
+	PathSearchEngine::CreateEngines(RoomEngines);
+	for (const TUniquePtr<PathSearchEngine>& Engine : RoomEngines)
+	{
+		Engine->SetRooms(&Rooms);
+	}
+	Subgoals.Build(Grid);
+	for (const TUniquePtr<PathSearchEngine>& Engine : Engines)
+	{
+		Engine->SetSubgoals(&Subgoals);
+	}
+	FPathResult SearchResult;
+	FPathResult PlainResult;
+	auto AddSearchKernel = [&Kernels, &Grid, &Occupancy, &Queries, &SearchResult, &PlainResult, &Reference, &MapFile](PathSearchEngine* Engine, bool bRooms)
+	{
+		// the expansions of one pass, checking on the way that pruning and the subgoal graph never change the cost of a path
+		int64 Expansions = 0;
+		for (const FPathQuery& Query : Queries)
+		{
+			Engine->FindPath(Grid, Occupancy, Query, SearchResult);
+			Expansions += SearchResult.Expansions;
+			if ((bRooms || Engine->CanUseSubgoals()) && Reference.FindPath(Grid, Occupancy, Query, PlainResult) && (!SearchResult.bFound || SearchResult.Cost != PlainResult.Cost))
+			{
+				UE_LOG(LogTemp, Warning, TEXT("%s: %s%s found the path from (%d, %d) to (%d, %d) at cost %d instead of %d"), *FPaths::GetBaseFilename(MapFile),
+					*Engine->GetName().ToString(), bRooms ? TEXT(" with rooms") : TEXT(""), Query.Start.X, Query.Start.Y, Query.Goal.X, Query.Goal.Y, SearchResult.bFound ? SearchResult.Cost : -1, PlainResult.Cost);
+			}
+		}
+
+		FKernel& Kernel = Kernels.Add_GetRef({ TEXT("FindPath.") + Engine->GetName().ToString() + (bRooms ? TEXT(".Rooms") : TEXT("")), [&Grid, &Occupancy, &Queries, &SearchResult, Engine]()
+		{
+			for (const FPathQuery& Query : Queries)
+			{
+				Engine->FindPath(Grid, Occupancy, Query, SearchResult);
+				Sink = Sink + SearchResult.Cost;
+			}
+			return (int64)FMath::Max(1, Queries.Num());
+		} });
+		Kernel.ExpansionsPerOp = (double)Expansions / FMath::Max(1, Queries.Num());
+	};
+	for (const TUniquePtr<PathSearchEngine>& Engine : Engines)
+	{
+		AddSearchKernel(Engine.Get(), false);
+	}
+	for (const TUniquePtr<PathSearchEngine>& Engine : RoomEngines)
+	{
+		if (Engine->CanPruneRooms())
+		{
+			AddSearchKernel(Engine.Get(), true);
+		}
+	}
+
+	const FString MapName = FPaths::GetBaseFilename(MapFile);
+	UE_LOG(LogTemp, Display, TEXT("%s: %d rooms (largest %d cells), %d doorways"), *MapName, Rooms.GetNumRooms(), Rooms.LargestRoom, Rooms.GetNumDoorways());
+	UE_LOG(LogTemp, Display, TEXT("%s: %d subgoals (of %d cells), %d links"), *MapName, Subgoals.GetNumSubgoals(), Grid.GetNumCells(), Subgoals.GetNumLinks());
+	const int32 FirstResult = OutResults.Num();
+	for (const FKernel& Kernel : Kernels)
+	{
+		if (Settings.Kernels.Num() > 0 && !Settings.Kernels.Contains(Kernel.Name))
+		{
+			continue;
+		}
+		if (Kernel.Name.StartsWith(TEXT("FindPath.")) && Queries.Num() == 0)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("%s: no query has a path, %s is skipped"), *MapName, *Kernel.Name);
+			continue;
+		}
+
+		FResult& Result = OutResults.AddDefaulted_GetRef();
+		Result.Map = MapName;
+		TimeKernel(Kernel, Settings, Result);
+	}
+
+	// how much faster the graph answers than searching the grid, when both ran
+	const FResult* GridSearch = nullptr;
+	const FResult* GraphSearch = nullptr;
+	for (int32 Index = FirstResult; Index < OutResults.Num(); Index++)
+	{
+		if (OutResults[Index].Kernel == TEXT("FindPath.AStar"))
+		{
+			GridSearch = &OutResults[Index];
+		}
+		else if (OutResults[Index].Kernel == TEXT("FindPath.Subgoal"))
+		{
+			GraphSearch = &OutResults[Index];
+		}
+	}
+	if (GridSearch && GraphSearch && GraphSearch->MedianNs > 0.0)
+	{
+		UE_LOG(LogTemp, Display, TEXT("%s: FindPath.Subgoal %.2fx the speed of FindPath.AStar"), *MapName, GridSearch->MedianNs / GraphSearch->MedianNs);
+	}
+	return true;
+}
+
+FString PathKernelBench::ToJson(const FSettings& Settings, const TArray<FResult>& Results)
+{
+	FString Json = TEXT("{\n");
+	Json += FString::Printf(TEXT("\t\"platform\": \"%s\",\n"), ANSI_TO_TCHAR(FPlatformProperties::PlatformName()));
+	Json += FString::Printf(TEXT("\t\"configuration\": \"%s\",\n"), LexToString(FApp::GetBuildConfiguration()));
+	Json += FString::Printf(TEXT("\t\"cpu\": \"%s\",\n"), *FPlatformMisc::GetCPUBrand().TrimStartAndEnd().ReplaceCharWithEscapedChar());
+	Json += FString::Printf(TEXT("\t\"samples\": %d,\n\t\"minSampleMs\": %.3f,\n\t\"seed\": %d,\n"), Settings.Samples, Settings.MinSampleSeconds * 1000.0, Settings.Seed);
+	Json += TEXT("\t\"results\": [\n");
+	for (int32 Index = 0; Index < Results.Num(); Index++)
+	{
+		const FResult& Result = Results[Index];
+		Json += FString::Printf(TEXT("\t\t{ \"map\": \"%s\", \"kernel\": \"%s\", \"opsPerPass\": %lld, \"ops\": %lld, \"samples\": %d, \"medianNs\": %.4f, \"madNs\": %.4f, \"minNs\": %.4f, \"maxNs\": %.4f, \"meanNs\": %.4f, \"cacheMissesPerOp\": %s, \"allocsPerOp\": %s, \"allocBytesPerOp\": %s, \"expansionsPerOp\": %s }%s\n"),
+			*Result.Map.ReplaceCharWithEscapedChar(), *Result.Kernel, Result.OpsPerPass, Result.TotalOps, Result.Samples,
+			Result.MedianNs, Result.MadNs, Result.MinNs, Result.MaxNs, Result.MeanNs,
+			*JsonNumber(Result.CacheMissesPerOp), *JsonNumber(Result.AllocsPerOp), *JsonNumber(Result.AllocBytesPerOp), *JsonNumber(Result.ExpansionsPerOp),
+			Index + 1 < Results.Num() ? TEXT(",") : TEXT(""));
+	}
+	Json += TEXT("\t]\n}\n");
+	return Json;
+}
+
+void PathKernelBench::LogResults(const TArray<FResult>& Results)
+{
+	for (const FResult& Result : Results)
+	{
+		UE_LOG(LogTemp, Display, TEXT("%-12s %-34s %12.2f ns/op +- %5.1f%% (min %.2f), %s cache misses/op, %.3f allocs/op%s"),
+			*Result.Map, *Result.Kernel, Result.MedianNs, Result.MedianNs > 0.0 ? Result.MadNs * 100.0 / Result.MedianNs : 0.0, Result.MinNs,
+			Result.CacheMissesPerOp >= 0.0 ? *FString::Printf(TEXT("%.3f"), Result.CacheMissesPerOp) : TEXT("no"), Result.AllocsPerOp,
+			Result.ExpansionsPerOp >= 0.0 ? *FString::Printf(TEXT(", %.1f expansions/op"), Result.ExpansionsPerOp) : TEXT(""));
+	}
+}
@@ -0,0 +1,74 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Microbenchmarks of the operations every search is made of, timed one at a time on fixtures built from real maps,
+ * so a regression shows in the operation that caused it instead of only in the time of whole searches.
+ *
+ * Every kernel runs over a fixed working set (cells, queries, entries drawn with a fixed seed) that is walked once per
+ * pass. Passes are batched until a sample is long enough for the clock, and each kernel is timed over many samples
+ * after a warm up: the median and the median absolute deviation are reported, as they are not thrown off by the odd
+ * sample a context switch slowed down. Allocations are counted through GMalloc and cache misses are read from the
+ * hardware counters where the platform lets us (Linux perf events), both per operation. The search kernels also run
+ * with dead-end rooms pruned (see RoomGraph) and report their expansions, so what the pruning saves shows per map, and
+ * the speed of the subgoal graph (see SubgoalGraph) against A* on the grid is logged per map
+ */
+class FIT3094_A1_CODE_API PathKernelBench
+{
+
+public:
+
+	struct FSettings
+	{
+		// Timed samples of every kernel, after the warm up ones
+		int32 Samples = 25;
+		int32 WarmupSamples = 3;
+		// A batch of passes is grown until one sample takes at least this long
+		double MinSampleSeconds = 0.002;
+		// Queries of the search kernels, and the size of the other working sets
+		int32 NumQueries = 64;
+		int32 NumCells = 4096;
+		int32 Seed = 1;
+		// Widest doorway of the rooms the pruned searches use
+		int32 MaxDoorwayWidth = 4;
+		// Kernels to run, every one when empty
+		TArray<FString> Kernels;
+	};
+
+	// The timings of one kernel on one map. Counters that are not available are negative
+	struct FResult
+	{
+		FString Map;
+		FString Kernel;
+		// Operations in one pass, and in all the timed samples
+		int64 OpsPerPass = 0;
+		int64 TotalOps = 0;
+		int32 Samples = 0;
+		// Nanoseconds per operation over the samples
+		double MedianNs = 0.0;
+		double MadNs = 0.0;
+		double MinNs = 0.0;
+		double MaxNs = 0.0;
+		double MeanNs = 0.0;
+		double CacheMissesPerOp = -1.0;
+		double AllocsPerOp = -1.0;
+		double AllocBytesPerOp = -1.0;
+		// Nodes expanded per search, for the search kernels only
+		double ExpansionsPerOp = -1.0;
+	};
+
+	// The names of every kernel, in the order they run
+	static void GetKernelNames(TArray<FString>& OutNames);
+
+	// Build the fixtures of a map and run the kernels on it, appending a result per kernel. False when the map cannot be read
+	static bool RunMap(const FString& MapFile, const FSettings& Settings, TArray<FResult>& OutResults);
+
+	// The results as JSON, one result to a line in a fixed order so two runs can be diffed
+	static FString ToJson(const FSettings& Settings, const TArray<FResult>& Results);
+
+	// Write a line per result to the log
+	static void LogResults(const TArray<FResult>& Results);
+};
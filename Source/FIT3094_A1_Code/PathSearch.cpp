@@ -0,0 +1,96 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "PathSearch.h"
+#include "ARAStarEngine.h"
+#include "AStarEngine.h"
+#include "BidirectionalAStarEngine.h"
+#include "PathGrid.h"
+#include "SubgoalEngine.h"
+#include "Algo/Reverse.h"
+
+// Up, Right, Down, Left as in OccupancyGrid::NEIGHBOUR
+const FIntPoint PathSearchEngine::NeighbourOffsets[4] = { FIntPoint(0, -1), FIntPoint(1, 0), FIntPoint(0, 1), FIntPoint(-1, 0) };
+
+SearchSpace::SearchSpace()
+{
+	Generation = 0;
+	ClosedGeneration = 0;
+	NumCells = 0;
+	NumAllocatedPages = 0;
+}
+
+void SearchSpace::Prepare(int NewNumCells)
+{
+	if (NumCells != NewNumCells)
+	{
+		// a different map, drop every page
+		NumCells = NewNumCells;
+		NumAllocatedPages = 0;
+		Pages.Empty();
+		Pages.SetNum((NumCells + PAGE_MASK) >> PAGE_SHIFT);
+		Generation = 0;
+		ClosedGeneration = 0;
+	}
+
+	// a new generation makes every cell unseen without touching the pages
+	Generation++;
+	if (Generation == 0)
+	{
+		// the stamps wrapped around, so they have to be cleared for real once
+		for (TArray<FCellRecord>& Page : Pages)
+		{
+			FMemory::Memzero(Page.GetData(), Page.Num() * sizeof(FCellRecord));
+		}
+		Generation = 1;
+		ClosedGeneration = 0;
+	}
+	ClearClosed();
+}
+
+void SearchSpace::ClearClosed()
+{
+	ClosedGeneration++;
+	if (ClosedGeneration == 0)
+	{
+		for (TArray<FCellRecord>& Page : Pages)
+		{
+			for (FCellRecord& Record : Page)
+			{
+				Record.ClosedStamp = 0;
+			}
+		}
+		ClosedGeneration = 1;
+	}
+}
+
+void SearchSpace::AllocatePage(TArray<FCellRecord>& Page)
+{
+	// zeroed stamps never match a live generation
+	Page.SetNumZeroed(1 << PAGE_SHIFT);
+	NumAllocatedPages++;
+}
+
+void PathSearchEngine::CreateEngines(TArray<TUniquePtr<PathSearchEngine>>& OutEngines)
+{
+	OutEngines.Add(MakeUnique<AStarEngine>());
+	OutEngines.Add(MakeUnique<BidirectionalAStarEngine>());
+	OutEngines.Add(MakeUnique<ARAStarEngine>());
+	OutEngines.Add(MakeUnique<SubgoalEngine>());
+}
+
+void PathSearchEngine::BuildPath(const PathGrid& Grid, const SearchSpace& Space, int GoalCell, FPathResult& OutResult)
+{
+	OutResult.Path.Reset();
+
+	// loop through all the cells which have a parent, the start is the only one without
+	for (int Cell = GoalCell; Space.GetParent(Cell) != INDEX_NONE; Cell = Space.GetParent(Cell))
+	{
+		OutResult.Path.Add(Grid.GetPosition(Cell));
+	}
+
+	// the walk went from the goal to the start, so flip it
+	Algo::Reverse(OutResult.Path);
+	OutResult.Cost = Space.GetG(GoalCell);
+	OutResult.bFound = true;
+}
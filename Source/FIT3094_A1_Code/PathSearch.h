@@ -0,0 +1,240 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Templates/UniquePtr.h"
+
+class PathGrid;
+class OccupancyGrid;
+class GoalBounds;
+class RoomGraph;
+class SearchHeatmap;
+class SubgoalGraph;
+
+// The question a path query asks
+struct FPathQuery
+{
+	FIntPoint Start;
+	FIntPoint Goal;
+
+	// The occupancy layers the searching agent cannot go through (see OccupancyGrid::LayerMask)
+	uint8 BlockingLayers;
+
+	FPathQuery()
+		: Start(0, 0)
+		, Goal(0, 0)
+		, BlockingLayers(0)
+	{
+	}
+};
+
+// The answer of a search engine to a path query
+struct FPathResult
+{
+	// Was a path found
+	bool bFound;
+
+	// Sum of the travel costs of every cell entered
+	int32 Cost;
+
+	// The cells to walk through, excluding the start and including the goal
+	TArray<FIntPoint> Path;
+
+	// How many nodes were expanded and how long the search took
+	int32 Expansions;
+	double Seconds;
+
+	FPathResult()
+	{
+		Reset();
+	}
+
+	void Reset()
+	{
+		bFound = false;
+		Cost = 0;
+		Path.Reset();
+		Expansions = 0;
+		Seconds = 0.0;
+	}
+};
+
+// An entry of an open list kept as a binary heap, stale entries are skipped when popped
+struct FOpenEntry
+{
+	float F;
+	int32 G;
+	int32 Cell;
+
+	FOpenEntry()
+		: F(0.f)
+		, G(0)
+		, Cell(INDEX_NONE)
+	{
+	}
+
+	FOpenEntry(float InF, int32 InG, int32 InCell)
+		: F(InF)
+		, G(InG)
+		, Cell(InCell)
+	{
+	}
+};
+
+// Lowest F first, ties broken towards the deeper node so equal-cost paths are not all explored
+struct FOpenEntryPredicate
+{
+	bool operator()(const FOpenEntry& A, const FOpenEntry& B) const
+	{
+		return A.F < B.F || (A.F == B.F && A.G > B.G);
+	}
+};
+
+/**
+ * Per-cell search values (G, parent, open/closed) that are cleared in O(1) between searches by bumping a generation.
+ * The cells are split in pages that are only allocated once a search reaches them, so a large map only pays for
+ * the area searches actually cover
+ */
+class FIT3094_A1_CODE_API SearchSpace
+{
+
+public:
+
+	// Cells per page
+	static const int PAGE_SHIFT = 12;
+	static const int PAGE_MASK = (1 << PAGE_SHIFT) - 1;
+
+	SearchSpace();
+
+	// Make room for the cells of the map and forget the previous search
+	void Prepare(int NewNumCells);
+
+	// Has the cell been reached in the current search
+	bool IsSeen(int Cell) const
+	{
+		const FCellRecord* Page = Pages[Cell >> PAGE_SHIFT].GetData();
+		return Page && Page[Cell & PAGE_MASK].SeenStamp == Generation;
+	}
+	bool IsClosed(int Cell) const
+	{
+		const FCellRecord* Page = Pages[Cell >> PAGE_SHIFT].GetData();
+		return Page && Page[Cell & PAGE_MASK].ClosedStamp == ClosedGeneration;
+	}
+
+	// Only valid for cells that have been seen
+	int32 GetG(int Cell) const
+	{
+		return Pages[Cell >> PAGE_SHIFT][Cell & PAGE_MASK].G;
+	}
+	int32 GetParent(int Cell) const
+	{
+		return Pages[Cell >> PAGE_SHIFT][Cell & PAGE_MASK].Parent;
+	}
+
+	// Reach the cell with a cost and the cell it was reached from
+	void Visit(int Cell, int32 NewG, int32 NewParent)
+	{
+		FCellRecord& Record = GetRecord(Cell);
+		Record.SeenStamp = Generation;
+		Record.G = NewG;
+		Record.Parent = NewParent;
+	}
+	void Close(int Cell)
+	{
+		GetRecord(Cell).ClosedStamp = ClosedGeneration;
+	}
+
+	// Reopen every cell but keep the G values and parents, for searches that repeat over the same tree
+	void ClearClosed();
+
+	// Number of pages allocated so far
+	int GetNumAllocatedPages() const
+	{
+		return NumAllocatedPages;
+	}
+
+private:
+
+	// Everything a search keeps about a cell, together so one visit touches one cache line
+	struct FCellRecord
+	{
+		uint32 SeenStamp;
+		uint32 ClosedStamp;
+		int32 G;
+		int32 Parent;
+	};
+
+	FCellRecord& GetRecord(int Cell)
+	{
+		TArray<FCellRecord>& Page = Pages[Cell >> PAGE_SHIFT];
+		if (Page.Num() == 0)
+		{
+			AllocatePage(Page);
+		}
+		return Page[Cell & PAGE_MASK];
+	}
+
+	void AllocatePage(TArray<FCellRecord>& Page);
+
+	uint32 Generation;
+	uint32 ClosedGeneration;
+	int NumCells;
+	int NumAllocatedPages;
+
+	// Empty until a search reaches a cell of the page
+	TArray<TArray<FCellRecord>> Pages;
+
+};
+
+/**
+ * A search algorithm that answers path queries over a grid and its occupancy
+ */
+class FIT3094_A1_CODE_API PathSearchEngine
+{
+
+public:
+
+	virtual ~PathSearchEngine() {}
+
+	// The name used to pick the engine in the subsystem, traces and replays
+	virtual FName GetName() const = 0;
+
+	// Search for a path, returns OutResult.bFound
+	virtual bool FindPath(const PathGrid& Grid, const OccupancyGrid& Occupancy, const FPathQuery& Query, FPathResult& OutResult) = 0;
+
+	// Goal bounds of the current map for engines that can prune with them, nullptr when the map has none
+	virtual void SetGoalBounds(const GoalBounds* Bounds) {}
+
+	// Rooms of the current map for engines that skip dead ends with them, nullptr when the map has none
+	virtual void SetRooms(const RoomGraph* Rooms) {}
+	virtual bool CanPruneRooms() const
+	{
+		return false;
+	}
+
+	// Subgoal graph of the current map for engines searching over it, nullptr when the map has none
+	virtual void SetSubgoals(const SubgoalGraph* Subgoals) {}
+	virtual bool CanUseSubgoals() const
+	{
+		return false;
+	}
+
+	// Heatmap to count every cell expanded into while profiling (see SearchHeatmap), nullptr when not profiling
+	virtual void SetHeatmap(SearchHeatmap* Heatmap) {}
+
+	// Create one of every available engine
+	static void CreateEngines(TArray<TUniquePtr<PathSearchEngine>>& OutEngines);
+
+	// The heuristic used by every engine, the straight line distance as in CalculateDistanceBetween
+	static float Heuristic(int X, int Y, const FIntPoint& Goal)
+	{
+		return FMath::Sqrt((float)((Goal.X - X) * (Goal.X - X) + (Goal.Y - Y) * (Goal.Y - Y)));
+	}
+
+	// Walk the parents back from the goal and fill the path (excluding the start)
+	static void BuildPath(const PathGrid& Grid, const SearchSpace& Space, int GoalCell, FPathResult& OutResult);
+
+	// The offset of each neighbour, indexed by the bit position of OccupancyGrid::NEIGHBOUR
+	static const FIntPoint NeighbourOffsets[4];
+};
@@ -0,0 +1,60 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "PathTraceReplayCommandlet.h"
+#include "PathSearch.h"
+#include "QueryTrace.h"
+#include "Misc/Paths.h"
+
+UPathTraceReplayCommandlet::UPathTraceReplayCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = false;
+	LogToConsole = true;
+}
+
+int32 UPathTraceReplayCommandlet::Main(const FString& Params)
+{
+	FString TraceFile;
+	if (!FParse::Value(*Params, TEXT("Trace="), TraceFile))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Usage: -run=PathTraceReplay -Trace=<file> [-Engines=AStar,...] [-Csv=<file>]"));
+		return 1;
+	}
+
+	FString EngineList;
+	FParse::Value(*Params, TEXT("Engines="), EngineList);
+	TArray<FString> EngineNames;
+	EngineList.ParseIntoArray(EngineNames, TEXT(","));
+
+	FString CsvFile;
+	FParse::Value(*Params, TEXT("Csv="), CsvFile);
+
+	// every engine unless some were asked for by name
+	TArray<TUniquePtr<PathSearchEngine>> Engines;
+	PathSearchEngine::CreateEngines(Engines);
+	TArray<PathSearchEngine*> Selected;
+	for (const TUniquePtr<PathSearchEngine>& Engine : Engines)
+	{
+		if (EngineNames.Num() == 0 || EngineNames.Contains(Engine->GetName().ToString()))
+		{
+			Selected.Add(Engine.Get());
+		}
+	}
+
+	if (Selected.Num() == 0)
+	{
+		UE_LOG(LogTemp, Error, TEXT("No search engine matches %s"), *EngineList);
+		return 1;
+	}
+
+	TArray<QueryTraceReplayer::FEngineSummary> Summaries;
+	if (!QueryTraceReplayer::Replay(TraceFile, Selected, CsvFile, Summaries))
+	{
+		return 1;
+	}
+
+	QueryTraceReplayer::LogSummaries(Summaries);
+	return 0;
+}
@@ -0,0 +1,23 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "PathTraceReplayCommandlet.generated.h"
+
+/**
+ * Replays a recorded query trace offline against the search engines and reports latency and cost differences.
+ * Usage: UE4Editor-Cmd FIT3094_A1_Code.uproject -run=PathTraceReplay -Trace=<file> [-Engines=AStar,...] [-Csv=<file>]
+ */
+UCLASS()
+class FIT3094_A1_CODE_API UPathTraceReplayCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+
+	UPathTraceReplayCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
@@ -0,0 +1,1252 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "PathfindingSubsystem.h"
+#include "CountingMalloc.h"
+#include "DistanceKernels.h"
+#include "FrameArena.h"
+#include "LevelGenerator.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformTime.h"
+#include "Async/Async.h"
+#include "Misc/CoreDelegates.h"
+#include "Misc/Paths.h"
+#include "Engine/World.h"
+
+// Console commands for recording and replaying query traces in a running game
+static FAutoConsoleCommandWithWorldAndArgs StartTraceCommand(
+	TEXT("Path.Trace.Start"),
+	TEXT("Record every path query to a trace file. Usage: Path.Trace.Start [FileName]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		if (UPathfindingSubsystem* Pathfinding = World ? World->GetSubsystem<UPathfindingSubsystem>() : nullptr)
+		{
+			FString FileName = Args.Num() > 0 ? Args[0] : FString::Printf(TEXT("Queries_%s.pqt"), *FDateTime::Now().ToString());
+			Pathfinding->StartTrace(FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("Traces"), FileName));
+		}
+	}));
+
+static FAutoConsoleCommandWithWorldAndArgs StopTraceCommand(
+	TEXT("Path.Trace.Stop"),
+	TEXT("Stop recording path queries"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		if (UPathfindingSubsystem* Pathfinding = World ? World->GetSubsystem<UPathfindingSubsystem>() : nullptr)
+		{
+			Pathfinding->StopTrace();
+		}
+	}));
+
+static TAutoConsoleVariable<int32> CVarCompareEngines(
+	TEXT("Path.CompareEngines"),
+	0,
+	TEXT("When 1, every path query is also run by every other search engine so their expansions and time can be compared with Path.Stats"));
+
+static FAutoConsoleCommandWithWorldAndArgs StatsCommand(
+	TEXT("Path.Stats"),
+	TEXT("Log the expansions and time of each search engine on the current map"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		if (UPathfindingSubsystem* Pathfinding = World ? World->GetSubsystem<UPathfindingSubsystem>() : nullptr)
+		{
+			Pathfinding->LogEngineStats();
+		}
+	}));
+
+static FAutoConsoleCommandWithWorldAndArgs SetEngineCommand(
+	TEXT("Path.Engine"),
+	TEXT("Pick the search engine agents use. Usage: Path.Engine <Name>"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		UPathfindingSubsystem* Pathfinding = World ? World->GetSubsystem<UPathfindingSubsystem>() : nullptr;
+		if (Pathfinding && Args.Num() > 0 && !Pathfinding->SetActiveEngine(FName(*Args[0])))
+		{
+			UE_LOG(LogTemp, Warning, TEXT("No search engine called %s"), *Args[0]);
+		}
+	}));
+
+static FAutoConsoleCommand BenchKernelsCommand(
+	TEXT("Path.BenchKernels"),
+	TEXT("Time the distance kernels on every instruction set this CPU supports. Usage: Path.BenchKernels [Candidates] [Repeats]"),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+	{
+		const int32 NumCandidates = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 10000;
+		const int32 Repeats = Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 1000;
+		DistanceKernels::Benchmark(NumCandidates, Repeats);
+	}));
+
+static FAutoConsoleCommandWithWorldAndArgs BenchClaimsCommand(
+	TEXT("Path.BenchClaims"),
+	TEXT("Time a crowd walking over the current map with the movement phases on 1, 2, 4... threads. Usage: Path.BenchClaims [Agents] [Steps]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		UPathfindingSubsystem* Pathfinding = World ? World->GetSubsystem<UPathfindingSubsystem>() : nullptr;
+		if (Pathfinding && Pathfinding->HasMap())
+		{
+			const int32 NumAgents = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 10000;
+			const int32 Steps = Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 200;
+			CellClaims::Benchmark(Pathfinding->Grid, Pathfinding->Occupancy, NumAgents, Steps);
+		}
+	}));
+
+static FAutoConsoleCommandWithWorldAndArgs CountAllocsCommand(
+	TEXT("Path.CountAllocs"),
+	TEXT("Count the heap allocations of every frame for a while and log them, with what the frame arena did. Usage: Path.CountAllocs [Frames]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		if (UPathfindingSubsystem* Pathfinding = World ? World->GetSubsystem<UPathfindingSubsystem>() : nullptr)
+		{
+			Pathfinding->CountFrameAllocations(Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 120);
+		}
+	}));
+
+// Console commands for the search heatmap
+static FAutoConsoleCommandWithWorldAndArgs StartHeatmapCommand(
+	TEXT("Path.Heatmap.Start"),
+	TEXT("Count per cell where the searches expand, where agents plan again and where they find their way blocked"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		if (UPathfindingSubsystem* Pathfinding = World ? World->GetSubsystem<UPathfindingSubsystem>() : nullptr)
+		{
+			Pathfinding->StartHeatmap();
+		}
+	}));
+
+static FAutoConsoleCommandWithWorldAndArgs StopHeatmapCommand(
+	TEXT("Path.Heatmap.Stop"),
+	TEXT("Stop counting, the counts stay to be exported and shown"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		if (UPathfindingSubsystem* Pathfinding = World ? World->GetSubsystem<UPathfindingSubsystem>() : nullptr)
+		{
+			Pathfinding->StopHeatmap();
+		}
+	}));
+
+static FAutoConsoleCommandWithWorldAndArgs ExportHeatmapCommand(
+	TEXT("Path.Heatmap.Export"),
+	TEXT("Write the heatmap of the current map to Saved/Heatmaps as a CSV file and a PNG image per layer. Usage: Path.Heatmap.Export [Name]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		UPathfindingSubsystem* Pathfinding = World ? World->GetSubsystem<UPathfindingSubsystem>() : nullptr;
+		if (Pathfinding && Pathfinding->HasMap())
+		{
+			Pathfinding->ExportHeatmap(Args.Num() > 0 ? Args[0] : Pathfinding->MapName);
+		}
+	}));
+
+static FAutoConsoleCommandWithWorldAndArgs ShowHeatmapCommand(
+	TEXT("Path.Heatmap.Show"),
+	TEXT("Draw a layer of the heatmap over the map. Usage: Path.Heatmap.Show <Expansions|Replans|Blocks|None>"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		UPathfindingSubsystem* Pathfinding = World ? World->GetSubsystem<UPathfindingSubsystem>() : nullptr;
+		if (!Pathfinding)
+		{
+			return;
+		}
+
+		const SearchHeatmap::LAYER Layer = Args.Num() > 0 ? SearchHeatmap::GetLayer(Args[0]) : SearchHeatmap::Expansions;
+		if (Args.Num() > 0 && Layer == SearchHeatmap::LAYER_COUNT && Args[0] != TEXT("None"))
+		{
+			UE_LOG(LogTemp, Warning, TEXT("No heatmap layer called %s"), *Args[0]);
+			return;
+		}
+		Pathfinding->ShowHeatmap(Layer);
+	}));
+
+// Installed while frames are being counted. Other threads may still be inside it after it is taken out, so it is never destroyed
+static CountingMalloc AllocationCounter;
+
+static FAutoConsoleCommandWithWorldAndArgs TerrainCommand(
+	TEXT("Path.Terrain"),
+	TEXT("Change the terrain of an area of the current map. Usage: Path.Terrain <Open|Wall|Forest|Swamp|Water> MinX MinY [MaxX MaxY]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		UPathfindingSubsystem* Pathfinding = World ? World->GetSubsystem<UPathfindingSubsystem>() : nullptr;
+		if (!Pathfinding || Args.Num() < 3)
+		{
+			return;
+		}
+
+		static const TCHAR* TypeNames[] = { TEXT("Open"), TEXT("Wall"), TEXT("Forest"), TEXT("Swamp"), TEXT("Water") };
+		int32 Type = INDEX_NONE;
+		for (int32 Index = 0; Index < UE_ARRAY_COUNT(TypeNames); Index++)
+		{
+			if (Args[0] == TypeNames[Index])
+			{
+				Type = Index;
+			}
+		}
+		if (Type == INDEX_NONE)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("No terrain called %s"), *Args[0]);
+			return;
+		}
+
+		const FIntPoint Min(FCString::Atoi(*Args[1]), FCString::Atoi(*Args[2]));
+		const FIntPoint Max = Args.Num() >= 5 ? FIntPoint(FCString::Atoi(*Args[3]), FCString::Atoi(*Args[4])) : Min;
+		TArray<FIntPoint> Cells;
+		for (int X = Min.X; X <= Max.X; X++)
+		{
+			for (int Y = Min.Y; Y <= Max.Y; Y++)
+			{
+				Cells.Add(FIntPoint(X, Y));
+			}
+		}
+		UE_LOG(LogTemp, Log, TEXT("Terrain: %d cells changed to %s"), Pathfinding->EditTerrain(Cells, (GridNode::GRID_TYPE)Type), *Args[0]);
+	}));
+
+void UPathfindingSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	MapId = 0;
+	bRecordingHeatmap = false;
+	HeatmapOverlay = SearchHeatmap::LAYER_COUNT;
+	NextOverlayTime = 0.0;
+	PathSearchEngine::CreateEngines(Engines);
+	ActiveEngine = Engines.Num() > 0 ? Engines[0].Get() : nullptr;
+	if (!DefaultEngine.IsNone())
+	{
+		SetActiveEngine(DefaultEngine);
+	}
+	Cache.SetBudget((int64)PathCacheBudgetKB * 1024);
+	TerrainVersion = 0;
+	bRebuildRunning = false;
+
+	AllocationFramesLeft = 0;
+	EndFrameHandle = FCoreDelegates::OnEndFrame.AddUObject(this, &UPathfindingSubsystem::HandleEndFrame);
+}
+
+void UPathfindingSubsystem::Deinitialize()
+{
+	// the load has nowhere to go any more, but it still has to finish before its passes are gone
+	if (PendingLoad.IsValid())
+	{
+		PendingLoad->Cancel();
+		PendingLoadFuture.Wait();
+		PendingLoad.Reset();
+	}
+	// a rebuild in flight is thrown away when it finishes, the same way
+	PendingRebuilds.Empty();
+	TerrainVersion++;
+	if (RebuildFuture.IsValid())
+	{
+		RebuildFuture.Wait();
+	}
+
+	StopTrace();
+	LogEngineStats();
+	if (bRecordingHeatmap && HasMap() && !Heatmap.IsEmpty())
+	{
+		ExportHeatmap(MapName);
+	}
+	StopHeatmap();
+
+	FCoreDelegates::OnEndFrame.Remove(EndFrameHandle);
+	if (AllocationFramesLeft > 0)
+	{
+		AllocationCounter.Uninstall();
+		AllocationFramesLeft = 0;
+	}
+
+	// report how well the pool did before forgetting everything
+	Pool.LogStats();
+	Assignment.LogStats();
+	Pool.Empty();
+	Assignment.Reset();
+	Cache.Reset();
+	Claims.Reset();
+	Events.Reset(0.0);
+	FoodActors.Empty();
+	PreprocessPasses.Empty();
+	Occupancy.Reset();
+	Grid.Reset();
+
+	Super::Deinitialize();
+}
+
+bool UPathfindingSubsystem::LoadMap(const TArray<FString>& NewMapLines)
+{
+	MapLoadTask Task(FString(), NewMapLines, NextMapName, GetPassesForMap(NextMapName));
+	NextMapName.Empty();
+
+	Task.Run();
+	if (Task.GetStage() != MapLoadTask::Done)
+	{
+		return false;
+	}
+
+	PublishMap(Task);
+	return true;
+}
+
+void UPathfindingSubsystem::LoadMapAsync(const TArray<FString>& NewMapLines)
+{
+	StartLoad(MakeShared<MapLoadTask, ESPMode::ThreadSafe>(FString(), NewMapLines, NextMapName, GetPassesForMap(NextMapName)));
+	NextMapName.Empty();
+}
+
+void UPathfindingSubsystem::LoadMapFileAsync(const FString& MapPath)
+{
+	const FString Name = FPaths::GetBaseFilename(MapPath);
+	StartLoad(MakeShared<MapLoadTask, ESPMode::ThreadSafe>(MapPath, TArray<FString>(), Name, GetPassesForMap(Name)));
+	NextMapName.Empty();
+}
+
+float UPathfindingSubsystem::GetLoadProgress() const
+{
+	return PendingLoad.IsValid() ? PendingLoad->GetProgress() : 1.f;
+}
+
+void UPathfindingSubsystem::StartLoad(const TSharedRef<MapLoadTask, ESPMode::ThreadSafe>& Task)
+{
+	// only the newest request is published
+	if (PendingLoad.IsValid())
+	{
+		PendingLoad->Cancel();
+	}
+	PendingLoad = Task;
+
+	TWeakObjectPtr<UPathfindingSubsystem> WeakThis(this);
+	PendingLoadFuture = Async(EAsyncExecution::ThreadPool, [Task, WeakThis]()
+	{
+		Task->Run();
+
+		// hand the results to the game thread, which is the only one allowed to change the map in use
+		AsyncTask(ENamedThreads::GameThread, [Task, WeakThis]()
+		{
+			UPathfindingSubsystem* This = WeakThis.Get();
+			if (!This || This->PendingLoad != Task)
+			{
+				return;
+			}
+
+			This->PendingLoad.Reset();
+			if (Task->GetStage() == MapLoadTask::Done)
+			{
+				This->PublishMap(*Task);
+			}
+			else
+			{
+				UE_LOG(LogTemp, Warning, TEXT("Loading map %s failed"), *Task->MapName);
+			}
+		});
+	});
+}
+
+void UPathfindingSubsystem::PublishMap(MapLoadTask& Task)
+{
+	// everything placed on the old grid has to go before the grid does
+	OnMapUnloading.Broadcast();
+
+	// the food of the previous map belongs to the old grid, and so do the claims on it and the statistics
+	FoodActors.Empty();
+	Assignment.Reset();
+	LogEngineStats();
+	EngineStats.Empty();
+	AnytimeStats.Empty();
+	if (bRecordingHeatmap && HasMap() && !Heatmap.IsEmpty())
+	{
+		ExportHeatmap(MapName);
+	}
+
+	Grid = MoveTemp(Task.Grid);
+	Occupancy = MoveTemp(Task.Occupancy);
+	MapLines = MoveTemp(Task.MapLines);
+	MapId = Task.MapId;
+	MapName = Task.MapName.IsEmpty() ? FString::Printf(TEXT("%08x"), MapId) : Task.MapName;
+	SelectEngineForMap();
+	if (bRecordingHeatmap)
+	{
+		Heatmap.Init(Grid.SizeX, Grid.SizeY);
+	}
+	Cache.Init(Grid);
+	Claims.Init(Grid.GetNumCells());
+
+	// derived data of the old map must not be used on the new one
+	InstallGoalBounds(nullptr);
+	InstallRooms(nullptr);
+	InstallSubgoals(nullptr);
+	SharedTerrain.Reset();
+	PendingRebuilds.Empty();
+	TerrainVersion++;
+
+	// the frames of the old map may have grown the arena far past what the new one needs
+	FrameArena::Get().Trim();
+
+	// install what the passes built
+	for (const TPair<FName, FPreprocessCommit>& Commit : Task.Commits)
+	{
+		if (Commit.Value)
+		{
+			Commit.Value();
+		}
+	}
+
+	// and catch up with the passes registered after the load started
+	for (const TPair<FName, FPreprocessPass>& Pass : PreprocessPasses)
+	{
+		const bool bRan = Task.Commits.ContainsByPredicate([&Pass](const TPair<FName, FPreprocessCommit>& Commit)
+		{
+			return Commit.Key == Pass.Key;
+		});
+
+		if (!bRan)
+		{
+			RunPreprocessPass(Pass.Key, Pass.Value);
+		}
+	}
+
+	// after the passes, so the trace knows what the engines search with
+	WriteTraceMap();
+
+	OnMapLoaded.Broadcast();
+}
+
+void UPathfindingSubsystem::RegisterPreprocessPass(FName Name, FPreprocessPass Pass)
+{
+	UnregisterPreprocessPass(Name);
+	PreprocessPasses.Add(TPair<FName, FPreprocessPass>(Name, Pass));
+
+	// bring the new pass up to date with the map that is already loaded
+	if (HasMap())
+	{
+		RunPreprocessPass(Name, Pass);
+	}
+}
+
+void UPathfindingSubsystem::UnregisterPreprocessPass(FName Name)
+{
+	PreprocessPasses.RemoveAll([Name](const TPair<FName, FPreprocessPass>& Pass)
+	{
+		return Pass.Key == Name;
+	});
+}
+
+TArray<TPair<FName, FPreprocessPass>> UPathfindingSubsystem::GetPassesForMap(const FString& Name)
+{
+	TArray<TPair<FName, FPreprocessPass>> Passes = PreprocessPasses;
+
+	const bool bGoalBounding = GoalBoundingMaps.ContainsByPredicate([&Name](const FString& Prefix)
+	{
+		return !Name.IsEmpty() && Name.StartsWith(Prefix);
+	});
+	if (bGoalBounding)
+	{
+		Passes.Add(TPair<FName, FPreprocessPass>(TEXT("GoalBounding"), MakeGoalBoundingPass()));
+	}
+
+	const bool bRooms = RoomPruningMaps.ContainsByPredicate([&Name](const FString& Prefix)
+	{
+		return !Name.IsEmpty() && Name.StartsWith(Prefix);
+	});
+	if (bRooms)
+	{
+		Passes.Add(TPair<FName, FPreprocessPass>(TEXT("Rooms"), MakeRoomPass()));
+	}
+
+	const bool bSubgoals = SubgoalGraphMaps.ContainsByPredicate([&Name](const FString& Prefix)
+	{
+		return !Name.IsEmpty() && Name.StartsWith(Prefix);
+	});
+	if (bSubgoals)
+	{
+		Passes.Add(TPair<FName, FPreprocessPass>(TEXT("Subgoals"), MakeSubgoalPass()));
+	}
+
+	return Passes;
+}
+
+FPreprocessPass UPathfindingSubsystem::MakeGoalBoundingPass()
+{
+	const int32 MaxCells = GoalBoundingMaxCells;
+	return [this, MaxCells](const PathGrid& PassGrid) -> FPreprocessCommit
+	{
+		if (PassGrid.GetNumCells() > MaxCells)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Map has %d cells, too many for goal bounding (GoalBoundingMaxCells %d)"), PassGrid.GetNumCells(), MaxCells);
+			return FPreprocessCommit();
+		}
+
+		// built on the loading thread, only the commit touches the subsystem
+		TSharedPtr<GoalBounds, ESPMode::ThreadSafe> Bounds = MakeShared<GoalBounds, ESPMode::ThreadSafe>();
+		Bounds->Build(PassGrid);
+
+		return [this, Bounds]()
+		{
+			InstallGoalBounds(Bounds);
+		};
+	};
+}
+
+void UPathfindingSubsystem::InstallGoalBounds(const TSharedPtr<GoalBounds, ESPMode::ThreadSafe>& Bounds)
+{
+	CurrentGoalBounds = Bounds;
+	for (const TUniquePtr<PathSearchEngine>& Engine : Engines)
+	{
+		Engine->SetGoalBounds(Bounds.Get());
+	}
+
+	if (Bounds.IsValid())
+	{
+		UE_LOG(LogTemp, Log, TEXT("Goal bounds for map %s: %d cells searched in %.2f s, %.2f MB"),
+			*MapName, Bounds->NumSources, Bounds->BuildSeconds, Bounds->GetAllocatedSize() / (1024.0 * 1024.0));
+	}
+}
+
+FPreprocessPass UPathfindingSubsystem::MakeRoomPass()
+{
+	const int32 DoorwayWidth = RoomDoorwayWidth;
+	return [this, DoorwayWidth](const PathGrid& PassGrid) -> FPreprocessCommit
+	{
+		TSharedPtr<RoomGraph, ESPMode::ThreadSafe> Rooms = MakeShared<RoomGraph, ESPMode::ThreadSafe>();
+		Rooms->Build(PassGrid, DoorwayWidth);
+
+		return [this, Rooms]()
+		{
+			InstallRooms(Rooms);
+		};
+	};
+}
+
+void UPathfindingSubsystem::InstallRooms(const TSharedPtr<RoomGraph, ESPMode::ThreadSafe>& Rooms)
+{
+	CurrentRooms = Rooms;
+	for (const TUniquePtr<PathSearchEngine>& Engine : Engines)
+	{
+		Engine->SetRooms(Rooms.Get());
+	}
+
+	if (Rooms.IsValid())
+	{
+		UE_LOG(LogTemp, Log, TEXT("Rooms of map %s: %d rooms (largest %d cells) and %d doorways in %.2f ms, %.2f MB"),
+			*MapName, Rooms->GetNumRooms(), Rooms->LargestRoom, Rooms->GetNumDoorways(), Rooms->BuildSeconds * 1000.0, Rooms->GetAllocatedSize() / (1024.0 * 1024.0));
+	}
+}
+
+FPreprocessPass UPathfindingSubsystem::MakeSubgoalPass()
+{
+	return [this](const PathGrid& PassGrid) -> FPreprocessCommit
+	{
+		TSharedPtr<SubgoalGraph, ESPMode::ThreadSafe> Subgoals = MakeShared<SubgoalGraph, ESPMode::ThreadSafe>();
+		Subgoals->Build(PassGrid);
+
+		return [this, Subgoals]()
+		{
+			InstallSubgoals(Subgoals);
+		};
+	};
+}
+
+void UPathfindingSubsystem::InstallSubgoals(const TSharedPtr<SubgoalGraph, ESPMode::ThreadSafe>& Subgoals)
+{
+	CurrentSubgoals = Subgoals;
+	for (const TUniquePtr<PathSearchEngine>& Engine : Engines)
+	{
+		Engine->SetSubgoals(Subgoals.Get());
+	}
+
+	if (Subgoals.IsValid())
+	{
+		UE_LOG(LogTemp, Log, TEXT("Subgoal graph of map %s: %d subgoals (of %d cells) and %d links in %.2f ms, %.2f MB"),
+			*MapName, Subgoals->GetNumSubgoals(), Grid.GetNumCells(), Subgoals->GetNumLinks(), Subgoals->BuildSeconds * 1000.0, Subgoals->GetAllocatedSize() / (1024.0 * 1024.0));
+	}
+}
+
+GridNode* UPathfindingSubsystem::GetNode(int X, int Y)
+{
+	if (!Grid.IsInside(X, Y))
+	{
+		return nullptr;
+	}
+	return Grid.GetNode(X, Y);
+}
+
+GridNode* UPathfindingSubsystem::GetNodeAtLocation(const FVector& Location)
+{
+	int X = Location.X / ALevelGenerator::GRID_SIZE_WORLD;
+	int Y = Location.Y / ALevelGenerator::GRID_SIZE_WORLD;
+	return GetNode(X, Y);
+}
+
+float UPathfindingSubsystem::CalculateDistanceBetween(const GridNode* first, const GridNode* second) const
+{
+	FVector distToTarget = FVector(second->X - first->X,
+		second->Y - first->Y, 0);
+	return distToTarget.Size();
+}
+
+bool UPathfindingSubsystem::FindPath(const FPathQuery& Query, FPathResult& OutResult)
+{
+	OutResult.Reset();
+	if (!ActiveEngine || !Grid.IsInside(Query.Start.X, Query.Start.Y) || !Grid.IsInside(Query.Goal.X, Query.Goal.Y))
+	{
+		return false;
+	}
+
+	if (FindCachedPath(Query, OutResult))
+	{
+		return true;
+	}
+
+	ActiveEngine->FindPath(Grid, Occupancy, Query, OutResult);
+	RecordEngineStats(ActiveEngine->GetName(), OutResult);
+	CachePath(Query, OutResult);
+	CompareEngines(Query, ActiveEngine);
+
+	if (TraceWriter.IsOpen())
+	{
+		TraceWriter.WriteQuery(Occupancy, Query, OutResult);
+	}
+
+	return OutResult.bFound;
+}
+
+bool UPathfindingSubsystem::BeginAnytimePath(AnytimeSearch& Search, const FAnytimeSearchSetting& Setting, const FPathQuery& Query, FPathResult& OutResult)
+{
+	OutResult.Reset();
+	if (!Grid.IsInside(Query.Start.X, Query.Start.Y) || !Grid.IsInside(Query.Goal.X, Query.Goal.Y))
+	{
+		return false;
+	}
+
+	// an optimal path cached already is better than anything the first iteration finds
+	if (FindCachedPath(Query, OutResult))
+	{
+		return true;
+	}
+
+	Search.SetHeatmap(GetHeatmap());
+	Search.Begin(Grid, Occupancy, Query, Setting.InitialEpsilon, Setting.EpsilonStep, OutResult);
+	RecordEngineStats(TEXT("Anytime"), OutResult);
+	if (Search.IsOptimal())
+	{
+		CachePath(Query, OutResult);
+	}
+	CompareEngines(Query, nullptr);
+
+	if (TraceWriter.IsOpen())
+	{
+		TraceWriter.WriteQuery(Occupancy, Query, OutResult);
+	}
+
+	return OutResult.bFound;
+}
+
+bool UPathfindingSubsystem::ImproveAnytimePath(AnytimeSearch& Search, const FAnytimeSearchSetting& Setting, FPathResult& OutResult)
+{
+	// the profiler may have been switched since the search began
+	Search.SetHeatmap(GetHeatmap());
+
+	const int32 Expansions = Search.Expansions;
+	const double Seconds = Search.Seconds;
+	const bool bImproved = Search.Improve(Grid, Occupancy, Setting.MaxImproveMilliseconds / 1000.0, OutResult);
+
+	// not a query of its own, only the work adds up
+	FEngineStats& Stats = EngineStats.FindOrAdd(TEXT("Anytime"));
+	Stats.Expansions += Search.Expansions - Expansions;
+	Stats.Seconds += Search.Seconds - Seconds;
+	return bImproved;
+}
+
+void UPathfindingSubsystem::CompareEngines(const FPathQuery& Query, const PathSearchEngine* Skip)
+{
+	// run the same query through the other engines so they can be compared on this map
+	if (CVarCompareEngines.GetValueOnGameThread() == 0)
+	{
+		return;
+	}
+
+	for (const TUniquePtr<PathSearchEngine>& Engine : Engines)
+	{
+		if (Engine.Get() != Skip)
+		{
+			Engine->FindPath(Grid, Occupancy, Query, CompareResult);
+			RecordEngineStats(Engine->GetName(), CompareResult);
+		}
+	}
+}
+
+bool UPathfindingSubsystem::FindCachedPath(const FPathQuery& Query, FPathResult& OutResult)
+{
+	OutResult.Reset();
+	if (!CanUseCache() || !Grid.IsInside(Query.Start.X, Query.Start.Y) || !Grid.IsInside(Query.Goal.X, Query.Goal.Y))
+	{
+		return false;
+	}
+	return Cache.Find(Grid, Occupancy, Query, OutResult);
+}
+
+void UPathfindingSubsystem::CachePath(const FPathQuery& Query, const FPathResult& Result)
+{
+	if (CanUseCache())
+	{
+		Cache.Add(Grid, Query, Result);
+	}
+}
+
+bool UPathfindingSubsystem::CanUseCache() const
+{
+	// comparisons and traces are about the engines, so they always get the engine's answer
+	return CVarCompareEngines.GetValueOnGameThread() == 0 && !TraceWriter.IsOpen();
+}
+
+PathSearchEngine* UPathfindingSubsystem::GetEngine(FName Name) const
+{
+	for (const TUniquePtr<PathSearchEngine>& Engine : Engines)
+	{
+		if (Engine->GetName() == Name)
+		{
+			return Engine.Get();
+		}
+	}
+	return nullptr;
+}
+
+bool UPathfindingSubsystem::SetActiveEngine(FName Name)
+{
+	PathSearchEngine* Engine = GetEngine(Name);
+	if (!Engine)
+	{
+		return false;
+	}
+	ActiveEngine = Engine;
+	UpdateEngineHeatmaps();
+	return true;
+}
+
+void UPathfindingSubsystem::LogEngineStats() const
+{
+	for (const TPair<FName, FAnytimeStats>& Pair : AnytimeStats)
+	{
+		const FAnytimeStats& Stats = Pair.Value;
+		const double Searches = FMath::Max(Stats.Searches, 1);
+		UE_LOG(LogTemp, Display, TEXT("Anytime search of %s: %d searches, %d optimal, time to first path mean %.1f us max %.1f us, final/first cost %.3f"),
+			*Pair.Key.ToString(), Stats.Searches, Stats.Optimal, Stats.FirstPathSeconds * 1000000.0 / Searches, Stats.MaxFirstPathSeconds * 1000000.0,
+			Stats.CostRatio / Searches);
+	}
+	Cache.LogStats();
+	Events.LogStats();
+
+	const FrameArena::FStats& Arena = FrameArena::Get().GetLastFrameStats();
+	UE_LOG(LogTemp, Display, TEXT("Frame arena: %d allocations of %.1f KB last frame, %d blocks from the heap, %.1f KB held, %lld blocks from the heap by every thread so far"),
+		Arena.Allocations, Arena.Bytes / 1024.0, Arena.HeapAllocations, FrameArena::Get().GetReservedBytes() / 1024.0, FrameArena::GetTotalHeapAllocations());
+
+	if (EngineStats.Num() == 0)
+	{
+		return;
+	}
+
+	UE_LOG(LogTemp, Display, TEXT("Search engines on map %s (active: %s)"), *MapName, ActiveEngine ? *ActiveEngine->GetName().ToString() : TEXT("none"));
+	for (const TPair<FName, FEngineStats>& Pair : EngineStats)
+	{
+		const FEngineStats& Stats = Pair.Value;
+		const double Queries = FMath::Max(Stats.Queries, 1);
+		UE_LOG(LogTemp, Display, TEXT("  %-20s queries %6d  found %6d  mean cost %8.1f  mean expansions %9.1f  mean %8.1f us  total %8.2f ms"),
+			*Pair.Key.ToString(), Stats.Queries, Stats.Found, Stats.Cost / FMath::Max<double>(Stats.Found, 1), Stats.Expansions / Queries,
+			Stats.Seconds * 1000000.0 / Queries, Stats.Seconds * 1000.0);
+	}
+}
+
+TSharedPtr<PathGrid, ESPMode::ThreadSafe> UPathfindingSubsystem::GetSharedTerrain()
+{
+	if (!SharedTerrain.IsValid() && HasMap())
+	{
+		SharedTerrain = MakeShared<PathGrid, ESPMode::ThreadSafe>();
+		SharedTerrain->CopyTerrain(Grid);
+	}
+	return SharedTerrain;
+}
+
+void UPathfindingSubsystem::CountFrameAllocations(int32 Frames)
+{
+	if (AllocationCounter.IsInstalled())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Allocations are being counted already"));
+		return;
+	}
+
+	// the frame the counting starts in is only partly counted, it is dropped
+	AllocationFramesLeft = FMath::Max(Frames, 1) + 1;
+	FrameAllocations.Reset(AllocationFramesLeft);
+	FrameAllocationBytes.Reset(AllocationFramesLeft);
+	AllocationCounter.Install();
+}
+
+void UPathfindingSubsystem::HandleEndFrame()
+{
+	// nothing allocated from the arena this frame is in use any more
+	FrameArena::Get().Reset();
+
+	// redrawn a few times a second to follow the counts, each drawing lasts until the next
+	if (HeatmapOverlay != SearchHeatmap::LAYER_COUNT && HasMap() && FPlatformTime::Seconds() >= NextOverlayTime)
+	{
+		const float OverlayInterval = 0.25f;
+		Heatmap.DrawOverlay(GetWorld(), HeatmapOverlay, ALevelGenerator::GRID_SIZE_WORLD, OverlayInterval);
+		NextOverlayTime = FPlatformTime::Seconds() + OverlayInterval;
+	}
+
+	if (AllocationFramesLeft == 0)
+	{
+		return;
+	}
+
+	// the arrays were reserved for every frame, adding does not allocate
+	FrameAllocations.Add(AllocationCounter.GetNumAllocs());
+	FrameAllocationBytes.Add(AllocationCounter.GetNumBytes());
+	AllocationCounter.ResetCounts();
+	if (--AllocationFramesLeft == 0)
+	{
+		AllocationCounter.Uninstall();
+		LogFrameAllocations();
+	}
+}
+
+void UPathfindingSubsystem::StartHeatmap()
+{
+	Heatmap.Init(Grid.SizeX, Grid.SizeY);
+	bRecordingHeatmap = true;
+	UpdateEngineHeatmaps();
+	UE_LOG(LogTemp, Log, TEXT("Recording the search heatmap of map %s"), *MapName);
+}
+
+void UPathfindingSubsystem::StopHeatmap()
+{
+	bRecordingHeatmap = false;
+	UpdateEngineHeatmaps();
+}
+
+void UPathfindingSubsystem::ExportHeatmap(const FString& Name)
+{
+	const FString Directory = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("Heatmaps"));
+	const FString CsvFile = FPaths::Combine(Directory, Name + TEXT(".csv"));
+	if (!Heatmap.ExportCsv(CsvFile))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Could not write the heatmap to %s"), *CsvFile);
+		return;
+	}
+	for (int32 Layer = 0; Layer < SearchHeatmap::LAYER_COUNT; Layer++)
+	{
+		const FString PngFile = FPaths::Combine(Directory, FString::Printf(TEXT("%s_%s.png"), *Name, SearchHeatmap::GetLayerName((SearchHeatmap::LAYER)Layer)));
+		if (!Heatmap.ExportPng(PngFile, (SearchHeatmap::LAYER)Layer, Grid))
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Could not write the heatmap to %s"), *PngFile);
+		}
+	}
+
+	UE_LOG(LogTemp, Display, TEXT("Search heatmap of map %s written to %s"), *MapName, *CsvFile);
+	Heatmap.LogStats();
+}
+
+void UPathfindingSubsystem::ShowHeatmap(SearchHeatmap::LAYER Layer)
+{
+	HeatmapOverlay = Layer;
+	NextOverlayTime = 0.0;
+}
+
+void UPathfindingSubsystem::UpdateEngineHeatmaps()
+{
+	for (const TUniquePtr<PathSearchEngine>& Engine : Engines)
+	{
+		Engine->SetHeatmap(Engine.Get() == ActiveEngine ? GetHeatmap() : nullptr);
+	}
+}
+
+void UPathfindingSubsystem::LogFrameAllocations() const
+{
+	// the first frame was only partly counted
+	TArray<int64> Counts;
+	int64 Total = 0;
+	int64 Bytes = 0;
+	for (int32 Frame = 1; Frame < FrameAllocations.Num(); Frame++)
+	{
+		Counts.Add(FrameAllocations[Frame]);
+		Total += FrameAllocations[Frame];
+		Bytes += FrameAllocationBytes[Frame];
+	}
+	if (Counts.Num() == 0)
+	{
+		return;
+	}
+	Counts.Sort();
+	UE_LOG(LogTemp, Display, TEXT("Heap allocations over %d frames: min %lld, median %lld, max %lld, mean %.1f per frame (%.1f KB)"),
+		Counts.Num(), Counts[0], Counts[Counts.Num() / 2], Counts.Last(), (double)Total / Counts.Num(), Bytes / 1024.0 / Counts.Num());
+
+	const FrameArena::FStats& Arena = FrameArena::Get().GetLastFrameStats();
+	UE_LOG(LogTemp, Display, TEXT("Frame arena: %d allocations of %.1f KB last frame, %d blocks from the heap, %.1f KB held"),
+		Arena.Allocations, Arena.Bytes / 1024.0, Arena.HeapAllocations, FrameArena::Get().GetReservedBytes() / 1024.0);
+}
+
+const FAnytimeSearchSetting* UPathfindingSubsystem::GetAnytimeSetting(FName AgentType) const
+{
+	const FAnytimeSearchSetting* Setting = AnytimeSettings.FindByPredicate([AgentType](const FAnytimeSearchSetting& Candidate)
+	{
+		return Candidate.AgentType == AgentType;
+	});
+	return Setting && Setting->InitialEpsilon > 1.f ? Setting : nullptr;
+}
+
+void UPathfindingSubsystem::RecordAnytimeSearch(FName AgentType, const AnytimeSearch& Search)
+{
+	if (Search.GetFirstCost() <= 0)
+	{
+		return;
+	}
+
+	FAnytimeStats& Stats = AnytimeStats.FindOrAdd(AgentType);
+	Stats.Searches++;
+	Stats.Optimal += Search.IsOptimal() ? 1 : 0;
+	Stats.FirstPathSeconds += Search.GetTimeToFirstPath();
+	Stats.MaxFirstPathSeconds = FMath::Max(Stats.MaxFirstPathSeconds, Search.GetTimeToFirstPath());
+	Stats.CostRatio += (double)Search.GetCurrentCostFromOrigin(Grid) / Search.GetFirstCost();
+}
+
+void UPathfindingSubsystem::SetNextMapName(const FString& Name)
+{
+	NextMapName = Name;
+}
+
+void UPathfindingSubsystem::SelectEngineForMap()
+{
+	for (const FMapEngineSetting& Setting : MapEngines)
+	{
+		if (MapName.StartsWith(Setting.MapPrefix) && SetActiveEngine(Setting.Engine))
+		{
+			UE_LOG(LogTemp, Log, TEXT("Map %s uses search engine %s"), *MapName, *Setting.Engine.ToString());
+			return;
+		}
+	}
+
+	if (DefaultEngine.IsNone() || !SetActiveEngine(DefaultEngine))
+	{
+		ActiveEngine = Engines.Num() > 0 ? Engines[0].Get() : nullptr;
+		UpdateEngineHeatmaps();
+	}
+}
+
+void UPathfindingSubsystem::RecordEngineStats(FName Engine, const FPathResult& Result)
+{
+	FEngineStats& Stats = EngineStats.FindOrAdd(Engine);
+	Stats.Queries++;
+	Stats.Expansions += Result.Expansions;
+	Stats.Seconds += Result.Seconds;
+	if (Result.bFound)
+	{
+		Stats.Found++;
+		Stats.Cost += Result.Cost;
+	}
+}
+
+bool UPathfindingSubsystem::StartTrace(const FString& FileName)
+{
+	if (!TraceWriter.Open(FileName))
+	{
+		return false;
+	}
+
+	UE_LOG(LogTemp, Log, TEXT("Recording path queries to %s"), *FileName);
+
+	// queries are relative to a map, so start with the one that is loaded
+	if (HasMap())
+	{
+		WriteTraceMap();
+	}
+	return true;
+}
+
+void UPathfindingSubsystem::StopTrace()
+{
+	TraceWriter.Close();
+}
+
+void UPathfindingSubsystem::WriteTraceMap()
+{
+	if (!TraceWriter.IsOpen())
+	{
+		return;
+	}
+
+	TraceWriter.WriteMap(MapId, MapLines, Grid, GetTracePreprocessing(), RoomDoorwayWidth);
+}
+
+uint8 UPathfindingSubsystem::GetTracePreprocessing() const
+{
+	uint8 Preprocessing = 0;
+	Preprocessing |= CurrentGoalBounds.IsValid() ? QueryTraceWriter::GoalBoundsPass : 0;
+	Preprocessing |= CurrentRooms.IsValid() ? QueryTraceWriter::RoomsPass : 0;
+	Preprocessing |= CurrentSubgoals.IsValid() ? QueryTraceWriter::SubgoalsPass : 0;
+	return Preprocessing;
+}
+
+int32 UPathfindingSubsystem::EditTerrain(const TArray<FIntPoint>& Cells, GridNode::GRID_TYPE NewType)
+{
+	TArray<FTerrainEdit> Edits;
+	Edits.Reserve(Cells.Num());
+	for (const FIntPoint& Cell : Cells)
+	{
+		Edits.Add(FTerrainEdit(Cell, NewType));
+	}
+	return EditTerrain(Edits);
+}
+
+int32 UPathfindingSubsystem::EditTerrain(const TArray<FTerrainEdit>& Edits)
+{
+	FTerrainChange Change;
+	Change.Min = FIntPoint(MAX_int32, MAX_int32);
+	Change.Max = FIntPoint(MIN_int32, MIN_int32);
+
+	const uint8 ObjectLayers = OccupancyGrid::LayerMask(OccupancyGrid::Agents) | OccupancyGrid::LayerMask(OccupancyGrid::Meat) | OccupancyGrid::LayerMask(OccupancyGrid::Vegetation);
+	FIntPoint CheaperMin(MAX_int32, MAX_int32);
+	FIntPoint CheaperMax(MIN_int32, MIN_int32);
+	TArray<FTerrainEdit> Changed;
+	for (const FTerrainEdit& Edit : Edits)
+	{
+		const FIntPoint& Cell = Edit.Key;
+		const GridNode::GRID_TYPE NewType = Edit.Value;
+		if (!Grid.IsInside(Cell.X, Cell.Y))
+		{
+			continue;
+		}
+		// nothing may stand in a wall
+		if (NewType == GridNode::Wall && Occupancy.IsBlocked(Cell.X, Cell.Y, ObjectLayers))
+		{
+			continue;
+		}
+		const float OldCost = Grid.GetTravelCost(Cell.X, Cell.Y);
+		if (!Grid.SetType(Cell.X, Cell.Y, NewType))
+		{
+			continue;
+		}
+		if (GridNode::GetTravelCost(NewType) < OldCost)
+		{
+			CheaperMin = FIntPoint(FMath::Min(CheaperMin.X, Cell.X), FMath::Min(CheaperMin.Y, Cell.Y));
+			CheaperMax = FIntPoint(FMath::Max(CheaperMax.X, Cell.X), FMath::Max(CheaperMax.Y, Cell.Y));
+		}
+
+		if (NewType == GridNode::Wall)
+		{
+			Occupancy.Set(Cell.X, Cell.Y, OccupancyGrid::Walls);
+		}
+		else
+		{
+			Occupancy.Clear(Cell.X, Cell.Y, OccupancyGrid::Walls);
+		}
+
+		// keep the map lines in step with the grid, for traces started later. Short lines are padded with the walls they stood for
+		if (Cell.X + 4 < MapLines.Num())
+		{
+			FString& Line = MapLines[Cell.X + 4];
+			while (Line.Len() <= Cell.Y)
+			{
+				Line.AppendChar(PathGrid::GetCharFromType(GridNode::Wall));
+			}
+			Line[Cell.Y] = PathGrid::GetCharFromType(NewType);
+		}
+
+		Change.Cells.Add(Cell);
+		Changed.Add(Edit);
+		Change.Min = FIntPoint(FMath::Min(Change.Min.X, Cell.X), FMath::Min(Change.Min.Y, Cell.Y));
+		Change.Max = FIntPoint(FMath::Max(Change.Max.X, Cell.X), FMath::Max(Change.Max.Y, Cell.Y));
+	}
+
+	if (Change.Cells.Num() == 0)
+	{
+		return 0;
+	}
+
+	// a chunk edited back to a single type only needs its type again
+	for (int ChunkX = Change.Min.X >> PathGrid::CHUNK_SHIFT; ChunkX <= Change.Max.X >> PathGrid::CHUNK_SHIFT; ChunkX++)
+	{
+		for (int ChunkY = Change.Min.Y >> PathGrid::CHUNK_SHIFT; ChunkY <= Change.Max.Y >> PathGrid::CHUNK_SHIFT; ChunkY++)
+		{
+			Grid.CompactChunk(ChunkX, ChunkY);
+		}
+	}
+
+	// a dearer cell only spoils the paths through it, a cheaper one also the paths that could now go through it
+	for (const FIntPoint& Cell : Change.Cells)
+	{
+		Cache.InvalidateCell(Grid, Cell.X, Cell.Y, MAX_uint8);
+	}
+	if (CheaperMin.X <= CheaperMax.X)
+	{
+		Cache.InvalidateCheaper(Grid, CheaperMin, CheaperMax);
+	}
+
+	// snapshots taken before keep the old terrain, the next one copies the new, and so does the next rebuild
+	SharedTerrain.Reset();
+	TerrainVersion++;
+	TraceWriter.WriteTerrain(Grid, Changed);
+
+	// every box of the goal bounds depends on the whole map, so they are built again in the background. Stale boxes
+	// could prune the only way left, so the engines search without any until then
+	if (CurrentGoalBounds.IsValid() || IsRebuildPending(TEXT("GoalBounding")))
+	{
+		UE_LOG(LogTemp, Log, TEXT("Terrain of %s changed, goal bounds building again"), *MapName);
+		InstallGoalBounds(nullptr);
+		QueueRebuild(TEXT("GoalBounding"), MakeGoalBoundingPass());
+	}
+
+	// doorways depend on the walls and on the cost of the ground across them, a room cut off by the edit would still be
+	// pruned as a dead end, so the engines go without rooms until they are decomposed again in the background
+	if (CurrentRooms.IsValid() || IsRebuildPending(TEXT("Rooms")))
+	{
+		InstallRooms(nullptr);
+		QueueRebuild(TEXT("Rooms"), MakeRoomPass());
+	}
+
+	// a changed cell moves the corners around it and the links of every subgoal seeing it, and a stale link could lead
+	// through a new wall, so the subgoal engine searches the grid itself until the graph is scanned again in the background
+	if (CurrentSubgoals.IsValid() || IsRebuildPending(TEXT("Subgoals")))
+	{
+		InstallSubgoals(nullptr);
+		QueueRebuild(TEXT("Subgoals"), MakeSubgoalPass());
+	}
+
+	// replays have to search with what the engines have now
+	TraceWriter.WritePreprocessing(GetTracePreprocessing(), RoomDoorwayWidth);
+	StartRebuild();
+
+	OnTerrainChanged.Broadcast(Change);
+	return Change.Cells.Num();
+}
+
+void UPathfindingSubsystem::RegisterFood(AFood* Food, GridNode* Node)
+{
+	Node->ObjectAtLocation = Food;
+	Occupancy.Set(Node->X, Node->Y, OccupancyGrid::GetFoodLayer(Food->Type));
+	FoodActors.Add(Food);
+
+	// the agents that do not eat this food cannot walk through it any more
+	Cache.InvalidateCell(Grid, Node->X, Node->Y, OccupancyGrid::LayerMask(OccupancyGrid::GetFoodLayer(Food->Type)));
+}
+
+void UPathfindingSubsystem::UnregisterFood(AFood* Food)
+{
+	FoodActors.Remove(Food);
+	Assignment.ReleaseFood(Food);
+	// the level generator puts food down again straight away
+	Events.Schedule(Events.GetTime(), EScheduledEvent::FoodRespawn, nullptr);
+
+	GridNode* Node = GetNodeAtLocation(Food->GetActorLocation());
+	if (!Node)
+	{
+		return;
+	}
+
+	Occupancy.Clear(Node->X, Node->Y, OccupancyGrid::GetFoodLayer(Food->Type));
+	if (Node->ObjectAtLocation == Food)
+	{
+		Node->ObjectAtLocation = nullptr;
+	}
+}
+
+bool UPathfindingSubsystem::OccupyNode(GridNode* Node, AActor* Agent)
+{
+	// only the holder of a cell writes its node, so the node needs no lock of its own
+	if (!Claims.TryClaim(Grid.GetIndex(Node->X, Node->Y), Agent->GetUniqueID()))
+	{
+		return false;
+	}
+	Node->ObjectAtLocation = Agent;
+	Occupancy.SetAtomic(Node->X, Node->Y, OccupancyGrid::Agents);
+	return true;
+}
+
+void UPathfindingSubsystem::ReleaseNode(GridNode* Node, AActor* Agent)
+{
+	if (!Claims.Release(Grid.GetIndex(Node->X, Node->Y), Agent->GetUniqueID()))
+	{
+		return;
+	}
+	// a food may have been put on the node since
+	if (Node->ObjectAtLocation == Agent)
+	{
+		Node->ObjectAtLocation = nullptr;
+	}
+	Occupancy.ClearAtomic(Node->X, Node->Y, OccupancyGrid::Agents);
+}
+
+void UPathfindingSubsystem::QueueRebuild(FName Name, FPreprocessPass Pass)
+{
+	PendingRebuilds.RemoveAll([Name](const TPair<FName, FPreprocessPass>& Rebuild)
+	{
+		return Rebuild.Key == Name;
+	});
+	PendingRebuilds.Add(TPair<FName, FPreprocessPass>(Name, Pass));
+}
+
+bool UPathfindingSubsystem::IsRebuildPending(FName Name) const
+{
+	return PendingRebuilds.ContainsByPredicate([Name](const TPair<FName, FPreprocessPass>& Rebuild)
+	{
+		return Rebuild.Key == Name;
+	});
+}
+
+void UPathfindingSubsystem::StartRebuild()
+{
+	if (bRebuildRunning || PendingRebuilds.Num() == 0 || !HasMap())
+	{
+		return;
+	}
+	bRebuildRunning = true;
+
+	// the passes read a copy of the terrain, the game thread keeps editing the grid meanwhile
+	const TSharedPtr<PathGrid, ESPMode::ThreadSafe> Terrain = GetSharedTerrain();
+	const TArray<TPair<FName, FPreprocessPass>> Passes = PendingRebuilds;
+	const uint32 Version = TerrainVersion;
+	TWeakObjectPtr<UPathfindingSubsystem> WeakThis(this);
+	RebuildFuture = Async(EAsyncExecution::ThreadPool, [Terrain, Passes, Version, WeakThis]()
+	{
+		const double StartTime = FPlatformTime::Seconds();
+		TArray<TPair<FName, FPreprocessCommit>> Commits;
+		for (const TPair<FName, FPreprocessPass>& Pass : Passes)
+		{
+			Commits.Add(TPair<FName, FPreprocessCommit>(Pass.Key, Pass.Value(*Terrain)));
+		}
+		const double Seconds = FPlatformTime::Seconds() - StartTime;
+
+		AsyncTask(ENamedThreads::GameThread, [Commits, Version, Seconds, WeakThis]()
+		{
+			UPathfindingSubsystem* This = WeakThis.Get();
+			if (!This)
+			{
+				return;
+			}
+
+			This->bRebuildRunning = false;
+			// built from terrain edited since, start over with the newest
+			if (Version == This->TerrainVersion)
+			{
+				for (const TPair<FName, FPreprocessCommit>& Commit : Commits)
+				{
+					This->PendingRebuilds.RemoveAll([&Commit](const TPair<FName, FPreprocessPass>& Rebuild)
+					{
+						return Rebuild.Key == Commit.Key;
+					});
+					if (Commit.Value)
+					{
+						Commit.Value();
+					}
+				}
+				UE_LOG(LogTemp, Log, TEXT("Rebuilt %d preprocess passes of %s in %.2f ms"), Commits.Num(), *This->MapName, Seconds * 1000.0);
+				This->TraceWriter.WritePreprocessing(This->GetTracePreprocessing(), This->RoomDoorwayWidth);
+			}
+			This->StartRebuild();
+		});
+	});
+}
+
+void UPathfindingSubsystem::RunPreprocessPass(FName Name, const FPreprocessPass& Pass)
+{
+	double StartTime = FPlatformTime::Seconds();
+	FPreprocessCommit Commit = Pass(Grid);
+	if (Commit)
+	{
+		Commit();
+	}
+	UE_LOG(LogTemp, Log, TEXT("Preprocess %s: %.2f ms"), *Name.ToString(), (FPlatformTime::Seconds() - StartTime) * 1000.0);
+}
@@ -0,0 +1,413 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "ActorPool.h"
+#include "ARAStarEngine.h"
+#include "CellClaims.h"
+#include "EventScheduler.h"
+#include "Food.h"
+#include "FoodAssignment.h"
+#include "GoalBounds.h"
+#include "GridNode.h"
+#include "MapLoadTask.h"
+#include "OccupancyGrid.h"
+#include "PathCache.h"
+#include "PathGrid.h"
+#include "PathSearch.h"
+#include "QueryTrace.h"
+#include "RoomGraph.h"
+#include "SearchHeatmap.h"
+#include "SubgoalGraph.h"
+#include "PathfindingSubsystem.generated.h"
+
+// Broadcast around publishing a new map
+DECLARE_MULTICAST_DELEGATE(FOnPathMapChanged);
+
+// The cells a terrain edit changed, the grid holds their new terrain
+struct FTerrainChange
+{
+	// The changed cells and the smallest rectangle around them (both corners inclusive)
+	TSet<FIntPoint> Cells;
+	FIntPoint Min;
+	FIntPoint Max;
+
+	// Was the cell changed, the rectangle rules out most cells without a lookup
+	bool Contains(int X, int Y) const
+	{
+		return X >= Min.X && Y >= Min.Y && X <= Max.X && Y <= Max.Y && Cells.Contains(FIntPoint(X, Y));
+	}
+};
+
+// Broadcast after a terrain edit
+DECLARE_MULTICAST_DELEGATE_OneParam(FOnTerrainChanged, const FTerrainChange&);
+
+// Picks the search engine for maps whose name starts with MapPrefix
+USTRUCT()
+struct FMapEngineSetting
+{
+	GENERATED_BODY()
+
+	UPROPERTY(Config)
+		FString MapPrefix;
+	UPROPERTY(Config)
+		FName Engine;
+};
+
+// The anytime search of one agent type (see AnytimeSearch)
+USTRUCT()
+struct FAnytimeSearchSetting
+{
+	GENERATED_BODY()
+
+	// "Carnivore" or "Herbivore"
+	UPROPERTY(Config)
+		FName AgentType;
+	// Bound on the first path, relative to the optimal. 1 means a plain optimal search for the type
+	UPROPERTY(Config)
+		float InitialEpsilon = 1.f;
+	// How much the bound drops with every improvement
+	UPROPERTY(Config)
+		float EpsilonStep = 0.5f;
+	// Time an agent of the type may spend improving its path every tick
+	UPROPERTY(Config)
+		float MaxImproveMilliseconds = 0.25f;
+};
+
+// How the anytime searches of an agent type did on the current map
+struct FAnytimeStats
+{
+	int32 Searches = 0;
+	int32 Optimal = 0;
+	double FirstPathSeconds = 0.0;
+	double MaxFirstPathSeconds = 0.0;
+	// Sum over searches of the final cost divided by the first, both from where the agent started
+	double CostRatio = 0.0;
+};
+
+// What a search engine did on the current map
+struct FEngineStats
+{
+	int32 Queries = 0;
+	int32 Found = 0;
+	int64 Cost = 0;
+	int64 Expansions = 0;
+	double Seconds = 0.0;
+};
+
+/**
+ * Owns the grid, the food registry and the path services of a world,
+ * so agents can reach them directly instead of searching the world for the level generator
+ */
+UCLASS(Config = Game)
+class FIT3094_A1_CODE_API UPathfindingSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+
+	// Subsystem lifetime
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	// Parse the map file lines, build the grid and run every registered preprocessing pass, all on the calling thread
+	bool LoadMap(const TArray<FString>& NewMapLines);
+
+	// Do the same on worker threads. The current map stays in use until the new one is published on the game thread,
+	// a newer load cancels one still in progress
+	void LoadMapAsync(const TArray<FString>& NewMapLines);
+	// Read the map file on a worker thread as well
+	void LoadMapFileAsync(const FString& MapPath);
+
+	// Is a map being loaded in the background, and how far it got (0 to 1)
+	bool IsLoadingMap() const
+	{
+		return PendingLoad.IsValid();
+	}
+	float GetLoadProgress() const;
+
+	// Broadcast on the game thread right before the current map is replaced, and right after the new one is in place
+	FOnPathMapChanged OnMapUnloading;
+	FOnPathMapChanged OnMapLoaded;
+
+	// Register a pass to be run after every map load, it also runs straight away if a map is loaded already.
+	// Passes registered while a load is in progress run when that load is published
+	void RegisterPreprocessPass(FName Name, FPreprocessPass Pass);
+	void UnregisterPreprocessPass(FName Name);
+
+	// Change the terrain of cells of the current map without reloading it. Cells outside the map, cells already of the type
+	// and walls under agents or food are skipped. Returns how many cells changed, OnTerrainChanged is broadcast when any did.
+	// Goal bounds, rooms and subgoals are left out of searches until they are built again in the background
+	int32 EditTerrain(const TArray<FIntPoint>& Cells, GridNode::GRID_TYPE NewType);
+	// The same for cells changed to different types, as one edit: one broadcast, one trace record and one rebuild
+	int32 EditTerrain(const TArray<FTerrainEdit>& Edits);
+
+	// Broadcast on the game thread after a terrain edit, so whatever was built on the old terrain is repaired in the changed area only
+	FOnTerrainChanged OnTerrainChanged;
+
+	// Is there a map loaded
+	bool HasMap() const
+	{
+		return Grid.SizeX > 0 && Grid.SizeY > 0;
+	}
+
+	// Get the node at a grid position, nullptr when outside the map
+	GridNode* GetNode(int X, int Y);
+
+	// Get the node under a world location, nullptr when outside the map
+	GridNode* GetNodeAtLocation(const FVector& Location);
+
+	// The heuristic distance between two nodes
+	float CalculateDistanceBetween(const GridNode* first, const GridNode* second) const;
+
+	// Answer a path query from the path cache or with the active search engine, recording it when a trace is running
+	bool FindPath(const FPathQuery& Query, FPathResult& OutResult);
+
+	// Answer a path query from the path cache only, for callers running their own search on a miss
+	bool FindCachedPath(const FPathQuery& Query, FPathResult& OutResult);
+	// Offer the cache an optimal path found outside FindPath
+	void CachePath(const FPathQuery& Query, const FPathResult& Result);
+
+	// Find a search engine by name, nullptr if there is no such engine
+	PathSearchEngine* GetEngine(FName Name) const;
+	// Pick the engine FindPath uses, returns false if there is no such engine
+	bool SetActiveEngine(FName Name);
+	PathSearchEngine* GetActiveEngine() const
+	{
+		return ActiveEngine;
+	}
+
+	// Log the expansions and time of every engine on the current map, side by side
+	void LogEngineStats() const;
+
+	// Count the heap allocations of every thread over the next frames and log them per frame once done
+	void CountFrameAllocations(int32 Frames);
+
+	// Start and stop counting the expansions of the active engine and the agents' searches, their plans and the nodes
+	// they found blocked, per cell (see SearchHeatmap). Each map's counts are exported when the next map replaces it
+	// and when the world ends, starting again clears them
+	void StartHeatmap();
+	void StopHeatmap();
+	// The heatmap to count into, nullptr when the profiler is off so recording costs a pointer test
+	SearchHeatmap* GetHeatmap()
+	{
+		return bRecordingHeatmap ? &Heatmap : nullptr;
+	}
+	// Write the counts of the current map to Saved/Heatmaps as Name.csv and a Name_Layer.png per layer
+	void ExportHeatmap(const FString& Name);
+	// Draw a layer over the map from now on, LAYER_COUNT to stop
+	void ShowHeatmap(SearchHeatmap::LAYER Layer);
+
+	// A copy of the terrain of the current map for snapshots (see SimSnapshot). Made once and shared by every snapshot
+	// until the terrain changes, nullptr without a map
+	TSharedPtr<PathGrid, ESPMode::ThreadSafe> GetSharedTerrain();
+
+	// The anytime search setting of an agent type, nullptr when the type searches optimally straight away
+	const FAnytimeSearchSetting* GetAnytimeSetting(FName AgentType) const;
+	// Add a finished anytime search to the statistics of its agent type
+	void RecordAnytimeSearch(FName AgentType, const AnytimeSearch& Search);
+
+	// Answer an agent's query from the path cache or with the first path of its anytime search, recorded, traced and
+	// compared with the engines like FindPath (under the engine name Anytime)
+	bool BeginAnytimePath(AnytimeSearch& Search, const FAnytimeSearchSetting& Setting, const FPathQuery& Query, FPathResult& OutResult);
+	// Spend a tick's budget improving an agent's anytime search, the work counts towards the Anytime statistics.
+	// Returns true with the better path in OutResult when an iteration completed
+	bool ImproveAnytimePath(AnytimeSearch& Search, const FAnytimeSearchSetting& Setting, FPathResult& OutResult);
+
+	// The game mode tells the subsystem which file the next map comes from, so per-map settings can be applied
+	void SetNextMapName(const FString& Name);
+
+	// Record every path query into a trace file (see QueryTraceWriter)
+	bool StartTrace(const FString& FileName);
+	void StopTrace();
+
+	// Put a food on a node and add it to the food registry
+	void RegisterFood(AFood* Food, GridNode* Node);
+	// Take a food off its node and out of the food registry, scheduling another to be put down
+	void UnregisterFood(AFood* Food);
+
+	// 'occupy' a node with an agent, so other agents cannot go through it. Fails when another agent holds the node.
+	// Both are safe to call from several threads at once, as long as the node's cell is not bid for in the same round
+	bool OccupyNode(GridNode* Node, AActor* Agent);
+	// 'release' a node the agent occupies, does nothing if something else is there now
+	void ReleaseNode(GridNode* Node, AActor* Agent);
+
+	// The grid of the currently loaded map
+	PathGrid Grid;
+
+	// Which cells are blocked by walls, agents and each type of food
+	OccupancyGrid Occupancy;
+
+	// Which agent holds every cell, the agent layer of Occupancy follows it
+	CellClaims Claims;
+
+	// Every food currently in the world
+	UPROPERTY()
+		TArray<AFood*> FoodActors;
+
+	// Recycles eaten food and starved agents instead of destroying and respawning them
+	ActorPool Pool;
+
+	// Matches the agents needing a goal to the food once per tick and keeps the claims
+	FoodAssignment Assignment;
+
+	// The paths found for earlier queries, for agents asking the same again
+	PathCache Cache;
+
+	// The events due at known times: agents arriving at nodes while asleep, their health dropping and food respawning.
+	// Advanced by the level generator every tick, on the world's clock
+	EventScheduler Events;
+
+	// The lines of the map file the grid was built from and a checksum identifying them
+	TArray<FString> MapLines;
+	uint32 MapId;
+
+	// The name of the map file (or the checksum when it is not known)
+	FString MapName;
+
+	// The engine used on maps without a setting, and the per-map settings
+	UPROPERTY(Config)
+		FName DefaultEngine;
+	UPROPERTY(Config)
+		TArray<FMapEngineSetting> MapEngines;
+
+	// Maps (by name prefix) that get goal bounds built when loaded, for maps with enough queries to pay for building them
+	UPROPERTY(Config)
+		TArray<FString> GoalBoundingMaps;
+	// Building is quadratic in the map size, larger maps are never bounded
+	UPROPERTY(Config)
+		int32 GoalBoundingMaxCells = 40000;
+
+	// Maps (by name prefix) that get decomposed into rooms when loaded, so searches skip the rooms that are dead ends.
+	// Worth it on maps of rooms joined by narrow doorways, building is linear in the map size
+	UPROPERTY(Config)
+		TArray<FString> RoomPruningMaps;
+	// Widest passage (in cells) that counts as a doorway
+	UPROPERTY(Config)
+		int32 RoomDoorwayWidth = 4;
+
+	// Maps (by name prefix) that get a subgoal graph built when loaded, for the Subgoal engine to search over.
+	// Worth it on maps of open areas between few corners, building is linear in the map size times the area a corner sees
+	UPROPERTY(Config)
+		TArray<FString> SubgoalGraphMaps;
+
+	// Memory the path cache may use, 0 turns it off
+	UPROPERTY(Config)
+		int32 PathCacheBudgetKB = 1024;
+
+	// Agent types that take a bounded-suboptimal path first and improve it while walking
+	UPROPERTY(Config)
+		TArray<FAnytimeSearchSetting> AnytimeSettings;
+
+private:
+
+	// Run one pass over the current grid, commit it and log how long it took
+	void RunPreprocessPass(FName Name, const FPreprocessPass& Pass);
+
+	// The registered passes plus the passes the map is configured for
+	TArray<TPair<FName, FPreprocessPass>> GetPassesForMap(const FString& Name);
+
+	// The pass building the goal bounds of a map, and installing them in the engines
+	FPreprocessPass MakeGoalBoundingPass();
+	void InstallGoalBounds(const TSharedPtr<GoalBounds, ESPMode::ThreadSafe>& Bounds);
+
+	// The pass decomposing a map into rooms, and installing them in the engines that prune with them
+	FPreprocessPass MakeRoomPass();
+	void InstallRooms(const TSharedPtr<RoomGraph, ESPMode::ThreadSafe>& Rooms);
+
+	// The pass building the subgoal graph of a map, and installing it in the engines searching over it
+	FPreprocessPass MakeSubgoalPass();
+	void InstallSubgoals(const TSharedPtr<SubgoalGraph, ESPMode::ThreadSafe>& Subgoals);
+
+	// Build a pass again over the edited terrain in the background, replacing a rebuild of the same name not started yet
+	void QueueRebuild(FName Name, FPreprocessPass Pass);
+	bool IsRebuildPending(FName Name) const;
+	// Run the queued rebuilds on the thread pool unless they already are, their commits wait for the game thread
+	void StartRebuild();
+
+	// Start running a load task on the thread pool
+	void StartLoad(const TSharedRef<MapLoadTask, ESPMode::ThreadSafe>& Task);
+	// Swap the results of a finished load in, on the game thread
+	void PublishMap(MapLoadTask& Task);
+
+	// Pick the engine configured for the current map
+	void SelectEngineForMap();
+
+	// Is the path cache answering queries, it stays out of the way of engine comparisons and traces
+	bool CanUseCache() const;
+
+	// Add a search result to the statistics of an engine
+	void RecordEngineStats(FName Engine, const FPathResult& Result);
+
+	// Start the trace over with the current map and the preprocessing installed for it
+	void WriteTraceMap();
+	// The preprocessing the engines search with, as QueryTraceWriter::PREPROCESSING bits
+	uint8 GetTracePreprocessing() const;
+
+	// Run a query answered by FindPath or BeginAnytimePath through every engine but Skip, when Path.CompareEngines is on
+	void CompareEngines(const FPathQuery& Query, const PathSearchEngine* Skip);
+
+	// Reset the frame arena of the game thread and take the allocation counts, at the end of every frame
+	void HandleEndFrame();
+	void LogFrameAllocations() const;
+
+	// Hand the heatmap to the active engine only, the others run for comparisons
+	void UpdateEngineHeatmaps();
+
+	// The registered passes, in registration order
+	TArray<TPair<FName, FPreprocessPass>> PreprocessPasses;
+
+	// Every available search engine and the one answering queries
+	TArray<TUniquePtr<PathSearchEngine>> Engines;
+	PathSearchEngine* ActiveEngine;
+
+	// Statistics per engine on the current map, and scratch for running the other engines in comparison mode
+	TMap<FName, FEngineStats> EngineStats;
+	TMap<FName, FAnytimeStats> AnytimeStats;
+	FPathResult CompareResult;
+
+	// The map name the game mode passed for the next load
+	FString NextMapName;
+
+	// The goal bounds of the current map, if it has any
+	TSharedPtr<GoalBounds, ESPMode::ThreadSafe> CurrentGoalBounds;
+
+	// The rooms of the current map, if it has them
+	TSharedPtr<RoomGraph, ESPMode::ThreadSafe> CurrentRooms;
+
+	// The subgoal graph of the current map, if it has one
+	TSharedPtr<SubgoalGraph, ESPMode::ThreadSafe> CurrentSubgoals;
+
+	// The terrain the snapshots of the current map share, made on the first snapshot
+	TSharedPtr<PathGrid, ESPMode::ThreadSafe> SharedTerrain;
+
+	// The background load in progress, if any
+	TSharedPtr<MapLoadTask, ESPMode::ThreadSafe> PendingLoad;
+	TFuture<void> PendingLoadFuture;
+
+	// The passes to build again after terrain edits, until their results are installed. A rebuild started before the
+	// latest edit (or map) is thrown away and started over
+	TArray<TPair<FName, FPreprocessPass>> PendingRebuilds;
+	uint32 TerrainVersion;
+	bool bRebuildRunning;
+	TFuture<void> RebuildFuture;
+
+	// Writes the queries to a file while a trace is running
+	QueryTraceWriter TraceWriter;
+
+	FDelegateHandle EndFrameHandle;
+
+	// The heap allocations of each frame counted so far, and the frames still to count
+	TArray<int64> FrameAllocations;
+	TArray<int64> FrameAllocationBytes;
+	int32 AllocationFramesLeft;
+
+	// The per-cell counts of the current map, the layer drawn over the map (LAYER_COUNT for none) and when it is drawn next
+	SearchHeatmap Heatmap;
+	bool bRecordingHeatmap;
+	SearchHeatmap::LAYER HeatmapOverlay;
+	double NextOverlayTime;
+
+};
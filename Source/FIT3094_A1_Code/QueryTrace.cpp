@@ -0,0 +1,469 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "QueryTrace.h"
+#include "GoalBounds.h"
+#include "RoomGraph.h"
+#include "SubgoalGraph.h"
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+#include "Serialization/MemoryReader.h"
+
+namespace
+{
+	// The derived data of the map being replayed, the engines point into it until the next map
+	struct FReplayPreprocessing
+	{
+		TUniquePtr<GoalBounds> Bounds;
+		TUniquePtr<RoomGraph> Rooms;
+		TUniquePtr<SubgoalGraph> Subgoals;
+
+		void Build(const PathGrid& Grid, uint8 Preprocessing, int32 RoomDoorwayWidth, const TArray<PathSearchEngine*>& Engines)
+		{
+			Install(Engines, true);
+			Bounds.Reset();
+			Rooms.Reset();
+			Subgoals.Reset();
+
+			if (Preprocessing & QueryTraceWriter::GoalBoundsPass)
+			{
+				Bounds = MakeUnique<GoalBounds>();
+				Bounds->Build(Grid);
+			}
+			if (Preprocessing & QueryTraceWriter::RoomsPass)
+			{
+				Rooms = MakeUnique<RoomGraph>();
+				Rooms->Build(Grid, RoomDoorwayWidth);
+			}
+			if (Preprocessing & QueryTraceWriter::SubgoalsPass)
+			{
+				Subgoals = MakeUnique<SubgoalGraph>();
+				Subgoals->Build(Grid);
+			}
+			Install(Engines, false);
+		}
+
+		// Hand the data to the engines, or take it away from them
+		void Install(const TArray<PathSearchEngine*>& Engines, bool bRemove) const
+		{
+			for (PathSearchEngine* Engine : Engines)
+			{
+				Engine->SetGoalBounds(bRemove ? nullptr : Bounds.Get());
+				Engine->SetRooms(bRemove ? nullptr : Rooms.Get());
+				Engine->SetSubgoals(bRemove ? nullptr : Subgoals.Get());
+			}
+		}
+	};
+}
+
+QueryTraceWriter::QueryTraceWriter()
+{
+	NumQueries = 0;
+	Archive = nullptr;
+	bHasMap = false;
+}
+
+QueryTraceWriter::~QueryTraceWriter()
+{
+	Close();
+}
+
+bool QueryTraceWriter::Open(const FString& FileName)
+{
+	Close();
+
+	Archive = IFileManager::Get().CreateFileWriter(*FileName);
+	if (!Archive)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Could not open query trace %s"), *FileName);
+		return false;
+	}
+
+	uint32 FileMagic = Magic;
+	uint32 FileVersion = Version;
+	*Archive << FileMagic;
+	*Archive << FileVersion;
+
+	NumQueries = 0;
+	bHasMap = false;
+	return true;
+}
+
+void QueryTraceWriter::Close()
+{
+	if (Archive)
+	{
+		Archive->Close();
+		delete Archive;
+		Archive = nullptr;
+		UE_LOG(LogTemp, Log, TEXT("Query trace closed, %d queries"), NumQueries);
+	}
+	Baseline.Reset();
+	bHasMap = false;
+}
+
+void QueryTraceWriter::WriteMap(uint32 MapId, const TArray<FString>& MapLines, const PathGrid& Grid, uint8 Preprocessing, int32 RoomDoorwayWidth)
+{
+	if (!Archive)
+	{
+		return;
+	}
+
+	uint8 Tag = MapRecord;
+	int32 NumLines = MapLines.Num();
+	*Archive << Tag;
+	*Archive << MapId;
+	*Archive << NumLines;
+	for (const FString& Line : MapLines)
+	{
+		FString Copy = Line;
+		*Archive << Copy;
+	}
+	*Archive << Preprocessing;
+	*Archive << RoomDoorwayWidth;
+
+	// the replay starts every map with only the walls, the first query then carries the agents and food
+	Baseline.Init(Grid);
+	bHasMap = true;
+}
+
+void QueryTraceWriter::WriteTerrain(const PathGrid& Grid, const TArray<FTerrainEdit>& Edits)
+{
+	if (!Archive || !bHasMap)
+	{
+		return;
+	}
+
+	// increasing cell indices, a cell edited twice keeps the order of its edits
+	TArray<FTerrainEdit> Sorted = Edits;
+	Sorted.StableSort([&Grid](const FTerrainEdit& A, const FTerrainEdit& B)
+	{
+		return Grid.GetIndex(A.Key.X, A.Key.Y) < Grid.GetIndex(B.Key.X, B.Key.Y);
+	});
+
+	uint8 Tag = TerrainRecord;
+	*Archive << Tag;
+	WriteVarInt(*Archive, Sorted.Num());
+	uint32 Previous = 0;
+	for (const FTerrainEdit& Edit : Sorted)
+	{
+		const uint32 Cell = (uint32)Grid.GetIndex(Edit.Key.X, Edit.Key.Y);
+		uint8 Type = (uint8)Edit.Value;
+		WriteVarInt(*Archive, Cell - Previous);
+		*Archive << Type;
+		Previous = Cell;
+
+		// the replay moves the walls with the terrain, so the next query must not carry them again
+		if (Edit.Value == GridNode::Wall)
+		{
+			Baseline.Set(Edit.Key.X, Edit.Key.Y, OccupancyGrid::Walls);
+		}
+		else
+		{
+			Baseline.Clear(Edit.Key.X, Edit.Key.Y, OccupancyGrid::Walls);
+		}
+	}
+}
+
+void QueryTraceWriter::WritePreprocessing(uint8 Preprocessing, int32 RoomDoorwayWidth)
+{
+	if (!Archive || !bHasMap)
+	{
+		return;
+	}
+
+	uint8 Tag = PreprocessingRecord;
+	*Archive << Tag;
+	*Archive << Preprocessing;
+	*Archive << RoomDoorwayWidth;
+}
+
+void QueryTraceWriter::WriteQuery(const OccupancyGrid& Occupancy, const FPathQuery& Query, const FPathResult& Result)
+{
+	if (!Archive || !bHasMap)
+	{
+		return;
+	}
+
+	uint8 Tag = QueryRecord;
+	uint16 StartX = (uint16)Query.Start.X;
+	uint16 StartY = (uint16)Query.Start.Y;
+	uint16 GoalX = (uint16)Query.Goal.X;
+	uint16 GoalY = (uint16)Query.Goal.Y;
+	uint8 BlockingLayers = Query.BlockingLayers;
+	*Archive << Tag;
+	*Archive << StartX;
+	*Archive << StartY;
+	*Archive << GoalX;
+	*Archive << GoalY;
+	*Archive << BlockingLayers;
+
+	// only the bits that changed since the previous query, as gaps between increasing indices
+	Occupancy.Diff(Baseline, ChangedBits);
+	WriteVarInt(*Archive, ChangedBits.Num());
+	uint32 Previous = 0;
+	for (uint32 Bit : ChangedBits)
+	{
+		WriteVarInt(*Archive, Bit - Previous);
+		Previous = Bit;
+	}
+	Baseline.ToggleBits(ChangedBits);
+
+	int32 Cost = Result.bFound ? Result.Cost : -1;
+	uint32 Expansions = (uint32)Result.Expansions;
+	float Micros = (float)(Result.Seconds * 1000000.0);
+	*Archive << Cost;
+	*Archive << Expansions;
+	*Archive << Micros;
+
+	NumQueries++;
+}
+
+void QueryTraceWriter::WriteVarInt(FArchive& Ar, uint32 Value)
+{
+	do
+	{
+		uint8 Byte = Value & 0x7f;
+		Value >>= 7;
+		if (Value)
+		{
+			Byte |= 0x80;
+		}
+		Ar << Byte;
+	} while (Value);
+}
+
+uint32 QueryTraceWriter::ReadVarInt(FArchive& Ar)
+{
+	uint32 Value = 0;
+	int Shift = 0;
+	uint8 Byte = 0;
+	do
+	{
+		Ar << Byte;
+		Value |= (uint32)(Byte & 0x7f) << Shift;
+		Shift += 7;
+	} while ((Byte & 0x80) && Shift < 35 && !Ar.IsError());
+	return Value;
+}
+
+bool QueryTraceReplayer::Replay(const FString& TraceFile, const TArray<PathSearchEngine*>& Engines, const FString& CsvFile, TArray<FEngineSummary>& OutSummaries)
+{
+	TArray<uint8> Bytes;
+	if (!FFileHelper::LoadFileToArray(Bytes, *TraceFile))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Could not read query trace %s"), *TraceFile);
+		return false;
+	}
+
+	FMemoryReader Reader(Bytes);
+	uint32 FileMagic = 0;
+	uint32 FileVersion = 0;
+	Reader << FileMagic;
+	Reader << FileVersion;
+	if (FileMagic != QueryTraceWriter::Magic || FileVersion != QueryTraceWriter::Version)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("%s is not a query trace this build can read"), *TraceFile);
+		return false;
+	}
+
+	// the recorded answers first, then one summary per engine
+	OutSummaries.Reset();
+	OutSummaries.AddDefaulted(Engines.Num() + 1);
+	OutSummaries[0].Engine = TEXT("Recorded");
+	for (int i = 0; i < Engines.Num(); i++)
+	{
+		OutSummaries[i + 1].Engine = Engines[i]->GetName();
+	}
+
+	TArray<FString> CsvLines;
+	CsvLines.Add(TEXT("Query,MapId,StartX,StartY,GoalX,GoalY,Engine,RecordedCost,Cost,CostDifference,RecordedMicros,Micros,Expansions"));
+
+	PathGrid Grid;
+	OccupancyGrid Occupancy;
+	uint32 MapId = 0;
+	bool bHasMap = false;
+	int QueryIndex = 0;
+	TArray<uint32> ChangedBits;
+	FPathResult Result;
+	TArray<FTerrainEdit> Edits;
+	FReplayPreprocessing Preprocessed;
+
+	while (!Reader.AtEnd() && !Reader.IsError())
+	{
+		uint8 Tag = 0;
+		Reader << Tag;
+
+		if (Tag == QueryTraceWriter::MapRecord)
+		{
+			int32 NumLines = 0;
+			Reader << MapId;
+			Reader << NumLines;
+			TArray<FString> MapLines;
+			MapLines.SetNum(NumLines);
+			for (FString& Line : MapLines)
+			{
+				Reader << Line;
+			}
+			uint8 Preprocessing = 0;
+			int32 RoomDoorwayWidth = 0;
+			Reader << Preprocessing;
+			Reader << RoomDoorwayWidth;
+
+			bHasMap = !Reader.IsError() && Grid.Load(MapLines);
+			if (bHasMap)
+			{
+				Occupancy.Init(Grid);
+				// the engines searched with whatever the session had built for the map, so build it again
+				Preprocessed.Build(Grid, Preprocessing, RoomDoorwayWidth, Engines);
+			}
+		}
+		else if (Tag == QueryTraceWriter::TerrainRecord)
+		{
+			// an index past the map becomes a cell outside it, skipped below
+			Edits.SetNum(QueryTraceWriter::ReadVarInt(Reader));
+			uint32 Previous = 0;
+			for (FTerrainEdit& Edit : Edits)
+			{
+				const uint32 Cell = Previous + QueryTraceWriter::ReadVarInt(Reader);
+				uint8 Type = 0;
+				Reader << Type;
+				Edit.Key = (int32)Cell < Grid.GetNumCells() ? Grid.GetPosition(Cell) : FIntPoint(-1, -1);
+				Edit.Value = (GridNode::GRID_TYPE)Type;
+				Previous = Cell;
+			}
+
+			if (!bHasMap || Reader.IsError())
+			{
+				continue;
+			}
+			// the preprocessing record following the edit says what the engines search with now
+			for (const FTerrainEdit& Edit : Edits)
+			{
+				if (!Grid.IsInside(Edit.Key.X, Edit.Key.Y))
+				{
+					continue;
+				}
+				Grid.SetType(Edit.Key.X, Edit.Key.Y, Edit.Value);
+				if (Edit.Value == GridNode::Wall)
+				{
+					Occupancy.Set(Edit.Key.X, Edit.Key.Y, OccupancyGrid::Walls);
+				}
+				else
+				{
+					Occupancy.Clear(Edit.Key.X, Edit.Key.Y, OccupancyGrid::Walls);
+				}
+			}
+		}
+		else if (Tag == QueryTraceWriter::PreprocessingRecord)
+		{
+			uint8 Preprocessing = 0;
+			int32 RoomDoorwayWidth = 0;
+			Reader << Preprocessing;
+			Reader << RoomDoorwayWidth;
+
+			if (bHasMap && !Reader.IsError())
+			{
+				Preprocessed.Build(Grid, Preprocessing, RoomDoorwayWidth, Engines);
+			}
+		}
+		else if (Tag == QueryTraceWriter::QueryRecord)
+		{
+			uint16 StartX, StartY, GoalX, GoalY;
+			uint8 BlockingLayers;
+			Reader << StartX;
+			Reader << StartY;
+			Reader << GoalX;
+			Reader << GoalY;
+			Reader << BlockingLayers;
+
+			// rebuild the occupancy the query saw
+			ChangedBits.SetNum(QueryTraceWriter::ReadVarInt(Reader));
+			uint32 Previous = 0;
+			for (uint32& Bit : ChangedBits)
+			{
+				Bit = Previous + QueryTraceWriter::ReadVarInt(Reader);
+				Previous = Bit;
+			}
+
+			int32 RecordedCost;
+			uint32 RecordedExpansions;
+			float RecordedMicros;
+			Reader << RecordedCost;
+			Reader << RecordedExpansions;
+			Reader << RecordedMicros;
+
+			if (!bHasMap || Reader.IsError())
+			{
+				continue;
+			}
+			Occupancy.ToggleBits(ChangedBits);
+
+			FEngineSummary& Recorded = OutSummaries[0];
+			Recorded.Queries++;
+			Recorded.Expansions += RecordedExpansions;
+			Recorded.Seconds += RecordedMicros / 1000000.0;
+			Recorded.MaxSeconds = FMath::Max(Recorded.MaxSeconds, RecordedMicros / 1000000.0);
+
+			FPathQuery Query;
+			Query.Start = FIntPoint(StartX, StartY);
+			Query.Goal = FIntPoint(GoalX, GoalY);
+			Query.BlockingLayers = BlockingLayers;
+
+			for (int i = 0; i < Engines.Num(); i++)
+			{
+				Engines[i]->FindPath(Grid, Occupancy, Query, Result);
+				const int32 Cost = Result.bFound ? Result.Cost : -1;
+
+				FEngineSummary& Summary = OutSummaries[i + 1];
+				Summary.Queries++;
+				Summary.Expansions += Result.Expansions;
+				Summary.Seconds += Result.Seconds;
+				Summary.MaxSeconds = FMath::Max(Summary.MaxSeconds, Result.Seconds);
+				if ((Cost < 0) != (RecordedCost < 0))
+				{
+					Summary.FoundMismatches++;
+				}
+				else if (Cost != RecordedCost)
+				{
+					Summary.CostMismatches++;
+					Summary.CostDifference += Cost - RecordedCost;
+				}
+
+				CsvLines.Add(FString::Printf(TEXT("%d,%u,%d,%d,%d,%d,%s,%d,%d,%d,%.1f,%.1f,%d"),
+					QueryIndex, MapId, StartX, StartY, GoalX, GoalY, *Summary.Engine.ToString(),
+					RecordedCost, Cost, (Cost >= 0 && RecordedCost >= 0) ? Cost - RecordedCost : 0,
+					RecordedMicros, Result.Seconds * 1000000.0, Result.Expansions));
+			}
+
+			QueryIndex++;
+		}
+		else
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Unknown record %d in query trace %s, stopping"), Tag, *TraceFile);
+			break;
+		}
+	}
+
+	// the engines outlive the data built for them
+	Preprocessed.Install(Engines, true);
+
+	if (!CsvFile.IsEmpty())
+	{
+		FFileHelper::SaveStringArrayToFile(CsvLines, *CsvFile);
+	}
+
+	return true;
+}
+
+void QueryTraceReplayer::LogSummaries(const TArray<FEngineSummary>& Summaries)
+{
+	for (const FEngineSummary& Summary : Summaries)
+	{
+		const double MeanMicros = Summary.Queries > 0 ? Summary.Seconds * 1000000.0 / Summary.Queries : 0.0;
+		const double MeanExpansions = Summary.Queries > 0 ? (double)Summary.Expansions / Summary.Queries : 0.0;
+		UE_LOG(LogTemp, Display, TEXT("%-20s queries %6d  mean %9.1f us  max %9.1f us  mean expansions %9.1f  cost mismatches %d (total %+lld)  found mismatches %d"),
+			*Summary.Engine.ToString(), Summary.Queries, MeanMicros, Summary.MaxSeconds * 1000000.0, MeanExpansions,
+			Summary.CostMismatches, Summary.CostDifference, Summary.FoundMismatches);
+	}
+}
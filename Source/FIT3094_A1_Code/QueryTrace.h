@@ -0,0 +1,120 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "OccupancyGrid.h"
+#include "PathGrid.h"
+#include "PathSearch.h"
+
+/**
+ * Records path queries into a compact binary trace so production workloads can be replayed later.
+ *
+ * The file is a header (magic, version) followed by records:
+ *  - Map: the map id, the lines of the map file, so the trace does not depend on the map files, and the preprocessing
+ *    installed for the map, so the replay searches with the same goal bounds, rooms and subgoals
+ *  - Query: start, goal, blocking layers, the occupancy bits that changed since the previous query
+ *    (delta encoded varints), and the cost, expansions and latency of the recorded answer
+ *  - Terrain: cells of the map given a new type, as delta encoded cell indices each followed by its type
+ *  - Preprocessing: the preprocessing the engines search with from here on, after an edit detached it or a
+ *    background rebuild installed it again
+ */
+class FIT3094_A1_CODE_API QueryTraceWriter
+{
+
+public:
+
+	static const uint32 Magic = 0x52545150; // "PQTR"
+	static const uint32 Version = 3;
+
+	// Record tags
+	enum RECORD_TYPE
+	{
+		MapRecord = 1,
+		QueryRecord = 2,
+		TerrainRecord = 3,
+		PreprocessingRecord = 4
+	};
+
+	// The preprocessing a map record can carry, as bits
+	enum PREPROCESSING
+	{
+		GoalBoundsPass = 1 << 0,
+		RoomsPass = 1 << 1,
+		SubgoalsPass = 1 << 2
+	};
+
+	QueryTraceWriter();
+	~QueryTraceWriter();
+
+	// Start writing a new trace file, closing any trace in progress
+	bool Open(const FString& FileName);
+	void Close();
+
+	bool IsOpen() const
+	{
+		return Archive != nullptr;
+	}
+
+	// Start a new map, every following query is relative to it. Preprocessing holds PREPROCESSING bits, the rooms
+	// are built with the doorway width given
+	void WriteMap(uint32 MapId, const TArray<FString>& MapLines, const PathGrid& Grid, uint8 Preprocessing, int32 RoomDoorwayWidth);
+
+	// Record cells of the current map changed to new types, the grid already holding the new terrain
+	void WriteTerrain(const PathGrid& Grid, const TArray<FTerrainEdit>& Edits);
+
+	// Record the preprocessing of the current map changing, with the same values as WriteMap
+	void WritePreprocessing(uint8 Preprocessing, int32 RoomDoorwayWidth);
+
+	// Record a query with the occupancy it saw and the answer it got
+	void WriteQuery(const OccupancyGrid& Occupancy, const FPathQuery& Query, const FPathResult& Result);
+
+	// Number of queries written to the current file
+	int NumQueries;
+
+	// Write an unsigned number in 7 bit groups, small numbers take one byte
+	static void WriteVarInt(FArchive& Ar, uint32 Value);
+	static uint32 ReadVarInt(FArchive& Ar);
+
+private:
+
+	FArchive* Archive;
+
+	// The occupancy as of the previous record, queries store the difference to it
+	OccupancyGrid Baseline;
+	bool bHasMap;
+
+	// Scratch for the changed bits, kept to avoid allocating per query
+	TArray<uint32> ChangedBits;
+
+};
+
+/**
+ * Reruns a recorded trace against search engines and reports latency and cost differences per query
+ */
+class FIT3094_A1_CODE_API QueryTraceReplayer
+{
+
+public:
+
+	// The totals of one engine over a replay
+	struct FEngineSummary
+	{
+		FName Engine;
+		int Queries = 0;
+		int CostMismatches = 0;
+		int FoundMismatches = 0;
+		int64 CostDifference = 0;
+		int64 Expansions = 0;
+		double Seconds = 0.0;
+		double MaxSeconds = 0.0;
+	};
+
+	// Replay every query of the trace against each engine, with the preprocessing of each map built again first. One CSV row per query and engine is written when CsvFile is not empty.
+	// The first summary holds the recorded answers, followed by one per engine
+	static bool Replay(const FString& TraceFile, const TArray<PathSearchEngine*>& Engines, const FString& CsvFile, TArray<FEngineSummary>& OutSummaries);
+
+	// Write the summaries to the log
+	static void LogSummaries(const TArray<FEngineSummary>& Summaries);
+
+};
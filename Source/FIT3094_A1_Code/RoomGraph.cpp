@@ -0,0 +1,520 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "RoomGraph.h"
+#include "FrameArena.h"
+#include "PathGrid.h"
+#include "PathSearch.h"
+#include "HAL/PlatformTime.h"
+
+namespace
+{
+	// A straight run of open cells walled in at both ends, a doorway if it is short enough
+	struct FRun
+	{
+		int32 X;
+		int32 Y;
+		int32 Length;
+		bool bAlongY;
+	};
+
+	// A region on the depth first search stack, the region it was reached from and the next of its links to follow
+	struct FVisit
+	{
+		int32 Region;
+		int32 Parent;
+		int32 Link;
+	};
+
+	// The set a component is in while the components meeting at a room are merged
+	int32 FindSet(TArray<int32, TFrameArenaAllocator<>>& Sets, int32 Set)
+	{
+		while (Sets[Set] != Set)
+		{
+			Sets[Set] = Sets[Sets[Set]];
+			Set = Sets[Set];
+		}
+		return Set;
+	}
+
+	// Is walking along the run between any two of its cells no dearer than stepping off it and back on around them.
+	// Stepping around enters at least one cell more than the gap, each costing at least as much as open ground
+	bool IsCheapToCross(const PathGrid& Grid, const FRun& Run)
+	{
+		const FIntPoint Step = Run.bAlongY ? FIntPoint(0, 1) : FIntPoint(1, 0);
+		for (int32 First = 0; First < Run.Length; First++)
+		{
+			float Between = 0.f;
+			for (int32 Last = First + 2; Last < Run.Length; Last++)
+			{
+				const FIntPoint Cell = FIntPoint(Run.X, Run.Y) + Step * (Last - 1);
+				Between += Grid.GetTravelCost(Cell.X, Cell.Y);
+				if (Between > (Last - First + 1) * GridNode::GetTravelCost(GridNode::Open))
+				{
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+}
+
+RoomMask::RoomMask()
+{
+	Generation = 0;
+}
+
+void RoomMask::Prepare(int32 NumNodes)
+{
+	if (Stamps.Num() != NumNodes)
+	{
+		// a different graph
+		Stamps.Init(0, NumNodes);
+		Generation = 0;
+	}
+
+	// a new generation unmarks every node without touching them
+	Generation++;
+	if (Generation == 0)
+	{
+		FMemory::Memzero(Stamps.GetData(), Stamps.Num() * sizeof(uint32));
+		Generation = 1;
+	}
+}
+
+RoomGraph::RoomGraph()
+{
+	NumRooms = 0;
+	LargestRoom = 0;
+	BuildSeconds = 0.0;
+}
+
+void RoomGraph::Build(const PathGrid& Grid, int32 MaxDoorwayWidth)
+{
+	const double StartTime = FPlatformTime::Seconds();
+	const int32 NumCells = Grid.GetNumCells();
+
+	// all the scratch only lives for the build
+	FrameArena::FMark Mark;
+
+	// the runs across passages narrow enough to be doorways, and cheap enough to walk along that a path never has a reason to leave one
+	TArray<FRun, TFrameArenaAllocator<>> Runs;
+	for (int32 Pass = 0; Pass < 2; Pass++)
+	{
+		const bool bAlongY = Pass == 0;
+		const int32 NumLines = bAlongY ? Grid.SizeX : Grid.SizeY;
+		const int32 LineLength = bAlongY ? Grid.SizeY : Grid.SizeX;
+		for (int32 Line = 0; Line < NumLines; Line++)
+		{
+			int32 First = 0;
+			for (int32 Step = 0; Step <= LineLength; Step++)
+			{
+				const int X = bAlongY ? Line : Step;
+				const int Y = bAlongY ? Step : Line;
+				const GridNode::GRID_TYPE Type = Step < LineLength ? Grid.GetType(X, Y) : GridNode::Wall;
+				if (Type != GridNode::Wall)
+				{
+					continue;
+				}
+
+				// the map edge walls a run in as well
+				const FRun Run = { bAlongY ? Line : First, bAlongY ? First : Line, Step - First, bAlongY };
+				if (Run.Length > 0 && Run.Length <= MaxDoorwayWidth && IsCheapToCross(Grid, Run))
+				{
+					Runs.Add(Run);
+				}
+				First = Step + 1;
+			}
+		}
+	}
+
+	// narrowest first, and never touching another doorway, so every doorway is a single run
+	Runs.StableSort([](const FRun& A, const FRun& B)
+	{
+		return A.Length < B.Length;
+	});
+	TArray<uint8, TFrameArenaAllocator<>> Doorways;
+	Doorways.SetNumZeroed(NumCells);
+	for (const FRun& Run : Runs)
+	{
+		const FIntPoint Step = Run.bAlongY ? FIntPoint(0, 1) : FIntPoint(1, 0);
+		bool bFree = true;
+		for (int32 Index = 0; Index < Run.Length && bFree; Index++)
+		{
+			const FIntPoint Cell = FIntPoint(Run.X, Run.Y) + Step * Index;
+			bFree = !Doorways[Grid.GetIndex(Cell.X, Cell.Y)];
+			for (int Direction = 0; Direction < 4 && bFree; Direction++)
+			{
+				const FIntPoint Next = Cell + PathSearchEngine::NeighbourOffsets[Direction];
+				bFree = !Grid.IsInside(Next.X, Next.Y) || !Doorways[Grid.GetIndex(Next.X, Next.Y)];
+			}
+		}
+
+		for (int32 Index = 0; Index < Run.Length && bFree; Index++)
+		{
+			const FIntPoint Cell = FIntPoint(Run.X, Run.Y) + Step * Index;
+			Doorways[Grid.GetIndex(Cell.X, Cell.Y)] = true;
+		}
+	}
+
+	// the regions: each doorway, and the open cells between them
+	TArray<int32, TFrameArenaAllocator<>> CellRegions;
+	TArray<uint8, TFrameArenaAllocator<>> RegionDoorways;
+	TArray<int32, TFrameArenaAllocator<>> Frontier;
+	CellRegions.Init(INDEX_NONE, NumCells);
+	for (int32 Cell = 0; Cell < NumCells; Cell++)
+	{
+		const FIntPoint Position = Grid.GetPosition(Cell);
+		if (CellRegions[Cell] != INDEX_NONE || Grid.GetType(Position.X, Position.Y) == GridNode::Wall)
+		{
+			continue;
+		}
+
+		const int32 Region = RegionDoorways.Add(Doorways[Cell]);
+		CellRegions[Cell] = Region;
+		Frontier.Add(Cell);
+		while (Frontier.Num() > 0)
+		{
+			const FIntPoint Current = Grid.GetPosition(Frontier.Pop(false));
+			for (int Direction = 0; Direction < 4; Direction++)
+			{
+				const FIntPoint Next = Current + PathSearchEngine::NeighbourOffsets[Direction];
+				if (!Grid.IsInside(Next.X, Next.Y) || Grid.GetType(Next.X, Next.Y) == GridNode::Wall)
+				{
+					continue;
+				}
+				const int32 NextCell = Grid.GetIndex(Next.X, Next.Y);
+				if (CellRegions[NextCell] == INDEX_NONE && Doorways[NextCell] == Doorways[Cell])
+				{
+					CellRegions[NextCell] = Region;
+					Frontier.Add(NextCell);
+				}
+			}
+		}
+	}
+	const int32 NumRegions = RegionDoorways.Num();
+
+	// the regions that touch, every link once, then as lists per region
+	TArray<FIntPoint, TFrameArenaAllocator<>> Links;
+	for (int32 Cell = 0; Cell < NumCells; Cell++)
+	{
+		if (CellRegions[Cell] == INDEX_NONE)
+		{
+			continue;
+		}
+		// right and down only, so every pair of cells is looked at once
+		const FIntPoint Position = Grid.GetPosition(Cell);
+		for (int Direction = 1; Direction <= 2; Direction++)
+		{
+			const FIntPoint Next = Position + PathSearchEngine::NeighbourOffsets[Direction];
+			const int32 Other = Grid.IsInside(Next.X, Next.Y) ? CellRegions[Grid.GetIndex(Next.X, Next.Y)] : INDEX_NONE;
+			if (Other != INDEX_NONE && Other != CellRegions[Cell])
+			{
+				Links.Add(FIntPoint(FMath::Min(Other, CellRegions[Cell]), FMath::Max(Other, CellRegions[Cell])));
+			}
+		}
+	}
+	Links.Sort([](const FIntPoint& A, const FIntPoint& B)
+	{
+		return A.X < B.X || (A.X == B.X && A.Y < B.Y);
+	});
+
+	TArray<int32, TFrameArenaAllocator<>> FirstLinks;
+	TArray<int32, TFrameArenaAllocator<>> Neighbours;
+	FirstLinks.SetNumZeroed(NumRegions + 1);
+	for (int32 Index = 0; Index < Links.Num(); Index++)
+	{
+		if (Index == 0 || Links[Index] != Links[Index - 1])
+		{
+			FirstLinks[Links[Index].X + 1]++;
+			FirstLinks[Links[Index].Y + 1]++;
+		}
+	}
+	for (int32 Region = 0; Region < NumRegions; Region++)
+	{
+		FirstLinks[Region + 1] += FirstLinks[Region];
+	}
+	TArray<int32, TFrameArenaAllocator<>> Filled;
+	Filled.SetNumZeroed(NumRegions);
+	Neighbours.SetNumUninitialized(FirstLinks[NumRegions]);
+	for (int32 Index = 0; Index < Links.Num(); Index++)
+	{
+		if (Index == 0 || Links[Index] != Links[Index - 1])
+		{
+			Neighbours[FirstLinks[Links[Index].X] + Filled[Links[Index].X]++] = Links[Index].Y;
+			Neighbours[FirstLinks[Links[Index].Y] + Filled[Links[Index].Y]++] = Links[Index].X;
+		}
+	}
+
+	// Tarjan's biconnected components of the regions, with explicit stacks as a winding passage is as deep as the map is large.
+	// Order is when the search first reached a region (0 not yet) and Low the earliest region the regions below it reach over
+	// one link back up. A region where components meet is a doorway of the tree, unless it is a room: a path can cross a
+	// room by any of its components, so they are merged into one room of the tree
+	TArray<int32, TFrameArenaAllocator<>> Order;
+	TArray<int32, TFrameArenaAllocator<>> Low;
+	TArray<uint8, TFrameArenaAllocator<>> Cuts;
+	Order.SetNumZeroed(NumRegions);
+	Low.SetNumUninitialized(NumRegions);
+	Cuts.SetNumZeroed(NumRegions);
+	TArray<FVisit, TFrameArenaAllocator<>> Stack;
+	TArray<int32, TFrameArenaAllocator<>> Pending;
+	TArray<int32, TFrameArenaAllocator<>> RootComponents;
+
+	// the component of every region (any of them for a room where several meet, the one above for a doorway that splits),
+	// and the doorway above every component, if it is below one
+	TArray<int32, TFrameArenaAllocator<>> RegionComponents;
+	TArray<int32, TFrameArenaAllocator<>> ComponentDoorways;
+	TArray<int32, TFrameArenaAllocator<>> ComponentSets;
+	RegionComponents.Init(INDEX_NONE, NumRegions);
+	auto AddComponent = [&ComponentDoorways, &ComponentSets]()
+	{
+		ComponentSets.Add(ComponentSets.Num());
+		return ComponentDoorways.Add(INDEX_NONE);
+	};
+	auto JoinRoom = [&RegionComponents, &ComponentSets](int32 Room, int32 Component)
+	{
+		if (RegionComponents[Room] == INDEX_NONE)
+		{
+			RegionComponents[Room] = Component;
+		}
+		else
+		{
+			ComponentSets[FindSet(ComponentSets, Component)] = FindSet(ComponentSets, RegionComponents[Room]);
+		}
+	};
+
+	int32 Counter = 0;
+	for (int32 Root = 0; Root < NumRegions; Root++)
+	{
+		if (Order[Root] != 0)
+		{
+			continue;
+		}
+
+		Order[Root] = Low[Root] = ++Counter;
+		Stack.Add({ Root, INDEX_NONE, FirstLinks[Root] });
+		Pending.Add(Root);
+
+		while (Stack.Num() > 0)
+		{
+			FVisit& Visit = Stack.Last();
+			if (Visit.Link < FirstLinks[Visit.Region + 1])
+			{
+				const int32 Region = Visit.Region;
+				const int32 Next = Neighbours[Visit.Link++];
+				if (Order[Next] == 0)
+				{
+					Order[Next] = Low[Next] = ++Counter;
+					Pending.Add(Next);
+					Stack.Add({ Next, Region, FirstLinks[Next] });
+				}
+				else if (Next != Visit.Parent)
+				{
+					Low[Region] = FMath::Min(Low[Region], Order[Next]);
+				}
+				continue;
+			}
+
+			// every link out of the region is done, what it reaches is reached from the region before it too
+			const int32 Region = Visit.Region;
+			const int32 Parent = Visit.Parent;
+			Stack.Pop(false);
+			if (Parent == INDEX_NONE)
+			{
+				continue;
+			}
+			Low[Parent] = FMath::Min(Low[Parent], Low[Region]);
+			if (Low[Region] < Order[Parent])
+			{
+				continue;
+			}
+
+			// nothing below the region gets around its parent: the regions found since it and the parent are a component
+			const int32 Component = AddComponent();
+			int32 Member;
+			do
+			{
+				Member = Pending.Pop(false);
+				if (!Cuts[Member] || RegionDoorways[Member])
+				{
+					RegionComponents[Member] = Component;
+				}
+				else
+				{
+					JoinRoom(Member, Component);
+				}
+			}
+			while (Member != Region);
+
+			// the root only splits if the search left it more than once, which is not known yet
+			if (Parent == Root)
+			{
+				RootComponents.Add(Component);
+			}
+			else
+			{
+				Cuts[Parent] = true;
+				if (RegionDoorways[Parent])
+				{
+					ComponentDoorways[Component] = Parent;
+				}
+				else
+				{
+					JoinRoom(Parent, Component);
+				}
+			}
+		}
+
+		if (RootComponents.Num() > 1)
+		{
+			Cuts[Root] = true;
+			for (const int32 Component : RootComponents)
+			{
+				if (RegionDoorways[Root])
+				{
+					ComponentDoorways[Component] = Root;
+				}
+				else
+				{
+					JoinRoom(Root, Component);
+				}
+			}
+		}
+		else
+		{
+			// a region touching no other is a component of its own
+			RegionComponents[Root] = RootComponents.Num() > 0 ? RootComponents[0] : AddComponent();
+		}
+		Pending.Reset();
+		RootComponents.Reset();
+	}
+
+	// number the rooms of the tree, then the doorways that split them
+	TArray<int32, TFrameArenaAllocator<>> SetRooms;
+	SetRooms.Init(INDEX_NONE, ComponentSets.Num());
+	NumRooms = 0;
+	for (int32 Component = 0; Component < ComponentSets.Num(); Component++)
+	{
+		const int32 Set = FindSet(ComponentSets, Component);
+		if (SetRooms[Set] == INDEX_NONE)
+		{
+			SetRooms[Set] = NumRooms++;
+		}
+	}
+	TArray<int32, TFrameArenaAllocator<>> RegionNodes;
+	RegionNodes.SetNumUninitialized(NumRegions);
+	int32 NumNodes = NumRooms;
+	for (int32 Region = 0; Region < NumRegions; Region++)
+	{
+		const bool bDoorway = Cuts[Region] && RegionDoorways[Region];
+		RegionNodes[Region] = bDoorway ? NumNodes++ : SetRooms[FindSet(ComponentSets, RegionComponents[Region])];
+	}
+
+	// a room's parent is the doorway above its top component, a doorway's the room it was found in
+	Parents.Init(INDEX_NONE, NumNodes);
+	for (int32 Component = 0; Component < ComponentSets.Num(); Component++)
+	{
+		if (ComponentDoorways[Component] != INDEX_NONE)
+		{
+			Parents[SetRooms[FindSet(ComponentSets, Component)]] = RegionNodes[ComponentDoorways[Component]];
+		}
+	}
+	for (int32 Region = 0; Region < NumRegions; Region++)
+	{
+		if (RegionNodes[Region] >= NumRooms && RegionComponents[Region] != INDEX_NONE)
+		{
+			Parents[RegionNodes[Region]] = SetRooms[FindSet(ComponentSets, RegionComponents[Region])];
+		}
+	}
+
+	TArray<int32, TFrameArenaAllocator<>> RoomSizes;
+	RoomSizes.SetNumZeroed(NumRooms);
+	CellNodes.Init(INDEX_NONE, NumCells);
+	for (int32 Cell = 0; Cell < NumCells; Cell++)
+	{
+		if (CellRegions[Cell] != INDEX_NONE)
+		{
+			CellNodes[Cell] = RegionNodes[CellRegions[Cell]];
+			if (CellNodes[Cell] < NumRooms)
+			{
+				RoomSizes[CellNodes[Cell]]++;
+			}
+		}
+	}
+	LargestRoom = 0;
+	for (const int32 Size : RoomSizes)
+	{
+		LargestRoom = FMath::Max(LargestRoom, Size);
+	}
+
+	// the depth of every node, going up only as far as a node whose depth is known
+	Depths.Init(INDEX_NONE, NumNodes);
+	TArray<int32, TFrameArenaAllocator<>> Chain;
+	for (int32 Node = 0; Node < NumNodes; Node++)
+	{
+		Chain.Reset();
+		int32 Up = Node;
+		while (Up != INDEX_NONE && Depths[Up] == INDEX_NONE)
+		{
+			Chain.Add(Up);
+			Up = Parents[Up];
+		}
+
+		int32 Depth = Up != INDEX_NONE ? Depths[Up] : -1;
+		for (int32 Index = Chain.Num() - 1; Index >= 0; Index--)
+		{
+			Depths[Chain[Index]] = ++Depth;
+		}
+	}
+
+	BuildSeconds = FPlatformTime::Seconds() - StartTime;
+}
+
+bool RoomGraph::MarkUsefulRooms(int StartCell, int GoalCell, RoomMask& Mask) const
+{
+	Mask.Prepare(Parents.Num());
+
+	int32 From = CellNodes[StartCell];
+	int32 To = CellNodes[GoalCell];
+	if (From == INDEX_NONE || To == INDEX_NONE)
+	{
+		return StartCell == GoalCell;
+	}
+
+	// a room holds the doorway above it as well
+	auto MarkNode = [this, &Mask](int32 Node)
+	{
+		Mask.Mark(Node);
+		if (Node < NumRooms && Parents[Node] != INDEX_NONE)
+		{
+			Mask.Mark(Parents[Node]);
+		}
+	};
+
+	// climb from both ends until they meet, every node passed is on the tree path between them
+	while (Depths[From] > Depths[To])
+	{
+		MarkNode(From);
+		From = Parents[From];
+	}
+	while (Depths[To] > Depths[From])
+	{
+		MarkNode(To);
+		To = Parents[To];
+	}
+	while (From != To)
+	{
+		MarkNode(From);
+		MarkNode(To);
+		From = Parents[From];
+		To = Parents[To];
+
+		// two roots, walls separate the cells
+		if (From == INDEX_NONE)
+		{
+			return false;
+		}
+	}
+	MarkNode(From);
+	return true;
+}
@@ -0,0 +1,108 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class PathGrid;
+
+/**
+ * Which rooms a search may enter, for one start and goal at a time (see RoomGraph::MarkUsefulRooms).
+ * Kept by the engine and cleared in O(1) between searches by bumping a generation, like SearchSpace
+ */
+class FIT3094_A1_CODE_API RoomMask
+{
+
+public:
+
+	RoomMask();
+
+private:
+
+	friend class RoomGraph;
+
+	// Forget the previous marks, with room for every room and doorway of the graph
+	void Prepare(int32 NumNodes);
+
+	void Mark(int32 Node)
+	{
+		Stamps[Node] = Generation;
+	}
+	bool IsMarked(int32 Node) const
+	{
+		return Stamps[Node] == Generation;
+	}
+
+	TArray<uint32> Stamps;
+	uint32 Generation;
+
+};
+
+/**
+ * Decomposition of the static map into rooms joined by doorways, for pruning the rooms that are dead ends.
+ *
+ * A doorway is a straight run across a passage, walled in at both ends, at most a few cells wide and cheap to walk along.
+ * The doorways that split the map and the rooms between them form a tree (the block-cut tree of the regions, with
+ * the parts meeting at a room merged into that room, as a path may cross a room through any of them). For a start
+ * and a goal, the rooms off the tree path between them are dead ends: a path going into one has to come back out
+ * through the same doorway, and walking along the doorway instead is never dearer (see Build). So with the
+ * terrain alone an optimal path never enters a dead end, and a search skipping them finds the same cost.
+ *
+ * Agents and food are not known here: one standing in a doorway can make a dead end the only way around it, so the
+ * pruned search can fail or take a detour and callers fall back to a full search when it fails.
+ * Building is linear in the size of the map
+ */
+class FIT3094_A1_CODE_API RoomGraph
+{
+
+public:
+
+	RoomGraph();
+
+	// Decompose the open cells of the grid, with doorways up to MaxDoorwayWidth cells wide
+	void Build(const PathGrid& Grid, int32 MaxDoorwayWidth);
+
+	// Mark the rooms and doorways a path from the start to the goal can go through. False when walls separate the
+	// cells (or either is a wall), in which case no search can find a path
+	bool MarkUsefulRooms(int StartCell, int GoalCell, RoomMask& Mask) const;
+
+	// Can a path between the cells of the last MarkUsefulRooms go through the cell
+	bool IsUseful(int Cell, const RoomMask& Mask) const
+	{
+		const int32 Node = CellNodes[Cell];
+		// a doorway is in its parent room too, and the rooms below it have it as their parent
+		return Node != INDEX_NONE && (Mask.IsMarked(Node) || (Node >= NumRooms && Parents[Node] != INDEX_NONE && Mask.IsMarked(Parents[Node])));
+	}
+
+	// Number of rooms, doorways splitting them and the cells (outside those doorways) of the largest room
+	int32 GetNumRooms() const
+	{
+		return NumRooms;
+	}
+	int32 GetNumDoorways() const
+	{
+		return Parents.Num() - NumRooms;
+	}
+	int32 LargestRoom;
+
+	// How long building took
+	double BuildSeconds;
+
+	// Memory used by the decomposition
+	int64 GetAllocatedSize() const
+	{
+		return CellNodes.GetAllocatedSize() + Parents.GetAllocatedSize() + Depths.GetAllocatedSize();
+	}
+
+private:
+
+	// The tree node of every cell, a room or (for the cells of a doorway that splits rooms) the doorway. INDEX_NONE for walls
+	TArray<int32> CellNodes;
+
+	// The tree: rooms come first, then doorways. A room's parent is a doorway in it and a doorway's parent is a room,
+	// INDEX_NONE at the root of each group of connected cells
+	TArray<int32> Parents;
+	TArray<int32> Depths;
+	int32 NumRooms;
+
+};
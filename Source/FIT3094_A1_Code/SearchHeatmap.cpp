@@ -0,0 +1,185 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SearchHeatmap.h"
+#include "PathGrid.h"
+#include "DrawDebugHelpers.h"
+#include "ImageUtils.h"
+#include "Misc/FileHelper.h"
+
+namespace
+{
+	const TCHAR* const LayerNames[SearchHeatmap::LAYER_COUNT] = { TEXT("Expansions"), TEXT("Replans"), TEXT("Blocks") };
+}
+
+SearchHeatmap::SearchHeatmap()
+{
+	Init(0, 0);
+}
+
+void SearchHeatmap::Init(int32 NewSizeX, int32 NewSizeY)
+{
+	SizeX = NewSizeX;
+	SizeY = NewSizeY;
+	for (int32 Layer = 0; Layer < LAYER_COUNT; Layer++)
+	{
+		Counts[Layer].Init(0, SizeX * SizeY);
+		Totals[Layer] = 0;
+	}
+}
+
+bool SearchHeatmap::IsEmpty() const
+{
+	for (int32 Layer = 0; Layer < LAYER_COUNT; Layer++)
+	{
+		if (Totals[Layer] > 0)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool SearchHeatmap::ExportCsv(const FString& FileName) const
+{
+	FString Csv = TEXT("X,Y");
+	for (int32 Layer = 0; Layer < LAYER_COUNT; Layer++)
+	{
+		Csv += TEXT(",");
+		Csv += LayerNames[Layer];
+	}
+	Csv += TEXT("\n");
+
+	for (int32 X = 0; X < SizeX; X++)
+	{
+		for (int32 Y = 0; Y < SizeY; Y++)
+		{
+			const int32 Cell = X * SizeY + Y;
+			if (Counts[Expansions][Cell] == 0 && Counts[Replans][Cell] == 0 && Counts[Blocks][Cell] == 0)
+			{
+				continue;
+			}
+			Csv += FString::Printf(TEXT("%d,%d,%u,%u,%u\n"), X, Y, Counts[Expansions][Cell], Counts[Replans][Cell], Counts[Blocks][Cell]);
+		}
+	}
+	return FFileHelper::SaveStringToFile(Csv, *FileName);
+}
+
+bool SearchHeatmap::ExportPng(const FString& FileName, LAYER Layer, const PathGrid& Grid) const
+{
+	if (SizeX == 0 || SizeY == 0 || Grid.SizeX != SizeX || Grid.SizeY != SizeY)
+	{
+		return false;
+	}
+
+	int32 MaxCell = INDEX_NONE;
+	const uint32 MaxCount = GetMaxCount(Layer, MaxCell);
+
+	// a row of the image per Y, as the map file lays the cells out
+	TArray<FColor> Pixels;
+	Pixels.SetNumUninitialized(SizeX * SizeY);
+	for (int32 Y = 0; Y < SizeY; Y++)
+	{
+		for (int32 X = 0; X < SizeX; X++)
+		{
+			const uint32 Count = Counts[Layer][X * SizeY + Y];
+			FColor& Pixel = Pixels[Y * SizeX + X];
+			if (Count > 0)
+			{
+				Pixel = GetHeatColor(GetHeat(Count, MaxCount));
+			}
+			else
+			{
+				Pixel = Grid.GetType(X, Y) == GridNode::Wall ? FColor(96, 96, 96) : FColor::Black;
+			}
+		}
+	}
+
+	TArray<uint8> Png;
+	FImageUtils::CompressImageArray(SizeX, SizeY, Pixels, Png);
+	return Png.Num() > 0 && FFileHelper::SaveArrayToFile(Png, *FileName);
+}
+
+void SearchHeatmap::DrawOverlay(UWorld* World, LAYER Layer, float CellSize, float LifeTime) const
+{
+	int32 MaxCell = INDEX_NONE;
+	const uint32 MaxCount = GetMaxCount(Layer, MaxCell);
+
+	// above the tiles and the food, the boxes hide nothing but the ground
+	const FVector Extent(CellSize * 0.5f, CellSize * 0.5f, 1.f);
+	for (int32 Cell = 0; Cell < Counts[Layer].Num(); Cell++)
+	{
+		const uint32 Count = Counts[Layer][Cell];
+		if (Count == 0)
+		{
+			continue;
+		}
+
+		FColor Color = GetHeatColor(GetHeat(Count, MaxCount));
+		Color.A = 160;
+		const FVector Center((Cell / SizeY) * CellSize, (Cell % SizeY) * CellSize, 60.f);
+		DrawDebugSolidBox(World, Center, Extent, Color, false, LifeTime);
+	}
+}
+
+void SearchHeatmap::LogStats() const
+{
+	for (int32 Layer = 0; Layer < LAYER_COUNT; Layer++)
+	{
+		int32 Cell = INDEX_NONE;
+		const uint32 MaxCount = GetMaxCount((LAYER)Layer, Cell);
+		if (Cell == INDEX_NONE)
+		{
+			UE_LOG(LogTemp, Log, TEXT("Heatmap %s: none"), LayerNames[Layer]);
+			continue;
+		}
+		UE_LOG(LogTemp, Log, TEXT("Heatmap %s: %lld in all, most at (%d, %d) with %u"), LayerNames[Layer], Totals[Layer], Cell / SizeY, Cell % SizeY, MaxCount);
+	}
+}
+
+SearchHeatmap::LAYER SearchHeatmap::GetLayer(const FString& Name)
+{
+	for (int32 Layer = 0; Layer < LAYER_COUNT; Layer++)
+	{
+		if (Name == LayerNames[Layer])
+		{
+			return (LAYER)Layer;
+		}
+	}
+	return LAYER_COUNT;
+}
+
+const TCHAR* SearchHeatmap::GetLayerName(LAYER Layer)
+{
+	return Layer < LAYER_COUNT ? LayerNames[Layer] : TEXT("None");
+}
+
+float SearchHeatmap::GetHeat(uint32 Count, uint32 MaxCount)
+{
+	// a few cells take most of the expansions, a linear scale would show little else
+	return MaxCount > 0 ? FMath::Loge(1.f + Count) / FMath::Loge(1.f + MaxCount) : 0.f;
+}
+
+FColor SearchHeatmap::GetHeatColor(float Heat)
+{
+	// dark blue through red and yellow to white
+	static const FLinearColor Stops[] = { FLinearColor(0.f, 0.f, 0.3f), FLinearColor(0.8f, 0.f, 0.f), FLinearColor(1.f, 0.9f, 0.f), FLinearColor::White };
+	const float Position = FMath::Clamp(Heat, 0.f, 1.f) * (UE_ARRAY_COUNT(Stops) - 1);
+	const int32 Stop = FMath::Min((int32)Position, (int32)UE_ARRAY_COUNT(Stops) - 2);
+	return FMath::Lerp(Stops[Stop], Stops[Stop + 1], Position - Stop).ToFColor(true);
+}
+
+uint32 SearchHeatmap::GetMaxCount(LAYER Layer, int32& OutCell) const
+{
+	uint32 MaxCount = 0;
+	OutCell = INDEX_NONE;
+	for (int32 Cell = 0; Cell < Counts[Layer].Num(); Cell++)
+	{
+		if (Counts[Layer][Cell] > MaxCount)
+		{
+			MaxCount = Counts[Layer][Cell];
+			OutCell = Cell;
+		}
+	}
+	return MaxCount;
+}
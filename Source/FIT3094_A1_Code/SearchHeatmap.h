@@ -0,0 +1,84 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class PathGrid;
+class UWorld;
+
+/**
+ * Per-cell counts of where the searches and the agents spend their effort on the current map: the cells the engines
+ * expanded, the cells agents planned again from and the nodes agents found blocked in front of them. Shows the choke
+ * points and the places the heuristic leads searches astray, which the totals of Path.Stats cannot.
+ *
+ * Only recording while switched on (see UPathfindingSubsystem::StartHeatmap): engines and agents are handed a pointer
+ * to it then, and nullptr otherwise, so a run without the profiler only tests a null pointer per expansion
+ */
+class FIT3094_A1_CODE_API SearchHeatmap
+{
+
+public:
+
+	enum LAYER
+	{
+		Expansions,
+		Replans,
+		Blocks,
+		LAYER_COUNT
+	};
+
+	SearchHeatmap();
+
+	// Size the layers to a map and clear them
+	void Init(int32 NewSizeX, int32 NewSizeY);
+
+	// Count one event at a cell (a grid index), cells outside the map the heatmap was sized for are ignored
+	void Add(LAYER Layer, int32 Cell)
+	{
+		if (Cell >= 0 && Cell < Counts[Layer].Num())
+		{
+			Counts[Layer][Cell]++;
+			Totals[Layer]++;
+		}
+	}
+	void AddExpansion(int32 Cell)
+	{
+		Add(Expansions, Cell);
+	}
+
+	// Is anything counted yet
+	bool IsEmpty() const;
+
+	// Write every cell with a count as a line of X, Y and the count of each layer
+	bool ExportCsv(const FString& FileName) const;
+	// Write a layer as a PNG image, a pixel per cell from dark blue to white on a log scale, walls grey
+	bool ExportPng(const FString& FileName, LAYER Layer, const PathGrid& Grid) const;
+
+	// Draw the cells of a layer with counts over the map as coloured boxes, for LifeTime seconds
+	void DrawOverlay(UWorld* World, LAYER Layer, float CellSize, float LifeTime) const;
+
+	// Write the totals and the busiest cells of every layer to the log
+	void LogStats() const;
+
+	// The layer of a name (as in the console commands), LAYER_COUNT for none
+	static LAYER GetLayer(const FString& Name);
+	static const TCHAR* GetLayerName(LAYER Layer);
+
+private:
+
+	// How hot a count is next to the busiest cell of its layer, 0 to 1 on a log scale
+	static float GetHeat(uint32 Count, uint32 MaxCount);
+	static FColor GetHeatColor(float Heat);
+
+	// The highest count of a layer and the cell it is at
+	uint32 GetMaxCount(LAYER Layer, int32& OutCell) const;
+
+	int32 SizeX;
+	int32 SizeY;
+
+	// The counts of every layer, indexed like PathGrid::GetIndex
+	TArray<uint32> Counts[LAYER_COUNT];
+	int64 Totals[LAYER_COUNT];
+
+};
@@ -0,0 +1,109 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ShardChannel.h"
+#include "HAL/PlatformProcess.h"
+#include "HAL/PlatformTime.h"
+#include "IPAddress.h"
+#include "Sockets.h"
+#include "SocketSubsystem.h"
+
+// Anything larger is a corrupt header rather than a message
+static const uint32 MaxMessageSize = 256 * 1024 * 1024;
+
+ShardChannel::ShardChannel(FSocket* InSocket)
+	: BytesSent(0)
+	, BytesReceived(0)
+	, Socket(InSocket)
+{
+}
+
+ShardChannel::~ShardChannel()
+{
+	if (Socket)
+	{
+		Socket->Close();
+		ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM)->DestroySocket(Socket);
+	}
+}
+
+FSocket* ShardChannel::ConnectToCoordinator(int32 Port, float TimeoutSeconds)
+{
+	ISocketSubsystem* SocketSubsystem = ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM);
+	TSharedRef<FInternetAddr> Address = SocketSubsystem->CreateInternetAddr();
+	bool bIsValid = false;
+	Address->SetIp(TEXT("127.0.0.1"), bIsValid);
+	Address->SetPort(Port);
+
+	// the coordinator may still be starting the other workers, keep trying until the timeout
+	const double Deadline = FPlatformTime::Seconds() + TimeoutSeconds;
+	while (true)
+	{
+		FSocket* NewSocket = SocketSubsystem->CreateSocket(NAME_Stream, TEXT("ShardWorker"), false);
+		if (NewSocket && NewSocket->Connect(*Address))
+		{
+			// messages are sent whole and waited for, batching them up only adds latency
+			NewSocket->SetNoDelay(true);
+			return NewSocket;
+		}
+		if (NewSocket)
+		{
+			SocketSubsystem->DestroySocket(NewSocket);
+		}
+		if (FPlatformTime::Seconds() > Deadline)
+		{
+			return nullptr;
+		}
+		FPlatformProcess::Sleep(0.1f);
+	}
+}
+
+bool ShardChannel::SendMessage(const TArray<uint8>& Message)
+{
+	uint32 Length = (uint32)Message.Num();
+	return SendAll((const uint8*)&Length, sizeof(Length)) && SendAll(Message.GetData(), Message.Num());
+}
+
+bool ShardChannel::ReceiveMessage(TArray<uint8>& OutMessage)
+{
+	uint32 Length = 0;
+	if (!ReceiveAll((uint8*)&Length, sizeof(Length)) || Length > MaxMessageSize)
+	{
+		return false;
+	}
+	OutMessage.SetNumUninitialized(Length, false);
+	return ReceiveAll(OutMessage.GetData(), Length);
+}
+
+bool ShardChannel::SendAll(const uint8* Data, int32 Count)
+{
+	while (Count > 0)
+	{
+		int32 Sent = 0;
+		if (!Socket || !Socket->Send(Data, Count, Sent) || Sent <= 0)
+		{
+			return false;
+		}
+		Data += Sent;
+		Count -= Sent;
+		BytesSent += Sent;
+	}
+	return true;
+}
+
+bool ShardChannel::ReceiveAll(uint8* Data, int32 Count)
+{
+	while (Count > 0)
+	{
+		// a blocking receive of nothing means the other side closed the connection
+		int32 Read = 0;
+		if (!Socket || !Socket->Recv(Data, Count, Read) || Read <= 0)
+		{
+			return false;
+		}
+		Data += Read;
+		Count -= Read;
+		BytesReceived += Read;
+	}
+	return true;
+}
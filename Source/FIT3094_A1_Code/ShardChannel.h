@@ -0,0 +1,76 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+
+class FSocket;
+
+/**
+ * A blocking message channel between the shard coordinator and one worker process, over a loopback TCP socket.
+ * Every message is its length followed by the bytes of one value serialized with an FArchive
+ */
+class FIT3094_A1_CODE_API ShardChannel
+{
+
+public:
+
+	// Takes ownership of the socket
+	explicit ShardChannel(FSocket* InSocket);
+	~ShardChannel();
+
+	// Connect to a coordinator listening on this machine, nullptr when it cannot be reached within the timeout
+	static FSocket* ConnectToCoordinator(int32 Port, float TimeoutSeconds);
+
+	bool IsValid() const
+	{
+		return Socket != nullptr;
+	}
+
+	FSocket* GetSocket() const
+	{
+		return Socket;
+	}
+
+	// Send and receive one raw message, false when the other side is gone
+	bool SendMessage(const TArray<uint8>& Message);
+	bool ReceiveMessage(TArray<uint8>& OutMessage);
+
+	// Send and receive one value with an operator<< for FArchive
+	template<typename ValueType>
+	bool Send(ValueType& Value)
+	{
+		Scratch.Reset();
+		FMemoryWriter Writer(Scratch);
+		Writer << Value;
+		return SendMessage(Scratch);
+	}
+	template<typename ValueType>
+	bool Receive(ValueType& OutValue)
+	{
+		if (!ReceiveMessage(Scratch))
+		{
+			return false;
+		}
+		FMemoryReader Reader(Scratch);
+		Reader << OutValue;
+		return !Reader.IsError();
+	}
+
+	// Bytes moved over the channel so far, headers included
+	int64 BytesSent;
+	int64 BytesReceived;
+
+private:
+
+	bool SendAll(const uint8* Data, int32 Count);
+	bool ReceiveAll(uint8* Data, int32 Count);
+
+	FSocket* Socket;
+
+	// The message being sent or received, kept to avoid allocating per message
+	TArray<uint8> Scratch;
+
+};
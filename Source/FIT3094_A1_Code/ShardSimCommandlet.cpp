@@ -0,0 +1,348 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ShardSimCommandlet.h"
+#include "ShardChannel.h"
+#include "ShardSimulation.h"
+#include "HAL/PlatformProcess.h"
+#include "HAL/PlatformTime.h"
+#include "IPAddress.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Sockets.h"
+#include "SocketSubsystem.h"
+
+UShardSimCommandlet::UShardSimCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = false;
+	LogToConsole = true;
+}
+
+int32 UShardSimCommandlet::Main(const FString& Params)
+{
+	FShardSimSettings Settings;
+	if (!ParseSettings(Params, Settings))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Usage: -run=ShardSim -Map=<file> [-Shards=4] [-Agents=1000] [-Steps=200] [-Port=47810] [-Seed=1] [-Timeout=120] [-NoSpawn] [-InProcess]"));
+		return 1;
+	}
+
+	int32 ShardIndex = 0;
+	if (FParse::Param(*Params, TEXT("Worker")) && FParse::Value(*Params, TEXT("Shard="), ShardIndex))
+	{
+		return RunWorker(Settings, ShardIndex);
+	}
+	if (FParse::Param(*Params, TEXT("InProcess")))
+	{
+		return RunInProcess(Settings);
+	}
+	return RunCoordinator(Settings, !FParse::Param(*Params, TEXT("NoSpawn")));
+}
+
+bool UShardSimCommandlet::ParseSettings(const FString& Params, FShardSimSettings& OutSettings)
+{
+	if (!FParse::Value(*Params, TEXT("Map="), OutSettings.MapFile))
+	{
+		return false;
+	}
+	OutSettings.MapFile = FPaths::ConvertRelativePathToFull(OutSettings.MapFile);
+
+	// the coordinator is given the total, workers are given their share
+	int32 TotalAgents = 1000;
+	FParse::Value(*Params, TEXT("Shards="), OutSettings.NumShards);
+	OutSettings.NumShards = FMath::Max(1, OutSettings.NumShards);
+	if (FParse::Value(*Params, TEXT("Agents="), TotalAgents))
+	{
+		OutSettings.AgentsPerShard = FParse::Param(*Params, TEXT("Worker")) ? TotalAgents : FMath::DivideAndRoundUp(TotalAgents, OutSettings.NumShards);
+	}
+	else
+	{
+		OutSettings.AgentsPerShard = FMath::DivideAndRoundUp(TotalAgents, OutSettings.NumShards);
+	}
+	FParse::Value(*Params, TEXT("Steps="), OutSettings.Steps);
+	FParse::Value(*Params, TEXT("Port="), OutSettings.Port);
+	FParse::Value(*Params, TEXT("Seed="), OutSettings.Seed);
+	FParse::Value(*Params, TEXT("Timeout="), OutSettings.TimeoutSeconds);
+	return true;
+}
+
+bool UShardSimCommandlet::LoadMapLines(const FString& MapFile, TArray<FString>& OutLines)
+{
+	FString MapText;
+	if (!FFileHelper::LoadFileToString(MapText, *MapFile))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Cannot read map %s"), *MapFile);
+		return false;
+	}
+	MapText.ParseIntoArrayLines(OutLines);
+	return true;
+}
+
+int32 UShardSimCommandlet::RunCoordinator(const FShardSimSettings& Settings, bool bSpawnWorkers)
+{
+	TArray<FString> MapLines;
+	if (!LoadMapLines(Settings.MapFile, MapLines))
+	{
+		return 1;
+	}
+
+	// only workers on this machine may connect
+	ISocketSubsystem* SocketSubsystem = ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM);
+	TSharedRef<FInternetAddr> Address = SocketSubsystem->CreateInternetAddr();
+	bool bIsValid = false;
+	Address->SetIp(TEXT("127.0.0.1"), bIsValid);
+	Address->SetPort(Settings.Port);
+
+	ShardChannel Listener(SocketSubsystem->CreateSocket(NAME_Stream, TEXT("ShardCoordinator"), false));
+	FSocket* ListenSocket = Listener.GetSocket();
+	if (!ListenSocket || !ListenSocket->SetReuseAddr(true) || !ListenSocket->Bind(*Address) || !ListenSocket->Listen(Settings.NumShards))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Cannot listen on port %d"), Settings.Port);
+		return 1;
+	}
+
+	TArray<FProcHandle> Workers;
+	if (bSpawnWorkers)
+	{
+		const FString ProjectFile = FPaths::ConvertRelativePathToFull(FPaths::GetProjectFilePath());
+		for (int32 Shard = 0; Shard < Settings.NumShards; Shard++)
+		{
+			const FString WorkerParams = FString::Printf(TEXT("\"%s\" -run=ShardSim -Worker -Shard=%d -Map=\"%s\" -Shards=%d -Agents=%d -Port=%d -Seed=%d -Timeout=%f -unattended -nopause -nosplash"),
+				*ProjectFile, Shard, *Settings.MapFile, Settings.NumShards, Settings.AgentsPerShard, Settings.Port, Settings.Seed, Settings.TimeoutSeconds);
+			FProcHandle Worker = FPlatformProcess::CreateProc(FPlatformProcess::ExecutablePath(), *WorkerParams, false, true, true, nullptr, 0, nullptr, nullptr);
+			if (!Worker.IsValid())
+			{
+				UE_LOG(LogTemp, Error, TEXT("Cannot start worker %d"), Shard);
+				StopWorkers(Workers);
+				return 1;
+			}
+			Workers.Add(Worker);
+		}
+	}
+
+	// every worker says which shard it runs first, they may connect in any order
+	TArray<TUniquePtr<ShardChannel>> Channels;
+	Channels.SetNum(Settings.NumShards);
+	for (int32 Connected = 0; Connected < Settings.NumShards; Connected++)
+	{
+		bool bPending = false;
+		if (!ListenSocket->WaitForPendingConnection(bPending, FTimespan::FromSeconds(Settings.TimeoutSeconds)) || !bPending)
+		{
+			UE_LOG(LogTemp, Error, TEXT("Only %d of %d workers connected"), Connected, Settings.NumShards);
+			StopWorkers(Workers);
+			return 1;
+		}
+
+		TUniquePtr<ShardChannel> Channel = MakeUnique<ShardChannel>(ListenSocket->Accept(TEXT("ShardWorker")));
+		int32 ShardIndex = INDEX_NONE;
+		if (!Channel->IsValid() || !Channel->Receive(ShardIndex) || !Channels.IsValidIndex(ShardIndex) || Channels[ShardIndex].IsValid())
+		{
+			UE_LOG(LogTemp, Error, TEXT("A worker sent a bad hello"));
+			StopWorkers(Workers);
+			return 1;
+		}
+		Channel->GetSocket()->SetNoDelay(true);
+		Channels[ShardIndex] = MoveTemp(Channel);
+	}
+
+	UE_LOG(LogTemp, Log, TEXT("%d workers connected, simulating %d steps"), Settings.NumShards, Settings.Steps);
+
+	// step -1 is the state after spawning, every later step is one move of every agent
+	TArray<FShardStepOut> Outs;
+	TArray<FShardStepIn> Ins;
+	Outs.SetNum(Settings.NumShards);
+	int32 TotalAgents = INDEX_NONE;
+	const double StartTime = FPlatformTime::Seconds();
+	for (int32 Step = -1; Step < Settings.Steps; Step++)
+	{
+		for (int32 Shard = 0; Shard < Settings.NumShards; Shard++)
+		{
+			if (!Channels[Shard]->Receive(Outs[Shard]) || Outs[Shard].Step != Step)
+			{
+				UE_LOG(LogTemp, Error, TEXT("Lost worker %d at step %d"), Shard, Step);
+				StopWorkers(Workers);
+				return 1;
+			}
+		}
+
+		// agents are only ever moved between shards, never made or lost
+		int32 Agents = 0;
+		for (const FShardStepOut& Out : Outs)
+		{
+			Agents += Out.Stats.Agents + Out.MigrantsBefore.Num() + Out.MigrantsAfter.Num();
+		}
+		if (TotalAgents != INDEX_NONE && Agents != TotalAgents)
+		{
+			UE_LOG(LogTemp, Error, TEXT("Step %d: %d agents instead of %d"), Step, Agents, TotalAgents);
+		}
+		TotalAgents = Agents;
+
+		ShardSimulation::Route(Outs, Ins);
+		for (int32 Shard = 0; Shard < Settings.NumShards; Shard++)
+		{
+			Ins[Shard].bQuit = Step == Settings.Steps - 1;
+			if (!Channels[Shard]->Send(Ins[Shard]))
+			{
+				UE_LOG(LogTemp, Error, TEXT("Lost worker %d at step %d"), Shard, Step);
+				StopWorkers(Workers);
+				return 1;
+			}
+		}
+	}
+	const double Seconds = FPlatformTime::Seconds() - StartTime;
+
+	// the final statistics include the migrants of the last exchange
+	TArray<FShardStats> Stats;
+	Stats.SetNum(Settings.NumShards);
+	int64 BytesExchanged = 0;
+	for (int32 Shard = 0; Shard < Settings.NumShards; Shard++)
+	{
+		if (!Channels[Shard]->Receive(Stats[Shard]))
+		{
+			UE_LOG(LogTemp, Error, TEXT("Lost worker %d before its statistics"), Shard);
+			StopWorkers(Workers);
+			return 1;
+		}
+		BytesExchanged += Channels[Shard]->BytesSent + Channels[Shard]->BytesReceived;
+	}
+	LogResults(Settings, Stats, Seconds, BytesExchanged);
+
+	for (FProcHandle& Worker : Workers)
+	{
+		FPlatformProcess::WaitForProc(Worker);
+		FPlatformProcess::CloseProc(Worker);
+	}
+	return 0;
+}
+
+void UShardSimCommandlet::StopWorkers(TArray<FProcHandle>& Workers)
+{
+	// the others would wait for the coordinator until their timeout
+	for (FProcHandle& Worker : Workers)
+	{
+		if (FPlatformProcess::IsProcRunning(Worker))
+		{
+			FPlatformProcess::TerminateProc(Worker);
+		}
+		FPlatformProcess::CloseProc(Worker);
+	}
+	Workers.Empty();
+}
+
+int32 UShardSimCommandlet::RunWorker(const FShardSimSettings& Settings, int32 ShardIndex)
+{
+	TArray<FString> MapLines;
+	ShardSimulation Simulation;
+	if (!LoadMapLines(Settings.MapFile, MapLines) || !Simulation.Init(MapLines, ShardIndex, Settings.NumShards, Settings.Seed))
+	{
+		return 1;
+	}
+	Simulation.SpawnAgents(Settings.AgentsPerShard, ShardIndex * Settings.AgentsPerShard);
+
+	ShardChannel Channel(ShardChannel::ConnectToCoordinator(Settings.Port, Settings.TimeoutSeconds));
+	if (!Channel.IsValid() || !Channel.Send(ShardIndex))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Shard %d cannot reach the coordinator on port %d"), ShardIndex, Settings.Port);
+		return 1;
+	}
+
+	FShardStepOut Out;
+	FShardStepIn In;
+	Simulation.Publish(-1, Out);
+	while (Channel.Send(Out) && Channel.Receive(In))
+	{
+		Simulation.Apply(In);
+		if (In.bQuit)
+		{
+			Channel.Send(Simulation.Stats);
+			return 0;
+		}
+
+		Simulation.Step(In.Step + 1);
+		Simulation.Publish(In.Step + 1, Out);
+	}
+
+	UE_LOG(LogTemp, Error, TEXT("Shard %d lost the coordinator"), ShardIndex);
+	return 1;
+}
+
+int32 UShardSimCommandlet::RunInProcess(const FShardSimSettings& Settings)
+{
+	TArray<FString> MapLines;
+	if (!LoadMapLines(Settings.MapFile, MapLines))
+	{
+		return 1;
+	}
+
+	TArray<TUniquePtr<ShardSimulation>> Shards;
+	for (int32 Shard = 0; Shard < Settings.NumShards; Shard++)
+	{
+		TUniquePtr<ShardSimulation> Simulation = MakeUnique<ShardSimulation>();
+		if (!Simulation->Init(MapLines, Shard, Settings.NumShards, Settings.Seed))
+		{
+			return 1;
+		}
+		Simulation->SpawnAgents(Settings.AgentsPerShard, Shard * Settings.AgentsPerShard);
+		Shards.Add(MoveTemp(Simulation));
+	}
+
+	// the same exchange as between processes, without the sockets
+	TArray<FShardStepOut> Outs;
+	TArray<FShardStepIn> Ins;
+	Outs.SetNum(Settings.NumShards);
+	const double StartTime = FPlatformTime::Seconds();
+	for (int32 Step = -1; Step < Settings.Steps; Step++)
+	{
+		for (int32 Shard = 0; Shard < Settings.NumShards; Shard++)
+		{
+			if (Step >= 0)
+			{
+				Shards[Shard]->Step(Step);
+			}
+			Shards[Shard]->Publish(Step, Outs[Shard]);
+		}
+		ShardSimulation::Route(Outs, Ins);
+		for (int32 Shard = 0; Shard < Settings.NumShards; Shard++)
+		{
+			Shards[Shard]->Apply(Ins[Shard]);
+		}
+	}
+	const double Seconds = FPlatformTime::Seconds() - StartTime;
+
+	TArray<FShardStats> Stats;
+	for (const TUniquePtr<ShardSimulation>& Simulation : Shards)
+	{
+		Stats.Add(Simulation->Stats);
+	}
+	LogResults(Settings, Stats, Seconds, 0);
+	return 0;
+}
+
+void UShardSimCommandlet::LogResults(const FShardSimSettings& Settings, const TArray<FShardStats>& Stats, double Seconds, int64 BytesExchanged)
+{
+	FShardStats Total;
+	for (int32 Shard = 0; Shard < Stats.Num(); Shard++)
+	{
+		const FShardStats& ShardStats = Stats[Shard];
+		UE_LOG(LogTemp, Log, TEXT("Shard %d: %d agents, %lld moves, %lld waits, %d goals, %d plans (%d failed, %.1f ms), %d in, %d out, %.1f ms stepping"),
+			Shard, ShardStats.Agents, ShardStats.Moves, ShardStats.Waits, ShardStats.GoalsReached, ShardStats.Plans, ShardStats.PlanFailures,
+			ShardStats.PlanSeconds * 1000.0, ShardStats.MigratedIn, ShardStats.MigratedOut, ShardStats.StepSeconds * 1000.0);
+
+		Total.Agents += ShardStats.Agents;
+		Total.Moves += ShardStats.Moves;
+		Total.Waits += ShardStats.Waits;
+		Total.GoalsReached += ShardStats.GoalsReached;
+		Total.Plans += ShardStats.Plans;
+		Total.PlanFailures += ShardStats.PlanFailures;
+		Total.MigratedOut += ShardStats.MigratedOut;
+		Total.StepSeconds = FMath::Max(Total.StepSeconds, ShardStats.StepSeconds);
+	}
+
+	// the slowest shard sets the pace, the rest of the wall time is spent exchanging
+	const double AgentSteps = (double)Total.Agents * Settings.Steps;
+	UE_LOG(LogTemp, Log, TEXT("%d shards, %d agents, %d steps in %.2f s: %.0f agent-steps/s, %lld moves, %d goals, %d migrations, slowest shard %.2f s, %.1f KB exchanged"),
+		Stats.Num(), Total.Agents, Settings.Steps, Seconds, Seconds > 0.0 ? AgentSteps / Seconds : 0.0, Total.Moves, Total.GoalsReached,
+		Total.MigratedOut, Total.StepSeconds, BytesExchanged / 1024.0);
+}
@@ -0,0 +1,58 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "HAL/PlatformProcess.h"
+#include "ShardSimCommandlet.generated.h"
+
+struct FShardStats;
+
+/**
+ * Runs a headless agent simulation of a map split into shards (see ShardSimulation), one worker process per shard.
+ * The coordinator starts the workers on this machine, passes the halo rows and migrating agents between neighbours
+ * after every step and reports the throughput.
+ * Usage: UE4Editor-Cmd FIT3094_A1_Code.uproject -run=ShardSim -Map=<file> [-Shards=4] [-Agents=1000] [-Steps=200]
+ *        [-Port=47810] [-Seed=1] [-Timeout=120] [-NoSpawn] [-InProcess]
+ * -NoSpawn waits for workers started by hand (-run=ShardSim -Worker -Shard=<n> with the same other arguments),
+ * -InProcess runs every shard in the coordinator instead, for comparison
+ */
+UCLASS()
+class FIT3094_A1_CODE_API UShardSimCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+
+	UShardSimCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+
+private:
+
+	// The arguments shared by the coordinator and the workers
+	struct FShardSimSettings
+	{
+		FString MapFile;
+		int32 NumShards = 4;
+		int32 AgentsPerShard = 250;
+		int32 Steps = 200;
+		int32 Port = 47810;
+		int32 Seed = 1;
+		float TimeoutSeconds = 120.f;
+	};
+
+	static bool ParseSettings(const FString& Params, FShardSimSettings& OutSettings);
+	static bool LoadMapLines(const FString& MapFile, TArray<FString>& OutLines);
+
+	int32 RunCoordinator(const FShardSimSettings& Settings, bool bSpawnWorkers);
+	int32 RunWorker(const FShardSimSettings& Settings, int32 ShardIndex);
+	int32 RunInProcess(const FShardSimSettings& Settings);
+
+	// Kill the spawned workers still running and close their handles, when the coordinator gives up
+	static void StopWorkers(TArray<FProcHandle>& Workers);
+
+	// Log every shard's statistics and the totals
+	static void LogResults(const FShardSimSettings& Settings, const TArray<FShardStats>& Stats, double Seconds, int64 BytesExchanged);
+};
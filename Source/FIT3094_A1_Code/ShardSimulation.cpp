@@ -0,0 +1,270 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ShardSimulation.h"
+#include "HAL/PlatformTime.h"
+
+// Agents do not go through walls or each other
+const uint8 ShardSimulation::BlockingLayers = OccupancyGrid::LayerMask(OccupancyGrid::Walls) | OccupancyGrid::LayerMask(OccupancyGrid::Agents);
+
+// Steps an agent waits behind another before looking for a way around
+static const int32 MaxWaits = 2;
+
+// Tries at finding a random cell before giving up
+static const int32 MaxRandomTries = 100;
+
+ShardSimulation::ShardSimulation()
+	: Random(0)
+{
+	ShardIndex = 0;
+	NumShards = 1;
+	FirstRow = 0;
+	EndRow = 0;
+}
+
+void ShardSimulation::GetShardRows(int32 SizeX, int32 ShardIndex, int32 NumShards, int32& OutFirstRow, int32& OutEndRow)
+{
+	OutFirstRow = (int32)((int64)SizeX * ShardIndex / NumShards);
+	OutEndRow = (int32)((int64)SizeX * (ShardIndex + 1) / NumShards);
+}
+
+void ShardSimulation::Route(const TArray<FShardStepOut>& Outs, TArray<FShardStepIn>& OutIns)
+{
+	OutIns.SetNum(Outs.Num());
+	for (int32 Shard = 0; Shard < Outs.Num(); Shard++)
+	{
+		FShardStepIn& In = OutIns[Shard];
+		In.Step = Outs[Shard].Step;
+		In.HaloBefore.Reset();
+		In.HaloAfter.Reset();
+		In.Migrants.Reset();
+		In.bQuit = false;
+
+		if (Shard > 0)
+		{
+			In.HaloBefore = Outs[Shard - 1].LastRow;
+			In.Migrants.Append(Outs[Shard - 1].MigrantsAfter);
+		}
+		if (Shard < Outs.Num() - 1)
+		{
+			In.HaloAfter = Outs[Shard + 1].FirstRow;
+			In.Migrants.Append(Outs[Shard + 1].MigrantsBefore);
+		}
+	}
+}
+
+bool ShardSimulation::Init(const TArray<FString>& MapLines, int32 InShardIndex, int32 InNumShards, int32 Seed)
+{
+	if (!Grid.Load(MapLines))
+	{
+		return false;
+	}
+	if (InNumShards < 1 || InShardIndex < 0 || InShardIndex >= InNumShards || InNumShards > Grid.SizeX)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Cannot run shard %d of %d on a map with %d rows"), InShardIndex, InNumShards, Grid.SizeX);
+		return false;
+	}
+
+	Occupancy.Init(Grid);
+	ShardIndex = InShardIndex;
+	NumShards = InNumShards;
+	GetShardRows(Grid.SizeX, ShardIndex, NumShards, FirstRow, EndRow);
+
+	// every shard gets its own sequence, so the shards do not all pick the same goals
+	Random.Initialize(Seed * 7919 + ShardIndex);
+	return true;
+}
+
+void ShardSimulation::SpawnAgents(int32 NumAgents, int32 FirstId)
+{
+	for (int32 Tries = 0; Agents.Num() < NumAgents && Tries < NumAgents * MaxRandomTries; Tries++)
+	{
+		FIntPoint Cell;
+		if (!FindRandomOpenCell(true, Cell) || Occupancy.Test(Cell.X, Cell.Y, OccupancyGrid::Agents))
+		{
+			continue;
+		}
+
+		FShardAgent& Agent = Agents.AddDefaulted_GetRef();
+		Agent.Id = FirstId + Agents.Num() - 1;
+		Agent.Cell = Cell;
+		Agent.Goal = Cell;
+		Occupancy.Set(Cell.X, Cell.Y, OccupancyGrid::Agents);
+	}
+
+	if (Agents.Num() < NumAgents)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Shard %d: only found room for %d of %d agents"), ShardIndex, Agents.Num(), NumAgents);
+	}
+	Stats.Agents = Agents.Num();
+}
+
+void ShardSimulation::Step(int32 StepIndex)
+{
+	const double StartTime = FPlatformTime::Seconds();
+	Stats.Steps++;
+
+	for (int32 Index = 0; Index < Agents.Num();)
+	{
+		FShardAgent& Agent = Agents[Index];
+
+		// a new goal anywhere on the map, in this shard or not
+		if (Agent.Path.Num() == 0 && (!FindRandomOpenCell(false, Agent.Goal) || !PlanPath(Agent)))
+		{
+			Index++;
+			continue;
+		}
+
+		const FIntPoint Next = Agent.Path.Last();
+		if (!CanEnter(Next, StepIndex))
+		{
+			Agent.Waits++;
+			Stats.Waits++;
+			// whatever is in the way may stay there, look for a way around it
+			if (Agent.Waits >= MaxWaits && Occupancy.IsBlocked(Next.X, Next.Y, BlockingLayers))
+			{
+				PlanPath(Agent);
+			}
+			Index++;
+			continue;
+		}
+
+		Occupancy.Clear(Agent.Cell.X, Agent.Cell.Y, OccupancyGrid::Agents);
+		Occupancy.Set(Next.X, Next.Y, OccupancyGrid::Agents);
+		Agent.Cell = Next;
+		Agent.Path.Pop(false);
+		Agent.Waits = 0;
+		Stats.Moves++;
+		if (Agent.Path.Num() == 0)
+		{
+			Stats.GoalsReached++;
+		}
+
+		// the agent walked into a halo row, it belongs to the neighbour now. Its bit stays set until the next halo arrives
+		if (Next.X < FirstRow || Next.X >= EndRow)
+		{
+			(Next.X < FirstRow ? LeavingBefore : LeavingAfter).Add(MoveTemp(Agent));
+			Agents.RemoveAtSwap(Index, 1, false);
+			Stats.MigratedOut++;
+			continue;
+		}
+
+		Index++;
+	}
+
+	Stats.Agents = Agents.Num();
+	Stats.StepSeconds += FPlatformTime::Seconds() - StartTime;
+}
+
+void ShardSimulation::Publish(int32 StepIndex, FShardStepOut& Out)
+{
+	Out.Step = StepIndex;
+	Occupancy.GetRow(FirstRow, OccupancyGrid::Agents, Out.FirstRow);
+	Occupancy.GetRow(EndRow - 1, OccupancyGrid::Agents, Out.LastRow);
+	Out.MigrantsBefore = MoveTemp(LeavingBefore);
+	Out.MigrantsAfter = MoveTemp(LeavingAfter);
+	LeavingBefore.Reset();
+	LeavingAfter.Reset();
+	Out.Stats = Stats;
+}
+
+void ShardSimulation::Apply(const FShardStepIn& In)
+{
+	if (FirstRow > 0 && In.HaloBefore.Num() > 0)
+	{
+		Occupancy.SetRow(FirstRow - 1, OccupancyGrid::Agents, In.HaloBefore);
+	}
+	if (EndRow < Grid.SizeX && In.HaloAfter.Num() > 0)
+	{
+		Occupancy.SetRow(EndRow, OccupancyGrid::Agents, In.HaloAfter);
+	}
+
+	// migrants stand in one of the border rows, which the crossing rules kept free for them
+	for (const FShardAgent& Migrant : In.Migrants)
+	{
+		check(Migrant.Cell.X >= FirstRow && Migrant.Cell.X < EndRow);
+		Occupancy.Set(Migrant.Cell.X, Migrant.Cell.Y, OccupancyGrid::Agents);
+		Agents.Add(Migrant);
+		Stats.MigratedIn++;
+	}
+	Stats.Agents = Agents.Num();
+}
+
+bool ShardSimulation::CanEnter(const FIntPoint& Cell, int32 StepIndex) const
+{
+	if (Occupancy.IsBlocked(Cell.X, Cell.Y, BlockingLayers))
+	{
+		return false;
+	}
+
+	const bool bTowardsHigherX = (StepIndex & 1) == 0;
+
+	// crossing into a neighbour, only in the direction of the step
+	if (Cell.X == FirstRow - 1)
+	{
+		return !bTowardsHigherX;
+	}
+	if (Cell.X == EndRow)
+	{
+		return bTowardsHigherX;
+	}
+
+	// the border row the neighbour may move agents into during this step
+	if (Cell.X == FirstRow && ShardIndex > 0 && bTowardsHigherX)
+	{
+		return false;
+	}
+	if (Cell.X == EndRow - 1 && ShardIndex < NumShards - 1 && !bTowardsHigherX)
+	{
+		return false;
+	}
+
+	return Cell.X >= FirstRow && Cell.X < EndRow;
+}
+
+bool ShardSimulation::PlanPath(FShardAgent& Agent)
+{
+	const double StartTime = FPlatformTime::Seconds();
+	Stats.Plans++;
+	Agent.Waits = 0;
+	Agent.Path.Reset();
+
+	FPathQuery Query;
+	Query.Start = Agent.Cell;
+	Query.Goal = Agent.Goal;
+	Query.BlockingLayers = BlockingLayers;
+
+	const bool bFound = Engine.FindPath(Grid, Occupancy, Query, Result);
+	if (bFound)
+	{
+		// walked from the back
+		Agent.Path.Reserve(Result.Path.Num());
+		for (int32 Index = Result.Path.Num() - 1; Index >= 0; Index--)
+		{
+			Agent.Path.Add(Result.Path[Index]);
+		}
+	}
+	else
+	{
+		Stats.PlanFailures++;
+	}
+
+	Stats.PlanSeconds += FPlatformTime::Seconds() - StartTime;
+	return bFound && Agent.Path.Num() > 0;
+}
+
+bool ShardSimulation::FindRandomOpenCell(bool bInBand, FIntPoint& OutCell)
+{
+	const int32 MinX = bInBand ? FirstRow : 0;
+	const int32 MaxX = bInBand ? EndRow - 1 : Grid.SizeX - 1;
+	for (int32 Tries = 0; Tries < MaxRandomTries; Tries++)
+	{
+		const FIntPoint Cell(Random.RandRange(MinX, MaxX), Random.RandRange(0, Grid.SizeY - 1));
+		if (Grid.GetType(Cell.X, Cell.Y) != GridNode::Wall)
+		{
+			OutCell = Cell;
+			return true;
+		}
+	}
+	return false;
+}
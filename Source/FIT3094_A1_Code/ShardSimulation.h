@@ -0,0 +1,164 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AStarEngine.h"
+#include "OccupancyGrid.h"
+#include "PathGrid.h"
+#include "PathSearch.h"
+
+// An agent of a shard simulation, positions and paths only, without an actor
+struct FShardAgent
+{
+	int32 Id = 0;
+	FIntPoint Cell;
+	FIntPoint Goal;
+	// The cells still to walk through, the next one last so a step is a pop
+	TArray<FIntPoint> Path;
+	// Steps in a row the agent could not move, it plans again after a few
+	int32 Waits = 0;
+
+	friend FArchive& operator<<(FArchive& Ar, FShardAgent& Agent)
+	{
+		return Ar << Agent.Id << Agent.Cell << Agent.Goal << Agent.Path << Agent.Waits;
+	}
+};
+
+// What a shard did so far
+struct FShardStats
+{
+	int32 Agents = 0;
+	int32 Steps = 0;
+	int64 Moves = 0;
+	int64 Waits = 0;
+	int32 GoalsReached = 0;
+	int32 Plans = 0;
+	int32 PlanFailures = 0;
+	int32 MigratedIn = 0;
+	int32 MigratedOut = 0;
+	double PlanSeconds = 0.0;
+	double StepSeconds = 0.0;
+
+	friend FArchive& operator<<(FArchive& Ar, FShardStats& Stats)
+	{
+		return Ar << Stats.Agents << Stats.Steps << Stats.Moves << Stats.Waits << Stats.GoalsReached << Stats.Plans << Stats.PlanFailures
+			<< Stats.MigratedIn << Stats.MigratedOut << Stats.PlanSeconds << Stats.StepSeconds;
+	}
+};
+
+// Sent by a shard after every step: its border rows of agent occupancy and the agents that walked out of it
+struct FShardStepOut
+{
+	int32 Step = 0;
+	TArray<uint64> FirstRow;
+	TArray<uint64> LastRow;
+	// Agents that entered the last row of the shard before (lower X) or the first row of the shard after
+	TArray<FShardAgent> MigrantsBefore;
+	TArray<FShardAgent> MigrantsAfter;
+	FShardStats Stats;
+
+	friend FArchive& operator<<(FArchive& Ar, FShardStepOut& Out)
+	{
+		return Ar << Out.Step << Out.FirstRow << Out.LastRow << Out.MigrantsBefore << Out.MigrantsAfter << Out.Stats;
+	}
+};
+
+// Received by a shard before every step: the border rows of its neighbours (the halo) and the agents walking in
+struct FShardStepIn
+{
+	int32 Step = 0;
+	// Empty for a shard without that neighbour
+	TArray<uint64> HaloBefore;
+	TArray<uint64> HaloAfter;
+	TArray<FShardAgent> Migrants;
+	// The simulation is over, send the final statistics and stop
+	bool bQuit = false;
+
+	friend FArchive& operator<<(FArchive& Ar, FShardStepIn& In)
+	{
+		return Ar << In.Step << In.HaloBefore << In.HaloAfter << In.Migrants << In.bQuit;
+	}
+};
+
+/**
+ * One shard of a simulation split over processes. The map is cut into bands of rows (X), every shard owns the agents
+ * standing in its band and keeps a copy of the static terrain of the whole map.
+ *
+ * Besides its own rows a shard sees the row on either side of its band (the halo), as the neighbours sent it after
+ * the previous step. An agent stepping into a halo row leaves the shard and is handed to the neighbour with the rest
+ * of its path, which the neighbour keeps walking, so a path crossing shards is planned once over the whole terrain
+ * and stitched together at every border it crosses. Only the agents the shard can see block its searches.
+ *
+ * Two shards must never move agents into the same border cell in one step, so each border is crossed one way
+ * at a time: on even steps agents only cross towards higher X, on odd steps towards lower X, and the shard on
+ * the receiving side keeps its own agents out of its border row during that step
+ */
+class FIT3094_A1_CODE_API ShardSimulation
+{
+
+public:
+
+	ShardSimulation();
+
+	// The rows [OutFirstRow, OutEndRow) of a shard, bands are as even as the map allows
+	static void GetShardRows(int32 SizeX, int32 ShardIndex, int32 NumShards, int32& OutFirstRow, int32& OutEndRow);
+
+	// What the coordinator does between steps: hand every shard the border rows and migrants of its neighbours.
+	// Outs holds one message per shard in shard order, Ins gets one per shard
+	static void Route(const TArray<FShardStepOut>& Outs, TArray<FShardStepIn>& OutIns);
+
+	// Build the grid from the map file lines and set up the band of the shard, returns false when the map is malformed
+	// or there are more shards than rows
+	bool Init(const TArray<FString>& MapLines, int32 InShardIndex, int32 InNumShards, int32 Seed);
+
+	// Place agents on random free cells of the band, ids start at FirstId
+	void SpawnAgents(int32 NumAgents, int32 FirstId);
+
+	// Move every agent one cell along its path, planning for the ones that need it
+	void Step(int32 StepIndex);
+
+	// Fill the message to the neighbours with the border rows and the agents that left during the last step
+	void Publish(int32 StepIndex, FShardStepOut& Out);
+
+	// Take the halo rows and the agents that walked in from the neighbours
+	void Apply(const FShardStepIn& In);
+
+	int32 GetNumAgents() const
+	{
+		return Agents.Num();
+	}
+
+	FShardStats Stats;
+
+private:
+
+	// Can an agent of this shard step into the cell on this step (terrain, agents seen, and the crossing rules)
+	bool CanEnter(const FIntPoint& Cell, int32 StepIndex) const;
+
+	// Plan from the agent's cell to its goal over the whole terrain
+	bool PlanPath(FShardAgent& Agent);
+
+	// A random cell that is not a wall, inside the band or anywhere on the map
+	bool FindRandomOpenCell(bool bInBand, FIntPoint& OutCell);
+
+	static const uint8 BlockingLayers;
+
+	PathGrid Grid;
+	OccupancyGrid Occupancy;
+	AStarEngine Engine;
+	FPathResult Result;
+	FRandomStream Random;
+
+	int32 ShardIndex;
+	int32 NumShards;
+	int32 FirstRow;
+	int32 EndRow;
+
+	TArray<FShardAgent> Agents;
+
+	// Agents that stepped into a halo row, sent with the next Publish
+	TArray<FShardAgent> LeavingBefore;
+	TArray<FShardAgent> LeavingAfter;
+
+};
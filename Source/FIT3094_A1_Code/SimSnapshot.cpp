@@ -0,0 +1,37 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SimSnapshot.h"
+
+SimSnapshot::SimSnapshot()
+{
+	Seed = 0;
+	Time = 0.0;
+}
+
+void SimSnapshot::SetTerrain(const TSharedPtr<PathGrid, ESPMode::ThreadSafe>& NewTerrain)
+{
+	Terrain = NewTerrain;
+}
+
+PathGrid& SimSnapshot::EditTerrain()
+{
+	// the snapshots sharing the terrain keep the old one
+	if (!Terrain.IsUnique())
+	{
+		TSharedPtr<PathGrid, ESPMode::ThreadSafe> Copy = MakeShared<PathGrid, ESPMode::ThreadSafe>();
+		Copy->CopyTerrain(*Terrain);
+		Terrain = Copy;
+	}
+	return *Terrain;
+}
+
+int64 SimSnapshot::GetAllocatedSize() const
+{
+	int64 Size = Agents.GetAllocatedSize() + Food.GetAllocatedSize();
+	for (const FSimAgent& Agent : Agents)
+	{
+		Size += Agent.Path.GetAllocatedSize();
+	}
+	return Size;
+}
@@ -0,0 +1,95 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "PathGrid.h"
+
+// An agent of a snapshot, what the actor knew without the actor
+struct FSimAgent
+{
+	int32 Id = 0;
+	// AAgent::AGENT_TYPE, and the AFood::FOOD_TYPE it eats
+	int32 Type = 0;
+	int32 FoodType = 0;
+	int32 Health = 0;
+	// Seconds until the health drops next
+	float HealthSeconds = 0.f;
+	float MoveSpeed = 0.f;
+	float Tolerance = 0.f;
+	// The cell the agent last reached, and how far (in world units) it walked towards the next cell of its path
+	FIntPoint Cell;
+	float StepDistance = 0.f;
+	// The cells still to walk through, the next one last so a step is a pop
+	TArray<FIntPoint> Path;
+	// The food the agent goes for (an index into the food of the snapshot) and the generation it had when chosen,
+	// INDEX_NONE while the agent has no goal
+	int32 Goal = INDEX_NONE;
+	int32 GoalGeneration = 0;
+};
+
+// A food of a snapshot. Eaten food comes back somewhere else in the same slot with the generation bumped, as the pool does
+struct FSimFood
+{
+	FIntPoint Cell;
+	int32 Type = 0;
+	int32 Generation = 0;
+};
+
+/**
+ * The state of a whole simulation at one moment: terrain, food, agents and the random seed, without any actor.
+ * Taken from the world by ALevelGenerator::CaptureSnapshot and put back by RestoreSnapshot, or run on headless
+ * by ForkSimulation.
+ *
+ * The terrain is by far the largest part and rarely changes, so copying a snapshot shares it, and only a copy
+ * changing its terrain gets a terrain of its own (copy on write). Dozens of forks of one snapshot cost their
+ * agents and food each. Occupancy is not kept, it follows from the rest
+ */
+class FIT3094_A1_CODE_API SimSnapshot
+{
+
+public:
+
+	SimSnapshot();
+
+	// Share the terrain of the world (see UPathfindingSubsystem::GetSharedTerrain)
+	void SetTerrain(const TSharedPtr<PathGrid, ESPMode::ThreadSafe>& NewTerrain);
+
+	const PathGrid& GetTerrain() const
+	{
+		return *Terrain;
+	}
+	bool HasTerrain() const
+	{
+		return Terrain.IsValid();
+	}
+
+	// The terrain for changing, copied first while other snapshots share it
+	PathGrid& EditTerrain();
+
+	bool SharesTerrainWith(const SimSnapshot& Other) const
+	{
+		return Terrain == Other.Terrain;
+	}
+
+	// Memory of the snapshot's own, and of the terrain it may share
+	int64 GetAllocatedSize() const;
+	int64 GetTerrainSize() const
+	{
+		return Terrain.IsValid() ? Terrain->GetTerrainSize() : 0;
+	}
+
+	TArray<FSimAgent> Agents;
+	TArray<FSimFood> Food;
+
+	// What the random numbers were seeded with when the snapshot was taken
+	int32 Seed;
+
+	// Seconds simulated since the snapshot was taken from the world
+	double Time;
+
+private:
+
+	TSharedPtr<PathGrid, ESPMode::ThreadSafe> Terrain;
+
+};
@@ -0,0 +1,253 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SubgoalEngine.h"
+#include "OccupancyGrid.h"
+#include "PathGrid.h"
+#include "SearchHeatmap.h"
+#include "Algo/Reverse.h"
+#include "HAL/PlatformTime.h"
+
+SubgoalEngine::SubgoalEngine()
+{
+	Subgoals = nullptr;
+	Heatmap = nullptr;
+	GraphSearches = 0;
+	Fallbacks = 0;
+}
+
+void SubgoalEngine::SetHeatmap(SearchHeatmap* NewHeatmap)
+{
+	Heatmap = NewHeatmap;
+	Fallback.SetHeatmap(NewHeatmap);
+}
+
+void SubgoalEngine::SetSubgoals(const SubgoalGraph* NewSubgoals)
+{
+	LogFallbacks();
+	Subgoals = NewSubgoals;
+	GoalCosts.Init(INDEX_NONE, Subgoals ? Subgoals->GetNumSubgoals() : 0);
+}
+
+void SubgoalEngine::LogFallbacks()
+{
+	if (GraphSearches > 0)
+	{
+		UE_LOG(LogTemp, Log, TEXT("Subgoal graph: %d searches, %d searched the grid as agents or food stood on the path"), GraphSearches, Fallbacks);
+	}
+
+	GraphSearches = 0;
+	Fallbacks = 0;
+}
+
+bool SubgoalEngine::FindPath(const PathGrid& Grid, const OccupancyGrid& Occupancy, const FPathQuery& Query, FPathResult& OutResult)
+{
+	if (!Subgoals)
+	{
+		return Fallback.FindPath(Grid, Occupancy, Query, OutResult);
+	}
+
+	GraphSearches++;
+	if (!SearchGraph(Grid, Query, OutResult))
+	{
+		return false;
+	}
+
+	// the graph only knows the terrain, the path is only good if nothing the agent cannot pass stands on it
+	const bool bBlocked = OutResult.Path.ContainsByPredicate([&Occupancy, &Query](const FIntPoint& Cell)
+	{
+		return Occupancy.IsBlocked(Cell.X, Cell.Y, Query.BlockingLayers);
+	});
+	if (!bBlocked)
+	{
+		return true;
+	}
+
+	Fallbacks++;
+	const int32 GraphExpansions = OutResult.Expansions;
+	const double GraphSeconds = OutResult.Seconds;
+	Fallback.FindPath(Grid, Occupancy, Query, OutResult);
+	OutResult.Expansions += GraphExpansions;
+	OutResult.Seconds += GraphSeconds;
+	return OutResult.bFound;
+}
+
+bool SubgoalEngine::SearchGraph(const PathGrid& Grid, const FPathQuery& Query, FPathResult& OutResult)
+{
+	OutResult.Reset();
+	const double StartTime = FPlatformTime::Seconds();
+
+	const int StartCell = Grid.GetIndex(Query.Start.X, Query.Start.Y);
+	const int GoalCell = Grid.GetIndex(Query.Goal.X, Query.Goal.Y);
+	if (Grid.GetType(Query.Goal.X, Query.Goal.Y) == GridNode::Wall)
+	{
+		OutResult.Seconds = FPlatformTime::Seconds() - StartTime;
+		return false;
+	}
+	if (StartCell == GoalCell)
+	{
+		OutResult.bFound = true;
+		OutResult.Seconds = FPlatformTime::Seconds() - StartTime;
+		return true;
+	}
+
+	// link the start and the goal into the graph. The goal's links are scanned from the goal, the cost the other way
+	// enters the goal instead of the subgoal
+	StartLinks.Reset();
+	Subgoals->ScanDirect(Grid, Query.Start, GoalCell, Scratch, StartLinks);
+	GoalLinks.Reset();
+	Subgoals->ScanDirect(Grid, Query.Goal, INDEX_NONE, Scratch, GoalLinks);
+	const int32 GoalCost = (int32)Grid.GetTravelCost(Query.Goal.X, Query.Goal.Y);
+	for (const FSubgoalLink& Link : GoalLinks)
+	{
+		const FIntPoint& Cell = Subgoals->GetSubgoalCell(Link.Subgoal);
+		GoalCosts[Link.Subgoal] = Link.Cost - (int32)Grid.GetTravelCost(Cell.X, Cell.Y) + GoalCost;
+	}
+	if (Subgoals->GetSubgoal(GoalCell) != INDEX_NONE)
+	{
+		GoalLinks.Add(FSubgoalLink(Subgoals->GetSubgoal(GoalCell), 0));
+		GoalCosts[GoalLinks.Last().Subgoal] = 0;
+	}
+
+	// the subgoals are the nodes of the search, with the start and the goal after them
+	const int32 NumSubgoals = Subgoals->GetNumSubgoals();
+	const int32 StartNode = NumSubgoals;
+	const int32 GoalNode = NumSubgoals + 1;
+	auto GetNodeCell = [this, &Query, StartNode, GoalNode](int32 Node) -> const FIntPoint&
+	{
+		return Node == StartNode ? Query.Start : Node == GoalNode ? Query.Goal : Subgoals->GetSubgoalCell(Node);
+	};
+
+	Space.Prepare(NumSubgoals + 2);
+	OpenList.Reset();
+	Space.Visit(StartNode, 0, INDEX_NONE);
+	OpenList.HeapPush(FOpenEntry(Heuristic(Query.Start.X, Query.Start.Y, Query.Goal), 0, StartNode), FOpenEntryPredicate());
+
+	auto Relax = [this, &Query, &GetNodeCell](int32 Node, int32 G, int32 Next, int32 Cost)
+	{
+		const int32 PossibleG = G + Cost;
+		if (!Space.IsClosed(Next) && (!Space.IsSeen(Next) || PossibleG < Space.GetG(Next)))
+		{
+			const FIntPoint& Cell = GetNodeCell(Next);
+			Space.Visit(Next, PossibleG, Node);
+			OpenList.HeapPush(FOpenEntry(PossibleG + Heuristic(Cell.X, Cell.Y, Query.Goal), PossibleG, Next), FOpenEntryPredicate());
+		}
+	};
+
+	while (OpenList.Num() > 0)
+	{
+		FOpenEntry Current;
+		OpenList.HeapPop(Current, FOpenEntryPredicate(), false);
+		if (Space.IsClosed(Current.Cell) || Current.G != Space.GetG(Current.Cell))
+		{
+			continue;
+		}
+
+		Space.Close(Current.Cell);
+		OutResult.Expansions++;
+		if (Heatmap)
+		{
+			const FIntPoint& Cell = GetNodeCell(Current.Cell);
+			Heatmap->AddExpansion(Grid.GetIndex(Cell.X, Cell.Y));
+		}
+
+		if (Current.Cell == GoalNode)
+		{
+			OutResult.bFound = true;
+			break;
+		}
+
+		if (Current.Cell == StartNode)
+		{
+			for (const FSubgoalLink& Link : StartLinks)
+			{
+				Relax(Current.Cell, Current.G, Link.Subgoal == INDEX_NONE ? GoalNode : Link.Subgoal, Link.Cost);
+			}
+			continue;
+		}
+
+		for (int32 Link = Subgoals->GetFirstLink(Current.Cell); Link < Subgoals->GetLastLink(Current.Cell); Link++)
+		{
+			Relax(Current.Cell, Current.G, Subgoals->GetLink(Link).Subgoal, Subgoals->GetLink(Link).Cost);
+		}
+		if (GoalCosts[Current.Cell] != INDEX_NONE)
+		{
+			Relax(Current.Cell, Current.G, GoalNode, GoalCosts[Current.Cell]);
+		}
+	}
+
+	// the goal costs are only kept for this query
+	for (const FSubgoalLink& Link : GoalLinks)
+	{
+		GoalCosts[Link.Subgoal] = INDEX_NONE;
+	}
+
+	// walk the parents back to the start, then fill in every link between them
+	if (OutResult.bFound)
+	{
+		Nodes.Reset();
+		for (int32 Node = GoalNode; Node != INDEX_NONE; Node = Space.GetParent(Node))
+		{
+			Nodes.Add(Node);
+		}
+		for (int32 Index = Nodes.Num() - 1; Index > 0; Index--)
+		{
+			AppendMonotonePath(Grid, GetNodeCell(Nodes[Index]), GetNodeCell(Nodes[Index - 1]), OutResult);
+		}
+	}
+
+	OutResult.Seconds = FPlatformTime::Seconds() - StartTime;
+	return OutResult.bFound;
+}
+
+void SubgoalEngine::AppendMonotonePath(const PathGrid& Grid, const FIntPoint& From, const FIntPoint& To, FPathResult& OutResult)
+{
+	const int DX = To.X >= From.X ? 1 : -1;
+	const int DY = To.Y >= From.Y ? 1 : -1;
+	const int Width = FMath::Abs(To.X - From.X) + 1;
+	const int Height = FMath::Abs(To.Y - From.Y) + 1;
+
+	// the cheapest cost of every cell of the box from the first cell, walls never being entered
+	Scratch.SetNumUninitialized(Width * Height);
+	for (int J = 0; J < Height; J++)
+	{
+		for (int I = 0; I < Width; I++)
+		{
+			int32& Cost = Scratch[J * Width + I];
+			if (I == 0 && J == 0)
+			{
+				Cost = 0;
+				continue;
+			}
+
+			const int32 FromLeft = I > 0 ? Scratch[J * Width + I - 1] : MAX_int32;
+			const int32 FromBelow = J > 0 ? Scratch[(J - 1) * Width + I] : MAX_int32;
+			const int32 Best = FMath::Min(FromLeft, FromBelow);
+			const int X = From.X + I * DX;
+			const int Y = From.Y + J * DY;
+			Cost = Best == MAX_int32 || Grid.GetType(X, Y) == GridNode::Wall ? MAX_int32 : Best + (int32)Grid.GetTravelCost(X, Y);
+		}
+	}
+
+	// step back from the last cell through the cells the cost came from
+	const int32 First = OutResult.Path.Num();
+	int I = Width - 1;
+	int J = Height - 1;
+	OutResult.Cost += Scratch[J * Width + I];
+	while (I > 0 || J > 0)
+	{
+		OutResult.Path.Add(FIntPoint(From.X + I * DX, From.Y + J * DY));
+		const int32 Entered = Scratch[J * Width + I] - (int32)Grid.GetTravelCost(From.X + I * DX, From.Y + J * DY);
+		if (I > 0 && Scratch[J * Width + I - 1] == Entered)
+		{
+			I--;
+		}
+		else
+		{
+			J--;
+		}
+	}
+
+	// stepped back from the end, so the new cells are backwards
+	Algo::Reverse(OutResult.Path.GetData() + First, OutResult.Path.Num() - First);
+}
@@ -0,0 +1,71 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AStarEngine.h"
+#include "PathSearch.h"
+#include "SubgoalGraph.h"
+
+/**
+ * A* over the subgoal graph of the map (see SubgoalGraph): the start and the goal are linked to the subgoals they
+ * reach directly, the graph is searched and every link of the result is filled in with the cheapest monotone path
+ * between its ends. Without a graph, or when agents or food stand on the path found, the grid is searched with A*
+ */
+class FIT3094_A1_CODE_API SubgoalEngine : public PathSearchEngine
+{
+
+public:
+
+	virtual FName GetName() const override
+	{
+		return TEXT("Subgoal");
+	}
+
+	SubgoalEngine();
+
+	virtual bool FindPath(const PathGrid& Grid, const OccupancyGrid& Occupancy, const FPathQuery& Query, FPathResult& OutResult) override;
+
+	virtual void SetSubgoals(const SubgoalGraph* NewSubgoals) override;
+	virtual bool CanUseSubgoals() const override
+	{
+		return true;
+	}
+
+	virtual void SetHeatmap(SearchHeatmap* NewHeatmap) override;
+
+private:
+
+	// Search the graph between the start and the goal and fill in the path, false when walls part them
+	bool SearchGraph(const PathGrid& Grid, const FPathQuery& Query, FPathResult& OutResult);
+
+	// Append the cells of the cheapest monotone path from one cell to another, excluding the first
+	void AppendMonotonePath(const PathGrid& Grid, const FIntPoint& From, const FIntPoint& To, FPathResult& OutResult);
+
+	// Log how often the grid had to be searched and start counting again, for a change of graph
+	void LogFallbacks();
+
+	// The graph of the current map, nullptr when it has none
+	const SubgoalGraph* Subgoals;
+
+	// Searches the grid when the graph cannot answer
+	AStarEngine Fallback;
+
+	// The cells of the subgoals expanded are counted into it when set, the fallback counts its own
+	SearchHeatmap* Heatmap;
+
+	// How many queries the graph answered on the current map, and how many went to the grid as something stood in the way
+	int32 GraphSearches;
+	int32 Fallbacks;
+
+	// Reused between searches so a query does not allocate. The search space holds the subgoals, then the start and the goal
+	SearchSpace Space;
+	TArray<FOpenEntry> OpenList;
+	TArray<FSubgoalLink> StartLinks;
+	TArray<FSubgoalLink> GoalLinks;
+	// The cost from every subgoal linked to the goal on to the goal, INDEX_NONE for the others
+	TArray<int32> GoalCosts;
+	TArray<int32> Scratch;
+	TArray<int32> Nodes;
+
+};
@@ -0,0 +1,162 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SubgoalGraph.h"
+#include "PathGrid.h"
+#include "HAL/PlatformTime.h"
+
+namespace
+{
+	// Cost of a monotone path that cannot go on
+	const int32 Unreachable = MAX_int32;
+
+	bool IsFree(const PathGrid& Grid, int X, int Y)
+	{
+		return Grid.IsInside(X, Y) && Grid.GetType(X, Y) != GridNode::Wall;
+	}
+
+	// Can an optimal path have to turn back at the cell: a diagonal neighbour is a wall or dearer ground while both
+	// cells between them are free, so the path cannot cut the corner through it for the same cost
+	bool IsSubgoal(const PathGrid& Grid, int X, int Y)
+	{
+		if (!IsFree(Grid, X, Y))
+		{
+			return false;
+		}
+
+		const float Cost = Grid.GetTravelCost(X, Y);
+		for (int DX = -1; DX <= 1; DX += 2)
+		{
+			for (int DY = -1; DY <= 1; DY += 2)
+			{
+				if (IsFree(Grid, X + DX, Y) && IsFree(Grid, X, Y + DY) && (!IsFree(Grid, X + DX, Y + DY) || Grid.GetTravelCost(X + DX, Y + DY) > Cost))
+				{
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+}
+
+SubgoalGraph::SubgoalGraph()
+{
+	BuildSeconds = 0.0;
+}
+
+void SubgoalGraph::Build(const PathGrid& Grid)
+{
+	const double StartTime = FPlatformTime::Seconds();
+
+	CellSubgoals.Init(INDEX_NONE, Grid.GetNumCells());
+	SubgoalCells.Reset();
+	for (int Y = 0; Y < Grid.SizeY; Y++)
+	{
+		for (int X = 0; X < Grid.SizeX; X++)
+		{
+			if (IsSubgoal(Grid, X, Y))
+			{
+				CellSubgoals[Grid.GetIndex(X, Y)] = SubgoalCells.Add(FIntPoint(X, Y));
+			}
+		}
+	}
+
+	// every subgoal scans for its own links, the links of the others only need the subgoals in place
+	LinkStarts.Reset(SubgoalCells.Num() + 1);
+	Links.Reset();
+	TArray<int32> Scratch;
+	for (const FIntPoint& Cell : SubgoalCells)
+	{
+		LinkStarts.Add(Links.Num());
+		ScanDirect(Grid, Cell, INDEX_NONE, Scratch, Links);
+	}
+	LinkStarts.Add(Links.Num());
+
+	Links.Shrink();
+	BuildSeconds = FPlatformTime::Seconds() - StartTime;
+}
+
+void SubgoalGraph::ScanDirect(const PathGrid& Grid, const FIntPoint& Origin, int TargetCell, TArray<int32>& Scratch, TArray<FSubgoalLink>& OutLinks) const
+{
+	const int Width = FMath::Max(Grid.SizeX, 1);
+	Scratch.SetNumUninitialized(4 * Width);
+
+	// one quadrant at a time, filling in the cheapest monotone paths to every cell row by row: the cheapest passing no
+	// subgoal (direct) and the cheapest passing one (through). A subgoal only gets a link when the direct path is cheaper,
+	// otherwise the links of the subgoal on the way already cover it. The axes are in two quadrants each and only
+	// recorded by the one going up or right along the other axis
+	for (int DX = -1; DX <= 1; DX += 2)
+	{
+		for (int DY = -1; DY <= 1; DY += 2)
+		{
+			const int QuadrantWidth = DX > 0 ? Grid.SizeX - Origin.X : Origin.X + 1;
+			const int QuadrantHeight = DY > 0 ? Grid.SizeY - Origin.Y : Origin.Y + 1;
+			int32* PreviousDirect = Scratch.GetData();
+			int32* CurrentDirect = PreviousDirect + Width;
+			int32* PreviousThrough = CurrentDirect + Width;
+			int32* CurrentThrough = PreviousThrough + Width;
+
+			// cells of the previous row past this have no direct path. Paths through subgoals are only followed
+			// as far as the direct ones go, beyond that they are taken as unreachable and can only keep extra links
+			int PreviousExtent = 0;
+			for (int J = 0; J < QuadrantHeight; J++)
+			{
+				int Extent = 0;
+				for (int I = 0; I < QuadrantWidth; I++)
+				{
+					if (I == 0 && J == 0)
+					{
+						CurrentDirect[0] = 0;
+						CurrentThrough[0] = Unreachable;
+						Extent = 1;
+						continue;
+					}
+
+					const bool bHasBelow = I < PreviousExtent;
+					const int32 Direct = FMath::Min(I > 0 ? CurrentDirect[I - 1] : Unreachable, bHasBelow ? PreviousDirect[I] : Unreachable);
+					const int32 Through = FMath::Min(I > 0 ? CurrentThrough[I - 1] : Unreachable, bHasBelow ? PreviousThrough[I] : Unreachable);
+					const int X = Origin.X + I * DX;
+					const int Y = Origin.Y + J * DY;
+					if (Direct == Unreachable || Grid.GetType(X, Y) == GridNode::Wall)
+					{
+						CurrentDirect[I] = Unreachable;
+						CurrentThrough[I] = Unreachable;
+						if (I >= PreviousExtent)
+						{
+							break;
+						}
+						continue;
+					}
+
+					const int32 Cost = (int32)Grid.GetTravelCost(X, Y);
+					CurrentDirect[I] = Direct + Cost;
+					CurrentThrough[I] = Through == Unreachable ? Unreachable : Through + Cost;
+
+					// a subgoal or the target ends the direct paths, paths going on past it pass through it
+					const int Cell = Grid.GetIndex(X, Y);
+					const int32 Subgoal = Cell == TargetCell ? INDEX_NONE : CellSubgoals[Cell];
+					if (Cell == TargetCell || Subgoal != INDEX_NONE)
+					{
+						if (CurrentDirect[I] < CurrentThrough[I] && !(J == 0 && DY < 0) && !(I == 0 && DX < 0))
+						{
+							OutLinks.Add(FSubgoalLink(Subgoal, CurrentDirect[I]));
+						}
+						CurrentThrough[I] = FMath::Min(CurrentDirect[I], CurrentThrough[I]);
+						CurrentDirect[I] = Unreachable;
+						continue;
+					}
+
+					Extent = I + 1;
+				}
+
+				if (Extent == 0)
+				{
+					break;
+				}
+				Swap(PreviousDirect, CurrentDirect);
+				Swap(PreviousThrough, CurrentThrough);
+				PreviousExtent = Extent;
+			}
+		}
+	}
+}
@@ -0,0 +1,110 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class PathGrid;
+
+// A subgoal reached directly from a cell, and the cost of getting there (the cells entered, not the one left)
+struct FSubgoalLink
+{
+	// Index of the subgoal, INDEX_NONE for the target cell of a scan
+	int32 Subgoal;
+	int32 Cost;
+
+	FSubgoalLink()
+		: Subgoal(INDEX_NONE)
+		, Cost(0)
+	{
+	}
+
+	FSubgoalLink(int32 InSubgoal, int32 InCost)
+		: Subgoal(InSubgoal)
+		, Cost(InCost)
+	{
+	}
+};
+
+/**
+ * Subgoal graph of the static map, for optimal searches over a few corners instead of every cell.
+ *
+ * A path only moving towards its end in both axes (a monotone path) needs no search: the cheapest one fills in row
+ * by row. So an optimal path is only ever searched for where it turns back, and it only has to turn back around a
+ * cell dearer than the one it turns at: turning at C with the dearer-or-equal diagonal D free, going through D instead
+ * costs no more and moves the turn on. Those cells (free cells with a wall or dearer ground diagonally across both
+ * free sides) are the subgoals. Two subgoals are linked when a monotone path joins them without passing another
+ * subgoal, at the cost of the cheapest such path, so every optimal path is a chain of links and searching the links
+ * finds the optimal cost. Forest counts as dearer ground, which keeps the graph exact under the travel costs.
+ *
+ * Queries link their start and goal the same way on the fly (see SubgoalEngine). Agents and food are not known here,
+ * callers check the path and search the grid when something stands on it
+ */
+class FIT3094_A1_CODE_API SubgoalGraph
+{
+
+public:
+
+	SubgoalGraph();
+
+	// Find the subgoals of the grid and link them
+	void Build(const PathGrid& Grid);
+
+	// Find what the cell reaches directly: the subgoals, and the target cell when not INDEX_NONE, joined to it by a
+	// monotone path with no other subgoal on it. Costs are those of the cheapest such path, Scratch holds two rows
+	void ScanDirect(const PathGrid& Grid, const FIntPoint& Origin, int TargetCell, TArray<int32>& Scratch, TArray<FSubgoalLink>& OutLinks) const;
+
+	// The subgoal at a cell, INDEX_NONE when the cell is not one
+	int32 GetSubgoal(int Cell) const
+	{
+		return CellSubgoals[Cell];
+	}
+	const FIntPoint& GetSubgoalCell(int32 Subgoal) const
+	{
+		return SubgoalCells[Subgoal];
+	}
+
+	// The links going out of a subgoal, as a range of GetLinks()
+	int32 GetFirstLink(int32 Subgoal) const
+	{
+		return LinkStarts[Subgoal];
+	}
+	int32 GetLastLink(int32 Subgoal) const
+	{
+		return LinkStarts[Subgoal + 1];
+	}
+	const FSubgoalLink& GetLink(int32 Link) const
+	{
+		return Links[Link];
+	}
+
+	// Size of the graph
+	int32 GetNumSubgoals() const
+	{
+		return SubgoalCells.Num();
+	}
+	int32 GetNumLinks() const
+	{
+		return Links.Num();
+	}
+
+	// How long building took
+	double BuildSeconds;
+
+	// Memory used by the graph
+	int64 GetAllocatedSize() const
+	{
+		return CellSubgoals.GetAllocatedSize() + SubgoalCells.GetAllocatedSize() + LinkStarts.GetAllocatedSize() + Links.GetAllocatedSize();
+	}
+
+private:
+
+	// The subgoal of every cell, INDEX_NONE for the others
+	TArray<int32> CellSubgoals;
+	TArray<FIntPoint> SubgoalCells;
+
+	// The links of subgoal S are Links[LinkStarts[S]] to Links[LinkStarts[S + 1] - 1]
+	TArray<int32> LinkStarts;
+	TArray<FSubgoalLink> Links;
+
+};
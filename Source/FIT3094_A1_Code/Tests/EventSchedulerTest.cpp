@@ -0,0 +1,219 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "EventScheduler.h"
+#include "Math/RandomStream.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+	// The scheduler only hands its targets back, so numbers stand in for the actors
+	AActor* GetTarget(int32 Id)
+	{
+		return reinterpret_cast<AActor*>((UPTRINT)(Id + 1) * 16);
+	}
+
+	// An event as the test scheduled it
+	struct FExpectedEvent
+	{
+		double Time;
+		int32 Id;
+		FEventHandle Handle;
+		bool bPending;
+	};
+
+	// A delay landing in a random wheel, or with Level NUM_WHEELS past the last one (seen from a tick at the start of a turn)
+	double GetRandomDelay(FRandomStream& Random, int32 Level)
+	{
+		const double TicksPerTurn = (double)(1LL << (EventScheduler::WHEEL_BITS * EventScheduler::NUM_WHEELS));
+		if (Level == EventScheduler::NUM_WHEELS)
+		{
+			return (TicksPerTurn + Random.FRand() * TicksPerTurn / 4.0) * EventScheduler::TICK_SECONDS;
+		}
+		const double Ticks = (double)(1LL << (EventScheduler::WHEEL_BITS * (Level + 1)));
+		return Random.FRand() * Ticks * EventScheduler::TICK_SECONDS;
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FEventSchedulerOrderTest, "FIT3094.EventScheduler.Order",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FEventSchedulerOrderTest::RunTest(const FString& Parameters)
+{
+	for (int32 Trial = 0; Trial < 3; Trial++)
+	{
+		FRandomStream Random(3094 + Trial);
+		EventScheduler Scheduler;
+		TArray<FExpectedEvent> Expected;
+		double LastTime = 0.0;
+
+		auto Schedule = [&](double DueTime)
+		{
+			FExpectedEvent& Event = Expected.AddDefaulted_GetRef();
+			Event.Time = DueTime;
+			Event.Id = Expected.Num() - 1;
+			Event.Handle = Scheduler.Schedule(DueTime, EScheduledEvent::Arrival, GetTarget(Event.Id));
+			Event.bPending = true;
+			LastTime = FMath::Max(LastTime, DueTime);
+		};
+
+		// every wheel and the list past them, with events right either side of the tick the last wheel turns at
+		for (int32 Index = 0; Index < 500; Index++)
+		{
+			Schedule(GetRandomDelay(Random, Index % (EventScheduler::NUM_WHEELS + 1)));
+		}
+		const double TurnTime = (double)(1LL << (EventScheduler::WHEEL_BITS * EventScheduler::NUM_WHEELS)) * EventScheduler::TICK_SECONDS;
+		Schedule(TurnTime);
+		Schedule(TurnTime - EventScheduler::TICK_SECONDS / 2.0);
+		Schedule(TurnTime);
+
+		TArray<FScheduledEvent> Fired;
+		TArray<int32> Due;
+		double Time = 0.0;
+		while (Time <= LastTime)
+		{
+			// some events are cancelled while they wait in an outer wheel, before it turns and moves them down
+			for (FExpectedEvent& Event : Expected)
+			{
+				if (Event.bPending && Random.FRand() < 0.002f)
+				{
+					Scheduler.Cancel(Event.Handle);
+					Event.bPending = false;
+				}
+			}
+
+			// more events on the way, some of them late, until the last wheel has turned once
+			if (Time < TurnTime)
+			{
+				for (int32 Index = 0; Index < 5; Index++)
+				{
+					const double Delay = GetRandomDelay(Random, Random.RandRange(0, EventScheduler::NUM_WHEELS));
+					Schedule(Random.FRand() < 0.1f ? Time - Delay / 1000.0 : Time + Delay);
+				}
+			}
+
+			// steps from a fraction of a tick up to a turn of the third wheel
+			Time = FMath::Min(Time + GetRandomDelay(Random, Random.RandRange(0, 2)), LastTime + 1.0);
+
+			// the events due by then, in the order they were due and scheduled
+			Due.Reset();
+			for (const FExpectedEvent& Event : Expected)
+			{
+				if (Event.bPending && Event.Time <= Time)
+				{
+					Due.Add(Event.Id);
+				}
+			}
+			Due.Sort([&Expected](int32 A, int32 B)
+			{
+				return Expected[A].Time < Expected[B].Time || (Expected[A].Time == Expected[B].Time && A < B);
+			});
+
+			Scheduler.Advance(Time, Fired);
+			if (Fired.Num() != Due.Num())
+			{
+				AddError(FString::Printf(TEXT("Trial %d at %.4f: %d events fired, %d were due"), Trial, Time, Fired.Num(), Due.Num()));
+				return false;
+			}
+			for (int32 Index = 0; Index < Due.Num(); Index++)
+			{
+				FExpectedEvent& Event = Expected[Due[Index]];
+				if (Fired[Index].Target != GetTarget(Event.Id) || Fired[Index].Time != Event.Time)
+				{
+					AddError(FString::Printf(TEXT("Trial %d at %.4f: event %d of %d fired out of order (due at %.4f)"), Trial, Time, Index, Due.Num(), Event.Time));
+				}
+				Event.bPending = false;
+			}
+
+			// the fired and cancelled events are gone, the rest still wait
+			int32 NumPending = 0;
+			for (const FExpectedEvent& Event : Expected)
+			{
+				NumPending += Event.bPending ? 1 : 0;
+				if (Scheduler.IsScheduled(Event.Handle) != Event.bPending)
+				{
+					AddError(FString::Printf(TEXT("Trial %d at %.4f: event %d is %s"), Trial, Time, Event.Id, Event.bPending ? TEXT("lost") : TEXT("still scheduled")));
+				}
+			}
+			if (Scheduler.GetNumScheduled() != NumPending)
+			{
+				AddError(FString::Printf(TEXT("Trial %d at %.4f: %d events scheduled, %d expected"), Trial, Time, Scheduler.GetNumScheduled(), NumPending));
+			}
+			if (HasAnyErrors())
+			{
+				return false;
+			}
+		}
+
+		if (Scheduler.GetNumScheduled() != 0)
+		{
+			AddError(FString::Printf(TEXT("Trial %d: %d events never fired"), Trial, Scheduler.GetNumScheduled()));
+		}
+	}
+
+	return !HasAnyErrors();
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FEventSchedulerEmptyResetTest, "FIT3094.EventScheduler.EmptyReset",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FEventSchedulerEmptyResetTest::RunTest(const FString& Parameters)
+{
+	// only cancelled events are left, one in the first wheel and one past the last, so Advance starts the clock over
+	EventScheduler Scheduler;
+	TArray<FScheduledEvent> Fired;
+	FEventHandle Near = Scheduler.Schedule(1.0, EScheduledEvent::Arrival, GetTarget(0));
+	FEventHandle Far = Scheduler.Schedule(1.0e6, EScheduledEvent::FoodRespawn, GetTarget(1));
+	const FEventHandle OldNear = Near;
+	Scheduler.Cancel(Near);
+	Scheduler.Cancel(Far);
+	Scheduler.Advance(50.0, Fired);
+	if (Fired.Num() != 0 || Scheduler.GetNumScheduled() != 0 || Scheduler.GetTime() != 50.0)
+	{
+		AddError(FString::Printf(TEXT("Empty advance: %d fired, %d scheduled, time %.2f"), Fired.Num(), Scheduler.GetNumScheduled(), Scheduler.GetTime()));
+	}
+
+	// the next event takes the place of a forgotten one, whose handle must not reach it
+	FEventHandle Next = Scheduler.Schedule(50.5, EScheduledEvent::HealthDecay, GetTarget(2));
+	FEventHandle Stale = OldNear;
+	if (Scheduler.IsScheduled(Stale))
+	{
+		AddError(TEXT("A handle from before the reset matches a new event"));
+	}
+	Scheduler.Cancel(Stale);
+	if (!Scheduler.IsScheduled(Next) || Scheduler.GetNumScheduled() != 1)
+	{
+		AddError(TEXT("Cancelling a handle from before the reset took a new event off"));
+	}
+
+	Scheduler.Advance(50.25, Fired);
+	if (Fired.Num() != 0)
+	{
+		AddError(FString::Printf(TEXT("%d events fired before they were due"), Fired.Num()));
+	}
+	Scheduler.Advance(51.0, Fired);
+	if (Fired.Num() != 1 || Fired[0].Target != GetTarget(2) || Fired[0].Time != 50.5 || Fired[0].Kind != EScheduledEvent::HealthDecay)
+	{
+		AddError(FString::Printf(TEXT("After the reset %d events fired instead of the one due at 50.5"), Fired.Num()));
+	}
+
+	// with nothing left the clock jumps, and events scheduled from there fire on time
+	Scheduler.Advance(2.0e6, Fired);
+	Scheduler.Schedule(2.0e6 + 2.0, EScheduledEvent::Arrival, GetTarget(3));
+	Scheduler.Advance(2.0e6 + 1.0, Fired);
+	if (Fired.Num() != 0 || Scheduler.GetTime() != 2.0e6 + 1.0)
+	{
+		AddError(TEXT("An event fired before it was due after the clock jumped"));
+	}
+	Scheduler.Advance(2.0e6 + 3.0, Fired);
+	if (Fired.Num() != 1 || Fired[0].Target != GetTarget(3))
+	{
+		AddError(TEXT("An event scheduled after the clock jumped did not fire"));
+	}
+
+	return !HasAnyErrors();
+}
+
+#endif
@@ -0,0 +1,109 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "FoodAssignment.h"
+#include "Math/RandomStream.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+	// The cheapest total over every way of matching min(NumRows, NumColumns) rows to distinct columns
+	double BruteForceMinCost(const TArray<double>& Costs, int NumRows, int NumColumns, int Row, int32 UsedColumns, int RowsToSkip)
+	{
+		if (Row == NumRows)
+		{
+			return 0.0;
+		}
+
+		double Best = MAX_dbl;
+		// more rows than columns leaves some rows out
+		if (RowsToSkip > 0)
+		{
+			Best = BruteForceMinCost(Costs, NumRows, NumColumns, Row + 1, UsedColumns, RowsToSkip - 1);
+		}
+		for (int Column = 0; Column < NumColumns; Column++)
+		{
+			if (UsedColumns & (1 << Column))
+			{
+				continue;
+			}
+			const double Rest = BruteForceMinCost(Costs, NumRows, NumColumns, Row + 1, UsedColumns | (1 << Column), RowsToSkip);
+			if (Rest < MAX_dbl)
+			{
+				Best = FMath::Min(Best, Costs[Row * NumColumns + Column] + Rest);
+			}
+		}
+		return Best;
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FFoodAssignmentSolveMinCostTest, "FIT3094.FoodAssignment.SolveMinCost",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FFoodAssignmentSolveMinCostTest::RunTest(const FString& Parameters)
+{
+	// square and rectangular both ways, the empty ones included. Whole costs keep the totals exact
+	FRandomStream Random(3094);
+	TArray<double> Costs;
+	TArray<int32> Columns;
+	for (int NumRows = 0; NumRows <= 6; NumRows++)
+	{
+		for (int NumColumns = 0; NumColumns <= 6; NumColumns++)
+		{
+			for (int Trial = 0; Trial < 20; Trial++)
+			{
+				// few distinct costs make ties, which is where a solver goes wrong most easily
+				const int MaxCost = Trial % 2 == 0 ? 4 : 1000;
+				Costs.SetNum(NumRows * NumColumns);
+				for (double& Cost : Costs)
+				{
+					Cost = Random.RandRange(0, MaxCost);
+				}
+
+				FoodAssignment::SolveMinCost(Costs, NumRows, NumColumns, Columns);
+				if (Columns.Num() != NumRows)
+				{
+					AddError(FString::Printf(TEXT("%dx%d: %d columns for %d rows"), NumRows, NumColumns, Columns.Num(), NumRows));
+					continue;
+				}
+
+				// every column at most once, and as many rows matched as there can be
+				int32 UsedColumns = 0;
+				int32 Matched = 0;
+				double Total = 0.0;
+				for (int Row = 0; Row < NumRows; Row++)
+				{
+					const int32 Column = Columns[Row];
+					if (Column == INDEX_NONE)
+					{
+						continue;
+					}
+					if (Column < 0 || Column >= NumColumns || (UsedColumns & (1 << Column)))
+					{
+						AddError(FString::Printf(TEXT("%dx%d trial %d: row %d given column %d twice or out of range"), NumRows, NumColumns, Trial, Row, Column));
+						continue;
+					}
+					UsedColumns |= 1 << Column;
+					Matched++;
+					Total += Costs[Row * NumColumns + Column];
+				}
+				if (Matched != FMath::Min(NumRows, NumColumns))
+				{
+					AddError(FString::Printf(TEXT("%dx%d trial %d: %d rows matched"), NumRows, NumColumns, Trial, Matched));
+				}
+
+				const double Expected = BruteForceMinCost(Costs, NumRows, NumColumns, 0, 0, FMath::Max(NumRows - NumColumns, 0));
+				if (Total != Expected)
+				{
+					AddError(FString::Printf(TEXT("%dx%d trial %d: total cost %.0f, the cheapest is %.0f"), NumRows, NumColumns, Trial, Total, Expected));
+				}
+			}
+		}
+	}
+
+	return !HasAnyErrors();
+}
+
+#endif